@@ -7,6 +7,9 @@ from app.src.data.reading import ReadingRepository
 from fastapi.responses import StreamingResponse
 from fastapi import WebSocket, WebSocketDisconnect
 from app.src.models.reading import ECGReading
+from app.src.utils.ecg_frame import decode_frame, upsample_linear, FrameDecodeError
+from app.src.utils.link_stats import DeviceLinkStats, server_time_us
+from app.src.utils.device_commands import DeviceCommander, STREAM_FULL, STREAM_PREVIEW
 
 MAX_NUM_OF_FRONTEND_CONNECTIONS = 3
 
@@ -22,16 +25,42 @@ store_reading_flags = {}      # device_id -> bool
 current_sessions = {}         # device_id -> session_id
 reading_buffers = {}          # device_id -> List[float]
 BUFFER_SIZE = 250             # for 125Hz input, this is 2 seconds of data
+heart_rates = {}              # device_id -> {"bpm": float, "rr_interval_ms": int} reported by the device
+device_status = {}            # device_id -> {status type: latest status message} reported by the device
+link_stats: Dict[str, DeviceLinkStats] = {}  # device_id -> latency/loss statistics of the current connection
+device_commanders: Dict[str, DeviceCommander] = {}  # device_id -> command sequencing of the current connection
+
+
+async def _send_device_command(device_id: str, name: str, **params):
+    """
+    Send a command to a connected device; does nothing if it is not connected.
+
+    Args:
+        device_id (str): The ID of the device.
+        name (str): The command name (see app.src.utils.device_commands).
+        **params: The command parameters.
+    """
+    websocket = device_connections.get(device_id)
+    commander = device_commanders.get(device_id)
+    if websocket is None or commander is None:
+        return
+    try:
+        await websocket.send_text(json.dumps(commander.command(name, **params)))
+    except (RuntimeError, WebSocketDisconnect):
+        pass  # Disconnecting; the device gets the current mode when it reconnects
+
 
 async def toggle_reading_store_service(device_id: str, enable: bool):
     """
-    Toggle storing of readings. When enabled, starts a new session.
+    Toggle storing of readings. When enabled, starts a new session. The device streams at its
+    full rate during a session and sends a low-rate preview otherwise.
 
     Args:
         device_id (str): The ID of the device.
         enable (bool): True to enable storing, False to disable.
     """
     store_reading_flags[device_id] = enable
+    await _send_device_command(device_id, "stream", mode=STREAM_FULL if enable else STREAM_PREVIEW)
 
     if enable:
         # New session
@@ -80,10 +109,76 @@ async def get_device_metadata_service(device_id: str) -> List[ECGReading]:
     return metadata_list
 
 
+async def get_link_stats_service(device_id: str) -> dict:
+    """
+    Latency, loss and reordering of a device's stream, with the counters it reports itself.
+
+    Args:
+        device_id (str): The ID of the device.
+
+    Returns:
+        dict: {"link": server-side statistics, "device": latest status messages by type,
+        "commands": command counters of the current connection}.
+    """
+    if device_id not in link_stats:
+        raise HTTPException(status_code=404, detail="No statistics for this device")
+    commander = device_commanders.get(device_id)
+    return {
+        "link": link_stats[device_id].summary(),
+        "device": device_status.get(device_id, {}),
+        "commands": commander.summary() if commander is not None else None,
+    }
+
+
+async def _store_device_points(device_id: str, points: List[float]):
+    """
+    Appends readings to the device's session buffer and flushes full buffers to the database.
+
+    Args:
+        device_id (str): The ID of the device.
+        points (List[float]): The readings to store, oldest first.
+    """
+    buffer = reading_buffers[device_id]
+    buffer.extend(points)
+
+    # Save when buffer reaches threshold
+    while len(buffer) >= BUFFER_SIZE:
+        session_id = current_sessions[device_id]
+
+        if device_id not in session_docs:
+            inserted_id = await ReadingRepository.store_reading_with_array({
+                "device_id": device_id,
+                "session_id": session_id
+            }, buffer[:BUFFER_SIZE])
+            session_docs[device_id] = inserted_id
+        else:
+            await ReadingRepository.append_to_array(session_docs[device_id], buffer[:BUFFER_SIZE])
+
+        del buffer[:BUFFER_SIZE]
+
+
 async def handle_device_websocket_service(websocket: WebSocket):
     """
     Handles WebSocket connections from devices, manages real-time data forwarding to frontend clients,
     and conditionally stores incoming data to the database in buffered batches.
+
+    Devices either send one reading per text message (legacy firmware) or batches of readings
+    as binary frames (see app.src.utils.ecg_frame). Batches are forwarded to the frontend as a
+    JSON array in a single text message. Text messages holding a JSON object are device
+    status reports and are kept in `device_status` instead. Backfilled frames, captured while the device was
+    offline, are stored but not forwarded, since they are no longer live. Lead events are kept
+    in `device_status` under "lead_off" and forwarded live as {"type": "lead_off", "off": bool}.
+    Frames sent at a lowered rate by the adaptive uplink are interpolated back to the full rate
+    from the device's latest "uplink_rate" report before being forwarded or stored.
+    Multi-channel frames, from devices recording several leads, are forwarded and stored as
+    their first lead.
+
+    Every TIME_SYNC_INTERVAL_S the device is sent a time-sync request; its replies and the
+    frame timestamps feed the per-device `link_stats`.
+
+    On connecting, the device is told to stream at its full rate if a session is recording and
+    to send a preview otherwise (see app.src.utils.device_commands). Command acks are kept in
+    `device_status` under "command_ack"; overdue commands are resent.
     """
     await websocket.accept()
     device_id = websocket.query_params.get("device_id")
@@ -92,48 +187,94 @@ async def handle_device_websocket_service(websocket: WebSocket):
         return
 
     device_connections[device_id] = websocket
+    stats = DeviceLinkStats()  # Sequence numbers restart when the device reboots
+    link_stats[device_id] = stats
+    commander = DeviceCommander()  # The device numbers commands per connection
+    device_commanders[device_id] = commander
 
     # print(f"Device {device_id} connected.")
 
     try:
-        inserted_id = ""
+        streaming = STREAM_FULL if store_reading_flags.get(device_id) else STREAM_PREVIEW
+        await _send_device_command(device_id, "stream", mode=streaming)
+
         while True:
-            data = await websocket.receive_text()
-            data_point = json.loads(data)
+            if stats.time_sync_due():
+                await websocket.send_text(json.dumps(stats.time_sync_request()))
+            for command in commander.resend_due():
+                await websocket.send_text(json.dumps(command))
+
+            message = await websocket.receive()
+            received_us = server_time_us()
+            if message["type"] == "websocket.disconnect":
+                raise WebSocketDisconnect(message.get("code", 1000))
+
+            frame = None
+            if message.get("bytes") is not None:
+                try:
+                    frame = decode_frame(message["bytes"])
+                except FrameDecodeError:
+                    # print(f"Dropping malformed frame from {device_id}: {e}")
+                    continue
+                points = frame.samples
+                stats.on_frame(frame, received_us)
+                if frame.is_lead_event:
+                    device_status.setdefault(device_id, {})["lead_off"] = {
+                        "type": "lead_off",
+                        "off": frame.leads_off,
+                        "time_us": frame.start_time_us,
+                    }
+                    if not frame.is_backfill and device_id in frontend_connections:
+                        event = json.dumps({"type": "lead_off", "off": frame.leads_off})
+                        for client_ws in frontend_connections[device_id]:
+                            await client_ws.send_text(event)
+                    continue
+                full_rate_hz = device_status.get(device_id, {}).get("uplink_rate", {}).get("full_rate_hz")
+                if full_rate_hz and frame.sample_rate_hz and full_rate_hz % frame.sample_rate_hz == 0:
+                    points = upsample_linear(points, full_rate_hz // frame.sample_rate_hz)
+                if frame.is_backfill:
+                    if store_reading_flags.get(device_id):
+                        await _store_device_points(device_id, [float(p) for p in points])
+                    continue
+                data = json.dumps(points)
+                if frame.heart_rate_bpm is not None:
+                    heart_rates[device_id] = {
+                        "bpm": frame.heart_rate_bpm,
+                        "rr_interval_ms": frame.rr_interval_ms,
+                    }
+            else:
+                data = message.get("text") or ""
+                payload = json.loads(data)
+                if isinstance(payload, dict):
+                    if payload.get("type") == "time_sync":
+                        stats.on_time_sync(payload, received_us)
+                        continue
+                    if payload.get("type") == "command_ack":
+                        commander.on_ack(payload)
+                    # Device status message, e.g. {"type": "task_stats", ...}
+                    device_status.setdefault(device_id, {})[payload.get("type", "unknown")] = payload
+                    continue
+                points = [payload]
 
             # Forward to frontend
             if device_id in frontend_connections:
                 for client_ws in frontend_connections[device_id]:
                     await client_ws.send_text(data)
+                if frame is not None:
+                    stats.on_forwarded(frame, server_time_us())
 
             # Store to DB if toggled on
             if store_reading_flags.get(device_id):
-                # if not isinstance(data_point, (int, float)): # it slows down the process
-                # data_point = data_point.get("value")
-                # if data_point is None:
-                #     continue
-
-                reading_buffers[device_id].append(float(data_point))
-
-                # Save when buffer reaches threshold
-                if len(reading_buffers[device_id]) >= BUFFER_SIZE:
-                    session_id = current_sessions[device_id]
-                    reading_buffers[device_id][:BUFFER_SIZE]
-
-                    if device_id not in session_docs:
-                        inserted_id = await ReadingRepository.store_reading_with_array({
-                            "device_id": device_id,
-                            "session_id": session_id
-                        }, reading_buffers[device_id][:BUFFER_SIZE])
-                        session_docs[device_id] = inserted_id
-                    else:
-                        await ReadingRepository.append_to_array(inserted_id, reading_buffers[device_id][:BUFFER_SIZE])
-
-                    reading_buffers[device_id].clear()
+                await _store_device_points(device_id, [float(p) for p in points])
 
     except WebSocketDisconnect:
         # print(f"Device {device_id} disconnected.")
-        device_connections.pop(device_id, None)
+        # The device may already have reconnected; leave the new connection's entries alone.
+        # link_stats keeps the figures of the last connection for get_link_stats_service().
+        if device_connections.get(device_id) is websocket:
+            device_connections.pop(device_id)
+        if device_commanders.get(device_id) is commander:
+            device_commanders.pop(device_id)
 
         # Handle pending buffer if session was active
         if store_reading_flags.get(device_id):
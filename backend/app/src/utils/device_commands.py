@@ -0,0 +1,127 @@
+import time
+from typing import Dict, List, Optional
+
+"""
+Commands the server sends a device over its WebSocket to change acquisition and streaming.
+
+A command is {"type": "command", "seq": n, "name": ..., <parameters>} and the device answers
+each one with {"type": "command_ack", "seq": n, "name": ..., "status": "ok" | "error" |
+"duplicate"}, plus an "error" message when rejected. Sequence numbers increase within a
+connection and the device applies a command once, so a command whose ack went missing can be
+resent unchanged: the device repeats its "ok" or "error", or answers "duplicate" while it is
+still applying the command, whose final status then follows. A command rejected on arrival
+(malformed, or too many pending) does not use up its number.
+
+Commands:
+    stream       mode: "full", "preview" (about 25 Hz, once a second) or "off"
+    batch        samples, delay_ms, compress
+    acquisition  sample_rate_hz, mains_hz, high_pass, notch, low_pass; acked once the first
+                 sample at the new settings has been sent
+"""
+
+COMMAND_RESEND_S = 5   # An unacknowledged command is sent again after this long
+COMMAND_MAX_SENDS = 3  # ...and given up on after this many sends
+COMMAND_MAX_WAIT_S = 60  # How long a command the device is still applying may take
+
+STREAM_FULL = "full"
+STREAM_PREVIEW = "preview"
+STREAM_OFF = "off"
+
+
+class DeviceCommander:
+    """
+    Command sequencing for one device connection.
+
+    Attributes:
+        acked (int): Commands the device accepted.
+        rejected (int): Commands the device answered with an error.
+        abandoned (int): Commands given up on after COMMAND_MAX_SENDS sends without an ack, or
+            COMMAND_MAX_WAIT_S without a final status once the device reported it in progress.
+        last_error (Optional[dict]): The last rejected command and the device's reason.
+    """
+
+    def __init__(self):
+        self.acked = 0
+        self.rejected = 0
+        self.abandoned = 0
+        self.last_error: Optional[dict] = None
+        self._next_seq = 1
+        self._pending: Dict[int, dict] = {}  # seq -> {"message", "first_s", "sent_s", "sends", "applying"}
+
+    def command(self, name: str, **params) -> dict:
+        """
+        Build a command and keep it until acknowledged.
+
+        Args:
+            name (str): The command name, e.g. "stream".
+            **params: Its parameters, e.g. mode="preview".
+
+        Returns:
+            dict: The message to send to the device as JSON text.
+        """
+        message = {"type": "command", "seq": self._next_seq, "name": name, **params}
+        now = time.monotonic()
+        self._pending[self._next_seq] = {"message": message, "first_s": now, "sent_s": now, "sends": 1, "applying": False}
+        self._next_seq += 1
+        return message
+
+    def resend_due(self) -> List[dict]:
+        """
+        Commands to send again because their ack is overdue.
+
+        Returns:
+            List[dict]: The messages, unchanged, so the device recognizes a repeat.
+        """
+        now = time.monotonic()
+        due = []
+        for seq, entry in list(self._pending.items()):
+            if now - entry["sent_s"] < COMMAND_RESEND_S:
+                continue
+            if entry["applying"]:
+                given_up = now - entry["first_s"] >= COMMAND_MAX_WAIT_S
+            else:
+                given_up = entry["sends"] >= COMMAND_MAX_SENDS
+            if given_up:
+                del self._pending[seq]
+                self.abandoned += 1
+                continue
+            entry["sent_s"] = now
+            entry["sends"] += 1
+            due.append(entry["message"])
+        return due
+
+    def on_ack(self, ack: dict) -> Optional[dict]:
+        """
+        Record a command_ack from the device.
+
+        Args:
+            ack (dict): The ack message.
+
+        Returns:
+            Optional[dict]: The acknowledged command, or None if it was not pending or the
+            device is still applying it.
+        """
+        if ack.get("status") == "duplicate":
+            entry = self._pending.get(ack.get("seq"))
+            if entry is not None:
+                entry["applying"] = True  # Keep waiting for "ok" or "error"
+            return None
+        entry = self._pending.pop(ack.get("seq"), None)
+        if entry is None:
+            return None
+        if ack.get("status") == "error":
+            self.rejected += 1
+            self.last_error = {"command": entry["message"], "error": ack.get("error")}
+        else:
+            self.acked += 1
+        return entry["message"]
+
+    def summary(self) -> dict:
+        """Current command counters as a JSON-serializable dict."""
+        return {
+            "pending": len(self._pending),
+            "acked": self.acked,
+            "rejected": self.rejected,
+            "abandoned": self.abandoned,
+            "last_error": self.last_error,
+        }
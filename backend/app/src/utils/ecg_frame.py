@@ -0,0 +1,275 @@
+import struct
+from dataclasses import dataclass, field
+from typing import List, Optional, Tuple
+
+"""
+Reference decoder for the binary ECG frames sent by the device firmware.
+
+The layout must match firmware/ecg_firmware/include/ECGFrame.h:
+
+    version(u8) type(u8) flags(u8) channels(u8) sequence(u32)
+    start_time_us(u64) sample_rate_hz(u16) sample_count(u16)
+    samples(u16 * count, or delta-zigzag-varint if FLAG_DELTA_VARINT)
+    [lead_off_bitmap(ceil(count / 8)) if FLAG_LEAD_OFF]
+    [bpm_x10(u16) rr_ms(u16) beat_count(u8) beat_index(u8 * beat_count) if FLAG_HEART_RATE]
+    [earlier_count(u8) earlier_beat_us(u32 * earlier_count) if FLAG_EARLIER_BEATS]
+    [send_delay_us(u32) if FLAG_SEND_TIME]
+
+A lead event (FRAME_TYPE_LEAD_EVENT) has the same header with no samples: FLAG_LEAD_OFF
+tells whether the leads came off or were reattached at start_time_us.
+
+A multi-channel frame (FRAME_TYPE_MULTI_SAMPLES) carries `count` samples of each of its
+`channels` leads: one sample block per channel, each coded as above with its own predictor,
+then one lead-off bitmap per channel if FLAG_LEAD_OFF, then the usual trailers. Other frames
+have channels 0.
+
+Beat indices point at the sample of each beat's R peak. A beat the device confirmed only
+after that sample had been sent (search-back finds beats up to ~1.7 R-R intervals late) is
+listed in the earlier-beats trailer of a later frame instead, as the time from its R peak
+back to start_time_us.
+
+All fields are little-endian. The varint codec matches firmware/ecg_firmware/include/ECGCodec.h."""
+
+FRAME_VERSION = 1
+HEADER_FORMAT = "<BBBBIQHH"
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)  # 20 bytes
+
+FRAME_TYPE_SAMPLES = 1
+FRAME_TYPE_LEAD_EVENT = 2
+FRAME_TYPE_MULTI_SAMPLES = 3
+
+FLAG_LEAD_OFF = 0x01
+FLAG_DELTA_VARINT = 0x02
+FLAG_HEART_RATE = 0x04
+FLAG_BACKFILL = 0x08  # Frame was spooled on the device while offline and is sent late
+FLAG_SEND_TIME = 0x10  # Send-time trailer appended
+FLAG_EARLIER_BEATS = 0x20  # Earlier-beats trailer appended
+
+MAX_VARINT_BYTES = 3
+
+
+class FrameDecodeError(ValueError):
+    """Raised when a binary frame is malformed or uses an unknown version."""
+
+
+@dataclass
+class ECGFrame:
+    """
+    A decoded batch of ECG samples.
+    Attributes:
+        frame_type (int): One of the FRAME_TYPE_* constants.
+        flags (int): Bitwise OR of the FLAG_* constants.
+        sequence (int): Frame sequence number, incremented by the device for every frame.
+        start_time_us (int): Device monotonic time of the first sample, in microseconds.
+        sample_rate_hz (int): Sampling rate of the samples.
+        samples (List[int]): Raw ADC values, oldest first; the first lead of a multi-channel frame.
+        lead_off (List[bool]): Per-sample lead-off state of `samples`; empty when no lead was off.
+        channels (List[List[int]]): Every lead of a multi-channel frame, `samples` first; empty otherwise.
+        channel_lead_off (List[List[bool]]): Per-sample lead-off state of each lead in `channels`;
+            empty when no lead was off.
+        heart_rate_bpm (Optional[float]): Instantaneous heart rate reported by the device, if known.
+        rr_interval_ms (Optional[int]): Last R-R interval reported by the device, if known.
+        beat_indices (List[int]): Indices into `samples` of the R peaks of the beats the device detected.
+        earlier_beat_times_us (List[int]): Device times of R peaks in frames received before this one,
+            for beats confirmed after those frames were sent.
+        send_delay_us (Optional[int]): Time from the first sample to the frame being sent, if reported.
+    """
+    frame_type: int
+    flags: int
+    sequence: int
+    start_time_us: int
+    sample_rate_hz: int
+    samples: List[int] = field(default_factory=list)
+    lead_off: List[bool] = field(default_factory=list)
+    channels: List[List[int]] = field(default_factory=list)
+    channel_lead_off: List[List[bool]] = field(default_factory=list)
+    heart_rate_bpm: Optional[float] = None
+    rr_interval_ms: Optional[int] = None
+    beat_indices: List[int] = field(default_factory=list)
+    earlier_beat_times_us: List[int] = field(default_factory=list)
+    send_delay_us: Optional[int] = None
+
+    @property
+    def is_backfill(self) -> bool:
+        """True if the frame was captured while the device was offline."""
+        return bool(self.flags & FLAG_BACKFILL)
+
+    @property
+    def is_lead_event(self) -> bool:
+        """True if the frame reports a lead-off change instead of carrying samples."""
+        return self.frame_type == FRAME_TYPE_LEAD_EVENT
+
+    @property
+    def leads_off(self) -> bool:
+        """For a lead event, True if the leads came off and False if they were reattached."""
+        return bool(self.flags & FLAG_LEAD_OFF)
+
+    @property
+    def send_time_us(self) -> Optional[int]:
+        """Device monotonic time at which the frame was sent, if reported."""
+        if self.send_delay_us is None:
+            return None
+        return self.start_time_us + self.send_delay_us
+
+
+def decode_delta_varint(data: bytes, offset: int, count: int) -> Tuple[List[int], int]:
+    """
+    Decode `count` delta-zigzag-varint coded values, with the predictor starting at 0.
+
+    Args:
+        data (bytes): The buffer holding the coded values.
+        offset (int): Where the first coded value starts.
+        count (int): Number of values to decode.
+
+    Returns:
+        Tuple[List[int], int]: The decoded values and the offset just past the last one.
+
+    Raises:
+        FrameDecodeError: If the data ends early or a value is over-long.
+    """
+    values = []
+    previous = 0
+    for _ in range(count):
+        zigzag = 0
+        shift = 0
+        while True:
+            if offset >= len(data) or shift >= 7 * MAX_VARINT_BYTES:
+                raise FrameDecodeError("Malformed varint sample data")
+            byte = data[offset]
+            offset += 1
+            zigzag |= (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+                break
+        delta = (zigzag >> 1) ^ -(zigzag & 1)
+        previous = (previous + delta) & 0xFFFF
+        values.append(previous)
+    return values, offset
+
+
+def upsample_linear(values: List[int], factor: int) -> List[int]:
+    """
+    Restore a decimated signal to `factor` times its rate by linear interpolation.
+
+    The device lowers its output rate on a congested link (see ECGWebSocket.h); this gives
+    the frontend and the database the rate they expect. The last value is held, since the
+    next one arrives in the following frame.
+
+    Args:
+        values (List[int]): The decimated samples, oldest first.
+        factor (int): The decimation factor the device applied.
+
+    Returns:
+        List[int]: len(values) * factor samples.
+    """
+    if factor <= 1 or not values:
+        return list(values)
+    upsampled = []
+    for current, following in zip(values, values[1:] + values[-1:]):
+        for step in range(factor):
+            upsampled.append(current + round((following - current) * step / factor))
+    return upsampled
+
+
+def decode_frame(data: bytes) -> ECGFrame:
+    """
+    Decode a binary ECG frame.
+
+    Args:
+        data (bytes): The raw WebSocket binary message.
+
+    Returns:
+        ECGFrame: The decoded frame.
+
+    Raises:
+        FrameDecodeError: If the frame is truncated or has an unsupported version.
+    """
+    if len(data) < HEADER_SIZE:
+        raise FrameDecodeError("Frame shorter than header")
+
+    (version, frame_type, flags, channel_count, sequence,
+     start_time_us, sample_rate_hz, count) = struct.unpack_from(HEADER_FORMAT, data, 0)
+    if version != FRAME_VERSION:
+        raise FrameDecodeError(f"Unsupported frame version {version}")
+
+    if frame_type == FRAME_TYPE_LEAD_EVENT:
+        # FLAG_LEAD_OFF is the event itself; there is no bitmap
+        return ECGFrame(frame_type=frame_type, flags=flags, sequence=sequence,
+                        start_time_us=start_time_us, sample_rate_hz=sample_rate_hz)
+
+    multi_channel = frame_type == FRAME_TYPE_MULTI_SAMPLES
+    if multi_channel and channel_count == 0:
+        raise FrameDecodeError("Multi-channel frame without channels")
+    blocks = channel_count if multi_channel else 1
+
+    offset = HEADER_SIZE
+    channels: List[List[int]] = []
+    for _ in range(blocks):
+        if flags & FLAG_DELTA_VARINT:
+            values, offset = decode_delta_varint(data, offset, count)
+        else:
+            if len(data) < offset + 2 * count:
+                raise FrameDecodeError("Frame truncated in sample data")
+            values = list(struct.unpack_from(f"<{count}H", data, offset))
+            offset += 2 * count
+        channels.append(values)
+
+    channel_lead_off: List[List[bool]] = []
+    if flags & FLAG_LEAD_OFF:
+        for _ in range(blocks):
+            bitmap = data[offset:offset + (count + 7) // 8]
+            if len(bitmap) < (count + 7) // 8:
+                raise FrameDecodeError("Frame truncated in lead-off bitmap")
+            channel_lead_off.append([bool(bitmap[i >> 3] & (1 << (i & 7))) for i in range(count)])
+            offset += len(bitmap)
+    samples = channels[0]
+    lead_off = channel_lead_off[0] if channel_lead_off else []
+
+    heart_rate_bpm = None
+    rr_interval_ms = None
+    beat_indices: List[int] = []
+    if flags & FLAG_HEART_RATE:
+        if len(data) < offset + 5:
+            raise FrameDecodeError("Frame truncated in heart-rate trailer")
+        bpm_x10, rr_ms, beat_count = struct.unpack_from("<HHB", data, offset)
+        offset += 5
+        if len(data) < offset + beat_count:
+            raise FrameDecodeError("Frame truncated in beat list")
+        beat_indices = list(data[offset:offset + beat_count])
+        heart_rate_bpm = bpm_x10 / 10 if bpm_x10 else None
+        rr_interval_ms = rr_ms or None
+        offset += beat_count
+
+    earlier_beat_times_us: List[int] = []
+    if flags & FLAG_EARLIER_BEATS:
+        if len(data) < offset + 1:
+            raise FrameDecodeError("Frame truncated in earlier-beats trailer")
+        earlier_count = data[offset]
+        offset += 1
+        if len(data) < offset + 4 * earlier_count:
+            raise FrameDecodeError("Frame truncated in earlier-beats list")
+        earlier_beat_times_us = [start_time_us - delta for delta in struct.unpack_from(f"<{earlier_count}I", data, offset)]
+        offset += 4 * earlier_count
+
+    send_delay_us = None
+    if flags & FLAG_SEND_TIME:
+        if len(data) < offset + 4:
+            raise FrameDecodeError("Frame truncated in send-time trailer")
+        (send_delay_us,) = struct.unpack_from("<I", data, offset)
+
+    return ECGFrame(
+        frame_type=frame_type,
+        flags=flags,
+        sequence=sequence,
+        start_time_us=start_time_us,
+        sample_rate_hz=sample_rate_hz,
+        samples=samples,
+        lead_off=lead_off,
+        channels=channels if multi_channel else [],
+        channel_lead_off=channel_lead_off if multi_channel else [],
+        heart_rate_bpm=heart_rate_bpm,
+        rr_interval_ms=rr_interval_ms,
+        beat_indices=beat_indices,
+        earlier_beat_times_us=earlier_beat_times_us,
+        send_delay_us=send_delay_us,
+    )
@@ -0,0 +1,215 @@
+import time
+from collections import deque
+from typing import Deque, Dict, Optional, Set
+
+from app.src.utils.ecg_frame import ECGFrame
+
+"""
+Per-device link statistics: clock offset, one-way latency, loss and reordering.
+
+The device clock is measured with time-sync exchanges: the server sends
+{"type": "time_sync", "server_us": t0} and the device answers with the same message
+plus "device_us", its monotonic time when replying. If the reply arrives at t3,
+the device clock is ahead of the server clock by about device_us - (t0 + t3) / 2, with
+an error of at most half the round trip, so the sample with the shortest round trip wins.
+
+Frame timestamps come from a wrapping 32-bit device clock that is widened on the device,
+so latencies are computed modulo 2^32 microseconds (about 71 minutes).
+"""
+
+TIME_SYNC_INTERVAL_S = 10   # How often the server asks the device for its clock
+TIME_SYNC_SAMPLES = 8       # Recent exchanges kept; the one with the shortest round trip is used
+LATENCY_WINDOW = 1000       # Recent latencies kept for the percentiles
+MAX_TRACKED_GAP = 4096      # Larger sequence gaps are counted as lost without tracking each frame
+
+DEVICE_CLOCK_MASK = (1 << 32) - 1
+
+
+def server_time_us() -> int:
+    """Server monotonic time in microseconds."""
+    return time.monotonic_ns() // 1000
+
+
+def _summarize(values: Deque[int]) -> Optional[Dict[str, float]]:
+    """
+    Summarize a window of latencies.
+
+    Args:
+        values (Deque[int]): Latencies in microseconds.
+
+    Returns:
+        Optional[Dict[str, float]]: min/mean/p50/p95/max in milliseconds, or None if empty.
+    """
+    if not values:
+        return None
+    ordered = sorted(values)
+    count = len(ordered)
+    return {
+        "count": count,
+        "min_ms": ordered[0] / 1000,
+        "mean_ms": sum(ordered) / count / 1000,
+        "p50_ms": ordered[count // 2] / 1000,
+        "p95_ms": ordered[min(count - 1, (count * 95) // 100)] / 1000,
+        "max_ms": ordered[-1] / 1000,
+    }
+
+
+class DeviceLinkStats:
+    """
+    Link statistics of one device connection.
+
+    Attributes:
+        frames_received (int): Live frames received.
+        frames_backfilled (int): Backfilled frames received.
+        frames_lost (int): Live frames missing from the sequence that were not received at all.
+        frames_reordered (int): Live frames that arrived after a later one.
+        frames_duplicated (int): Frames received twice.
+        frames_recovered (int): Missing frames that arrived later as backfill.
+    """
+
+    def __init__(self):
+        self.frames_received = 0
+        self.frames_backfilled = 0
+        self.frames_lost = 0
+        self.frames_reordered = 0
+        self.frames_duplicated = 0
+        self.frames_recovered = 0
+        self._next_sequence: Optional[int] = None
+        self._missing: Set[int] = set()
+        self._sync_samples: Deque[tuple] = deque(maxlen=TIME_SYNC_SAMPLES)  # (rtt_us, offset_us)
+        self._last_sync_request_s: Optional[float] = None
+        self._capture_latency: Deque[int] = deque(maxlen=LATENCY_WINDOW)
+        self._network_latency: Deque[int] = deque(maxlen=LATENCY_WINDOW)
+        self._frontend_latency: Deque[int] = deque(maxlen=LATENCY_WINDOW)
+
+    def time_sync_due(self) -> bool:
+        """True if a new time-sync request should be sent."""
+        now = time.monotonic()
+        return self._last_sync_request_s is None or now - self._last_sync_request_s >= TIME_SYNC_INTERVAL_S
+
+    def time_sync_request(self) -> dict:
+        """
+        Build a time-sync request and note when it was sent.
+
+        Returns:
+            dict: The message to send to the device as JSON text.
+        """
+        self._last_sync_request_s = time.monotonic()
+        return {"type": "time_sync", "server_us": server_time_us()}
+
+    def on_time_sync(self, reply: dict, received_us: int):
+        """
+        Record a time-sync reply from the device.
+
+        Args:
+            reply (dict): The reply, holding "server_us" and "device_us".
+            received_us (int): Server time at which the reply was received.
+        """
+        try:
+            sent_us = int(reply["server_us"])
+            device_us = int(reply["device_us"])
+        except (KeyError, TypeError, ValueError):
+            return
+        rtt_us = received_us - sent_us
+        if rtt_us < 0:
+            return
+        self._sync_samples.append((rtt_us, device_us - (sent_us + received_us) // 2))
+
+    @property
+    def clock_offset_us(self) -> Optional[int]:
+        """Device clock minus server clock, from the exchange with the shortest round trip."""
+        if not self._sync_samples:
+            return None
+        return min(self._sync_samples)[1]
+
+    @property
+    def clock_rtt_us(self) -> Optional[int]:
+        """Shortest recent time-sync round trip."""
+        if not self._sync_samples:
+            return None
+        return min(self._sync_samples)[0]
+
+    def _device_age_us(self, device_time_us: int, server_us: int) -> Optional[int]:
+        """Age at server time `server_us` of an event at `device_time_us`, or None without a clock offset."""
+        offset = self.clock_offset_us
+        if offset is None:
+            return None
+        return (server_us + offset - device_time_us) & DEVICE_CLOCK_MASK
+
+    def on_frame(self, frame: ECGFrame, received_us: int):
+        """
+        Update loss, reordering and latency with a received frame.
+
+        Args:
+            frame (ECGFrame): The decoded frame.
+            received_us (int): Server time at which the frame was received.
+        """
+        sequence = frame.sequence
+        if frame.is_backfill:
+            self.frames_backfilled += 1
+            if sequence in self._missing:
+                self._missing.discard(sequence)
+                self.frames_recovered += 1
+            return
+
+        self.frames_received += 1
+        if self._next_sequence is None or sequence == self._next_sequence:
+            self._next_sequence = sequence + 1
+        elif sequence > self._next_sequence:
+            gap = sequence - self._next_sequence
+            if gap <= MAX_TRACKED_GAP:
+                self._missing.update(range(self._next_sequence, sequence))
+            else:
+                self.frames_lost += gap
+            self._next_sequence = sequence + 1
+        elif sequence in self._missing:
+            self._missing.discard(sequence)
+            self.frames_reordered += 1
+        else:
+            self.frames_duplicated += 1
+
+        if len(self._missing) > MAX_TRACKED_GAP:
+            # Give up on the oldest gaps
+            for stale in sorted(self._missing)[:len(self._missing) - MAX_TRACKED_GAP]:
+                self._missing.discard(stale)
+                self.frames_lost += 1
+
+        capture_age = self._device_age_us(frame.start_time_us, received_us)
+        if capture_age is not None:
+            self._capture_latency.append(capture_age)
+            if frame.send_time_us is not None:
+                self._network_latency.append(self._device_age_us(frame.send_time_us, received_us))
+
+    def on_forwarded(self, frame: ECGFrame, forwarded_us: int):
+        """
+        Record when a live frame was handed to the frontend connections.
+
+        Args:
+            frame (ECGFrame): The forwarded frame.
+            forwarded_us (int): Server time at which forwarding finished.
+        """
+        age = self._device_age_us(frame.start_time_us, forwarded_us)
+        if age is not None:
+            self._frontend_latency.append(age)
+
+    def summary(self) -> dict:
+        """
+        Current statistics as a JSON-serializable dict.
+
+        Latencies are measured from the first sample of each frame ("capture"), or from the
+        moment the device sent it ("network"), to its receipt by the server, and from the
+        first sample to the end of forwarding to the frontend ("frontend").
+        """
+        return {
+            "frames_received": self.frames_received,
+            "frames_backfilled": self.frames_backfilled,
+            "frames_lost": self.frames_lost + len(self._missing),
+            "frames_reordered": self.frames_reordered,
+            "frames_duplicated": self.frames_duplicated,
+            "frames_recovered": self.frames_recovered,
+            "clock_offset_us": self.clock_offset_us,
+            "clock_rtt_us": self.clock_rtt_us,
+            "capture_latency": _summarize(self._capture_latency),
+            "network_latency": _summarize(self._network_latency),
+            "frontend_latency": _summarize(self._frontend_latency),
+        }
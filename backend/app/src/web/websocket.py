@@ -4,6 +4,7 @@ from fastapi import Depends, HTTPException, status
 from app.src.service.readings_service import (
     toggle_reading_store_service,
     download_ecg_service,
+    get_link_stats_service,
     handle_device_websocket_service,
     handle_frontend_websocket_service
 )
@@ -42,6 +43,16 @@ async def download_ecg(session_id: str, token: str = Depends(oauth2_scheme)):
     """
     return await download_ecg_service(session_id)
 
+@router.get("/readings/link_stats/{device_id}")
+async def get_link_stats(device_id: str, token: str = Depends(oauth2_scheme)):
+    """
+    Latency, loss and reordering of a device's stream, with the counters the device reports.
+
+    Args:
+        `device_id` (str): The unique identifier for the device.
+    """
+    return await get_link_stats_service(device_id)
+
 @router.websocket("/ws/device")
 async def device_ws(websocket: WebSocket):
     """
@@ -0,0 +1,125 @@
+// Arduino.h
+// Host replacement for the Arduino core API used by the firmware, for the native environment.
+
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define LOW 0x0
+#define HIGH 0x1
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define IRAM_ATTR
+
+/**
+ * @brief Subset of the Arduino String class, backed by std::string.
+ */
+class String {
+public:
+    String() {}
+    String(const char *text) : _text(text != nullptr ? text : "") {}
+    String(const std::string &text) : _text(text) {}
+    String(char c) : _text(1, c) {}
+    String(int value) : _text(std::to_string(value)) {}
+    String(unsigned int value) : _text(std::to_string(value)) {}
+    String(long value) : _text(std::to_string(value)) {}
+    String(unsigned long value) : _text(std::to_string(value)) {}
+    String(float value, unsigned int decimals = 2) : String(static_cast<double>(value), decimals) {}
+    String(double value, unsigned int decimals = 2) {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+        _text = buffer;
+    }
+
+    const char *c_str() const { return _text.c_str(); }
+    unsigned int length() const { return static_cast<unsigned int>(_text.size()); }
+    bool isEmpty() const { return _text.empty(); }
+    bool reserve(unsigned int size) { _text.reserve(size); return true; }
+    char operator[](unsigned int index) const { return index < _text.size() ? _text[index] : 0; }
+    long toInt() const { return strtol(_text.c_str(), nullptr, 10); }
+    int indexOf(const char *needle) const {
+        size_t at = _text.find(needle);
+        return at == std::string::npos ? -1 : static_cast<int>(at);
+    }
+
+    bool concat(const char *text) { _text += text; return true; }
+    bool concat(const char *text, unsigned int length) { _text.append(text, length); return true; }
+    bool concat(char c) { _text += c; return true; }
+    String &operator+=(const String &other) { _text += other._text; return *this; }
+    String &operator+=(const char *text) { _text += text; return *this; }
+    String &operator+=(char c) { _text += c; return *this; }
+
+    friend String operator+(const String &a, const String &b) { return String(a._text + b._text); }
+    bool operator==(const String &other) const { return _text == other._text; }
+    bool operator==(const char *text) const { return _text == (text != nullptr ? text : ""); }
+    bool operator!=(const String &other) const { return !(*this == other); }
+    bool operator!=(const char *text) const { return !(*this == text); }
+
+private:
+    std::string _text;
+};
+
+// Type of String concatenation results in the Arduino core; ArduinoJson refers to it.
+class StringSumHelper : public String {
+public:
+    StringSumHelper(const String &value) : String(value) {}
+};
+
+/**
+ * @brief Serial port replacement that writes to stdout.
+ */
+class HardwareSerial {
+public:
+    void begin(unsigned long) {}
+    size_t print(const char *text) { return fputs(text, stdout) >= 0 ? strlen(text) : 0; }
+    size_t print(const String &text) { return print(text.c_str()); }
+    size_t print(long value) { return printf("%ld", value); }
+    size_t println(const char *text = "") { return print(text) + print("\n"); }
+    size_t println(const String &text) { return println(text.c_str()); }
+    size_t println(long value) { return print(value) + print("\n"); }
+    template <typename... Args>
+    size_t printf(const char *format, Args... args) { return ::printf(format, args...); }
+};
+
+extern HardwareSerial Serial;
+
+// Flash-resident data is ordinary memory on the host
+#define PROGMEM
+
+// Time (simulated; see NativeHAL.h)
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+// CPU clock (recorded only; the simulated clock does not depend on it)
+bool setCpuFrequencyMhz(uint32_t cpuFreqMhz);
+uint32_t getCpuFrequencyMhz();
+
+// GPIO and ADC (driven by the simulation; see NativeHAL.h)
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+uint16_t analogRead(uint8_t pin);
+bool ledcAttach(uint8_t pin, uint32_t frequency, uint8_t resolution);
+bool ledcWrite(uint8_t pin, uint32_t duty);
+int digitalPinToInterrupt(uint8_t pin);
+void attachInterrupt(uint8_t interrupt, void (*handler)(), int mode);
+void attachInterruptArg(uint8_t pin, void (*handler)(void *), void *arg, int mode);
+void detachInterrupt(uint8_t interrupt);
+void noInterrupts();
+void interrupts();
+
+#endif // NATIVE_ARDUINO_H
@@ -0,0 +1,277 @@
+// ArduinoWebsockets.h
+// Host replacement for the ArduinoWebsockets client, connected to an in-process loopback server.
+
+#ifndef NATIVE_ARDUINO_WEBSOCKETS_H
+#define NATIVE_ARDUINO_WEBSOCKETS_H
+
+#include <Arduino.h>
+#include <esp_random.h>
+#include <deque>
+#include <functional>
+#include <string>
+#include "NativeHAL.h"
+
+namespace websockets {
+
+enum class WebsocketsEvent {
+    ConnectionOpened,
+    ConnectionClosed,
+    GotPing,
+    GotPong
+};
+
+enum class MessageType {
+    Empty,
+    Text,
+    Binary,
+    Ping,
+    Pong,
+    Close
+};
+
+/**
+ * @brief A received message.
+ */
+class WebsocketsMessage {
+public:
+    WebsocketsMessage(MessageType type = MessageType::Empty, const std::string &payload = std::string())
+        : _type(type), _payload(payload), _data(payload) {}
+
+    MessageType type() const { return _type; }
+    bool isEmpty() const { return _type == MessageType::Empty; }
+    bool isText() const { return _type == MessageType::Text; }
+    bool isBinary() const { return _type == MessageType::Binary; }
+    const String &data() const { return _data; }
+    const std::string &rawData() const { return _payload; }
+    size_t length() const { return _payload.size(); }
+
+private:
+    MessageType _type;
+    std::string _payload;
+    String _data;
+};
+
+/**
+ * @brief The server end of the loopback transport.
+ *
+ * Every WebsocketsClient in the process talks to this one server. It counts traffic,
+ * passes each message to optional hooks, and queues messages for the client, which
+ * receives them on its next poll().
+ *
+ * The transport is instant by default. With a bytesPerSecond limit in `transport`,
+ * client sends go through a send buffer of sendBufferBytes that drains at that rate,
+ * and a send that does not fit blocks until it does, as a send into a full TCP window
+ * does. Blocking goes through `block` (delayMicroseconds() unless set), which must
+ * advance the simulated clock so timers keep firing meanwhile. With
+ * lossPercent probability a message also stalls the wire for retransmitUs, as a lost
+ * segment does.
+ */
+class LoopbackServer {
+public:
+    struct Stats {
+        uint32_t connects;
+        uint32_t textMessages;
+        uint32_t binaryMessages;
+        uint64_t bytesReceived;
+        uint32_t messagesSent;
+        uint64_t blockedUs;   // Time client sends spent blocked in the transport
+        uint32_t retransmits; // Sends that hit a simulated loss
+    };
+
+    struct Transport {
+        uint32_t bytesPerSecond;  // Drain rate of the send buffer, 0 for unlimited
+        uint32_t sendBufferBytes; // Bytes accepted before a send blocks
+        uint8_t lossPercent;      // Chance that a message needs a retransmission
+        uint32_t retransmitUs;    // Time the wire stalls for a retransmission
+    };
+
+    std::function<void(const uint8_t *data, size_t length)> onBinary; // Called for each binary message
+    std::function<void(const std::string &text)> onText;            // Called for each text message
+    bool acceptConnections = true;                                    // false makes connect() fail
+    Transport transport = {};                                         // Cost of client sends
+    std::function<void(uint64_t us)> block;                           // Waits out a blocked send
+
+    static LoopbackServer &instance() {
+        static LoopbackServer server;
+        return server;
+    }
+
+    /**
+     * @brief Queues a text message for the client.
+     */
+    void sendText(const std::string &text) {
+        _outbox.emplace_back(MessageType::Text, text);
+        _stats.messagesSent++;
+    }
+
+    /**
+     * @brief Drops the connection; the client sees ConnectionClosed on its next poll().
+     */
+    void closeConnection() {
+        _closeRequested = true;
+    }
+
+    Stats getStats() const { return _stats; }
+
+    /**
+     * @brief Returns the path of the latest connection, with its query string.
+     */
+    const std::string &lastPath() const { return _lastPath; }
+
+    // Used by WebsocketsClient
+    void transmit(size_t length) {
+        uint64_t nowUs = micros();
+        if (transport.bytesPerSecond == 0) {
+            _wireFreeUs = nowUs;
+            return;
+        }
+        // _wireFreeUs is when everything accepted so far has left the buffer.
+        if (_wireFreeUs < nowUs) {
+            _wireFreeUs = nowUs;
+        }
+        _wireFreeUs += static_cast<uint64_t>(length) * 1000000 / transport.bytesPerSecond;
+        if (transport.lossPercent > 0 && esp_random() % 100 < transport.lossPercent) {
+            _wireFreeUs += transport.retransmitUs;
+            _stats.retransmits++;
+        }
+        uint64_t bufferUs = static_cast<uint64_t>(transport.sendBufferBytes) * 1000000 / transport.bytesPerSecond;
+        if (_wireFreeUs > nowUs + bufferUs) {
+            uint64_t waitUs = _wireFreeUs - nowUs - bufferUs;
+            _stats.blockedUs += waitUs;
+            if (block) {
+                block(waitUs);
+            } else {
+                delayMicroseconds(static_cast<unsigned int>(waitUs));
+            }
+        }
+    }
+    void received(MessageType type, const char *data, size_t length) {
+        NativeHAL::PeerHeapScope peer; // The hooks stand for the backend
+        _stats.bytesReceived += length;
+        if (type == MessageType::Binary) {
+            _stats.binaryMessages++;
+            if (onBinary) {
+                onBinary(reinterpret_cast<const uint8_t *>(data), length);
+            }
+        } else {
+            _stats.textMessages++;
+            if (onText) {
+                onText(std::string(data, length));
+            }
+        }
+    }
+    void connected(const String &path) { _stats.connects++; _closeRequested = false; _lastPath = path.c_str(); }
+    bool takeClose() { bool close = _closeRequested; _closeRequested = false; return close; }
+    bool takeMessage(WebsocketsMessage &message) {
+        if (_outbox.empty()) {
+            return false;
+        }
+        message = _outbox.front();
+        _outbox.pop_front();
+        return true;
+    }
+
+private:
+    Stats _stats = {};
+    std::deque<WebsocketsMessage> _outbox;
+    bool _closeRequested = false;
+    uint64_t _wireFreeUs = 0;
+    std::string _lastPath;
+};
+
+typedef std::function<void(WebsocketsMessage)> MessageCallback;
+typedef std::function<void(WebsocketsEvent, String)> EventCallback;
+
+/**
+ * @brief WebSocket client whose peer is LoopbackServer::instance().
+ */
+class WebsocketsClient {
+public:
+    bool connect(const String &host, int port, const String &path) {
+        (void)host;
+        (void)port;
+        LoopbackServer &server = LoopbackServer::instance();
+        if (!server.acceptConnections) {
+            return false;
+        }
+        server.connected(path);
+        _open = true;
+        if (_onEvent) {
+            _onEvent(WebsocketsEvent::ConnectionOpened, String());
+        }
+        return true;
+    }
+
+    bool available(bool activeTest = false) {
+        (void)activeTest;
+        return _open;
+    }
+
+    bool poll() {
+        if (!_open) {
+            return false;
+        }
+        LoopbackServer &server = LoopbackServer::instance();
+        if (server.takeClose()) {
+            close();
+            return false;
+        }
+        WebsocketsMessage message;
+        bool any = false;
+        while (server.takeMessage(message)) {
+            any = true;
+            if (_onMessage) {
+                _onMessage(message);
+            }
+        }
+        return any;
+    }
+
+    bool send(const String &text) {
+        return send(text.c_str(), text.length());
+    }
+
+    bool send(const char *data, size_t length) {
+        if (!_open) {
+            return false;
+        }
+        LoopbackServer::instance().transmit(length);
+        LoopbackServer::instance().received(MessageType::Text, data, length);
+        return true;
+    }
+
+    bool sendBinary(const char *data, size_t length) {
+        if (!_open) {
+            return false;
+        }
+        LoopbackServer::instance().transmit(length);
+        LoopbackServer::instance().received(MessageType::Binary, data, length);
+        return true;
+    }
+
+    bool ping(const String &data = String()) {
+        (void)data;
+        return _open;
+    }
+
+    void close() {
+        if (_open) {
+            _open = false;
+            if (_onEvent) {
+                _onEvent(WebsocketsEvent::ConnectionClosed, String());
+            }
+        }
+    }
+
+    void onMessage(MessageCallback callback) { _onMessage = callback; }
+    void onEvent(EventCallback callback) { _onEvent = callback; }
+
+private:
+    bool _open = false;
+    MessageCallback _onMessage;
+    EventCallback _onEvent;
+};
+
+} // namespace websockets
+
+#endif // NATIVE_ARDUINO_WEBSOCKETS_H
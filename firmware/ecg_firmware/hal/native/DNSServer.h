@@ -0,0 +1,7 @@
+// DNSServer.h
+// Host placeholder for the ESP32 DNSServer library, which the firmware includes but does not use yet.
+
+#ifndef NATIVE_DNS_SERVER_H
+#define NATIVE_DNS_SERVER_H
+
+#endif // NATIVE_DNS_SERVER_H
@@ -0,0 +1,380 @@
+// ESPAsyncWebServer.h
+// Host replacement for ESPAsyncWebServer. Routes are recorded but no socket is opened;
+// WebSocket clients are connected and drained by the simulation.
+
+#ifndef NATIVE_ESP_ASYNC_WEB_SERVER_H
+#define NATIVE_ESP_ASYNC_WEB_SERVER_H
+
+#include <Arduino.h>
+#include <strings.h>
+#include <deque>
+#include <functional>
+#include <list>
+#include <utility>
+#include <vector>
+
+typedef enum {
+    HTTP_GET = 0b00000001,
+    HTTP_POST = 0b00000010,
+    HTTP_ANY = 0b01111111
+} WebRequestMethod;
+
+class AsyncWebServerRequest;
+
+typedef std::function<void(AsyncWebServerRequest *request)> ArRequestHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest *request, const String &filename, size_t index,
+                           uint8_t *data, size_t len, bool final)> ArUploadHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index,
+                           size_t total)> ArBodyHandlerFunction;
+
+typedef std::vector<std::pair<String, String>> AsyncWebHeaders;
+
+/**
+ * @brief A response built with beginResponse(); send() takes ownership, as in the library.
+ */
+class AsyncWebServerResponse {
+public:
+    int code;
+    String contentType;
+    String body;
+    AsyncWebHeaders headers;
+
+    AsyncWebServerResponse(int code, const char *contentType, const String &body)
+        : code(code), contentType(contentType), body(body) {}
+
+    void addHeader(const char *name, const char *value) {
+        headers.emplace_back(String(name), String(value));
+    }
+};
+
+/**
+ * @brief A request handed to a route handler. Set requestHeaders before invoking the
+ * handler; the last response is kept for inspection.
+ */
+class AsyncWebServerRequest {
+public:
+    AsyncWebHeaders requestHeaders;
+    int responseCode = 0;
+    String responseType;
+    String responseBody;
+    AsyncWebHeaders responseHeaders;
+
+    bool hasHeader(const char *name) const {
+        return findHeader(name) != nullptr;
+    }
+    const String &header(const char *name) const {
+        static const String empty;
+        const String *value = findHeader(name);
+        return value != nullptr ? *value : empty;
+    }
+
+    AsyncWebServerResponse *beginResponse(int code, const char *contentType = "", const String &content = String()) {
+        return new AsyncWebServerResponse(code, contentType, content);
+    }
+    AsyncWebServerResponse *beginResponse(int code, const char *contentType, const uint8_t *content, size_t len) {
+        return new AsyncWebServerResponse(code, contentType, String(std::string(reinterpret_cast<const char *>(content), len)));
+    }
+
+    void send(AsyncWebServerResponse *response) {
+        responseCode = response->code;
+        responseType = response->contentType;
+        responseBody = response->body;
+        responseHeaders = response->headers;
+        delete response;
+    }
+    void send(int code, const char *contentType = "", const String &content = String()) {
+        responseCode = code;
+        responseType = contentType;
+        responseBody = content;
+        responseHeaders.clear();
+    }
+    void send(int code, const char *contentType, const char *content) {
+        send(code, contentType, String(content));
+    }
+
+private:
+    const String *findHeader(const char *name) const {
+        for (const auto &header : requestHeaders) {
+            if (strcasecmp(header.first.c_str(), name) == 0) {
+                return &header.second;
+            }
+        }
+        return nullptr;
+    }
+};
+
+class AsyncWebHandler {
+public:
+    virtual ~AsyncWebHandler() {}
+};
+
+#ifndef WS_MAX_QUEUED_MESSAGES
+#define WS_MAX_QUEUED_MESSAGES 32
+#endif
+
+typedef enum {
+    WS_EVT_CONNECT,
+    WS_EVT_DISCONNECT,
+    WS_EVT_PING,
+    WS_EVT_PONG,
+    WS_EVT_ERROR,
+    WS_EVT_DATA
+} AwsEventType;
+
+class AsyncWebSocket;
+
+/**
+ * @brief A WebSocket client. Queued messages stay until the simulation takes them,
+ * which stands in for the network delivering them.
+ */
+class AsyncWebSocketClient {
+public:
+    AsyncWebSocketClient(AsyncWebSocket *server, uint32_t id) : _server(server), _id(id) {}
+
+    uint32_t id() const { return _id; }
+    bool connected() const { return _connected; }
+    void close(uint16_t code = 0, const char *message = nullptr);
+    size_t queueLen() const { return _queue.size(); }
+    bool queueIsFull() const { return _queue.size() >= WS_MAX_QUEUED_MESSAGES || !_connected; }
+
+    // Simulation access: removes the oldest queued message, returns false if none.
+    bool takeMessage(std::vector<uint8_t> &message) {
+        if (_queue.empty()) {
+            return false;
+        }
+        message = std::move(_queue.front());
+        _queue.pop_front();
+        return true;
+    }
+
+private:
+    friend class AsyncWebSocket;
+    AsyncWebSocket *_server;
+    uint32_t _id;
+    bool _connected = true;
+    std::deque<std::vector<uint8_t>> _queue;
+};
+
+typedef std::function<void(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type,
+                           void *arg, uint8_t *data, size_t len)> AwsEventHandler;
+
+class AsyncWebSocket : public AsyncWebHandler {
+public:
+    explicit AsyncWebSocket(const char *url) : _url(url) { registry().push_back(this); }
+    ~AsyncWebSocket() {
+        std::vector<AsyncWebSocket *> &sockets = registry();
+        for (size_t i = 0; i < sockets.size(); i++) {
+            if (sockets[i] == this) {
+                sockets.erase(sockets.begin() + i);
+                break;
+            }
+        }
+    }
+
+    // Simulation access: the socket serving url, or nullptr.
+    static AsyncWebSocket *find(const char *url) {
+        for (AsyncWebSocket *socket : registry()) {
+            if (socket->_url == url) {
+                return socket;
+            }
+        }
+        return nullptr;
+    }
+
+    const char *url() const { return _url.c_str(); }
+    void onEvent(AwsEventHandler handler) { _handler = handler; }
+
+    size_t count() const {
+        size_t n = 0;
+        for (const AsyncWebSocketClient &c : _clients) {
+            n += c.connected() ? 1 : 0;
+        }
+        return n;
+    }
+
+    AsyncWebSocketClient *client(uint32_t id) {
+        for (AsyncWebSocketClient &c : _clients) {
+            if (c.id() == id && c.connected()) {
+                return &c;
+            }
+        }
+        return nullptr;
+    }
+
+    bool availableForWrite(uint32_t id) {
+        AsyncWebSocketClient *c = client(id);
+        return !c || !c->queueIsFull();
+    }
+
+    // Like the library, a message sent to a full queue closes the connection.
+    void binary(uint32_t id, const uint8_t *message, size_t len) {
+        AsyncWebSocketClient *c = client(id);
+        if (!c) {
+            return;
+        }
+        if (c->queueIsFull()) {
+            c->close();
+            return;
+        }
+        c->_queue.emplace_back(message, message + len);
+    }
+
+    // Closes the oldest client while more than maxClients are connected, and forgets closed ones.
+    void cleanupClients(uint16_t maxClients) {
+        if (count() > maxClients) {
+            for (AsyncWebSocketClient &c : _clients) {
+                if (c.connected()) {
+                    c.close();
+                    break;
+                }
+            }
+        }
+        _clients.remove_if([](const AsyncWebSocketClient &c) { return !c.connected(); });
+    }
+
+    void closeAll() {
+        for (AsyncWebSocketClient &c : _clients) {
+            c.close();
+        }
+    }
+
+    // Simulation access: a viewer connects. The returned client stays valid until cleanupClients().
+    AsyncWebSocketClient *connectClient() {
+        _clients.emplace_back(this, ++_lastId);
+        AsyncWebSocketClient *c = &_clients.back();
+        emit(c, WS_EVT_CONNECT);
+        return c;
+    }
+
+    // Simulation access: a viewer goes away.
+    void disconnectClient(uint32_t id) {
+        AsyncWebSocketClient *c = client(id);
+        if (c) {
+            c->close();
+        }
+    }
+
+private:
+    friend class AsyncWebSocketClient;
+    String _url;
+    AwsEventHandler _handler;
+    std::list<AsyncWebSocketClient> _clients; // A list, so client pointers stay valid
+    uint32_t _lastId = 0;
+
+    static std::vector<AsyncWebSocket *> &registry() {
+        static std::vector<AsyncWebSocket *> sockets;
+        return sockets;
+    }
+
+    void emit(AsyncWebSocketClient *client, AwsEventType type) {
+        if (_handler) {
+            _handler(this, client, type, nullptr, nullptr, 0);
+        }
+    }
+};
+
+inline void AsyncWebSocketClient::close(uint16_t code, const char *message) {
+    (void)code;
+    (void)message;
+    if (_connected) {
+        _connected = false;
+        _queue.clear();
+        _server->emit(this, WS_EVT_DISCONNECT);
+    }
+}
+
+/**
+ * @brief Registered route, kept so a simulation can invoke handlers directly.
+ */
+struct AsyncWebRoute {
+    String path;
+    WebRequestMethod method;
+    ArRequestHandlerFunction onRequest;
+    ArBodyHandlerFunction onBody;
+};
+
+class AsyncWebServer {
+public:
+    AsyncWebServer(uint16_t port) : _port(port) { registry().push_back(this); }
+    ~AsyncWebServer() {
+        std::vector<AsyncWebServer *> &servers = registry();
+        for (size_t i = 0; i < servers.size(); i++) {
+            if (servers[i] == this) {
+                servers.erase(servers.begin() + i);
+                break;
+            }
+        }
+    }
+
+    // Simulation access: the server on port, or nullptr.
+    static AsyncWebServer *find(uint16_t port) {
+        for (AsyncWebServer *server : registry()) {
+            if (server->_port == port) {
+                return server;
+            }
+        }
+        return nullptr;
+    }
+
+    // Simulation access: the route for path and method while running, or nullptr.
+    const AsyncWebRoute *route(const char *path, WebRequestMethod method) const {
+        for (const AsyncWebRoute &route : _routes) {
+            if (_running && route.path == path && (route.method & method) != 0) {
+                return &route;
+            }
+        }
+        return nullptr;
+    }
+
+    AsyncWebHandler &on(const char *uri, WebRequestMethod method, ArRequestHandlerFunction onRequest) {
+        _routes.push_back({String(uri), method, onRequest, nullptr});
+        return _handler;
+    }
+
+    AsyncWebHandler &on(const char *uri, WebRequestMethod method, ArRequestHandlerFunction onRequest,
+                        ArUploadHandlerFunction onUpload, ArBodyHandlerFunction onBody) {
+        (void)onUpload;
+        _routes.push_back({String(uri), method, onRequest, onBody});
+        return _handler;
+    }
+
+    void onNotFound(ArRequestHandlerFunction onRequest) {
+        _notFound = onRequest;
+    }
+
+    AsyncWebHandler &addHandler(AsyncWebHandler *handler) {
+        _handlers.push_back(handler);
+        return *handler;
+    }
+
+    bool removeHandler(AsyncWebHandler *handler) {
+        for (size_t i = 0; i < _handlers.size(); i++) {
+            if (_handlers[i] == handler) {
+                _handlers.erase(_handlers.begin() + i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void begin() { _running = true; }
+    void end() { _running = false; _routes.clear(); }
+    bool isRunning() const { return _running; }
+    const std::vector<AsyncWebRoute> &routes() const { return _routes; }
+    const std::vector<AsyncWebHandler *> &handlers() const { return _handlers; }
+
+private:
+    uint16_t _port;
+    bool _running = false;
+    std::vector<AsyncWebRoute> _routes;
+    std::vector<AsyncWebHandler *> _handlers;
+    ArRequestHandlerFunction _notFound;
+    AsyncWebHandler _handler;
+
+    static std::vector<AsyncWebServer *> &registry() {
+        static std::vector<AsyncWebServer *> servers;
+        return servers;
+    }
+};
+
+#endif // NATIVE_ESP_ASYNC_WEB_SERVER_H
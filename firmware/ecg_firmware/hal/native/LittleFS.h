@@ -0,0 +1,29 @@
+// LittleFS.h
+// Host replacement for the ESP32 LittleFS library.
+
+#ifndef NATIVE_LITTLEFS_H
+#define NATIVE_LITTLEFS_H
+
+/**
+ * @brief The partition is a temporary directory, created on the first mount and removed
+ * when the process exits. While it is mounted, fopen() of a path under basePath opens the
+ * file of the same name in it, as the ESP-IDF VFS does on the board, so FileSpoolStorage
+ * runs unchanged on its "/littlefs/..." path. Every process starts with an empty partition.
+ */
+class LittleFSFS {
+public:
+    /**
+     * @brief Mounts the partition at basePath.
+     * @return false if the temporary directory cannot be created.
+     */
+    bool begin(bool formatOnFail = false, const char *basePath = "/littlefs");
+
+    /**
+     * @brief Unmounts the partition; its files are kept for the next begin().
+     */
+    void end();
+};
+
+extern LittleFSFS LittleFS;
+
+#endif // NATIVE_LITTLEFS_H
@@ -0,0 +1,623 @@
+// NativeHAL.cpp
+// This file implements the simulated board declared in NativeHAL.h and the Arduino, esp_timer,
+// ADC and WiFi globals it stands in for.
+
+#include "NativeHAL.h"
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <WiFi.h>
+#include <esp_adc/adc_cali_scheme.h>
+#include <esp_adc/adc_continuous.h>
+#include <esp_mac.h>
+#include <esp_pm.h>
+#include <esp_random.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <new>
+#include <string>
+
+HardwareSerial Serial;
+WiFiClass WiFi;
+LittleFSFS LittleFS;
+
+// --- Simulated clock and timers ---
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void *arg;
+    uint64_t periodUs; // 0 for one-shot timers
+    uint64_t deadlineUs;
+    bool active;
+    bool inUse;
+};
+
+#define NATIVE_MAX_TIMERS 8
+
+static uint64_t s_nowUs = 0;
+static esp_timer s_timers[NATIVE_MAX_TIMERS];
+static NativeHAL::TimerLatency s_timerLatency = nullptr;
+
+namespace NativeHAL {
+
+uint64_t nowMicros() {
+    return s_nowUs;
+}
+
+void setTimerLatency(TimerLatency latency) {
+    s_timerLatency = latency;
+}
+
+uint64_t nextTimerDeadline() {
+    uint64_t next = UINT64_MAX;
+    for (int i = 0; i < NATIVE_MAX_TIMERS; i++) {
+        if (s_timers[i].inUse && s_timers[i].active && s_timers[i].deadlineUs < next) {
+            next = s_timers[i].deadlineUs;
+        }
+    }
+    return next;
+}
+
+void advanceMicros(uint64_t us) {
+    uint64_t target = s_nowUs + us;
+    for (;;) {
+        // Fire the earliest due timer, like the esp_timer task does.
+        esp_timer *due = nullptr;
+        for (int i = 0; i < NATIVE_MAX_TIMERS; i++) {
+            esp_timer &timer = s_timers[i];
+            if (timer.inUse && timer.active && timer.deadlineUs <= target &&
+                (due == nullptr || timer.deadlineUs < due->deadlineUs)) {
+                due = &timer;
+            }
+        }
+        if (due == nullptr) {
+            break;
+        }
+        // A late callback starts after its latency, or after the one before it if that ran later.
+        uint64_t startUs = due->deadlineUs + (s_timerLatency != nullptr ? s_timerLatency(due->deadlineUs) : 0);
+        if (startUs > s_nowUs) {
+            s_nowUs = startUs;
+        }
+        if (due->periodUs > 0) {
+            due->deadlineUs += due->periodUs;
+        } else {
+            due->active = false;
+        }
+        due->callback(due->arg);
+    }
+    if (target > s_nowUs) {
+        s_nowUs = target;
+    }
+}
+
+} // namespace NativeHAL
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out) {
+    if (args == nullptr || args->callback == nullptr || out == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < NATIVE_MAX_TIMERS; i++) {
+        if (!s_timers[i].inUse) {
+            s_timers[i] = {args->callback, args->arg, 0, 0, false, true};
+            *out = &s_timers[i];
+            return ESP_OK;
+        }
+    }
+    return ESP_FAIL;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period) {
+    if (timer == nullptr || period == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->periodUs = period;
+    timer->deadlineUs = s_nowUs + period;
+    timer->active = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout) {
+    if (timer == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->periodUs = 0;
+    timer->deadlineUs = s_nowUs + timeout;
+    timer->active = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (timer == nullptr || !timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->active = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    if (timer == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    timer->active = false;
+    timer->inUse = false;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+    return timer != nullptr && timer->active;
+}
+
+int64_t esp_timer_get_time() {
+    return static_cast<int64_t>(s_nowUs);
+}
+
+uint32_t esp_random() {
+    // xorshift32 with a fixed seed
+    static uint32_t state = 0x2545F491;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+esp_err_t esp_efuse_mac_get_default(uint8_t *mac) {
+    static const uint8_t kMac[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x01};
+    memcpy(mac, kMac, sizeof(kMac));
+    return ESP_OK;
+}
+
+static uint32_t s_restarts = 0;
+static esp_pm_config_t s_pmConfig = {};
+
+void esp_restart() {
+    s_restarts++;
+}
+
+esp_err_t esp_pm_configure(const void *config) {
+    s_pmConfig = *static_cast<const esp_pm_config_t *>(config);
+    return ESP_OK;
+}
+
+namespace NativeHAL {
+
+uint32_t restartCount() {
+    return s_restarts;
+}
+
+esp_pm_config_t pmConfig() {
+    return s_pmConfig;
+}
+
+} // namespace NativeHAL
+
+unsigned long millis() {
+    return static_cast<unsigned long>(s_nowUs / 1000);
+}
+
+unsigned long micros() {
+    return static_cast<unsigned long>(s_nowUs);
+}
+
+void delay(unsigned long ms) {
+    NativeHAL::advanceMicros(static_cast<uint64_t>(ms) * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+    NativeHAL::advanceMicros(us);
+}
+
+void yield() {}
+
+static uint32_t s_cpuFreqMhz = 240;
+
+bool setCpuFrequencyMhz(uint32_t cpuFreqMhz) {
+    s_cpuFreqMhz = cpuFreqMhz;
+    return true;
+}
+
+uint32_t getCpuFrequencyMhz() {
+    return s_cpuFreqMhz;
+}
+
+// --- GPIO and ADC ---
+
+#define NATIVE_MAX_PINS 64
+
+struct NativePin {
+    uint8_t mode;
+    int level;
+    uint32_t writes;
+    uint32_t duty; // Last ledcWrite() duty
+    void (*handler)();
+    void (*argHandler)(void *);
+    void *arg;
+    int interruptMode;
+};
+
+static NativePin s_pins[NATIVE_MAX_PINS];
+static NativeHAL::AnalogSource s_analogSource = nullptr;
+static uint32_t s_analogReads = 0;
+
+namespace NativeHAL {
+
+void setAnalogSource(AnalogSource source) {
+    s_analogSource = source;
+}
+
+void setDigitalInput(uint8_t pin, int level) {
+    if (pin >= NATIVE_MAX_PINS) {
+        return;
+    }
+    NativePin &p = s_pins[pin];
+    int previous = p.level;
+    p.level = level ? HIGH : LOW;
+    if ((p.handler == nullptr && p.argHandler == nullptr) || previous == p.level) {
+        return;
+    }
+    bool rising = p.level == HIGH;
+    if (p.interruptMode == CHANGE || (p.interruptMode == RISING && rising) ||
+        (p.interruptMode == FALLING && !rising)) {
+        if (p.argHandler != nullptr) {
+            p.argHandler(p.arg);
+        } else {
+            p.handler();
+        }
+    }
+}
+
+uint32_t digitalWriteCount(uint8_t pin) {
+    return pin < NATIVE_MAX_PINS ? s_pins[pin].writes : 0;
+}
+
+uint32_t analogReadCount() {
+    return s_analogReads;
+}
+
+uint32_t pwmDuty(uint8_t pin) {
+    return pin < NATIVE_MAX_PINS ? s_pins[pin].duty : 0;
+}
+
+} // namespace NativeHAL
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    if (pin >= NATIVE_MAX_PINS) {
+        return;
+    }
+    s_pins[pin].mode = mode;
+    if (mode == INPUT_PULLUP) {
+        s_pins[pin].level = HIGH;
+    }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    if (pin >= NATIVE_MAX_PINS) {
+        return;
+    }
+    int level = value ? HIGH : LOW;
+    if (s_pins[pin].level != level) {
+        s_pins[pin].writes++;
+    }
+    s_pins[pin].level = level;
+}
+
+bool ledcAttach(uint8_t pin, uint32_t frequency, uint8_t resolution) {
+    (void)frequency;
+    (void)resolution;
+    if (pin >= NATIVE_MAX_PINS) {
+        return false;
+    }
+    s_pins[pin].mode = OUTPUT;
+    return true;
+}
+
+bool ledcWrite(uint8_t pin, uint32_t duty) {
+    if (pin >= NATIVE_MAX_PINS) {
+        return false;
+    }
+    // The pin reads high while the duty is nonzero; each on/off change counts as a write.
+    digitalWrite(pin, duty != 0 ? HIGH : LOW);
+    s_pins[pin].duty = duty;
+    return true;
+}
+
+int digitalRead(uint8_t pin) {
+    return pin < NATIVE_MAX_PINS ? s_pins[pin].level : LOW;
+}
+
+uint16_t analogRead(uint8_t pin) {
+    s_analogReads++;
+    return s_analogSource != nullptr ? s_analogSource(pin, s_nowUs) : 2048;
+}
+
+int digitalPinToInterrupt(uint8_t pin) {
+    return pin;
+}
+
+void attachInterrupt(uint8_t interrupt, void (*handler)(), int mode) {
+    if (interrupt < NATIVE_MAX_PINS) {
+        s_pins[interrupt].handler = handler;
+        s_pins[interrupt].argHandler = nullptr;
+        s_pins[interrupt].interruptMode = mode;
+    }
+}
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void *), void *arg, int mode) {
+    if (pin < NATIVE_MAX_PINS) {
+        s_pins[pin].handler = nullptr;
+        s_pins[pin].argHandler = handler;
+        s_pins[pin].arg = arg;
+        s_pins[pin].interruptMode = mode;
+    }
+}
+
+void detachInterrupt(uint8_t interrupt) {
+    if (interrupt < NATIVE_MAX_PINS) {
+        s_pins[interrupt].handler = nullptr;
+        s_pins[interrupt].argHandler = nullptr;
+    }
+}
+
+void noInterrupts() {}
+
+void interrupts() {}
+
+// --- Heap ---
+
+static std::atomic<uint64_t> s_heapAllocations(0);
+static thread_local int s_peerHeapDepth = 0;
+
+namespace NativeHAL {
+
+uint64_t heapAllocations() {
+    return s_heapAllocations.load();
+}
+
+PeerHeapScope::PeerHeapScope() {
+    s_peerHeapDepth++;
+}
+
+PeerHeapScope::~PeerHeapScope() {
+    s_peerHeapDepth--;
+}
+
+} // namespace NativeHAL
+
+static void *countedAllocate(size_t size) {
+    if (s_peerHeapDepth == 0) {
+        s_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    return malloc(size != 0 ? size : 1);
+}
+
+void *operator new(size_t size) {
+    void *p = countedAllocate(size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    return countedAllocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return countedAllocate(size);
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+    free(p);
+}
+
+// --- LittleFS ---
+
+static std::string s_littleFsBase; // Mount point, empty while unmounted
+static std::string s_littleFsDir;  // Temporary directory holding the files
+
+static void removeLittleFsDir() {
+    DIR *dir = opendir(s_littleFsDir.c_str());
+    if (dir != nullptr) {
+        while (struct dirent *entry = readdir(dir)) {
+            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+                unlink((s_littleFsDir + "/" + entry->d_name).c_str());
+            }
+        }
+        closedir(dir);
+    }
+    rmdir(s_littleFsDir.c_str());
+}
+
+bool LittleFSFS::begin(bool formatOnFail, const char *basePath) {
+    (void)formatOnFail;
+    if (s_littleFsDir.empty()) {
+        const char *tmp = getenv("TMPDIR");
+        std::string pattern = std::string(tmp != nullptr && tmp[0] != '\0' ? tmp : "/tmp") + "/littlefs-XXXXXX";
+        if (mkdtemp(&pattern[0]) == nullptr) {
+            return false;
+        }
+        s_littleFsDir = pattern;
+        atexit(removeLittleFsDir);
+    }
+    s_littleFsBase = basePath;
+    return true;
+}
+
+void LittleFSFS::end() {
+    s_littleFsBase.clear();
+}
+
+/**
+ * @brief The VFS: opens paths under the mount point in the partition directory, and any
+ * other path with the C library's own fopen().
+ */
+extern "C" FILE *fopen(const char *path, const char *mode) {
+    typedef FILE *(*Fopen)(const char *, const char *);
+    static Fopen libcFopen = reinterpret_cast<Fopen>(dlsym(RTLD_NEXT, "fopen"));
+    size_t baseLength = s_littleFsBase.size();
+    if (baseLength > 0 && strncmp(path, s_littleFsBase.c_str(), baseLength) == 0 && path[baseLength] == '/') {
+        return libcFopen((s_littleFsDir + (path + baseLength)).c_str(), mode);
+    }
+    return libcFopen(path, mode);
+}
+
+// --- Continuous ADC and calibration ---
+
+struct adc_continuous_ctx_t {
+    uint32_t storeBytes;
+    uint32_t sampleFreqHz;
+    uint8_t channel;
+    bool configured;
+    bool running;
+    uint64_t startUs;
+    uint64_t converted; // Conversions handed out or lost since start
+};
+
+struct adc_cali_scheme_t {
+    adc_atten_t atten;
+};
+
+static adc_continuous_ctx_t s_continuousAdc;
+static adc_cali_scheme_t s_lineFitting;
+
+esp_err_t adc_continuous_new_handle(const adc_continuous_handle_cfg_t *config, adc_continuous_handle_t *out) {
+    if (config == nullptr || out == nullptr || config->max_store_buf_size < SOC_ADC_DIGI_RESULT_BYTES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_continuousAdc = {};
+    s_continuousAdc.storeBytes = config->max_store_buf_size;
+    *out = &s_continuousAdc;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_config(adc_continuous_handle_t handle, const adc_continuous_config_t *config) {
+    if (handle == nullptr || config == nullptr || config->pattern_num != 1 ||
+        config->sample_freq_hz < SOC_ADC_SAMPLE_FREQ_THRES_LOW ||
+        config->sample_freq_hz > SOC_ADC_SAMPLE_FREQ_THRES_HIGH) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (handle->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    handle->sampleFreqHz = config->sample_freq_hz;
+    handle->channel = config->adc_pattern[0].channel;
+    handle->configured = true;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_start(adc_continuous_handle_t handle) {
+    if (handle == nullptr || !handle->configured || handle->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    handle->running = true;
+    handle->startUs = s_nowUs;
+    handle->converted = 0;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_stop(adc_continuous_handle_t handle) {
+    if (handle == nullptr || !handle->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    handle->running = false;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_read(adc_continuous_handle_t handle, uint8_t *buf, uint32_t length_max,
+                              uint32_t *out_length, uint32_t) {
+    if (handle == nullptr || !handle->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // Conversion k completes at startUs + (k + 1) / sampleFreqHz.
+    uint64_t due = (s_nowUs - handle->startUs) * handle->sampleFreqHz / 1000000;
+    uint64_t stored = handle->storeBytes / SOC_ADC_DIGI_RESULT_BYTES;
+    if (due - handle->converted > stored) {
+        handle->converted = due - stored; // The DMA pool overflowed; the oldest conversions are gone
+    }
+    uint32_t count = static_cast<uint32_t>(due - handle->converted);
+    if (count > length_max / SOC_ADC_DIGI_RESULT_BYTES) {
+        count = length_max / SOC_ADC_DIGI_RESULT_BYTES;
+    }
+    if (count == 0) {
+        *out_length = 0;
+        return ESP_ERR_TIMEOUT;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t atUs = handle->startUs + (handle->converted + i + 1) * 1000000 / handle->sampleFreqHz;
+        adc_digi_output_data_t result;
+        result.val = 0;
+        result.type1.data = s_analogSource != nullptr ? s_analogSource(handle->channel, atUs) & 0x0FFF : 2048;
+        result.type1.channel = handle->channel & 0x0F;
+        memcpy(buf + i * SOC_ADC_DIGI_RESULT_BYTES, &result, SOC_ADC_DIGI_RESULT_BYTES);
+    }
+    handle->converted += count;
+    *out_length = count * SOC_ADC_DIGI_RESULT_BYTES;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_deinit(adc_continuous_handle_t handle) {
+    if (handle == nullptr || handle->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    handle->configured = false;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_io_to_channel(int io_num, adc_unit_t *unit_id, adc_channel_t *channel) {
+    if (io_num < 0 || io_num >= NATIVE_MAX_PINS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *unit_id = ADC_UNIT_1;
+    *channel = io_num;
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_create_scheme_line_fitting(const adc_cali_line_fitting_config_t *config,
+                                              adc_cali_handle_t *out) {
+    if (config == nullptr || out == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_lineFitting.atten = config->atten;
+    *out = &s_lineFitting;
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_delete_scheme_line_fitting(adc_cali_handle_t) {
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_raw_to_voltage(adc_cali_handle_t handle, int raw, int *voltage) {
+    if (handle == nullptr || voltage == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *voltage = (raw * 3300 + 2047) / 4095;
+    return ESP_OK;
+}
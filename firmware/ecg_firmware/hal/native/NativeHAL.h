@@ -0,0 +1,116 @@
+// NativeHAL.h
+// This header file defines the controls of the simulated hardware used by the native environment.
+
+#ifndef NATIVE_HAL_H
+#define NATIVE_HAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_pm.h"
+
+/**
+ * @brief Simulated board for host builds.
+ *
+ * Time is virtual: millis(), micros() and esp_timer_get_time() read a clock that only
+ * moves when advanceMicros() is called (delay() calls it too). Periodic esp_timer
+ * callbacks fire synchronously as the clock passes their deadlines, so a minute of
+ * acquisition can run in well under a second of real time.
+ *
+ * analogRead() returns values from a source function of (pin, time), digitalRead()
+ * returns what was last set with setDigitalInput() or digitalWrite(), and pin
+ * interrupts fire when setDigitalInput() produces the matching edge.
+ *
+ * Every operator new is counted, so a run can check that the firmware does not
+ * allocate once it is streaming.
+ */
+namespace NativeHAL {
+
+/**
+ * @brief Returns the simulated time in microseconds.
+ */
+uint64_t nowMicros();
+
+/**
+ * @brief Moves the simulated clock forward, firing due timers along the way.
+ * @param us Microseconds to advance.
+ */
+void advanceMicros(uint64_t us);
+
+/**
+ * @brief Signature of a dispatch latency: returns how many microseconds after its deadline
+ * the timer callback due at deadlineUs starts.
+ */
+typedef uint32_t (*TimerLatency)(uint64_t deadlineUs);
+
+/**
+ * @brief Delays timer callbacks past their deadlines, as a busy esp_timer task or masked
+ * interrupts do. Periodic timers keep their absolute deadlines, and callbacks due while
+ * another one runs late start after it. Without one, callbacks run on their deadlines.
+ */
+void setTimerLatency(TimerLatency latency);
+
+/**
+ * @brief Returns the time of the next timer deadline, or UINT64_MAX if no timer is active.
+ */
+uint64_t nextTimerDeadline();
+
+/**
+ * @brief Signature of an ADC source: returns the raw 12-bit reading of pin at time us.
+ */
+typedef uint16_t (*AnalogSource)(uint8_t pin, uint64_t us);
+
+/**
+ * @brief Sets the source of analogRead(). Without one, analogRead() returns mid-scale.
+ */
+void setAnalogSource(AnalogSource source);
+
+/**
+ * @brief Drives an input pin, firing an attached interrupt on the matching edge.
+ */
+void setDigitalInput(uint8_t pin, int level);
+
+/**
+ * @brief Returns how many times digitalWrite() changed a pin since the start.
+ */
+uint32_t digitalWriteCount(uint8_t pin);
+
+/**
+ * @brief Returns the number of analogRead() calls since the start.
+ */
+uint32_t analogReadCount();
+
+/**
+ * @brief Returns the duty last written to a pin with ledcWrite(), 0 if none.
+ */
+uint32_t pwmDuty(uint8_t pin);
+
+/**
+ * @brief Returns how many times esp_restart() was called. The simulation does not reboot.
+ */
+uint32_t restartCount();
+
+/**
+ * @brief Returns the configuration last passed to esp_pm_configure(), all zero if none.
+ */
+esp_pm_config_t pmConfig();
+
+/**
+ * @brief Returns the number of heap allocations (operator new) since the start, not
+ * counting those made inside a PeerHeapScope.
+ */
+uint64_t heapAllocations();
+
+/**
+ * @brief Leaves the allocations of the current thread out of heapAllocations() while it
+ * exists. The stand-ins for the far end of a connection use it, so that only the
+ * firmware's own allocations are counted.
+ */
+class PeerHeapScope {
+public:
+    PeerHeapScope();
+    ~PeerHeapScope();
+};
+
+} // namespace NativeHAL
+
+#endif // NATIVE_HAL_H
@@ -0,0 +1,397 @@
+// NativeMain.cpp
+// Entry point of the native environment: runs setup() and loop() on the simulated board
+// and prints the CPU cost and throughput of the pipeline. The checks of the firmware are
+// Unity tests under test/ (pio test -e native); this program is for watching a run and
+// for benchmarks.
+//
+// Usage:
+//   program [simulated seconds] [trace file]   Run the firmware (default 60 s of synthetic ECG,
+//                                              with LO+ pulled high for 2 s of every 20 s)
+//   program --link [bytes/s] [loss %] [seconds]
+//                                              Run the firmware with the uplink throttled to
+//                                              bytes/s (default 200) with loss % (default 10)
+//                                              for the second quarter of the run (default 240 s)
+//                                              and follow the adaptive uplink level
+//   program --bench [samples] [trace file]     Push samples through the DSP and framing code
+//                                              as fast as possible (default 10 million), with
+//                                              the cost of the filter and the encoder, and
+//                                              the compression of the encoder
+//   program --channels [samples]               Time acquisition, filtering and framing of 1 to
+//                                              ECG_MAX_CHANNELS leads sampled together and
+//                                              print the cost per channel (default 1 million)
+
+#include <Arduino.h>
+#include <ArduinoWebsockets.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "ECGFilter.h"
+#include "ECGFrame.h"
+#include "ECGMultiChannel.h"
+#include "ECGSource.h"
+#include "NativeHAL.h"
+#include "NativeSimulation.h"
+#include "QRSDetector.h"
+
+// The test runner brings its own main() and only needs NativeSimulation.cpp
+#ifndef PIO_UNIT_TESTING
+
+// Samples processed at a time by the benchmark, as in the DSP task
+#define BENCH_CHUNK_SAMPLES 32
+// Samples per frame in the benchmark, as in main.cpp
+#define BENCH_FRAME_SAMPLES 25
+
+// --link: the impaired transport. A send buffer of one TCP segment fills within seconds
+// at these rates, and a retransmission stalls the wire for a typical minimum RTO.
+#define LINK_SEND_BUFFER_BYTES 1460
+#define LINK_RETRANSMIT_US 200000
+
+static double realSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Returns the time stamp counter on hosts that have one, 0 elsewhere.
+ */
+static uint64_t cycleCount() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Time and cycles spent in one stage of the benchmark.
+ */
+struct StageTime {
+    double seconds;
+    uint64_t cycles;
+};
+
+/**
+ * @brief Prints the cost per sample of a stage, with cycles where the host counts them.
+ */
+static void printStage(const char *name, const StageTime &stage, uint64_t sampleCount) {
+    printf("  %-7s %.1f ns per sample", name, stage.seconds / sampleCount * 1e9);
+    if (stage.cycles != 0) {
+        printf(", %.0f cycles per sample", static_cast<double>(stage.cycles) / sampleCount);
+    }
+    printf("\n");
+}
+
+static void printTask(PeriodicTask &task) {
+    PeriodicTask::Stats stats = task.getStats();
+    printf("  %-8s iterations %lu, busy %.3f s, max step %lu us\n", task.getName(),
+           (unsigned long)stats.iterations, stats.busyUs / 1e6, (unsigned long)stats.maxStepUs);
+}
+
+/**
+ * @brief Prints the uplink level from the device's uplink_rate messages.
+ */
+static void printUplinkRate(const std::string &text) {
+    if (text.find("\"uplink_rate\"") == std::string::npos) {
+        return;
+    }
+    int level = 0;
+    unsigned rate = 0;
+    unsigned batch = 0;
+    char reason[16] = "";
+    const char *field = strstr(text.c_str(), "\"level\":");
+    if (field != nullptr) {
+        level = atoi(field + 8);
+    }
+    if ((field = strstr(text.c_str(), "\"reason\":\"")) != nullptr) {
+        sscanf(field + 10, "%15[a-z_]", reason);
+    }
+    if ((field = strstr(text.c_str(), "\"batch_samples\":")) != nullptr) {
+        batch = static_cast<unsigned>(atoi(field + 16));
+    }
+    if ((field = strstr(text.c_str(), "\"sample_rate_hz\":")) != nullptr) {
+        rate = static_cast<unsigned>(atoi(field + 17));
+    }
+    printf("%7.1f s  uplink level %d (%s): %u samples per frame at %u Hz\n", NativeHAL::nowMicros() / 1e6, level,
+           reason, batch, rate);
+}
+
+/**
+ * @brief Runs the firmware for the given simulated time and prints what the server received.
+ */
+static int runFirmware(const NativeSim::Options &options, double seconds) {
+    if (!NativeSim::begin(options)) {
+        fprintf(stderr, "cannot map trace %s\n", options.tracePath);
+        return 1;
+    }
+    bool impaired = false;
+    NativeSim::runUntil(seconds, [&impaired](uint64_t nowUs) {
+        if (NativeSim::linkImpaired() != impaired) {
+            impaired = !impaired;
+            printf("%7.1f s  link %s\n", nowUs / 1e6, impaired ? "impaired" : "restored");
+        }
+    });
+
+    const NativeSim::ReceivedFrames &received = NativeSim::received();
+    AD8232_ECG::SamplingStats sampling = NativeSim::samplingStats();
+    websockets::LoopbackServer::Stats server = websockets::LoopbackServer::instance().getStats();
+    ECGWebSocketClient::Stats uplink = wsClient.getStats();
+    PeriodicTask::Stats dsp = dspTask.getStats();
+    double simulated = NativeHAL::nowMicros() / 1e6;
+    double realElapsed = NativeSim::realSecondsElapsed();
+
+    printf("simulated %.1f s in %.3f s real (%.0fx real time)\n", simulated, realElapsed,
+           simulated / realElapsed);
+    printf("acquisition: %lu samples captured, %lu dropped, interval %lu to %lu us\n",
+           (unsigned long)sampling.samplesCaptured, (unsigned long)sampling.samplesDropped,
+           (unsigned long)sampling.minIntervalUs, (unsigned long)sampling.maxIntervalUs);
+    printf("adc: %s, %lu conversions, %lu analogRead calls\n",
+           ecgSensor.isOversampling() ? "oversampled" : "one read per sample", (unsigned long)sampling.adcConversions,
+           (unsigned long)NativeHAL::analogReadCount());
+    printf("server: %lu frames (%lu backfill, %lu bad), %llu bytes, %llu samples, %lu text messages\n",
+           (unsigned long)received.frames, (unsigned long)received.backfillFrames, (unsigned long)received.badFrames,
+           (unsigned long long)server.bytesReceived, (unsigned long long)received.samples,
+           (unsigned long)server.textMessages);
+    printf("leads: %lu off and %lu on events, %lu interrupts, %lu frames with lead-off samples\n",
+           (unsigned long)received.leadOffEvents, (unsigned long)received.leadOnEvents,
+           (unsigned long)ecgSensor.getLeadChangeCount(), (unsigned long)received.leadOffFrames);
+    printf("  pin change to lead event %.1f ms max, reattach event to next frame %.1f ms max\n",
+           received.maxReactionUs / 1e3, received.maxResumeUs / 1e3);
+    printf("link: %lu samples dropped, %lu retransmits, sends blocked %.1f s, %lu level changes\n",
+           (unsigned long)uplink.samplesDropped, (unsigned long)server.retransmits, server.blockedUs / 1e6,
+           (unsigned long)uplink.uplinkChanges);
+    printf("time sync: %lu requests, %lu replies\n", (unsigned long)server.messagesSent,
+           (unsigned long)received.timeSyncReplies);
+    printf("device: connected %lu times as %s\n", (unsigned long)server.connects,
+           websockets::LoopbackServer::instance().lastPath().c_str());
+    if (sampling.samplesCaptured > 0) {
+        printf("dsp: %.2f us per sample, %.0f samples/s throughput\n",
+               static_cast<double>(dsp.busyUs) / sampling.samplesCaptured,
+               dsp.busyUs > 0 ? sampling.samplesCaptured / (dsp.busyUs / 1e6) : 0.0);
+    }
+    printf("tasks:\n");
+    printTask(dspTask);
+    printTask(networkTask);
+    NativeSim::end();
+    return 0;
+}
+
+/**
+ * @brief Runs the samples of source through the filter, the QRS detector and the frame
+ * encoder, timing each chunk and the filter and the encoder on their own, and prints
+ * throughput, latency and the compression of the delta-varint codec against raw uint16 frames.
+ */
+static int runBenchmark(ECGSource &source, uint64_t sampleCount) {
+    const ECGSampleRate rate = ECGSampleRate::Hz125;
+    const uint32_t periodUs = 1000000 / static_cast<uint32_t>(rate);
+
+    ECGFilter filter;
+    QRSDetector detector;
+    filter.configure(rate, MainsFrequency::Hz50);
+    detector.configure(rate);
+
+    ECGSample chunk[BENCH_CHUNK_SAMPLES];
+    uint8_t frame[ecgFrameMaxSize(BENCH_FRAME_SAMPLES)];
+    uint64_t frameBytes = 0;
+    uint64_t rawFrameBytes = 0; // The same frames without the codec
+    StageTime filterStage = {};
+    StageTime encode = {};
+    double untimedS = 0; // Spent encoding the raw frames, left out of the totals
+    uint32_t frames = 0;
+    uint32_t sequence = 0;
+    uint64_t beats = 0;
+    double worstChunkS = 0;
+
+    double start = realSeconds();
+    for (uint64_t done = 0; done < sampleCount;) {
+        size_t n = sampleCount - done < BENCH_CHUNK_SAMPLES ? static_cast<size_t>(sampleCount - done)
+                                                             : BENCH_CHUNK_SAMPLES;
+        double chunkStart = realSeconds();
+        double chunkUntimedS = untimedS;
+        for (size_t i = 0; i < n; i++) {
+            chunk[i].timestampUs = static_cast<uint32_t>((done + i) * periodUs);
+            chunk[i].value = static_cast<uint16_t>(source.readECG());
+            chunk[i].flags = source.isSensorConnected() ? 0 : ECG_SAMPLE_FLAG_LEAD_OFF;
+            chunk[i].reserved = 0;
+        }
+        double filterStart = realSeconds();
+        uint64_t filterCycles = cycleCount();
+        filter.filterSamples(chunk, n);
+        filterStage.cycles += cycleCount() - filterCycles;
+        filterStage.seconds += realSeconds() - filterStart;
+        beats += detector.processSamples(chunk, n);
+        for (size_t i = 0; i < n; i += BENCH_FRAME_SAMPLES) {
+            size_t count = n - i < BENCH_FRAME_SAMPLES ? n - i : BENCH_FRAME_SAMPLES;
+            ECGFrameHeader header = {};
+            header.type = ECG_FRAME_TYPE_SAMPLES;
+            header.flags = ECG_FRAME_FLAG_DELTA_VARINT;
+            header.sequence = sequence++;
+            header.startTimeUs = chunk[i].timestampUs;
+            header.sampleRateHz = static_cast<uint16_t>(rate);
+            ECGFrameHeader raw = header;
+            raw.flags = 0;
+            double encodeStart = realSeconds();
+            uint64_t encodeCycles = cycleCount();
+            frameBytes += encodeECGFrame(header, chunk + i, count, frame, sizeof(frame));
+            encode.cycles += cycleCount() - encodeCycles;
+            encode.seconds += realSeconds() - encodeStart;
+            double rawStart = realSeconds();
+            rawFrameBytes += encodeECGFrame(raw, chunk + i, count, frame, sizeof(frame));
+            untimedS += realSeconds() - rawStart;
+            frames++;
+        }
+        double chunkS = realSeconds() - chunkStart - (untimedS - chunkUntimedS);
+        if (chunkS > worstChunkS) {
+            worstChunkS = chunkS;
+        }
+        done += n;
+    }
+    double elapsed = realSeconds() - start - untimedS;
+    double signalS = static_cast<double>(sampleCount) / static_cast<uint16_t>(rate);
+
+    printf("bench: %llu samples (%.0f s of signal) in %.3f s\n", (unsigned long long)sampleCount, signalS,
+           elapsed);
+    printf("  throughput %.2f M samples/s, %.1f ns per sample\n", sampleCount / elapsed / 1e6,
+           elapsed / sampleCount * 1e9);
+    printf("  worst %d-sample chunk %.1f us\n", BENCH_CHUNK_SAMPLES, worstChunkS * 1e6);
+    printStage("filter", filterStage, sampleCount);
+    printStage("encode", encode, sampleCount);
+    printf("  %lu frames, %.2f bytes per sample, %.2fx smaller than raw uint16 frames\n", (unsigned long)frames,
+           static_cast<double>(frameBytes) / sampleCount, static_cast<double>(rawFrameBytes) / frameBytes);
+    printf("  %llu beats, %.1f bpm average, last %.1f bpm\n", (unsigned long long)beats,
+           beats * 60.0 / signalS, detector.getInstantHeartRateX10() / 10.0);
+    return 0;
+}
+
+/**
+ * @brief Reads every channel through an ECGMultiChannel-style capture, filters each lead,
+ * detects beats on the first and encodes multi-channel frames, for 1 to ECG_MAX_CHANNELS
+ * channels, and prints the time per sample and the cost of each additional channel.
+ */
+static int runChannelBenchmark(uint64_t sampleCount) {
+    const ECGSampleRate rate = ECGSampleRate::Hz125;
+    const uint32_t periodUs = 1000000 / static_cast<uint32_t>(rate);
+
+    ECGMultiSample chunk[BENCH_CHUNK_SAMPLES];
+    uint8_t frame[ecgMultiFrameMaxSize(BENCH_FRAME_SAMPLES, ECG_MAX_CHANNELS)];
+    double nsPerSample[ECG_MAX_CHANNELS + 1] = {};
+
+    printf("channels: %llu samples per run at %d Hz, %d-sample frames\n", (unsigned long long)sampleCount,
+           static_cast<int>(rate), BENCH_FRAME_SAMPLES);
+    for (uint8_t channels = 1; channels <= ECG_MAX_CHANNELS; channels++) {
+        // Each lead its own signal: different noise, and a lead-off now and then on the last.
+        SyntheticECGSource sources[ECG_MAX_CHANNELS];
+        ECGFilter filters[ECG_MAX_CHANNELS];
+        for (uint8_t c = 0; c < channels; c++) {
+            SyntheticECGSource::Config config = SyntheticECGSource::defaultConfig();
+            config.seed = 1 + c;
+            config.leadOffEveryMs = c == channels - 1 && channels > 1 ? 20000 : 0;
+            config.leadOffDurationMs = 2000;
+            sources[c].configure(rate, config);
+            filters[c].configure(rate, MainsFrequency::Hz50);
+        }
+        QRSDetector detector;
+        detector.configure(rate);
+
+        uint64_t frameBytes = 0;
+        uint64_t beats = 0;
+        uint32_t sequence = 0;
+        double start = realSeconds();
+        for (uint64_t done = 0; done < sampleCount;) {
+            size_t n = sampleCount - done < BENCH_CHUNK_SAMPLES ? static_cast<size_t>(sampleCount - done)
+                                                                 : BENCH_CHUNK_SAMPLES;
+            for (size_t i = 0; i < n; i++) {
+                ECGMultiSample &sample = chunk[i];
+                sample = {};
+                sample.timestampUs = static_cast<uint32_t>((done + i) * periodUs);
+                for (uint8_t c = 0; c < channels; c++) {
+                    sample.values[c] = static_cast<uint16_t>(sources[c].readECG());
+                    if (!sources[c].isSensorConnected()) {
+                        sample.leadOffMask |= static_cast<uint8_t>(1u << c);
+                    }
+                }
+                for (uint8_t c = 0; c < channels; c++) {
+                    sample.values[c] = static_cast<uint16_t>(filters[c].filter(sample.values[c]));
+                }
+                uint32_t beatTimeUs;
+                if (sample.leadOffMask & 0x01) {
+                    detector.reset();
+                } else if (detector.process(sample.values[0], sample.timestampUs, beatTimeUs)) {
+                    markECGBeat(chunk, i + 1, beatTimeUs);
+                    beats++;
+                }
+            }
+            for (size_t i = 0; i < n; i += BENCH_FRAME_SAMPLES) {
+                size_t count = n - i < BENCH_FRAME_SAMPLES ? n - i : BENCH_FRAME_SAMPLES;
+                ECGFrameHeader header = {};
+                header.flags = ECG_FRAME_FLAG_DELTA_VARINT;
+                header.sequence = sequence++;
+                header.startTimeUs = chunk[i].timestampUs;
+                header.sampleRateHz = static_cast<uint16_t>(rate);
+                frameBytes += encodeECGMultiFrame(header, chunk + i, count, channels, frame, sizeof(frame));
+            }
+            done += n;
+        }
+        double elapsed = realSeconds() - start;
+        nsPerSample[channels] = elapsed / sampleCount * 1e9;
+        double perChannel = channels > 1 ? (nsPerSample[channels] - nsPerSample[1]) / (channels - 1) : 0;
+        printf("  %u channel%s: %.1f ns per sample, %.1f ns per added channel, %.2f bytes per lead sample, "
+               "%llu beats\n",
+               channels, channels > 1 ? "s" : " ", nsPerSample[channels], perChannel,
+               static_cast<double>(frameBytes) / sampleCount / channels, (unsigned long long)beats);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    bool bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+    bool channels = argc > 1 && strcmp(argv[1], "--channels") == 0;
+    bool link = argc > 1 && strcmp(argv[1], "--link") == 0;
+    int arg = bench || channels ? 2 : 1;
+    double amount = argc > arg ? atof(argv[arg]) : (bench ? 1e7 : (channels ? 1e6 : 60.0));
+    NativeSim::Options options = NativeSim::defaultOptions();
+    options.tracePath = !channels && argc > arg + 1 ? argv[arg + 1] : nullptr;
+    if (link) {
+        websockets::LoopbackServer::Transport transport = {};
+        transport.bytesPerSecond = argc > 2 ? static_cast<uint32_t>(atoi(argv[2])) : 200;
+        transport.lossPercent = argc > 3 ? static_cast<uint8_t>(atoi(argv[3])) : 10;
+        transport.sendBufferBytes = LINK_SEND_BUFFER_BYTES;
+        transport.retransmitUs = LINK_RETRANSMIT_US;
+        amount = argc > 4 ? atof(argv[4]) : 240.0;
+        options.tracePath = nullptr;
+        options.leadScript = false;
+        NativeSim::impairLink(transport, static_cast<uint64_t>(amount * 1e6 / 4),
+                              static_cast<uint64_t>(amount * 1e6 / 2));
+        NativeSim::setTextHandler(printUplinkRate);
+        if (transport.bytesPerSecond == 0 || transport.lossPercent > 100) {
+            amount = 0;
+        }
+    }
+    if (amount <= 0 || ((bench || channels) && amount < 1)) {
+        fprintf(stderr, "usage: %s [simulated seconds] [trace file]\n"
+                        "       %s --link [bytes per second] [loss percent] [simulated seconds]\n"
+                        "       %s --bench [samples] [trace file]\n"
+                        "       %s --channels [samples]\n",
+                argv[0], argv[0], argv[0], argv[0]);
+        return 1;
+    }
+
+    if (channels) {
+        return runChannelBenchmark(static_cast<uint64_t>(amount));
+    }
+    if (bench) {
+        SyntheticECGSource synthetic;
+        TraceECGSource trace(options.tracePath != nullptr ? options.tracePath : "");
+        if (options.tracePath != nullptr && !trace.begin()) {
+            fprintf(stderr, "cannot map trace %s\n", options.tracePath);
+            return 1;
+        }
+        ECGSource &source = options.tracePath != nullptr ? static_cast<ECGSource &>(trace) : synthetic;
+        return runBenchmark(source, static_cast<uint64_t>(amount));
+    }
+    return runFirmware(options, amount);
+}
+#endif // PIO_UNIT_TESTING
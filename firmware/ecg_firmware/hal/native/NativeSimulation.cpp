@@ -0,0 +1,432 @@
+// NativeSimulation.cpp
+// This file implements the simulated surroundings declared in NativeSimulation.h.
+
+#include "NativeSimulation.h"
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <time.h>
+
+#include "ECGSource.h"
+#include "NativeHAL.h"
+
+namespace NativeSim {
+
+struct LinkScript {
+    websockets::LoopbackServer::Transport impaired;
+    uint64_t fromUs;
+    uint64_t toUs;
+    bool active; // Whether the transport is impaired now
+};
+
+static ReceivedFrames s_received = {};
+static Options s_options = {};
+static FrameHandler s_frameHandler;
+static TextHandler s_textHandler;
+static LinkScript s_link = {};
+static uint64_t s_leadChangeUs = 0;        // When the lead script last moved LO+
+static uint64_t s_leadOnUs = UINT64_MAX;    // When the lead script last reattached the leads
+
+// Channel 0 of the latest live sample frames, to place the beats later frames report
+#define SIM_SAMPLE_HISTORY 1024
+static uint32_t s_historyUs[SIM_SAMPLE_HISTORY];
+static uint16_t s_historyValues[SIM_SAMPLE_HISTORY];
+static size_t s_historyCount = 0; // Samples ever added; the newest is at (s_historyCount - 1) % SIM_SAMPLE_HISTORY
+static double s_realSeconds = 0;
+
+static SyntheticECGSource s_synthetic;
+static TraceECGSource *s_trace = nullptr;
+static uint64_t s_syntheticNextUs = 0;
+static uint16_t s_syntheticValue = ECG_SOURCE_MID_SCALE;
+
+static double monotonicSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint16_t syntheticAnalog(uint8_t, uint64_t us) {
+    // One synthetic sample per sample period, held in between, so the signal keeps its
+    // real-time shape however often the ADC converts.
+    while (us >= s_syntheticNextUs) {
+        s_syntheticValue = static_cast<uint16_t>(s_synthetic.readECG());
+        s_syntheticNextUs += SIM_SAMPLE_PERIOD_US;
+    }
+    return s_syntheticValue;
+}
+
+static uint32_t simulatedMillis() {
+    return millis();
+}
+
+static void advanceSimulatedMillis(uint32_t ms) {
+    NativeHAL::advanceMicros(static_cast<uint64_t>(ms) * 1000);
+}
+
+/**
+ * @brief Moves LO+ according to the lead-off script.
+ */
+static void runLeadScript(uint64_t nowUs) {
+    uint64_t second = nowUs / 1000000 % SIM_LEAD_OFF_EVERY_S;
+    int level = second >= SIM_LEAD_OFF_AT_S && second < SIM_LEAD_OFF_AT_S + SIM_LEAD_OFF_FOR_S ? HIGH : LOW;
+    if (digitalRead(SIM_LO_PLUS_PIN) != level) {
+        s_leadChangeUs = nowUs;
+        if (level == LOW) {
+            s_leadOnUs = nowUs;
+        }
+        NativeHAL::setDigitalInput(SIM_LO_PLUS_PIN, level);
+    }
+}
+
+/**
+ * @brief Throttles the transport during the impaired part of the run.
+ */
+static void runLinkScript(uint64_t nowUs) {
+    bool impaired = nowUs >= s_link.fromUs && nowUs < s_link.toUs;
+    if (impaired != s_link.active) {
+        s_link.active = impaired;
+        websockets::LoopbackServer::Transport transport = {};
+        if (impaired) {
+            transport = s_link.impaired;
+        }
+        websockets::LoopbackServer::instance().transport = transport;
+    }
+}
+
+static uint16_t readU16(const uint8_t *p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static uint32_t readU32(const uint8_t *p) {
+    return readU16(p) | (static_cast<uint32_t>(readU16(p + 2)) << 16);
+}
+
+bool decodeSampleFrame(const uint8_t *data, size_t length, DecodedFrame &frame) {
+    ECGFrameHeader &header = frame.header;
+    if (!decodeECGFrameHeader(data, length, header) || header.sampleCount == 0 ||
+        header.sampleCount > ECG_FRAME_MAX_SAMPLES) {
+        return false;
+    }
+    if (header.type == ECG_FRAME_TYPE_SAMPLES) {
+        frame.channels = 1;
+    } else if (header.type == ECG_FRAME_TYPE_MULTI_SAMPLES && header.channels >= 1 &&
+               header.channels <= ECG_MAX_CHANNELS) {
+        frame.channels = header.channels;
+    } else {
+        return false;
+    }
+
+    size_t offset = ECG_FRAME_HEADER_SIZE;
+    for (uint8_t c = 0; c < frame.channels; c++) {
+        ECGDeltaDecoder decoder;
+        for (uint16_t i = 0; i < header.sampleCount; i++) {
+            if (header.flags & ECG_FRAME_FLAG_DELTA_VARINT) {
+                size_t used = decoder.decode(data + offset, length - offset, frame.values[c][i]);
+                if (used == 0) {
+                    return false;
+                }
+                offset += used;
+            } else {
+                if (length - offset < 2) {
+                    return false;
+                }
+                frame.values[c][i] = readU16(data + offset);
+                offset += 2;
+            }
+        }
+    }
+    for (uint8_t c = 0; c < frame.channels; c++) {
+        const uint8_t *bitmap = data + offset;
+        if (header.flags & ECG_FRAME_FLAG_LEAD_OFF) {
+            if (length - offset < (header.sampleCount + 7u) / 8) {
+                return false;
+            }
+            offset += (header.sampleCount + 7u) / 8;
+        }
+        for (uint16_t i = 0; i < header.sampleCount; i++) {
+            frame.leadOff[c][i] = (header.flags & ECG_FRAME_FLAG_LEAD_OFF) && (bitmap[i >> 3] & (1u << (i & 7)));
+        }
+    }
+
+    frame.bpmX10 = 0;
+    frame.rrIntervalMs = 0;
+    frame.beatCount = 0;
+    if (header.flags & ECG_FRAME_FLAG_HEART_RATE) {
+        if (length - offset < 5 || data[offset + 4] > ECG_FRAME_MAX_BEATS ||
+            length - offset - 5 < data[offset + 4]) {
+            return false;
+        }
+        frame.bpmX10 = readU16(data + offset);
+        frame.rrIntervalMs = readU16(data + offset + 2);
+        frame.beatCount = data[offset + 4];
+        offset += 5;
+        for (uint8_t b = 0; b < frame.beatCount; b++) {
+            frame.beats[b] = data[offset++];
+            if (frame.beats[b] >= header.sampleCount) {
+                return false;
+            }
+        }
+    }
+    frame.earlierBeatCount = 0;
+    if (header.flags & ECG_FRAME_FLAG_EARLIER_BEATS) {
+        if (length - offset < 1 || data[offset] > ECG_FRAME_MAX_EARLIER_BEATS ||
+            length - offset - 1 < 4u * data[offset]) {
+            return false;
+        }
+        frame.earlierBeatCount = data[offset++];
+        for (uint8_t b = 0; b < frame.earlierBeatCount; b++) {
+            frame.earlierBeatsUs[b] = static_cast<uint32_t>(header.startTimeUs) - readU32(data + offset);
+            offset += 4;
+        }
+    }
+    if (header.flags & ECG_FRAME_FLAG_SEND_TIME) {
+        offset += 4;
+    }
+    return offset == length;
+}
+
+/**
+ * @brief Counts the beats of a live sample frame, and those not marked on a local maximum of
+ * channel 0 (the R peak stands out of a clean signal by far).
+ */
+static void countBeats(const DecodedFrame &frame) {
+    const ECGFrameHeader &header = frame.header;
+    for (uint16_t i = 0; i < header.sampleCount; i++) {
+        size_t slot = s_historyCount++ % SIM_SAMPLE_HISTORY;
+        s_historyUs[slot] = static_cast<uint32_t>(header.startTimeUs + i * 1000000ULL / header.sampleRateHz);
+        s_historyValues[slot] = frame.values[0][i];
+    }
+
+    for (uint8_t b = 0; b < frame.beatCount; b++) {
+        uint8_t i = frame.beats[b];
+        const uint16_t *values = frame.values[0];
+        s_received.beats++;
+        if ((i > 0 && values[i - 1] > values[i]) || (i + 1 < header.sampleCount && values[i + 1] > values[i])) {
+            s_received.beatsOffPeak++;
+        }
+    }
+
+    // Beats confirmed after their frame was sent name the time of their R peak instead.
+    size_t oldest = s_historyCount > SIM_SAMPLE_HISTORY ? s_historyCount - SIM_SAMPLE_HISTORY : 0;
+    for (uint8_t b = 0; b < frame.earlierBeatCount; b++) {
+        s_received.earlierBeats++;
+        size_t n = s_historyCount;
+        while (n > oldest && s_historyUs[(n - 1) % SIM_SAMPLE_HISTORY] != frame.earlierBeatsUs[b]) {
+            n--;
+        }
+        // Neither end of the history: the R peak's neighbours must be known.
+        if (n <= oldest + 1 || n == s_historyCount) {
+            s_received.earlierBeatsUnplaced++;
+            continue;
+        }
+        uint16_t value = s_historyValues[(n - 1) % SIM_SAMPLE_HISTORY];
+        if (s_historyValues[(n - 2) % SIM_SAMPLE_HISTORY] > value || s_historyValues[n % SIM_SAMPLE_HISTORY] > value) {
+            s_received.beatsOffPeak++;
+        }
+    }
+}
+
+/**
+ * @brief Counts the lead-off samples of each lead of a multi-channel frame, and those of
+ * lead 0 that the lead script did not take off (LO+ moves on whole seconds).
+ */
+static void countLeadOff(const DecodedFrame &frame) {
+    const ECGFrameHeader &header = frame.header;
+    for (uint8_t c = 0; c < frame.channels; c++) {
+        for (uint16_t i = 0; i < header.sampleCount; i++) {
+            if (!frame.leadOff[c][i]) {
+                continue;
+            }
+            s_received.leadOffSamples[c]++;
+            uint64_t us = header.startTimeUs + i * 1000000ULL / header.sampleRateHz;
+            uint64_t intoCycleUs = us % (SIM_LEAD_OFF_EVERY_S * 1000000ULL);
+            bool scripted = s_options.leadScript && intoCycleUs >= SIM_LEAD_OFF_AT_S * 1000000ULL &&
+                            intoCycleUs < (SIM_LEAD_OFF_AT_S + SIM_LEAD_OFF_FOR_S) * 1000000ULL + SIM_SAMPLE_PERIOD_US;
+            if (c == 0 && !scripted) {
+                s_received.leadOffOutsideScript++;
+            }
+        }
+    }
+}
+
+static void onFrame(const uint8_t *data, size_t length) {
+    ECGFrameHeader header;
+    if (!decodeECGFrameHeader(data, length, header)) {
+        s_received.badFrames++;
+        return;
+    }
+    s_received.frames++;
+    if (header.flags & ECG_FRAME_FLAG_BACKFILL) {
+        s_received.backfillFrames++;
+    }
+    if (header.type == ECG_FRAME_TYPE_LEAD_EVENT) {
+        bool off = (header.flags & ECG_FRAME_FLAG_LEAD_OFF) != 0;
+        (off ? s_received.leadOffEvents : s_received.leadOnEvents)++;
+        s_received.leadOnTimeUs = off ? 0 : header.startTimeUs;
+        if (header.startTimeUs >= s_leadChangeUs && header.startTimeUs - s_leadChangeUs > s_received.maxReactionUs) {
+            s_received.maxReactionUs = header.startTimeUs - s_leadChangeUs;
+        }
+    } else {
+        // Multi-channel frames flag leads that are off instead of pausing (ECG_CHANNEL_COUNT > 1 builds).
+        if (header.type == ECG_FRAME_TYPE_SAMPLES && (header.flags & ECG_FRAME_FLAG_LEAD_OFF)) {
+            s_received.leadOffFrames++;
+        }
+        if (s_received.leadOnTimeUs != 0) {
+            uint64_t resume = header.startTimeUs - s_received.leadOnTimeUs;
+            if (resume > s_received.maxResumeUs) {
+                s_received.maxResumeUs = resume;
+            }
+            s_received.leadOnTimeUs = 0;
+        }
+        s_received.samples += header.sampleCount;
+        DecodedFrame decoded;
+        if (!decodeSampleFrame(data, length, decoded)) {
+            s_received.badFrames++;
+            return;
+        }
+        if (!(header.flags & ECG_FRAME_FLAG_BACKFILL)) {
+            countBeats(decoded);
+        }
+        if (header.type == ECG_FRAME_TYPE_MULTI_SAMPLES) {
+            countLeadOff(decoded);
+        }
+        if (header.flags & ECG_FRAME_FLAG_HEART_RATE) {
+            s_received.heartRateFrames++;
+            if (header.startTimeUs >= s_leadOnUs && header.startTimeUs - s_leadOnUs < SIM_RATE_UNKNOWN_AFTER_LEAD_ON_US) {
+                s_received.staleHeartRateFrames++;
+            }
+        }
+        if (header.sampleRateHz > 0) {
+            double seconds = static_cast<double>(header.sampleCount) / header.sampleRateHz;
+            uint64_t endUs = header.startTimeUs + static_cast<uint64_t>(seconds * 1e6);
+            if (s_received.signalSeconds == 0) {
+                s_received.firstSampleUs = header.startTimeUs;
+            }
+            if (endUs > s_received.lastSampleEndUs) {
+                s_received.lastSampleEndUs = endUs;
+            }
+            s_received.signalSeconds += seconds;
+        }
+    }
+    if (s_frameHandler) {
+        s_frameHandler(header, data, length);
+    }
+}
+
+Options defaultOptions() {
+    Options options = {};
+    options.leadScript = true;
+    options.timeSync = true;
+    return options;
+}
+
+bool begin(const Options &options) {
+    s_options = options;
+    // The synthetic signal goes through the simulated ADC and lead-off pins, a trace
+    // replaces the front end.
+    if (options.tracePath != nullptr) {
+        s_trace = new TraceECGSource(options.tracePath);
+        if (!s_trace->begin()) {
+            return false;
+        }
+        ecgSensor.setSource(s_trace);
+    } else {
+        NativeHAL::setAnalogSource(syntheticAnalog);
+    }
+    taskSetSimulatedClock(simulatedMillis, advanceSimulatedMillis);
+
+    // Saved credentials, so setup() goes straight to station mode.
+    Preferences prefs;
+    prefs.begin(WIFI_CREDS);
+    prefs.putString("ssid", "simulated");
+    prefs.putString("password", "simulated");
+    prefs.end();
+    if (options.burstIntervalMs != 0) {
+        // Low-power streaming, as the setup page saves it
+        prefs.begin(DEVICE_SETTINGS);
+        prefs.putUInt(CONFIG_KEY_BURST_INTERVAL, options.burstIntervalMs);
+        prefs.end();
+    }
+
+    websockets::LoopbackServer &server = websockets::LoopbackServer::instance();
+    server.onBinary = onFrame;
+    // A blocked send sleeps its task, so the DSP task keeps draining acquisition meanwhile.
+    server.block = [](uint64_t us) {
+        taskSleepMs(static_cast<uint32_t>(us / 1000));
+        NativeHAL::advanceMicros(us % 1000);
+    };
+    server.onText = [](const std::string &text) {
+        if (text.find("\"time_sync\"") != std::string::npos) {
+            s_received.timeSyncReplies++;
+        } else if (s_textHandler) {
+            s_textHandler(text);
+        }
+    };
+    setup();
+    return true;
+}
+
+void runUntil(double seconds, const SecondScript &script) {
+    double start = monotonicSeconds();
+    uint64_t endUs = static_cast<uint64_t>(seconds * 1e6);
+    while (NativeHAL::nowMicros() < endUs) {
+        uint64_t nowUs = NativeHAL::nowMicros();
+        // Clock-sync request, as the backend sends them; the firmware answers on its next poll.
+        if (s_options.timeSync) {
+            websockets::LoopbackServer::instance().sendText(
+                "{\"type\":\"time_sync\",\"server_us\":" + std::to_string(nowUs) + "}");
+        }
+        if (s_link.toUs > s_link.fromUs) {
+            runLinkScript(nowUs);
+        }
+        if (s_options.leadScript && s_options.tracePath == nullptr) {
+            runLeadScript(nowUs);
+        }
+        if (script) {
+            script(nowUs);
+        }
+        loop();
+    }
+    s_realSeconds += monotonicSeconds() - start;
+}
+
+void end() {
+    dspTask.stop();
+    networkTask.stop();
+}
+
+void setFrameHandler(const FrameHandler &handler) {
+    s_frameHandler = handler;
+}
+
+void setTextHandler(const TextHandler &handler) {
+    s_textHandler = handler;
+}
+
+void impairLink(const websockets::LoopbackServer::Transport &transport, uint64_t fromUs, uint64_t toUs) {
+    s_link.impaired = transport;
+    s_link.fromUs = fromUs;
+    s_link.toUs = toUs;
+}
+
+bool linkImpaired() {
+    return s_link.active;
+}
+
+const ReceivedFrames &received() {
+    return s_received;
+}
+
+SamplingStats samplingStats() {
+#if defined(ECG_CHANNEL_COUNT) && ECG_CHANNEL_COUNT > 1
+    return ecgLeads.getSamplingStats();
+#else
+    return ecgSensor.getSamplingStats();
+#endif
+}
+
+double realSecondsElapsed() {
+    return s_realSeconds;
+}
+
+} // namespace NativeSim
@@ -0,0 +1,198 @@
+// NativeSimulation.h
+// This header file defines the scripted surroundings the firmware runs in on the host: the
+// ECG signal, the lead and link scripts, and the server that receives the stream.
+
+#ifndef NATIVE_SIMULATION_H
+#define NATIVE_SIMULATION_H
+
+#include <ArduinoWebsockets.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <string>
+
+#include "AD8232_ECG.h"
+#include "BurstScheduler.h"
+#include "DeviceSettings.h"
+#include "ECGFrame.h"
+#include "ECGMultiChannel.h"
+#include "ECGSpool.h"
+#include "ECGWebSocket.h"
+#include "HotspotWebServer.h"
+#include "TaskRuntime.h"
+
+// Firmware globals of src/main.cpp the simulations look at
+void setup();
+void loop();
+extern AD8232_ECG ecgSensor;
+#if defined(ECG_CHANNEL_COUNT) && ECG_CHANNEL_COUNT > 1
+extern ECGMultiChannel ecgLeads;
+#endif
+extern ECGWebSocketClient wsClient;
+extern ECGSpool ecgSpool;
+extern HotspotWebServer hotspotServer;
+extern DeviceSettings deviceSettings;
+extern BurstScheduler burstScheduler;
+extern PeriodicTask dspTask;
+extern PeriodicTask networkTask;
+
+// LO_PLUS_PIN and BUTTON_PIN in main.cpp
+#define SIM_LO_PLUS_PIN 14
+#define SIM_BUTTON_PIN 19
+// Scripted lead-off: LO+ goes high at second 10 of every 20 for 2 s
+#define SIM_LEAD_OFF_EVERY_S 20
+#define SIM_LEAD_OFF_AT_S 10
+#define SIM_LEAD_OFF_FOR_S 2
+// The beat detector learns its thresholds for 2 s after the leads come back, so no heart
+// rate is known for at least that long
+#define SIM_RATE_UNKNOWN_AFTER_LEAD_ON_US 2000000
+// Sample period of main.cpp's 125 Hz acquisition
+#define SIM_SAMPLE_PERIOD_US 8000
+// The device ID main.cpp derives from the simulated MAC (24:6F:28:00:00:01)
+#define SIM_DEVICE_ID "cardiacai-000001"
+
+/**
+ * @brief Runs the whole firmware (setup() and loop() of src/main.cpp) on the simulated board.
+ *
+ * The signal is the synthetic ECG through the simulated ADC, or a trace replayed in place
+ * of the front end. The WebSocket goes to the loopback server, whose frames are decoded and
+ * counted here; a run can add its own handlers for frames and text messages, and a script
+ * called once per simulated second (loop() sleeps a second at a time).
+ *
+ * setup() runs once per process, so each program or test runs one simulation.
+ */
+namespace NativeSim {
+
+/**
+ * @brief What the server decoded from the binary messages of the device.
+ */
+struct ReceivedFrames {
+    uint32_t frames;
+    uint32_t backfillFrames;
+    uint32_t badFrames;
+    uint64_t samples;
+    uint32_t leadOffEvents;
+    uint32_t leadOnEvents;
+    uint32_t leadOffFrames;   // Sample frames holding lead-off samples; should stay 0
+    uint64_t leadOnTimeUs;    // Time of the last reattach event, 0 once a frame followed it
+    uint64_t maxResumeUs;     // Longest gap from a reattach event to the next frame
+    uint64_t maxReactionUs;   // Longest delay from a scripted pin change to the matching lead event
+    double signalSeconds;     // Signal covered by the sample frames, at their own rates
+    uint64_t firstSampleUs;   // Start of the first sample frame
+    uint64_t lastSampleEndUs; // End of the latest sample frame
+    uint32_t timeSyncReplies;
+    uint32_t heartRateFrames;      // Sample frames with a heart-rate trailer
+    uint32_t staleHeartRateFrames; // Of those, frames starting before the rate can be known again after a reattach
+    uint32_t beats;                // Beats marked on a sample of their frame
+    uint32_t earlierBeats;         // Beats reported in earlier-beats trailers
+    uint32_t earlierBeatsUnplaced; // Of those, beats whose time is no recent sample's
+    uint32_t beatsOffPeak;         // Beats of either kind on a sample below a neighbour
+    uint32_t leadOffSamples[ECG_MAX_CHANNELS]; // Samples of each lead flagged off in multi-channel frames
+    uint32_t leadOffOutsideScript;             // Of those, samples of lead 0 taken while the script had it on
+};
+
+/**
+ * @brief The payload of a sample frame, as the backend reference decoder reads it.
+ */
+struct DecodedFrame {
+    ECGFrameHeader header;
+    uint8_t channels; // 1 for a single-channel frame
+    uint16_t values[ECG_MAX_CHANNELS][ECG_FRAME_MAX_SAMPLES];
+    bool leadOff[ECG_MAX_CHANNELS][ECG_FRAME_MAX_SAMPLES];
+    uint16_t bpmX10; // Heart-rate trailer, all zero without one
+    uint16_t rrIntervalMs;
+    uint8_t beatCount;
+    uint8_t beats[ECG_FRAME_MAX_BEATS];
+    uint8_t earlierBeatCount;
+    uint32_t earlierBeatsUs[ECG_FRAME_MAX_EARLIER_BEATS]; // Capture times, low 32 bits
+};
+
+/**
+ * @brief Decodes a sample frame (single or multi-channel) in full.
+ * @return false if the frame is malformed, does not end with its trailers, or carries no samples.
+ */
+bool decodeSampleFrame(const uint8_t *data, size_t length, DecodedFrame &frame);
+
+/**
+ * @brief How the board and the server are set up before setup() runs.
+ */
+struct Options {
+    const char *tracePath;    // Trace file replayed instead of the synthetic ECG, or nullptr
+    bool leadScript;          // Move LO+ by the SIM_LEAD_OFF_* script (synthetic signal only)
+    bool timeSync;            // Send a time_sync request every simulated second
+    uint16_t burstIntervalMs; // Saved as the burst interval device setting if nonzero
+};
+
+typedef std::function<void(const ECGFrameHeader &header, const uint8_t *data, size_t length)> FrameHandler;
+typedef std::function<void(const std::string &text)> TextHandler;
+typedef std::function<void(uint64_t nowUs)> SecondScript;
+
+/**
+ * @brief Returns the options of a plain run: synthetic signal, lead script and time sync.
+ */
+Options defaultOptions();
+
+/**
+ * @brief Sets the board up, saves WiFi credentials so setup() goes straight to station
+ * mode, and runs setup().
+ * @return false if the trace cannot be mapped.
+ */
+bool begin(const Options &options);
+
+/**
+ * @brief Runs loop() until the simulated clock reaches the given time.
+ * @param seconds Simulated time since boot to stop at.
+ * @param script Called before each loop(), with the simulated time.
+ */
+void runUntil(double seconds, const SecondScript &script = nullptr);
+
+/**
+ * @brief Stops the firmware tasks.
+ */
+void end();
+
+/**
+ * @brief Called for every decoded binary message, after the counters are updated.
+ */
+void setFrameHandler(const FrameHandler &handler);
+
+/**
+ * @brief Called for every text message other than time_sync replies.
+ */
+void setTextHandler(const TextHandler &handler);
+
+/**
+ * @brief Throttles the transport from fromUs to toUs of simulated time, and restores it after.
+ */
+void impairLink(const websockets::LoopbackServer::Transport &transport, uint64_t fromUs, uint64_t toUs);
+
+/**
+ * @brief Returns true while the transport is impaired by impairLink().
+ */
+bool linkImpaired();
+
+/**
+ * @brief Returns what the server received so far.
+ */
+const ReceivedFrames &received();
+
+#if defined(ECG_CHANNEL_COUNT) && ECG_CHANNEL_COUNT > 1
+typedef ECGMultiChannel::SamplingStats SamplingStats;
+#else
+typedef AD8232_ECG::SamplingStats SamplingStats;
+#endif
+
+/**
+ * @brief Returns the sampling statistics of the acquisition main.cpp runs: ecgLeads in
+ * multi-lead builds, ecgSensor otherwise.
+ */
+SamplingStats samplingStats();
+
+/**
+ * @brief Returns the real time spent in runUntil(), in seconds.
+ */
+double realSecondsElapsed();
+
+} // namespace NativeSim
+
+#endif // NATIVE_SIMULATION_H
@@ -0,0 +1,126 @@
+// Preferences.h
+// In-memory stand-in for the ESP32 Preferences (NVS) library, for host builds.
+
+#ifndef NATIVE_PREFERENCES_H
+#define NATIVE_PREFERENCES_H
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+
+/**
+ * @brief Host replacement for Preferences that keeps every namespace in process memory.
+ *
+ * Values survive end()/begin() and separate instances for the rest of the process,
+ * much like NVS survives across a reboot. Every successful put counts as one flash
+ * write in writeCount(), so tests can check how often a layer such as PersistentConfig
+ * really writes. reset() wipes the simulated flash.
+ */
+class Preferences {
+public:
+    bool begin(const char *name, bool readOnly = false) {
+        _namespace = name;
+        _readOnly = readOnly;
+        _open = true;
+        return true;
+    }
+
+    void end() {
+        _open = false;
+    }
+
+    bool isKey(const char *key) {
+        return _open && store().count(_key(key)) > 0;
+    }
+
+    bool remove(const char *key) {
+        return _open && !_readOnly && store().erase(_key(key)) > 0;
+    }
+
+    bool clear() {
+        if (!_open || _readOnly) {
+            return false;
+        }
+        std::string prefix = _namespace + "/";
+        for (auto it = store().begin(); it != store().end();) {
+            it = it->first.compare(0, prefix.size(), prefix) == 0 ? store().erase(it) : ++it;
+        }
+        return true;
+    }
+
+    size_t putString(const char *key, const char *value) {
+        return _put(key, value) ? strlen(value) + 1 : 0;
+    }
+
+    size_t putString(const char *key, const String &value) {
+        return putString(key, value.c_str());
+    }
+
+    String getString(const char *key, const String &defaultValue = String()) {
+        auto it = store().find(_key(key));
+        return (_open && it != store().end()) ? String(it->second.c_str()) : defaultValue;
+    }
+
+    size_t putUInt(const char *key, uint32_t value) {
+        return _put(key, std::to_string(value)) ? sizeof(value) : 0;
+    }
+
+    uint32_t getUInt(const char *key, uint32_t defaultValue = 0) {
+        auto it = store().find(_key(key));
+        return (_open && it != store().end()) ? static_cast<uint32_t>(std::stoul(it->second)) : defaultValue;
+    }
+
+    size_t putBool(const char *key, bool value) {
+        return _put(key, value ? "1" : "0") ? 1 : 0;
+    }
+
+    bool getBool(const char *key, bool defaultValue = false) {
+        auto it = store().find(_key(key));
+        return (_open && it != store().end()) ? it->second == "1" : defaultValue;
+    }
+
+    /**
+     * @brief Number of successful writes across all instances since the last reset().
+     */
+    static uint32_t writeCount() {
+        return writes();
+    }
+
+    /**
+     * @brief Erases the simulated flash and the write counter.
+     */
+    static void reset() {
+        store().clear();
+        writes() = 0;
+    }
+
+private:
+    std::string _namespace;
+    bool _readOnly = false;
+    bool _open = false;
+
+    static std::map<std::string, std::string> &store() {
+        static std::map<std::string, std::string> values;
+        return values;
+    }
+
+    static uint32_t &writes() {
+        static uint32_t count = 0;
+        return count;
+    }
+
+    std::string _key(const char *key) const {
+        return _namespace + "/" + key;
+    }
+
+    bool _put(const char *key, const std::string &value) {
+        if (!_open || _readOnly) {
+            return false;
+        }
+        store()[_key(key)] = value;
+        writes()++;
+        return true;
+    }
+};
+
+#endif // NATIVE_PREFERENCES_H
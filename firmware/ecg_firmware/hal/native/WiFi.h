@@ -0,0 +1,251 @@
+// WiFi.h
+// Host replacement for the ESP32 WiFi library, with a simulated access point.
+
+#ifndef NATIVE_WIFI_H
+#define NATIVE_WIFI_H
+
+#include <Arduino.h>
+#include <functional>
+#include <vector>
+
+typedef enum {
+    WIFI_OFF = 0,
+    WIFI_STA = 1,
+    WIFI_AP = 2,
+    WIFI_AP_STA = 3
+} wifi_mode_t;
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum {
+    ARDUINO_EVENT_WIFI_STA_START,
+    ARDUINO_EVENT_WIFI_STA_CONNECTED,
+    ARDUINO_EVENT_WIFI_STA_DISCONNECTED,
+    ARDUINO_EVENT_WIFI_STA_GOT_IP,
+    ARDUINO_EVENT_WIFI_AP_START,
+    ARDUINO_EVENT_WIFI_SCAN_DONE,
+    ARDUINO_EVENT_MAX
+} arduino_event_id_t;
+
+typedef enum {
+    WIFI_PS_NONE,
+    WIFI_PS_MIN_MODEM,
+    WIFI_PS_MAX_MODEM
+} wifi_ps_type_t;
+
+#define WIFI_REASON_ASSOC_LEAVE 8
+#define WIFI_REASON_NO_AP_FOUND 201
+
+typedef struct {
+    struct {
+        uint8_t reason;
+    } wifi_sta_disconnected;
+} arduino_event_info_t;
+
+typedef std::function<void(arduino_event_id_t, arduino_event_info_t)> WiFiEventFuncCb;
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED (-2)
+
+// Duration of a simulated asynchronous scan
+#define NATIVE_WIFI_SCAN_MS 2500
+
+/**
+ * @brief Minimal IPv4 address.
+ */
+class IPAddress {
+public:
+    IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : _octets{a, b, c, d} {}
+    String toString() const {
+        char text[16];
+        snprintf(text, sizeof(text), "%u.%u.%u.%u", _octets[0], _octets[1], _octets[2], _octets[3]);
+        return String(text);
+    }
+    uint8_t operator[](int index) const { return _octets[index]; }
+
+private:
+    uint8_t _octets[4];
+};
+
+/**
+ * @brief Simulated WiFi radio.
+ *
+ * Station connects succeed at once (GOT_IP is raised from inside begin()) unless
+ * setStationAvailable(false) was called, in which case they fail with NO_AP_FOUND.
+ * dropStation() simulates losing the access point. Events are delivered synchronously
+ * on the calling thread.
+ */
+class WiFiClass {
+public:
+    int onEvent(WiFiEventFuncCb callback, arduino_event_id_t event = ARDUINO_EVENT_MAX) {
+        (void)event;
+        _callbacks.push_back(callback);
+        return static_cast<int>(_callbacks.size());
+    }
+
+    bool mode(wifi_mode_t mode) {
+        _mode = mode;
+        return true;
+    }
+
+    wifi_mode_t getMode() const {
+        return _mode;
+    }
+
+    bool setAutoReconnect(bool enabled) {
+        _autoReconnect = enabled;
+        return true;
+    }
+
+    wl_status_t begin(const char *ssid, const char *password = nullptr) {
+        (void)ssid;
+        (void)password;
+        if (_stationAvailable) {
+            _status = WL_CONNECTED;
+            _raise(ARDUINO_EVENT_WIFI_STA_GOT_IP, 0);
+        } else {
+            _status = WL_NO_SSID_AVAIL;
+            _raise(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_NO_AP_FOUND);
+        }
+        return _status;
+    }
+
+    bool disconnect(bool wifiOff = false, bool eraseAp = false) {
+        (void)eraseAp;
+        if (_status == WL_CONNECTED) {
+            _status = WL_DISCONNECTED;
+            _raise(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_ASSOC_LEAVE);
+        }
+        if (wifiOff) {
+            _mode = WIFI_OFF;
+        }
+        return true;
+    }
+
+    bool softAP(const char *ssid, const char *password = nullptr) {
+        (void)ssid;
+        (void)password;
+        _raise(ARDUINO_EVENT_WIFI_AP_START, 0);
+        return true;
+    }
+
+    bool softAPdisconnect(bool wifiOff = false) {
+        if (wifiOff) {
+            _mode = WIFI_OFF;
+        }
+        return true;
+    }
+
+    wl_status_t status() const {
+        return _status;
+    }
+
+    IPAddress localIP() const {
+        return _status == WL_CONNECTED ? IPAddress(192, 168, 1, 50) : IPAddress();
+    }
+
+    IPAddress softAPIP() const {
+        return IPAddress(192, 168, 4, 1);
+    }
+
+    int8_t RSSI() const {
+        return _status == WL_CONNECTED ? _rssi : 0;
+    }
+
+    bool setSleep(wifi_ps_type_t sleepType) {
+        _sleep = sleepType;
+        return true;
+    }
+
+    wifi_ps_type_t getSleep() const {
+        return _sleep;
+    }
+
+    String macAddress() const {
+        return String("24:6F:28:00:00:01");
+    }
+
+    int16_t scanNetworks(bool async = false, bool showHidden = false) {
+        (void)showHidden;
+        if (async) {
+            // Finishes NATIVE_WIFI_SCAN_MS later, seen through scanComplete()
+            _scanCount = WIFI_SCAN_RUNNING;
+            _scanStartMs = millis();
+            return WIFI_SCAN_RUNNING;
+        }
+        _scanCount = 2;
+        return _scanCount;
+    }
+
+    int16_t scanComplete() const {
+        if (_scanCount == WIFI_SCAN_RUNNING && millis() - _scanStartMs >= NATIVE_WIFI_SCAN_MS) {
+            return 2;
+        }
+        return _scanCount;
+    }
+
+    void scanDelete() {
+        if (scanComplete() == WIFI_SCAN_RUNNING) {
+            return; // Like the driver, leaves a running scan alone
+        }
+        _scanCount = WIFI_SCAN_FAILED;
+    }
+
+    String SSID(uint8_t index) const {
+        return String(index == 0 ? "SimulatedLab" : "SimulatedGuest");
+    }
+
+    int32_t RSSI(uint8_t index) const {
+        return index == 0 ? -48 : -71;
+    }
+
+    int32_t channel(uint8_t index) const {
+        return index == 0 ? 6 : 11;
+    }
+
+    // --- Simulation controls ---
+
+    void setStationAvailable(bool available) {
+        _stationAvailable = available;
+    }
+
+    void setRSSI(int8_t rssi) {
+        _rssi = rssi;
+    }
+
+    void dropStation() {
+        if (_status == WL_CONNECTED) {
+            _status = WL_DISCONNECTED;
+            _raise(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_NO_AP_FOUND);
+        }
+    }
+
+private:
+    std::vector<WiFiEventFuncCb> _callbacks;
+    wifi_mode_t _mode = WIFI_OFF;
+    wl_status_t _status = WL_IDLE_STATUS;
+    bool _autoReconnect = true;
+    bool _stationAvailable = true;
+    int8_t _rssi = -55;
+    wifi_ps_type_t _sleep = WIFI_PS_MIN_MODEM; // The Arduino default
+    int16_t _scanCount = WIFI_SCAN_FAILED;
+    unsigned long _scanStartMs = 0;
+
+    void _raise(arduino_event_id_t event, uint8_t reason) {
+        arduino_event_info_t info = {};
+        info.wifi_sta_disconnected.reason = reason;
+        for (auto &callback : _callbacks) {
+            callback(event, info);
+        }
+    }
+};
+
+extern WiFiClass WiFi;
+
+#endif // NATIVE_WIFI_H
@@ -0,0 +1,13 @@
+// adc_cali.h
+// Host replacement for the ESP-IDF ADC calibration API.
+
+#ifndef NATIVE_ADC_CALI_H
+#define NATIVE_ADC_CALI_H
+
+#include <hal/adc_types.h>
+
+typedef struct adc_cali_scheme_t *adc_cali_handle_t;
+
+esp_err_t adc_cali_raw_to_voltage(adc_cali_handle_t handle, int raw, int *voltage);
+
+#endif // NATIVE_ADC_CALI_H
@@ -0,0 +1,23 @@
+// adc_cali_scheme.h
+// Host replacement for the ESP-IDF ADC calibration schemes. The simulated ADC has the ESP32's
+// line-fitting scheme with an ideal 0 to 3300 mV response.
+
+#ifndef NATIVE_ADC_CALI_SCHEME_H
+#define NATIVE_ADC_CALI_SCHEME_H
+
+#include "adc_cali.h"
+
+#define ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED 1
+
+typedef struct {
+    adc_unit_t unit_id;
+    adc_atten_t atten;
+    adc_bitwidth_t bitwidth;
+    uint32_t default_vref;
+} adc_cali_line_fitting_config_t;
+
+esp_err_t adc_cali_create_scheme_line_fitting(const adc_cali_line_fitting_config_t *config,
+                                              adc_cali_handle_t *out);
+esp_err_t adc_cali_delete_scheme_line_fitting(adc_cali_handle_t handle);
+
+#endif // NATIVE_ADC_CALI_SCHEME_H
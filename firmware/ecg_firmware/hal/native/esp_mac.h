@@ -0,0 +1,13 @@
+// esp_mac.h
+// Host replacement for the ESP-IDF MAC address functions.
+
+#ifndef NATIVE_ESP_MAC_H
+#define NATIVE_ESP_MAC_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// Writes the factory MAC, 24:6F:28:00:00:01, the same as WiFi.macAddress().
+esp_err_t esp_efuse_mac_get_default(uint8_t *mac);
+
+#endif // NATIVE_ESP_MAC_H
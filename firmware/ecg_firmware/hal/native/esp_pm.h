@@ -0,0 +1,18 @@
+// esp_pm.h
+// Host replacement for the ESP-IDF power management API.
+
+#ifndef NATIVE_ESP_PM_H
+#define NATIVE_ESP_PM_H
+
+#include "esp_err.h"
+
+typedef struct {
+    int max_freq_mhz;
+    int min_freq_mhz;
+    bool light_sleep_enable;
+} esp_pm_config_t;
+
+// Records the configuration in NativeHAL::pmConfig(); the simulated clock never scales.
+esp_err_t esp_pm_configure(const void *config);
+
+#endif // NATIVE_ESP_PM_H
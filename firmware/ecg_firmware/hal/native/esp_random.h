@@ -0,0 +1,12 @@
+// esp_random.h
+// Host replacement for the ESP-IDF hardware random number generator.
+
+#ifndef NATIVE_ESP_RANDOM_H
+#define NATIVE_ESP_RANDOM_H
+
+#include <stdint.h>
+
+// Deterministic across runs, so simulations are repeatable.
+uint32_t esp_random();
+
+#endif // NATIVE_ESP_RANDOM_H
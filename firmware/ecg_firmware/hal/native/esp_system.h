@@ -0,0 +1,12 @@
+// esp_system.h
+// Host replacement for the ESP-IDF system functions.
+
+#ifndef NATIVE_ESP_SYSTEM_H
+#define NATIVE_ESP_SYSTEM_H
+
+#include <stdint.h>
+
+// Counts the restart in NativeHAL::restartCount() and returns; the simulation carries on.
+void esp_restart();
+
+#endif // NATIVE_ESP_SYSTEM_H
@@ -0,0 +1,32 @@
+// adc_types.h
+// Host replacement for the ESP-IDF ADC types shared by the continuous and calibration drivers.
+
+#ifndef NATIVE_ADC_TYPES_H
+#define NATIVE_ADC_TYPES_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum {
+    ADC_UNIT_1,
+    ADC_UNIT_2
+} adc_unit_t;
+
+typedef int adc_channel_t; // On the simulated board the channel is the GPIO number
+
+typedef enum {
+    ADC_ATTEN_DB_0,
+    ADC_ATTEN_DB_2_5,
+    ADC_ATTEN_DB_6,
+    ADC_ATTEN_DB_12
+} adc_atten_t;
+
+typedef enum {
+    ADC_BITWIDTH_DEFAULT = 0,
+    ADC_BITWIDTH_9 = 9,
+    ADC_BITWIDTH_10,
+    ADC_BITWIDTH_11,
+    ADC_BITWIDTH_12
+} adc_bitwidth_t;
+
+#endif // NATIVE_ADC_TYPES_H
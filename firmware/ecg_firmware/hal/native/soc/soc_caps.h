@@ -0,0 +1,11 @@
+// soc_caps.h
+// Host replacement for the ESP-IDF SoC capabilities used by the firmware; values are the ESP32's.
+
+#ifndef NATIVE_SOC_CAPS_H
+#define NATIVE_SOC_CAPS_H
+
+#define SOC_ADC_DIGI_RESULT_BYTES 2              // Conversion results use the 16-bit type1 format
+#define SOC_ADC_SAMPLE_FREQ_THRES_HIGH (2 * 1000 * 1000)
+#define SOC_ADC_SAMPLE_FREQ_THRES_LOW (20 * 1000)
+
+#endif // NATIVE_SOC_CAPS_H
@@ -0,0 +1,90 @@
+// AD8232Lead.h
+// This header file defines the AD8232Lead class, the pins of one AD8232 front end: its analog
+// output and its interrupt-driven lead-off detection.
+#ifndef AD8232_LEAD_H
+#define AD8232_LEAD_H
+
+#include <Arduino.h>
+#include "ECGSource.h"
+
+// Bits of getLeadOffState()
+#define AD8232_LEAD_OFF_PLUS 0x01  // LO+ reports the + electrode off
+#define AD8232_LEAD_OFF_MINUS 0x02 // LO- reports the - electrode off
+
+/**
+ * @brief One AD8232 front end, read as an ECGSource.
+ *
+ * Lead-off detection is interrupt driven: begin() attaches CHANGE interrupts to LO+
+ * and LO-, which keep a cached lead state up to date, so isSensorConnected() never
+ * reads a pin. The output is read with analogRead().
+ *
+ * AD8232_ECG adds the acquisition engine on top of one lead; further leads of a
+ * multi-lead recording are plain AD8232Lead objects (see ECGMultiChannel).
+ */
+class AD8232Lead : public ECGSource {
+public:
+    /**
+     * @brief Constructor for the AD8232Lead class.
+     * @param outputPin The analog pin connected to the 'OUTPUT' pin of the AD8232.
+     * @param loPlusPin The digital pin connected to the 'LO+' (Lead-Off +) pin of the AD8232.
+     * @param loMinusPin The digital pin connected to the 'LO-' (Lead-Off -) pin of the AD8232.
+     */
+    AD8232Lead(int outputPin, int loPlusPin, int loMinusPin);
+
+    /**
+     * @brief Initializes the pins connected to the AD8232 sensor.
+     * This method sets the pin modes for the lead-off detection pins, reads the
+     * initial lead state and attaches the lead-off interrupts.
+     */
+    void begin();
+
+    /**
+     * @brief Checks if the ECG leads are properly connected to the patient.
+     * The AD8232 provides active high signals on LO+ and LO- pins when a lead-off
+     * condition is detected (i.e., leads are disconnected). This method returns true
+     * if both leads are connected (LO+ and LO- are LOW), and false otherwise.
+     * The state is kept by the lead-off interrupts, so no pin is read here.
+     * @return true if both leads are connected, false if any lead is off.
+     */
+    bool isSensorConnected() override;
+
+    /**
+     * @brief Reads the raw analog ECG value from the AD8232's OUTPUT pin.
+     * This value represents the amplified and filtered ECG signal.
+     * The range of the analog reading depends on the ADC resolution (e.g., 0-4095 for ESP32's 12-bit ADC).
+     * @return The raw analog value read from the ECG output pin.
+     */
+    int readECG() override;
+
+    /**
+     * @brief Returns which electrodes are off, as AD8232_LEAD_OFF_* bits (0 when both are connected).
+     */
+    uint8_t getLeadOffState() const;
+
+    /**
+     * @brief Returns the number of lead-off interrupts handled since begin().
+     */
+    uint32_t getLeadChangeCount() const;
+
+protected:
+    int _outputPin;  // Pin connected to the OUTPUT of AD8232 (analog input)
+    int _loPlusPin;  // Pin connected to LO+ of AD8232 (digital input for lead-off detection)
+    int _loMinusPin; // Pin connected to LO- of AD8232 (digital input for lead-off detection)
+
+    volatile uint8_t _leadOffState; // AD8232_LEAD_OFF_* bits, written by the lead-off interrupts
+    volatile uint32_t _leadChanges; // Lead-off interrupts handled
+
+private:
+    /**
+     * @brief Lead-off interrupt handler, re-reads LO+ and LO-.
+     * @param arg Pointer to the AD8232Lead instance.
+     */
+    static void IRAM_ATTR _onLeadChange(void *arg);
+
+    /**
+     * @brief Reads LO+ and LO- into _leadOffState.
+     */
+    void IRAM_ATTR _readLeadState();
+};
+
+#endif // AD8232_LEAD_H
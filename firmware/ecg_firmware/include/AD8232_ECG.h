@@ -4,14 +4,51 @@
 #define AD8232_ECG_H
 
 #include <Arduino.h>
+#include <atomic>
+#include <esp_timer.h>
+#include <esp_adc/adc_continuous.h>
+#include "AD8232Lead.h"
+#include "ADCCalibration.h"
+#include "CICDecimator.h"
+#include "ECGSample.h"
+#include "ECGSource.h"
+#include "SPSCRingBuffer.h"
+
+// Number of samples the acquisition buffer can hold (about 4 s at 125 Hz, 0.5 s at 1 kHz).
+// Must be a power of two.
+#define ECG_SAMPLE_BUFFER_SIZE 512
+
+// Order of the CIC decimator used by oversampled capture
+#define AD8232_CIC_ORDER 3
+// Conversion results drained per adc_continuous_read() call, in bytes
+#define AD8232_ADC_READ_BYTES 256
+// Conversion results the DMA driver keeps between drains; about 100 ms at 20 kHz
+#define AD8232_ADC_POOL_BYTES 4096
 
 /**
  * @brief A class to encapsulate the functionality of the AD8232 ECG sensor.
  *
  * This class provides methods to initialize the sensor, check its connection
  * status (lead-off detection), and read the raw analog ECG signal.
+ *
+ * It also contains a timer-driven acquisition engine: once startSampling() is called,
+ * a periodic esp_timer reads the ADC at a fixed rate and stores timestamped samples
+ * in an internal buffer. The main loop drains that buffer at its own pace, so network
+ * stalls no longer change the sampling rate.
+ *
+ * The engine reads the sensor through the ECGSource interface, so a synthetic or
+ * recorded source can be swapped in with setSource() for benchmarks and replays.
+ *
+ * With setOversampling() the ADC instead runs continuously into DMA at a multiple of
+ * the sampling rate. The timer callback then drains the conversions, calibrates each
+ * one to millivolts through a table built from eFuse, and decimates them with a CIC
+ * filter, so each sample averages many conversions and no ADC read blocks the CPU.
+ *
+ * Lead-off detection is interrupt driven (see AD8232Lead). Every sample is flagged
+ * from the cached lead state, so the first sample taken after an electrode is
+ * reattached is already marked connected.
  */
-class AD8232_ECG {
+class AD8232_ECG : public AD8232Lead {
 public:
     /**
      * @brief Constructor for the AD8232_ECG class.
@@ -22,32 +59,152 @@ public:
     AD8232_ECG(int outputPin, int loPlusPin, int loMinusPin);
 
     /**
-     * @brief Initializes the pins connected to the AD8232 sensor.
-     * This method sets the pin modes for the lead-off detection pins.
+     * @brief Initializes the pins connected to the AD8232 sensor (see AD8232Lead::begin())
+     * and builds the calibration table used by oversampled capture.
      */
     void begin();
 
     /**
-     * @brief Checks if the ECG leads are properly connected to the patient.
-     * The AD8232 provides active high signals on LO+ and LO- pins when a lead-off
-     * condition is detected (i.e., leads are disconnected). This method returns true
-     * if both leads are connected (LO+ and LO- are LOW), and false otherwise.
-     * @return true if both leads are connected, false if any lead is off.
+     * @brief Replaces the signal read by the acquisition engine. Call while not sampling.
+     * @param source The source to read, or nullptr to read the AD8232 again.
+     */
+    void setSource(ECGSource *source);
+
+    /**
+     * @brief Selects oversampled capture for the next startSampling().
+     *
+     * Each sample is then the CIC-decimated average of rawRateHz / rate conversions,
+     * calibrated to millivolts and converted back to the nominal 12-bit scale, so the
+     * rest of the pipeline is unchanged. Timestamps are corrected for the filter delay.
+     * Only applies while reading the AD8232 itself (see setSource()).
+     * @param rawRateHz Conversion rate, a multiple of the sampling rate within the driver's
+     * limits (20 kHz to 2 MHz on the ESP32). 0 to read the ADC once per sample.
+     */
+    void setOversampling(uint32_t rawRateHz);
+
+    /**
+     * @brief Returns true if the running engine captures through the continuous ADC.
+     * False if oversampling is off or the driver could not be set up for it.
+     */
+    bool isOversampling() const;
+
+    /**
+     * @brief Returns true if oversampled readings are corrected with eFuse calibration.
      */
-    bool isSensorConnected();
+    bool isCalibrated() const;
 
     /**
-     * @brief Reads the raw analog ECG value from the AD8232's OUTPUT pin.
-     * This value represents the amplified and filtered ECG signal.
-     * The range of the analog reading depends on the ADC resolution (e.g., 0-4095 for ESP32's 12-bit ADC).
-     * @return The raw analog value read from the ECG output pin.
+     * @brief Statistics about the timer-driven acquisition, used to verify the sampling interval.
      */
-    int readECG();
+    struct SamplingStats {
+        uint32_t samplesCaptured;  // Total samples taken since startSampling()
+        uint32_t samplesDropped;   // Samples lost because the buffer was full
+        uint32_t bufferHighWater;  // Highest buffer fill level observed
+        uint32_t minIntervalUs;    // Shortest observed interval between two samples
+        uint32_t maxIntervalUs;    // Longest observed interval between two samples
+        uint32_t adcConversions;   // Conversions decimated into samples, 0 without oversampling
+    };
+
+    /**
+     * @brief Starts periodic sampling of the ECG output at a fixed rate.
+     * The ADC is read from an esp_timer callback, independently of the Arduino loop().
+     * Calling this while already sampling restarts the engine at the new rate.
+     * @param rate The sampling rate to use.
+     * @return true if the timer was started, false otherwise.
+     */
+    bool startSampling(ECGSampleRate rate);
+
+    /**
+     * @brief Stops periodic sampling. Samples already in the buffer remain readable.
+     */
+    void stopSampling();
+
+    /**
+     * @brief Checks if the acquisition engine is running.
+     * @return true if sampling, false otherwise.
+     */
+    bool isSampling() const;
+
+    /**
+     * @brief Returns the configured sampling rate in Hz, or 0 if sampling has not been started.
+     */
+    uint16_t getSampleRateHz() const;
+
+    /**
+     * @brief Returns the number of samples waiting in the acquisition buffer.
+     */
+    size_t availableSamples() const;
+
+    /**
+     * @brief Removes up to maxSamples samples from the acquisition buffer, oldest first.
+     * @param out Destination array for the samples.
+     * @param maxSamples Capacity of the destination array.
+     * @return The number of samples copied into out.
+     */
+    size_t readSamples(ECGSample *out, size_t maxSamples);
+
+    /**
+     * @brief Returns a snapshot of the acquisition statistics.
+     */
+    SamplingStats getSamplingStats() const;
+
+    /**
+     * @brief Resets the interval and drop statistics.
+     */
+    void resetSamplingStats();
 
 private:
-    int _outputPin;  // Pin connected to the OUTPUT of AD8232 (analog input)
-    int _loPlusPin;  // Pin connected to LO+ of AD8232 (digital input for lead-off detection)
-    int _loMinusPin; // Pin connected to LO- of AD8232 (digital input for lead-off detection)
+    ECGSource *_source;              // Read by the acquisition engine; this object by default
+    esp_timer_handle_t _sampleTimer; // Periodic timer driving the acquisition
+    uint16_t _sampleRateHz;          // Current sampling rate, 0 when not started
+
+    // Oversampled capture, used from the timer callback while _oversampling is set.
+    uint32_t _rawRateHz;               // Requested conversion rate, 0 for one read per sample
+    adc_continuous_handle_t _adc;      // Continuous ADC driver, created on first use
+    bool _oversampling;
+    uint64_t _adcStartUs;              // When the continuous ADC was started
+    uint64_t _adcConversionIndex;      // Conversions decimated since then; timer callback only
+    std::atomic<uint32_t> _adcConversions; // Its low 32 bits, for getSamplingStats() on other tasks
+    uint32_t _groupDelayUs;            // Delay of the decimator, subtracted from timestamps
+    CICDecimator _decimator;
+    ADCCalibration _calibration;
+    alignas(4) uint8_t _adcBuffer[AD8232_ADC_READ_BYTES];
+
+    // Producer: timer callback. Consumer: whoever calls readSamples().
+    SPSCRingBuffer<ECGSample, ECG_SAMPLE_BUFFER_SIZE> _sampleBuffer;
+
+    // Interval statistics, only written from the timer callback.
+    uint32_t _lastSampleUs;
+    volatile uint32_t _samplesCaptured;
+    volatile uint32_t _minIntervalUs;
+    volatile uint32_t _maxIntervalUs;
+
+    /**
+     * @brief Timer callback trampoline, forwards to _captureSample() on the owning instance.
+     * @param arg Pointer to the AD8232_ECG instance.
+     */
+    static void _onSampleTimer(void *arg);
+
+    /**
+     * @brief Reads the source and pushes one timestamped sample into the buffer.
+     */
+    void _captureSample();
+
+    /**
+     * @brief Drains the continuous ADC and pushes every decimated sample into the buffer.
+     */
+    void _captureOversampled();
+
+    /**
+     * @brief Configures and starts the continuous ADC and the decimator for a sampling rate.
+     * @return false if the rate does not divide _rawRateHz or the driver refused the setup.
+     */
+    bool _startContinuous(uint16_t rateHz);
+
+    /**
+     * @brief Updates the interval statistics and pushes a sample into the buffer.
+     */
+    void _pushSample(const ECGSample &sample);
 };
 
 #endif // AD8232_ECG_H
\ No newline at end of file
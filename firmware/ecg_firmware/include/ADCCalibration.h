@@ -0,0 +1,86 @@
+// ADCCalibration.h
+// This header file defines the ADCCalibration class, a lookup table from raw ADC codes
+// to millivolts built from the chip's eFuse calibration.
+
+#ifndef ADC_CALIBRATION_H
+#define ADC_CALIBRATION_H
+
+#include <stdint.h>
+
+// Codes of the 12-bit ADC
+#define ADC_CALIBRATION_CODES 4096
+// Codes between the points queried from the calibration scheme; the table interpolates between them
+#define ADC_CALIBRATION_KNOT_STEP 64
+// Table entries are millivolts with this many fractional bits (1/16 mV, up to 4095 mV)
+#define ADC_CALIBRATION_FRACTION_BITS 4
+// Input range the rest of the pipeline assumes for a 12-bit reading (see ECG_SOURCE_COUNTS_PER_MV)
+#define ADC_NOMINAL_FULL_SCALE_MV 3300
+
+/**
+ * @brief Converts raw ADC codes to millivolts with one table lookup.
+ *
+ * The ESP32 ADC has a chip-specific gain and offset, and its response bends near the
+ * top of the range. ESP-IDF corrects this from values burned into eFuse, but its
+ * adc_cali_raw_to_voltage() is too slow for every conversion of an oversampled stream
+ * and rounds to whole millivolts, which would throw away the resolution oversampling
+ * gains. begin() therefore samples the calibration every ADC_CALIBRATION_KNOT_STEP codes
+ * and interpolates a table with 1/16 mV steps in between.
+ *
+ * Without eFuse calibration the table stays at the nominal 0 to 3300 mV line.
+ */
+class ADCCalibration {
+public:
+    /**
+     * @brief Signature of a calibration: returns the voltage of a raw code, in millivolts.
+     */
+    typedef int (*RawToMillivolts)(int raw, void *context);
+
+    /**
+     * @brief Constructor for the ADCCalibration class. Starts with the nominal table.
+     */
+    ADCCalibration();
+
+    /**
+     * @brief Builds the table from the eFuse calibration of the ADC unit that reads a pin,
+     * at 12 dB attenuation and 12-bit width.
+     * @param pin The GPIO read by the ADC.
+     * @return true if the chip has calibration data; the nominal table is kept otherwise.
+     */
+    bool begin(uint8_t pin);
+
+    /**
+     * @brief Builds the table from a calibration function, e.g. for a measured curve.
+     * @param rawToMillivolts Queried every ADC_CALIBRATION_KNOT_STEP codes and at the last code.
+     * @param context Passed to rawToMillivolts.
+     */
+    void build(RawToMillivolts rawToMillivolts, void *context);
+
+    /**
+     * @brief Resets the table to the nominal line from 0 to ADC_NOMINAL_FULL_SCALE_MV.
+     */
+    void buildNominal();
+
+    /**
+     * @brief Returns true if the table comes from eFuse calibration.
+     */
+    bool isCalibrated() const;
+
+    /**
+     * @brief Returns the voltage of a raw code in 1/16 mV.
+     */
+    inline uint16_t toMillivoltsQ4(uint16_t raw) const {
+        return _table[raw & (ADC_CALIBRATION_CODES - 1)];
+    }
+
+    /**
+     * @brief Converts 1/16 mV back to a 12-bit code on the nominal scale (0-4095),
+     * the unit the filters, frames and backend work in.
+     */
+    static uint16_t millivoltsQ4ToCounts(int32_t millivoltsQ4);
+
+private:
+    uint16_t _table[ADC_CALIBRATION_CODES];
+    bool _calibrated;
+};
+
+#endif // ADC_CALIBRATION_H
@@ -0,0 +1,99 @@
+// BurstScheduler.h
+// This header file defines the BurstScheduler class, which paces the ECG uplink in bursts so the
+// radio can sleep in between.
+
+#ifndef BURST_SCHEDULER_H
+#define BURST_SCHEDULER_H
+
+#include <stdint.h>
+
+// Shortest and longest burst interval of the low-power mode (0 turns it off)
+#define BURST_INTERVAL_MIN_MS 100
+#define BURST_INTERVAL_MAX_MS 5000
+// A burst starts early once the buffered signal fills this share of the buffer, in percent
+#define BURST_EARLY_FILL_PERCENT 75
+
+/**
+ * @brief Decides when the buffered samples go out, and measures what that costs.
+ *
+ * With an interval set, samples wait in the caller's buffer and are sent together once
+ * per interval, or earlier if the buffer is filling up; between bursts nothing is sent,
+ * so WiFi modem sleep keeps the radio off apart from beacons. The caller brackets each
+ * burst with beginBurst() and endBurst(). The duty cycle is the share of the time spent
+ * inside bursts, which is when the radio transmits; the queue latency is the age of the
+ * oldest sample when its burst starts. The logic is clock-agnostic and takes the time as
+ * an argument (microseconds, wrapping like the sample timestamps).
+ */
+class BurstScheduler {
+public:
+    struct Stats {
+        uint32_t bursts;          // Bursts completed
+        uint32_t earlyBursts;     // Of those, started before the interval because the buffer filled
+        uint16_t dutyPermille;    // Time in bursts over every completed cycle, in 1/1000
+        uint16_t lastDutyPermille; // The same for the last cycle alone
+        uint32_t lastBurstUs;     // Duration of the last burst
+        uint32_t maxBurstUs;
+        uint32_t meanLatencyMs;   // Age of the oldest sample at the start of its burst
+        uint32_t maxLatencyMs;
+    };
+
+    /**
+     * @brief Constructor for the BurstScheduler class. Starts disabled.
+     */
+    BurstScheduler();
+
+    /**
+     * @brief Sets the burst interval and resets the scheduler.
+     * @param intervalMs BURST_INTERVAL_MIN_MS to BURST_INTERVAL_MAX_MS, or 0 to send
+     * continuously.
+     */
+    void setInterval(uint16_t intervalMs);
+
+    uint16_t getInterval() const;
+
+    /**
+     * @brief Returns true if an interval is set.
+     */
+    bool isEnabled() const;
+
+    /**
+     * @brief Forgets the statistics and the last burst, so the next one is due at once,
+     * e.g. on a new connection.
+     */
+    void reset();
+
+    /**
+     * @brief Returns true if the buffered samples should be sent now. Always true while
+     * disabled.
+     * @param nowUs The current time.
+     * @param bufferedMs Signal waiting in the buffer, in milliseconds.
+     * @param capacityMs Signal the buffer holds when full, in milliseconds.
+     */
+    bool isDue(uint32_t nowUs, uint32_t bufferedMs, uint32_t capacityMs) const;
+
+    /**
+     * @brief Marks the start of a burst.
+     * @param nowUs The current time.
+     * @param oldestAgeUs Age of the oldest buffered sample.
+     */
+    void beginBurst(uint32_t nowUs, uint32_t oldestAgeUs);
+
+    /**
+     * @brief Marks the end of the burst, once everything buffered was handed to the socket.
+     */
+    void endBurst(uint32_t nowUs);
+
+    Stats getStats() const;
+
+private:
+    uint16_t _intervalMs;
+    bool _started;            // A burst has begun since reset()
+    uint32_t _burstStartUs;   // Start of the current or last burst
+    uint32_t _lastBurstUs;
+    uint64_t _cycleTotalUs;   // Completed cycles, start to start
+    uint64_t _burstTotalUs;   // Bursts within those cycles
+    uint64_t _latencyTotalMs;
+    Stats _stats;
+};
+
+#endif // BURST_SCHEDULER_H
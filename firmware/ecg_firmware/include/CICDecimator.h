@@ -0,0 +1,79 @@
+// CICDecimator.h
+// This header file defines the CICDecimator class, which reduces an oversampled ADC stream
+// to the ECG sampling rate.
+
+#ifndef CIC_DECIMATOR_H
+#define CIC_DECIMATOR_H
+
+#include <stdint.h>
+
+// Limits of configure(). The accumulators are unsigned 64-bit and wrap modulo 2^64; as
+// long as the comb output fits, the wraps cancel in the combs. A 16-bit input at the
+// largest order and ratio needs 16 + 4 * 8 = 48 bits.
+#define CIC_MAX_ORDER 4
+#define CIC_MAX_RATIO 256
+
+/**
+ * @brief Cascaded integrator-comb decimator with an optional droop compensator.
+ *
+ * A CIC filter of order N and ratio R averages R inputs N times over, so it needs
+ * no multiplies: N integrators run at the input rate and N combs at the output rate.
+ * Its response falls off towards the output Nyquist frequency (about -2.7 dB at a
+ * quarter of the output rate for N = 3), so a 3-tap FIR at the output rate can
+ * flatten the passband again. The compensator is tuned for unity gain at a quarter
+ * of the output rate, which is 31 Hz at 125 Hz and covers the ECG band.
+ *
+ * Outputs are in the units of the inputs (the DC gain is 1). The first outputs after
+ * reset() are withheld until the filter holds a full impulse response of input.
+ */
+class CICDecimator {
+public:
+    /**
+     * @brief Constructor for the CICDecimator class. Starts as a third-order decimator by 8.
+     */
+    CICDecimator();
+
+    /**
+     * @brief Sets the filter shape and clears its state.
+     * @param order Number of integrator/comb stages (1 to CIC_MAX_ORDER).
+     * @param ratio Inputs per output (1 to CIC_MAX_RATIO).
+     * @param compensate true to apply the droop compensator to the outputs.
+     * @return true if the parameters are in range; the previous configuration is kept otherwise.
+     */
+    bool configure(uint8_t order, uint16_t ratio, bool compensate = true);
+
+    /**
+     * @brief Clears the filter state, e.g. after a gap in the input.
+     */
+    void reset();
+
+    /**
+     * @brief Feeds one input.
+     * @param input The input value.
+     * @param output Set to the next output when one is produced.
+     * @return true if an output was produced.
+     */
+    bool push(int32_t input, int32_t &output);
+
+    uint8_t getOrder() const;
+    uint16_t getRatio() const;
+
+    /**
+     * @brief Returns the delay of the filter in input samples (integer part).
+     */
+    uint32_t getGroupDelayInputs() const;
+
+private:
+    uint8_t _order;
+    uint16_t _ratio;
+    bool _compensate;
+    int64_t _gain;        // ratio^order
+    float _compensation;  // Side tap of the compensator, negated
+    uint64_t _integrators[CIC_MAX_ORDER]; // Wrap by design, hence unsigned
+    uint64_t _combDelays[CIC_MAX_ORDER];
+    int32_t _history[2];  // Last two CIC outputs, for the compensator
+    uint16_t _phase;      // Inputs since the last output
+    uint8_t _warmup;      // Outputs still to withhold
+};
+
+#endif // CIC_DECIMATOR_H
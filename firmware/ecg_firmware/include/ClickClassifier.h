@@ -0,0 +1,95 @@
+// ClickClassifier.h
+// This header file defines the ClickClassifier class, which turns timed button edges into
+// single-click, double-click and long-press events.
+
+#ifndef CLICK_CLASSIFIER_H
+#define CLICK_CLASSIFIER_H
+
+#include <stdint.h>
+#include "SPSCRingBuffer.h"
+
+// The button must keep a level this long before the change counts (contact bounce)
+#define CLICK_DEBOUNCE_MS 30
+// Time after a release to wait for another click before reporting the clicks so far
+#define MULTI_CLICK_TIMEOUT_MS 500
+// A press held this long is a long press, reported while still held
+#define LONG_PRESS_MS 1500
+// Events kept until the application takes them
+#define CLICK_EVENT_QUEUE_SIZE 8
+
+/**
+ * @brief Button events.
+ */
+enum class ButtonEvent : uint8_t {
+    None,
+    SingleClick,
+    DoubleClick,
+    LongPress
+};
+
+/**
+ * @brief Classifies button presses from the times of the raw edges.
+ *
+ * A level only counts once it has been stable for CLICK_DEBOUNCE_MS, so bouncing
+ * contacts produce one press. Clicks are counted until MULTI_CLICK_TIMEOUT_MS pass
+ * without a new press, then reported as a single or double click; three or more are
+ * ignored. A press held for LONG_PRESS_MS is reported as a long press at that moment,
+ * drops the clicks before it and is not counted as a click when released.
+ *
+ * Events go to a queue of CLICK_EVENT_QUEUE_SIZE; when it is full, new events are
+ * dropped. The logic is clock-agnostic: edges carry their own time and poll() takes the
+ * current time, so it runs the same on the device and on synthetic timings.
+ */
+class ClickClassifier {
+public:
+    /**
+     * @brief Constructor for the ClickClassifier class. The button starts released.
+     */
+    ClickClassifier();
+
+    /**
+     * @brief Feeds a raw edge. Edges must come in time order.
+     * @param pressed The new level, true if the button is pressed.
+     * @param timeMs Time of the edge in milliseconds.
+     */
+    void edge(bool pressed, uint32_t timeMs);
+
+    /**
+     * @brief Settles a pending level change and reports clicks and long presses that are
+     * due by nowMs. Call regularly, at least every few tens of milliseconds.
+     */
+    void poll(uint32_t nowMs);
+
+    /**
+     * @brief Removes the oldest event from the queue.
+     * @return The event, or ButtonEvent::None if the queue is empty.
+     */
+    ButtonEvent takeEvent();
+
+    /**
+     * @brief Returns true while the (debounced) button is held.
+     */
+    bool isPressed() const;
+
+private:
+    bool _rawPressed;       // Level of the last edge
+    uint32_t _rawChangeMs;  // Time of the last edge
+    bool _pressed;          // Debounced level
+    uint32_t _pressMs;      // When the current press started
+    uint32_t _releaseMs;    // When the last click was released
+    uint8_t _clicks;        // Clicks waiting for MULTI_CLICK_TIMEOUT_MS to pass
+    bool _longPressSent;    // The current press was already reported as a long press
+    SPSCRingBuffer<ButtonEvent, CLICK_EVENT_QUEUE_SIZE> _events;
+
+    /**
+     * @brief Commits the raw level once it has been stable for CLICK_DEBOUNCE_MS by nowMs.
+     */
+    void settle(uint32_t nowMs);
+
+    /**
+     * @brief Handles a debounced press or release at timeMs.
+     */
+    void onLevel(bool pressed, uint32_t timeMs);
+};
+
+#endif // CLICK_CLASSIFIER_H
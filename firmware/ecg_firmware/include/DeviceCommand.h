@@ -0,0 +1,83 @@
+// DeviceCommand.h
+// This header file defines the commands the server sends over the device WebSocket to change
+// acquisition and streaming at runtime.
+
+#ifndef DEVICE_COMMAND_H
+#define DEVICE_COMMAND_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+/**
+ * @brief What the uplink sends of the acquired signal.
+ */
+enum class StreamMode : uint8_t {
+    Full,    // Every sample at the acquisition rate (a recording session)
+    Preview, // Averaged down to ECG_PREVIEW_RATE_HZ in large batches, enough to show a trace
+    Off      // No sample frames; the connection, status and clock sync stay up
+};
+
+/**
+ * @brief Command names, as sent in the "name" field.
+ */
+enum class DeviceCommandType : uint8_t {
+    Stream,     // "stream": mode
+    Batch,      // "batch": samples, delay_ms, compress
+    Acquisition, // "acquisition": sample_rate_hz, mains_hz, high_pass, notch, low_pass
+    Unknown      // Any other name; only ever rejected
+};
+
+// Bits of DeviceCommand::fields, one per optional parameter the command carried
+#define DEVICE_COMMAND_BATCH_SAMPLES 0x0001
+#define DEVICE_COMMAND_BATCH_DELAY 0x0002
+#define DEVICE_COMMAND_COMPRESS 0x0004
+#define DEVICE_COMMAND_SAMPLE_RATE 0x0008
+#define DEVICE_COMMAND_MAINS 0x0010
+#define DEVICE_COMMAND_HIGH_PASS 0x0020
+#define DEVICE_COMMAND_NOTCH 0x0040
+#define DEVICE_COMMAND_LOW_PASS 0x0080
+
+/**
+ * @brief One parsed command. Only the parameters flagged in fields were sent; the
+ * others keep their current values when the command is applied.
+ *
+ * On the wire a command is a text message such as
+ * {"type":"command","seq":7,"name":"stream","mode":"preview"}, and every command is
+ * answered with {"type":"command_ack","seq":7,"name":"stream","status":"ok"}, or with
+ * "status":"error" and an "error" message. See ECGWebSocketClient for the sequence rules.
+ */
+struct DeviceCommand {
+    uint32_t seq;           // Sequence number chosen by the server, echoed in the ack
+    DeviceCommandType type;
+    uint16_t fields;        // DEVICE_COMMAND_* bits
+    StreamMode mode;        // Stream
+    uint16_t batchSamples;  // Batch: samples per frame
+    uint16_t batchDelayMs;  // Batch: age of the oldest queued sample that forces a frame
+    bool compress;          // Batch: delta-zigzag-varint frames
+    uint16_t sampleRateHz;  // Acquisition: one of the ECGSampleRate values
+    uint8_t mainsHz;        // Acquisition: 50 or 60, the notch frequency
+    bool highPass;          // Acquisition: filter stages
+    bool notch;
+    bool lowPass;
+};
+
+/**
+ * @brief Parses the body of a {"type":"command"} message.
+ * @param doc The message. Its "seq" must already have been checked.
+ * @param command Receives the command; seq is taken from doc.
+ * @return nullptr on success, otherwise a message for the ack. command.type is
+ * Unknown if the name was not recognised.
+ */
+const char *parseDeviceCommand(JsonDocument &doc, DeviceCommand &command);
+
+/**
+ * @brief Returns the wire name of a command type, e.g. "stream".
+ */
+const char *deviceCommandName(DeviceCommandType type);
+
+/**
+ * @brief Returns the wire name of a stream mode: "full", "preview" or "off".
+ */
+const char *streamModeName(StreamMode mode);
+
+#endif // DEVICE_COMMAND_H
@@ -0,0 +1,135 @@
+// DeviceSettings.h
+// This header file defines the DeviceSettings class, the per-device identity, server endpoint and
+// stream parameters provisioned from the hotspot setup page.
+
+#ifndef DEVICE_SETTINGS_H
+#define DEVICE_SETTINGS_H
+
+#include <Arduino.h>
+#include "ECGSample.h"
+#include "PersistentConfig.h"
+
+// Namespace for Preferences storage.
+#define DEVICE_SETTINGS "device"
+
+// Setting keys in the DEVICE_SETTINGS namespace
+#define CONFIG_KEY_DEVICE_ID "device_id"
+#define CONFIG_KEY_SERVER_HOST "server_host"
+#define CONFIG_KEY_SERVER_PORT "server_port"
+#define CONFIG_KEY_SERVER_PATH "server_path"
+#define CONFIG_KEY_SAMPLE_RATE "sample_rate"
+#define CONFIG_KEY_BATCH_SAMPLES "batch_samples"
+#define CONFIG_KEY_BATCH_DELAY "batch_delay_ms"
+#define CONFIG_KEY_COMPRESS "compress"
+#define CONFIG_KEY_BURST_INTERVAL "burst_ms"
+
+// Longest device ID; the backend keys connections and readings by it
+#define DEVICE_ID_MAX_LENGTH 32
+// Longest server host name or address
+#define SERVER_HOST_MAX_LENGTH 63
+// Longest WebSocket path, without the query string
+#define SERVER_PATH_MAX_LENGTH 63
+// Longest batch delay accepted from the setup page
+#define BATCH_DELAY_MAX_MS 5000
+// The default device ID is this prefix followed by the last three bytes of the MAC in hex
+#define DEVICE_ID_MAC_PREFIX "cardiacai-"
+
+/**
+ * @brief The values of every device setting. Strings are stored inline, so a copy
+ * needs no heap.
+ */
+struct DeviceSettingsValues {
+    char deviceId[DEVICE_ID_MAX_LENGTH + 1];     // Empty selects the MAC-derived ID
+    char serverHost[SERVER_HOST_MAX_LENGTH + 1]; // Host name or IPv4 address
+    uint16_t serverPort;
+    char serverPath[SERVER_PATH_MAX_LENGTH + 1]; // WebSocket path, starting with '/'
+    uint16_t sampleRateHz;                       // One of the ECGSampleRate values
+    uint16_t batchSamples;                       // 1 to ECG_FRAME_MAX_SAMPLES
+    uint16_t batchDelayMs;                       // 0 to BATCH_DELAY_MAX_MS
+    bool compress;                               // Delta-zigzag-varint compressed frames
+    uint16_t burstIntervalMs;                    // Low-power bursts (see BurstScheduler), 0 when off
+};
+
+/**
+ * @brief Settings that tell one device apart from the rest of the fleet, stored in NVS
+ * through a PersistentConfig.
+ *
+ * begin() loads them once at boot and they stay fixed until the next boot: the setup
+ * page saves new values with save(), and the device restarts to apply them, so the
+ * acquisition and the uplink never change configuration under way. Server commands
+ * (DeviceCommand) change the running acquisition and uplink without touching the
+ * stored values, so a restart returns to them. Until a device ID
+ * is set, each device identifies itself as DEVICE_ID_MAC_PREFIX followed by the end of
+ * its factory MAC (e.g. "cardiacai-a1b2c3"), so no two units connect under the same ID.
+ *
+ * save() runs on the AsyncTCP task; the active values are only read after begin().
+ */
+class DeviceSettings {
+public:
+    /**
+     * @brief Constructor for the DeviceSettings class.
+     * @param config The store for the DEVICE_SETTINGS namespace.
+     */
+    DeviceSettings(PersistentConfig &config);
+
+    /**
+     * @brief Loads the stored settings. Settings never saved take the given defaults;
+     * stored values that no longer validate fall back to them as a whole.
+     * @param defaults The compiled-in settings. Their deviceId is ignored in favour of
+     * the MAC-derived ID.
+     */
+    void begin(const DeviceSettingsValues &defaults);
+
+    /**
+     * @brief Returns the settings loaded at boot, with the device ID resolved.
+     */
+    const DeviceSettingsValues &active() const;
+
+    /**
+     * @brief Returns the settings as stored, which differ from active() after a save
+     * until the next boot. An empty deviceId means the MAC-derived ID.
+     */
+    const DeviceSettingsValues &stored() const;
+
+    /**
+     * @brief Returns the MAC-derived device ID.
+     */
+    const char *getDefaultDeviceId() const;
+
+    /**
+     * @brief Returns the active sampling rate.
+     */
+    ECGSampleRate getSampleRate() const;
+
+    /**
+     * @brief Returns the WebSocket path with the device ID query, e.g.
+     * "/api/ws/device?device_id=cardiacai-a1b2c3".
+     */
+    const char *getStreamPath() const;
+
+    /**
+     * @brief Checks values without storing them.
+     * @return nullptr if they are valid, otherwise a message naming the first bad field.
+     */
+    static const char *validate(const DeviceSettingsValues &values);
+
+    /**
+     * @brief Validates and stores new settings. They take effect at the next boot.
+     * @return nullptr on success, otherwise the validation or storage error.
+     */
+    const char *save(const DeviceSettingsValues &values);
+
+private:
+    PersistentConfig &_config;
+    DeviceSettingsValues _active;
+    DeviceSettingsValues _stored;
+    char _defaultDeviceId[DEVICE_ID_MAX_LENGTH + 1];
+    char _streamPath[SERVER_PATH_MAX_LENGTH + DEVICE_ID_MAX_LENGTH + 12]; // path + "?device_id=" + ID
+
+    /**
+     * @brief Copies the stored settings into _stored.
+     */
+    void _load();
+};
+
+#endif // DEVICE_SETTINGS_H
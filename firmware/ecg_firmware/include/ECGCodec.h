@@ -0,0 +1,95 @@
+// ECGCodec.h
+// This header file defines a streaming delta + zigzag + varint codec for ECG sample values.
+
+#ifndef ECG_CODEC_H
+#define ECG_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Each value is coded as the difference from the previous value (the first value
+ * after a reset is coded against 0). The signed difference is zigzag-mapped to an
+ * unsigned integer (0, -1, 1, -2, 2 ... -> 0, 1, 2, 3, 4 ...) and written as a
+ * LEB128 varint: 7 bits per byte, high bit set on every byte except the last.
+ *
+ * Consecutive 12-bit ECG samples usually differ by less than +/-64, so most samples
+ * take a single byte instead of two. The worst case for 16-bit input is 3 bytes.
+ *
+ * The state is reset at the start of every frame so that each frame decodes on its
+ * own and a lost frame does not corrupt the ones after it.
+ */
+
+// Worst-case encoded size of one uint16 value.
+#define ECG_CODEC_MAX_BYTES_PER_VALUE 3
+
+/**
+ * @brief Streaming encoder for the delta-zigzag-varint ECG codec.
+ */
+class ECGDeltaEncoder {
+public:
+    ECGDeltaEncoder() : _previous(0) {}
+
+    /**
+     * @brief Resets the predictor. Call at the start of every independently decodable block.
+     */
+    void reset() { _previous = 0; }
+
+    /**
+     * @brief Encodes one value.
+     * @param value The sample value.
+     * @param out Destination, must have room for ECG_CODEC_MAX_BYTES_PER_VALUE bytes.
+     * @return The number of bytes written.
+     */
+    size_t encode(uint16_t value, uint8_t *out);
+
+    /**
+     * @brief Encodes a block of values.
+     * @param values The sample values, oldest first.
+     * @param count Number of values.
+     * @param out Destination buffer.
+     * @param capacity Size of the destination buffer.
+     * @return The number of bytes written, or 0 if out is too small.
+     */
+    size_t encodeBlock(const uint16_t *values, size_t count, uint8_t *out, size_t capacity);
+
+private:
+    uint16_t _previous; // Last encoded value
+};
+
+/**
+ * @brief Streaming decoder for the delta-zigzag-varint ECG codec.
+ */
+class ECGDeltaDecoder {
+public:
+    ECGDeltaDecoder() : _previous(0) {}
+
+    /**
+     * @brief Resets the predictor. Must mirror the encoder's resets.
+     */
+    void reset() { _previous = 0; }
+
+    /**
+     * @brief Decodes one value.
+     * @param in Encoded input.
+     * @param length Number of bytes available at in.
+     * @param value Receives the decoded value.
+     * @return The number of bytes consumed, or 0 if the input is truncated or malformed.
+     */
+    size_t decode(const uint8_t *in, size_t length, uint16_t &value);
+
+    /**
+     * @brief Decodes a block of values.
+     * @param in Encoded input.
+     * @param length Number of bytes available at in.
+     * @param values Destination for the decoded values.
+     * @param count Number of values to decode.
+     * @return The number of bytes consumed, or 0 if the input is truncated or malformed.
+     */
+    size_t decodeBlock(const uint8_t *in, size_t length, uint16_t *values, size_t count);
+
+private:
+    uint16_t _previous; // Last decoded value
+};
+
+#endif // ECG_CODEC_H
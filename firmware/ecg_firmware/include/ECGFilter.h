@@ -1,79 +1,125 @@
 // ECGFilter.h
-// This header file defines the ECGFilter class for applying a simple moving average filter to ECG data.
+// This header file defines the ECGFilter class, a fixed-point biquad filter bank for conditioning ECG data.
 
 #ifndef ECG_FILTER_H
 #define ECG_FILTER_H
 
-#include <Arduino.h>
-#include <deque>
+#include <stddef.h>
+#include <stdint.h>
+#include "ECGSample.h"
+
+// Fractional bits of the biquad coefficients (Q2.29, so |coefficient| < 4).
+#define ECG_FILTER_COEFF_SHIFT 29
+
+// Extra fractional bits given to the samples inside the filter, to keep rounding noise
+// well below one ADC count.
+#define ECG_FILTER_INPUT_SHIFT 4
+
+// ADC mid-scale; raw samples are centred on it before filtering and the output is centred on it again.
+#define ECG_FILTER_ADC_MIDSCALE 2048
+#define ECG_FILTER_ADC_MAX 4095
+
+// Corner frequencies of the filter bank.
+#define ECG_FILTER_HIGH_PASS_HZ 0.5 // Baseline-wander removal
+#define ECG_FILTER_LOW_PASS_HZ 40.0 // Muscle noise / anti-alias for display
+
+/**
+ * @brief Mains frequency to reject with the notch stage.
+ */
+enum class MainsFrequency : uint8_t {
+    Hz50 = 50,
+    Hz60 = 60
+};
 
 /**
- * @brief A class to apply a simple moving average filter to a stream of integer data.
+ * @brief Coefficients of one biquad section, normalised so that a0 = 1, in Q2.29.
+ */
+struct BiquadCoefficients {
+    int32_t b0;
+    int32_t b1;
+    int32_t b2;
+    int32_t a1;
+    int32_t a2;
+};
+
+/**
+ * @brief A fixed-point IIR filter bank for ECG conditioning.
  *
- * This filter helps smooth out noisy signals by averaging a specified number of
- * recent samples. It's suitable for basic noise reduction in sensor readings.
+ * Three biquad sections run in cascade on every sample:
+ * - a 0.5 Hz high-pass to remove baseline wander,
+ * - a 50 or 60 Hz notch to remove mains hum,
+ * - a 40 Hz low-pass to remove muscle noise.
+ *
+ * Coefficients for every supported sample rate and mains frequency are computed at
+ * compile time (RBJ audio-EQ designs evaluated with constexpr math), so configure()
+ * only selects a table entry. Filtering uses 32-bit state, 64-bit accumulators and
+ * first-order error feedback. It never allocates and is deterministic, which makes it
+ * suitable for the per-sample path.
  */
 class ECGFilter {
 public:
     /**
      * @brief Constructor for the ECGFilter class.
-     * @param windowSize The number of samples to include in the moving average calculation.
-     * A larger window provides more smoothing but introduces more lag.
-     * Minimum windowSize is 1.
+     * The filter starts configured for 125 Hz sampling and 50 Hz mains with all stages enabled.
      */
-    ECGFilter(unsigned int windowSize);
+    ECGFilter();
 
     /**
-     * @brief Adds a new raw data point to the filter and returns the smoothed (filtered) value.
-     * The oldest sample is discarded if the buffer is full.
-     * @param rawValue The new raw integer data point to filter.
-     * @return The filtered (averaged) integer value.
+     * @brief Selects the coefficient set for a sampling rate and mains frequency and clears the state.
+     * @param rate The sampling rate of the samples that will be filtered.
+     * @param mains The mains frequency to notch out.
+     */
+    void configure(ECGSampleRate rate, MainsFrequency mains);
+
+    /**
+     * @brief Enables or disables individual stages. Disabled stages pass samples through unchanged.
+     * @param highPass true to run the baseline-wander high-pass.
+     * @param notch true to run the mains notch.
+     * @param lowPass true to run the low-pass.
+     */
+    void setStages(bool highPass, bool notch, bool lowPass);
+
+    /**
+     * @brief Filters one raw ADC sample.
+     * @param rawValue The raw 12-bit ADC value.
+     * @return The filtered value, re-centred on ECG_FILTER_ADC_MIDSCALE and clamped to the ADC range.
      */
     int filter(int rawValue);
 
     /**
-     * @brief Clears all samples from the filter's internal buffer.
+     * @brief Filters a block of samples in place.
+     * @param samples The samples to filter, oldest first.
+     * @param count Number of samples.
+     */
+    void filterSamples(ECGSample *samples, size_t count);
+
+    /**
+     * @brief Clears the filter state.
      * This should be called if there's a discontinuity in the data or
      * when starting a new reading session to prevent old samples from affecting new ones.
      */
     void clear();
 
 private:
-    unsigned int _windowSize;      // Size of the moving average window
-    std::deque<int> _buffer;       // Deque to store samples for the moving average
-    long _currentSum;              // Sum of values currently in the buffer (use long to prevent overflow)
+    static const uint8_t kStageCount = 3;
+
+    /**
+     * @brief Direct-form-I state of one biquad section.
+     */
+    struct BiquadState {
+        int32_t x1, x2; // Previous inputs
+        int32_t y1, y2; // Previous outputs
+        int64_t error;  // Rounding error carried into the next sample (error feedback)
+    };
+
+    const BiquadCoefficients *_coefficients; // kStageCount sections, in cascade order
+    BiquadState _state[kStageCount];
+    bool _stageEnabled[kStageCount];
+
+    /**
+     * @brief Runs one biquad section on one sample.
+     */
+    static int32_t _processStage(const BiquadCoefficients &c, BiquadState &s, int32_t x);
 };
 
-// // ECGFilter.cpp
-// // This file implements the methods defined in the ECGFilter class.
-
-// // #include "ECGFilter.h" // Include the corresponding header file
-
-// ECGFilter::ECGFilter(unsigned int windowSize) : _currentSum(0) {
-//     // Ensure minimum window size is 1 to avoid division by zero or empty buffer issues.
-//     _windowSize = (windowSize > 0) ? windowSize : 1;
-// }
-
-// int ECGFilter::filter(int rawValue) {
-//     // Add the new value to the sum.
-//     _currentSum += rawValue;
-//     // Add the new value to the back of the buffer.
-//     _buffer.push_back(rawValue);
-
-//     // If the buffer has exceeded the window size, remove the oldest value from the front.
-//     if (_buffer.size() > _windowSize) {
-//         _currentSum -= _buffer.front(); // Subtract the value being removed from the sum.
-//         _buffer.pop_front();            // Remove the oldest value.
-//     }
-
-//     // Calculate the average. If the buffer is empty (shouldn't happen with rawValue added), return 0.
-//     if (_buffer.empty()) {
-//         return 0;
-//     }
-//     return _currentSum / _buffer.size(); // Return the calculated moving average.
-// }
-
-// void ECGFilter::clear() {
-//     _buffer.clear();   // Clear all elements from the deque.
-//     _currentSum = 0;   // Reset the sum.
-}
+#endif // ECG_FILTER_H
@@ -0,0 +1,232 @@
+// ECGFrame.h
+// This header file defines the binary frame format used to send batches of ECG samples.
+
+#ifndef ECG_FRAME_H
+#define ECG_FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ECGSample.h"
+#include "ECGCodec.h"
+
+/*
+ * Frame layout (all multi-byte fields little-endian):
+ *
+ *   offset  size  field
+ *   0       1     version        ECG_FRAME_VERSION
+ *   1       1     type           ECG_FRAME_TYPE_*
+ *   2       1     flags          ECG_FRAME_FLAG_*
+ *   3       1     channels       Channel count of a multi-channel frame, 0 otherwise
+ *   4       4     sequence       Incremented for every frame the device sends since boot
+ *   8       8     startTimeUs    Device monotonic time of the first sample, in microseconds
+ *   16      2     sampleRateHz   Sampling rate of the samples in the frame
+ *   18      2     sampleCount    Number of samples that follow
+ *   20      2*N   samples        Raw ADC values, uint16 each, or if ECG_FRAME_FLAG_DELTA_VARINT
+ *                                is set, N values in the codec of ECGCodec.h (1-3 bytes each,
+ *                                predictor reset at the start of every frame)
+ *   ...     (N+7)/8 leadOffBitmap Only if ECG_FRAME_FLAG_LEAD_OFF is set, N bits rounded up to
+ *                                whole bytes; bit i (LSB first) is set when sample i was taken
+ *                                with a lead off
+ *   ...     5+B   heartRate      Only if ECG_FRAME_FLAG_HEART_RATE is set:
+ *                                  uint16 instantaneous heart rate in tenths of BPM (0 = unknown)
+ *                                  uint16 last R-R interval in ms (0 = unknown)
+ *                                  uint8  B, number of beats in this frame
+ *                                  B x uint8 index of the sample of each beat's R peak
+ *   ...     1+4E  earlierBeats   Only if ECG_FRAME_FLAG_EARLIER_BEATS is set (always together
+ *                                with the heart-rate trailer):
+ *                                  uint8  E, number of beats
+ *                                  E x uint32 time from each beat's R peak to startTimeUs, in
+ *                                  microseconds. These beats were confirmed after the frame
+ *                                  holding their R peak had been sent (search-back finds beats
+ *                                  up to ~1.7 R-R intervals late), so the R peak is
+ *                                  startTimeUs - value.
+ *   ...     4     sendDelayUs    Only if ECG_FRAME_FLAG_SEND_TIME is set: uint32 time from the
+ *                                first sample to the frame being sent, in microseconds, so
+ *                                the send time is startTimeUs + sendDelayUs
+ *
+ * A multi-channel frame (ECG_FRAME_TYPE_MULTI_SAMPLES) carries sampleCount samples of
+ * each of its `channels` leads, all taken at the same times. The sample data is one block
+ * per channel, channel 0 first, each coded as above (the predictor restarts with every
+ * block, since consecutive values of one lead are what deltas compress well). With
+ * ECG_FRAME_FLAG_LEAD_OFF set, one lead-off bitmap per channel follows, in channel order.
+ * The trailers are unchanged; beats are detected on channel 0.
+ *
+ * A lead event frame (ECG_FRAME_TYPE_LEAD_EVENT) has the same header with sampleCount 0
+ * and no payload besides the optional send-time trailer. It reports that the leads came
+ * off (ECG_FRAME_FLAG_LEAD_OFF set) or were reattached (flag clear) at startTimeUs, the
+ * capture time of the first sample in the new state. No sample frames are sent in between.
+ *
+ * The backend reference decoder lives in backend/app/src/utils/ecg_frame.py and
+ * must be kept in sync with this layout.
+ */
+
+#define ECG_FRAME_VERSION 1
+#define ECG_FRAME_HEADER_SIZE 20
+
+// Frame types
+#define ECG_FRAME_TYPE_SAMPLES 1
+#define ECG_FRAME_TYPE_LEAD_EVENT 2
+#define ECG_FRAME_TYPE_MULTI_SAMPLES 3
+
+// Frame flags
+#define ECG_FRAME_FLAG_LEAD_OFF 0x01      // At least one sample has a lead off; bitmap(s) appended
+#define ECG_FRAME_FLAG_DELTA_VARINT 0x02  // Samples are delta-zigzag-varint coded
+#define ECG_FRAME_FLAG_HEART_RATE 0x04    // Heart-rate trailer appended
+#define ECG_FRAME_FLAG_BACKFILL 0x08      // Frame was spooled while offline and is sent late (see ECGSpool)
+#define ECG_FRAME_FLAG_SEND_TIME 0x10     // Send-time trailer appended
+#define ECG_FRAME_FLAG_EARLIER_BEATS 0x20 // Earlier-beats trailer appended
+
+// Byte offset of the flags field, for marking already encoded frames
+#define ECG_FRAME_FLAGS_OFFSET 2
+
+// Largest batch a single frame may carry (2 s at 125 Hz, 0.25 s at 1 kHz).
+#define ECG_FRAME_MAX_SAMPLES 250
+
+// Most beats listed in one heart-rate trailer (2 s at 300 BPM is 10 beats).
+#define ECG_FRAME_MAX_BEATS 16
+
+// Most beats listed in one earlier-beats trailer; one frame usually follows the next quickly.
+#define ECG_FRAME_MAX_EARLIER_BEATS 4
+
+// Worst-case size of the heart-rate, earlier-beats and send-time trailers together
+#define ECG_FRAME_MAX_TRAILER_SIZE (5 + ECG_FRAME_MAX_BEATS + 1 + 4 * ECG_FRAME_MAX_EARLIER_BEATS + 4)
+
+/**
+ * @brief Returns the worst-case encoded size of a frame carrying sampleCount samples.
+ */
+constexpr size_t ecgFrameMaxSize(size_t sampleCount) {
+    return ECG_FRAME_HEADER_SIZE + sampleCount * ECG_CODEC_MAX_BYTES_PER_VALUE + (sampleCount + 7) / 8 +
+           ECG_FRAME_MAX_TRAILER_SIZE;
+}
+
+/**
+ * @brief Returns the worst-case encoded size of a multi-channel frame carrying sampleCount
+ * samples of each of channels leads.
+ */
+constexpr size_t ecgMultiFrameMaxSize(size_t sampleCount, size_t channels) {
+    return ECG_FRAME_HEADER_SIZE + channels * (sampleCount * ECG_CODEC_MAX_BYTES_PER_VALUE + (sampleCount + 7) / 8) +
+           ECG_FRAME_MAX_TRAILER_SIZE;
+}
+
+/**
+ * @brief Header fields of an ECG frame, as filled in by the sender.
+ */
+struct ECGFrameHeader {
+    uint8_t type;          // ECG_FRAME_TYPE_*
+    uint8_t flags;         // ECG_FRAME_FLAG_*; the caller sets DELTA_VARINT, LEAD_OFF is computed
+    uint32_t sequence;     // Frame sequence number
+    uint64_t startTimeUs;  // Capture time of the first sample
+    uint16_t sampleRateHz; // Sampling rate
+    uint16_t sampleCount;  // Set by encodeECGFrame()
+    uint32_t sendDelayUs;  // Written as a trailer if the caller sets ECG_FRAME_FLAG_SEND_TIME
+    uint8_t channels;      // Set by encodeECGMultiFrame(), 0 in other frames
+};
+
+/**
+ * @brief Heart-rate summary carried in the optional frame trailer.
+ */
+struct ECGHeartRate {
+    uint16_t bpmX10;          // Instantaneous heart rate in tenths of BPM, 0 if unknown
+    uint16_t rrIntervalMs;    // Last R-R interval in milliseconds, 0 if unknown
+    uint8_t earlierBeatCount; // Entries in earlierBeatsUs, written as the earlier-beats trailer
+    uint32_t earlierBeatsUs[ECG_FRAME_MAX_EARLIER_BEATS]; // R-peak times of beats in frames already sent
+};
+
+/**
+ * @brief Encodes a batch of samples into a binary frame.
+ * The sampleCount and the lead-off/heart-rate flags of the header are derived from the arguments.
+ * @param header Header fields; sampleCount and flags are updated in place.
+ * @param samples The samples to encode, oldest first. Beats are taken from ECG_SAMPLE_FLAG_BEAT.
+ * @param count Number of samples (at most ECG_FRAME_MAX_SAMPLES).
+ * @param out Destination buffer.
+ * @param capacity Size of the destination buffer.
+ * @param heartRate Heart-rate summary to append, or nullptr to omit the trailer. Its earlier
+ * beats, which must precede the first sample, are appended as the earlier-beats trailer.
+ * @return The number of bytes written, or 0 if the arguments are invalid or out is too small.
+ */
+size_t encodeECGFrame(ECGFrameHeader &header, const ECGSample *samples, size_t count,
+                      uint8_t *out, size_t capacity, const ECGHeartRate *heartRate = nullptr);
+
+/**
+ * @brief Encodes a batch of multi-channel samples into a binary frame.
+ * The type, channels, sampleCount and the lead-off/heart-rate flags of the header are
+ * derived from the arguments.
+ * @param header Header fields; type, channels, sampleCount and flags are updated in place.
+ * @param samples The samples to encode, oldest first. Beats are taken from ECG_SAMPLE_FLAG_BEAT.
+ * @param count Number of samples (at most ECG_FRAME_MAX_SAMPLES).
+ * @param channels Number of channels to encode from each sample (1 to ECG_MAX_CHANNELS).
+ * @param out Destination buffer.
+ * @param capacity Size of the destination buffer.
+ * @param heartRate Heart-rate summary to append, or nullptr to omit the trailer, as in encodeECGFrame().
+ * @return The number of bytes written, or 0 if the arguments are invalid or out is too small.
+ */
+size_t encodeECGMultiFrame(ECGFrameHeader &header, const ECGMultiSample *samples, size_t count, uint8_t channels,
+                           uint8_t *out, size_t capacity, const ECGHeartRate *heartRate = nullptr);
+
+/**
+ * @brief Encodes a lead event frame.
+ * @param header Header fields; type, sampleCount and the lead-off flag are set in place.
+ * @param leadOff true if the leads came off, false if they were reattached.
+ * @param out Destination buffer.
+ * @param capacity Size of the destination buffer.
+ * @return The number of bytes written, or 0 if out is too small.
+ */
+size_t encodeECGLeadEvent(ECGFrameHeader &header, bool leadOff, uint8_t *out, size_t capacity);
+
+/**
+ * @brief Flags a beat on the queued sample covering its R peak: the newest one taken at or
+ * before beatTimeUs (a decimated sample stands for the capture periods up to the next one).
+ * @param samples Samples not yet encoded, oldest first.
+ * @param count Number of samples.
+ * @param beatTimeUs Capture time of the R peak.
+ * @return false if the beat precedes samples[0], i.e. its sample is in a frame already encoded.
+ */
+bool markECGBeat(ECGSample *samples, size_t count, uint32_t beatTimeUs);
+bool markECGBeat(ECGMultiSample *samples, size_t count, uint32_t beatTimeUs);
+
+/**
+ * @brief Lists a beat in the earlier-beats trailer of the next frame, dropping the oldest when full.
+ * @param heartRate The heart-rate summary the next frame carries.
+ * @param beatTimeUs Capture time of the R peak.
+ */
+void addEarlierBeat(ECGHeartRate &heartRate, uint32_t beatTimeUs);
+
+/**
+ * @brief Parses the fixed header at the start of a frame.
+ * @param data The received frame.
+ * @param length Length of the received frame.
+ * @param header Receives the header fields.
+ * @return true if the header is valid, false otherwise.
+ */
+bool decodeECGFrameHeader(const uint8_t *data, size_t length, ECGFrameHeader &header);
+
+/**
+ * @brief Extends the wrapping 32-bit microsecond sample timestamps to 64 bits.
+ *
+ * Timestamps must be fed in non-decreasing order and at least once every ~71 minutes,
+ * which the transmit path does for every batch.
+ */
+class ECGTimestampExtender {
+public:
+    ECGTimestampExtender() : _last(0), _high(0), _started(false) {}
+
+    /**
+     * @brief Returns the 64-bit equivalent of a 32-bit timestamp.
+     * @param timestampUs The wrapping 32-bit timestamp.
+     */
+    uint64_t extend(uint32_t timestampUs) {
+        if (_started && timestampUs < _last) {
+            _high += 1ULL << 32;
+        }
+        _last = timestampUs;
+        _started = true;
+        return _high | timestampUs;
+    }
+
+private:
+    uint32_t _last;
+    uint64_t _high;
+    bool _started;
+};
+
+#endif // ECG_FRAME_H
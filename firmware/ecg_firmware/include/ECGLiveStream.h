@@ -0,0 +1,144 @@
+// ECGLiveStream.h
+// This header file defines the ECGLiveStream class, which streams ECG frames to local viewers
+// over a WebSocket on the hotspot's web server, for monitoring without an upstream network.
+
+#ifndef ECG_LIVE_STREAM_H
+#define ECG_LIVE_STREAM_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <atomic>
+#include "ECGFrame.h"
+#include "ECGSample.h"
+
+// Most viewers streamed to at once; further connections are closed
+#define LIVE_STREAM_MAX_CLIENTS 4
+// Samples per frame (200 ms at 125 Hz)
+#define LIVE_STREAM_FRAME_SAMPLES 25
+// Frames kept for slow viewers (3.2 s at 125 Hz); a viewer further behind skips the oldest
+#define LIVE_STREAM_HISTORY_FRAMES 16
+// Largest encoded frame
+#define LIVE_STREAM_FRAME_BYTES ecgFrameMaxSize(LIVE_STREAM_FRAME_SAMPLES)
+
+/**
+ * @brief Streams ECG samples to up to LIVE_STREAM_MAX_CLIENTS WebSocket viewers.
+ *
+ * Samples are batched into the same binary frames the server receives (see ECGFrame.h),
+ * delta-varint coded, and each frame is encoded once into a shared history. Every viewer
+ * has its own position in that history, and a frame is only handed to a viewer whose
+ * WebSocket queue has room (the library queue is limited by WS_MAX_QUEUED_MESSAGES in
+ * platformio.ini). A viewer that falls more than LIVE_STREAM_HISTORY_FRAMES behind skips
+ * the oldest frames, so a slow viewer lags by at most the history, never stalls the
+ * others and never grows memory. Frame sequence numbers show viewers what they missed.
+ *
+ * queueSamples() and loop() belong to the network task. The connect and disconnect
+ * events run on the AsyncTCP task and only claim and release viewer slots atomically.
+ */
+class ECGLiveStream {
+public:
+    struct Stats {
+        uint32_t framesEncoded; // Frames built while someone was watching
+        uint32_t framesSent;    // Frames handed to viewers, counted per viewer
+        uint32_t framesDropped; // Frames skipped by viewers that fell behind, counted per viewer
+        uint32_t rejected;      // Connections closed because all slots were taken
+        uint8_t clients;        // Viewers connected now
+    };
+
+    /**
+     * @brief Constructor for the ECGLiveStream class.
+     * @param path The WebSocket URL path, e.g. "/live".
+     */
+    explicit ECGLiveStream(const char *path);
+
+    /**
+     * @brief Registers the WebSocket endpoint on a server.
+     */
+    void attach(AsyncWebServer &server);
+
+    /**
+     * @brief Closes all viewers and removes the endpoint from the server.
+     */
+    void detach(AsyncWebServer &server);
+
+    /**
+     * @brief Sets the sampling rate written into frame headers. A change first sends
+     * the samples taken at the old rate.
+     */
+    void setSampleRate(uint16_t sampleRateHz);
+
+    /**
+     * @brief Sets the heart-rate summary attached to the following frames.
+     * @param bpmX10 Heart rate in tenths of BPM, 0 if unknown.
+     * @param rrIntervalMs Last R-R interval in milliseconds, 0 if unknown.
+     */
+    void setHeartRate(uint16_t bpmX10, uint16_t rrIntervalMs);
+
+    /**
+     * @brief Marks a beat confirmed after its R-peak sample was queued, as
+     * ECGWebSocketClient::markBeat() does.
+     * @param beatTimeUs Capture time of the R peak, no later than the newest queued sample.
+     */
+    void markBeat(uint32_t beatTimeUs);
+
+    /**
+     * @brief Returns true if at least one viewer is connected.
+     */
+    bool hasClients() const;
+
+    /**
+     * @brief Adds samples to the current frame, completing frames as they fill.
+     * Samples are discarded while nobody is watching.
+     * @param samples The samples, oldest first.
+     * @param count Number of samples.
+     */
+    void queueSamples(const ECGSample *samples, size_t count);
+
+    /**
+     * @brief Sends each viewer the frames it is missing, as far as its queue allows,
+     * and closes connections beyond LIVE_STREAM_MAX_CLIENTS. Call from the network loop.
+     */
+    void loop();
+
+    /**
+     * @brief Returns the streaming counters.
+     */
+    Stats getStats() const;
+
+private:
+    struct Frame {
+        uint16_t length;
+        uint8_t data[LIVE_STREAM_FRAME_BYTES];
+    };
+
+    AsyncWebSocket _socket;
+    uint16_t _sampleRateHz;
+    ECGHeartRate _heartRate;
+    ECGTimestampExtender _timestampExtender;
+
+    ECGSample _pendingSamples[LIVE_STREAM_FRAME_SAMPLES];
+    size_t _pendingCount;
+    Frame _frames[LIVE_STREAM_HISTORY_FRAMES]; // Frame n is at n % LIVE_STREAM_HISTORY_FRAMES
+    uint32_t _nextFrame;                       // Sequence number of the next frame built
+
+    // Viewer slots. _clientIds is written by the AsyncTCP task (0 = free); the rest is
+    // owned by the network task, which notices a new id in a slot and starts it at the
+    // next frame built.
+    std::atomic<uint32_t> _clientIds[LIVE_STREAM_MAX_CLIENTS];
+    uint32_t _slotOwner[LIVE_STREAM_MAX_CLIENTS];   // Id the position below belongs to
+    uint32_t _slotNextFrame[LIVE_STREAM_MAX_CLIENTS]; // Next frame to send to that viewer
+
+    Stats _stats;
+    std::atomic<uint32_t> _rejected;
+
+    /**
+     * @brief Encodes the pending samples into the next history frame.
+     */
+    void completeFrame();
+
+    /**
+     * @brief Handles WebSocket events (AsyncTCP task).
+     */
+    void onEvent(AsyncWebSocketClient *client, AwsEventType type);
+};
+
+#endif // ECG_LIVE_STREAM_H
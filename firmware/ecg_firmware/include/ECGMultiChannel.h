@@ -0,0 +1,136 @@
+// ECGMultiChannel.h
+// This header file defines the ECGMultiChannel class, which samples several ECG front ends in
+// lockstep for multi-lead recordings.
+#ifndef ECG_MULTI_CHANNEL_H
+#define ECG_MULTI_CHANNEL_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "ECGSample.h"
+#include "ECGSource.h"
+#include "SPSCRingBuffer.h"
+
+// Number of multi-channel samples the acquisition buffer can hold (about 4 s at 125 Hz).
+// Must be a power of two.
+#define ECG_MULTI_SAMPLE_BUFFER_SIZE 512
+
+/**
+ * @brief Timer-driven acquisition of up to ECG_MAX_CHANNELS front ends at one rate.
+ *
+ * A single periodic esp_timer reads every channel back to back and stores the readings
+ * as one ECGMultiSample with one timestamp, so the leads stay aligned sample for
+ * sample. The channels are read within tens of microseconds of each other (one
+ * analogRead() each), which is reported as the skew in the statistics and is far below
+ * one sample period at the supported rates. Each channel keeps its own lead-off state,
+ * recorded per sample in leadOffMask.
+ *
+ * This is the multi-lead counterpart of the engine in AD8232_ECG. It reads through
+ * ECGSource, typically AD8232Lead objects (an AD8232_ECG works too), and always reads
+ * once per sample: the oversampled capture of AD8232_ECG is single-channel.
+ */
+class ECGMultiChannel {
+public:
+    /**
+     * @brief Statistics about the acquisition, used to verify the sampling interval and alignment.
+     */
+    struct SamplingStats {
+        uint32_t samplesCaptured; // Total samples taken since startSampling()
+        uint32_t samplesDropped;  // Samples lost because the buffer was full
+        uint32_t bufferHighWater; // Highest buffer fill level observed
+        uint32_t minIntervalUs;   // Shortest observed interval between two samples
+        uint32_t maxIntervalUs;   // Longest observed interval between two samples
+        uint32_t maxSkewUs;       // Longest time from reading the first channel to reading the last
+    };
+
+    /**
+     * @brief Constructor for the ECGMultiChannel class. No channels are attached.
+     */
+    ECGMultiChannel();
+
+    /**
+     * @brief Attaches the next channel. Call while not sampling.
+     * @param source The front end; it must already be initialized and must outlive sampling.
+     * @return false if ECG_MAX_CHANNELS channels are attached already.
+     */
+    bool addChannel(ECGSource *source);
+
+    /**
+     * @brief Returns the number of attached channels.
+     */
+    uint8_t getChannelCount() const;
+
+    /**
+     * @brief Starts periodic sampling of every channel at a fixed rate.
+     * Calling this while already sampling restarts the engine at the new rate.
+     * @param rate The sampling rate to use.
+     * @return true if the timer was started, false if it could not be or no channel is attached.
+     */
+    bool startSampling(ECGSampleRate rate);
+
+    /**
+     * @brief Stops periodic sampling. Samples already in the buffer remain readable.
+     */
+    void stopSampling();
+
+    /**
+     * @brief Checks if the acquisition engine is running.
+     */
+    bool isSampling() const;
+
+    /**
+     * @brief Returns the configured sampling rate in Hz, or 0 if sampling has not been started.
+     */
+    uint16_t getSampleRateHz() const;
+
+    /**
+     * @brief Returns the number of samples waiting in the acquisition buffer.
+     */
+    size_t availableSamples() const;
+
+    /**
+     * @brief Removes up to maxSamples samples from the acquisition buffer, oldest first.
+     * @param out Destination array for the samples.
+     * @param maxSamples Capacity of the destination array.
+     * @return The number of samples copied into out.
+     */
+    size_t readSamples(ECGMultiSample *out, size_t maxSamples);
+
+    /**
+     * @brief Returns a snapshot of the acquisition statistics.
+     */
+    SamplingStats getSamplingStats() const;
+
+    /**
+     * @brief Resets the interval, skew and drop statistics.
+     */
+    void resetSamplingStats();
+
+private:
+    ECGSource *_sources[ECG_MAX_CHANNELS];
+    uint8_t _channelCount;
+    esp_timer_handle_t _sampleTimer; // Periodic timer driving the acquisition
+    uint16_t _sampleRateHz;          // Current sampling rate, 0 when not started
+
+    // Producer: timer callback. Consumer: whoever calls readSamples().
+    SPSCRingBuffer<ECGMultiSample, ECG_MULTI_SAMPLE_BUFFER_SIZE> _sampleBuffer;
+
+    // Interval statistics, only written from the timer callback.
+    uint32_t _lastSampleUs;
+    volatile uint32_t _samplesCaptured;
+    volatile uint32_t _minIntervalUs;
+    volatile uint32_t _maxIntervalUs;
+    volatile uint32_t _maxSkewUs;
+
+    /**
+     * @brief Timer callback trampoline, forwards to _captureSample() on the owning instance.
+     * @param arg Pointer to the ECGMultiChannel instance.
+     */
+    static void _onSampleTimer(void *arg);
+
+    /**
+     * @brief Reads every channel and pushes one timestamped sample into the buffer.
+     */
+    void _captureSample();
+};
+
+#endif // ECG_MULTI_CHANNEL_H
@@ -0,0 +1,57 @@
+// ECGSample.h
+// This header file defines the timestamped sample type shared by the acquisition and transmit paths.
+
+#ifndef ECG_SAMPLE_H
+#define ECG_SAMPLE_H
+
+#include <stdint.h>
+
+/**
+ * @brief Sampling rates supported by the timer-driven acquisition engine.
+ * The underlying value is the rate in Hz.
+ */
+enum class ECGSampleRate : uint16_t {
+    Hz125 = 125,
+    Hz250 = 250,
+    Hz500 = 500,
+    Hz1000 = 1000
+};
+
+/**
+ * @brief A single ECG reading captured by the acquisition engine.
+ *
+ * The timestamp is taken from the monotonic microsecond clock at the moment
+ * the ADC was read, so it stays accurate no matter how late the sample is
+ * consumed by the network code.
+ */
+struct ECGSample {
+    uint32_t timestampUs; // Monotonic capture time in microseconds (wraps after ~71 minutes)
+    uint16_t value;       // Raw 12-bit ADC reading (0-4095)
+    uint8_t flags;        // ECG_SAMPLE_FLAG_* bits
+    uint8_t reserved;     // Padding, keeps the struct at 8 bytes
+};
+
+// Most front ends ECGMultiChannel samples together (e.g. three limb leads)
+#define ECG_MAX_CHANNELS 3
+
+/**
+ * @brief One reading of every channel of a multi-channel recording, taken together.
+ *
+ * The values are interleaved per capture time, so a ring buffer of these keeps the
+ * leads aligned sample for sample.
+ */
+struct ECGMultiSample {
+    uint32_t timestampUs;              // Capture time of the first channel, as in ECGSample
+    uint16_t values[ECG_MAX_CHANNELS]; // Raw 12-bit reading per channel; unused channels are 0
+    uint8_t leadOffMask;               // Bit c is set when channel c had a lead off
+    uint8_t flags;                     // ECG_SAMPLE_FLAG_* bits; LEAD_OFF when any channel is off
+};
+
+// Set on samples captured while at least one electrode reported lead-off.
+#define ECG_SAMPLE_FLAG_LEAD_OFF 0x01
+// Set on the R-peak sample of a detected beat (QRSDetector::processSamples(), markECGBeat()).
+// A beat confirmed after its R-peak sample was passed on travels in the earlier-beats trailer
+// of the next frame instead (see ECGFrame.h).
+#define ECG_SAMPLE_FLAG_BEAT 0x02
+
+#endif // ECG_SAMPLE_H
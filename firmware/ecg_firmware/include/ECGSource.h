@@ -0,0 +1,184 @@
+// ECGSource.h
+// This header file defines the ECGSource interface and the synthetic and recorded-trace sources
+// that can stand in for the AD8232 front end.
+
+#ifndef ECG_SOURCE_H
+#define ECG_SOURCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ECGSample.h"
+
+/**
+ * @brief The analog front end read by the acquisition engine.
+ *
+ * AD8232Lead implements it with the ADC and lead-off pins of one front end. The
+ * acquisition engine calls readECG() once per sample and then isSensorConnected() for
+ * the same sample.
+ */
+class ECGSource {
+public:
+    virtual ~ECGSource() {}
+
+    /**
+     * @brief Returns true if both leads are connected.
+     */
+    virtual bool isSensorConnected() = 0;
+
+    /**
+     * @brief Returns the next raw 12-bit reading (0-4095).
+     */
+    virtual int readECG() = 0;
+};
+
+// Mid-scale reading: the AD8232 reference sits at half the 3.3 V supply.
+#define ECG_SOURCE_MID_SCALE 2048
+// ADC counts per millivolt at the electrodes (gain of 100, 3.3 V / 4095 counts)
+#define ECG_SOURCE_COUNTS_PER_MV 124.1f
+// Longest beat the synthetic source can produce, in samples (e.g. 30 bpm at 1 kHz)
+#define SYNTHETIC_ECG_MAX_BEAT_SAMPLES 2048
+
+/**
+ * @brief Generates a single-lead ECG with optional noise, baseline wander, mains hum
+ * and periodic lead-off events.
+ *
+ * The signal advances by one sample per readECG() call, independent of the clock, so
+ * the same configuration always produces the same samples and the source can be read
+ * as fast as the caller likes. One beat (P, QRS and T waves) is rendered into a table
+ * by configure(); the beat length is rounded to a whole number of samples.
+ */
+class SyntheticECGSource : public ECGSource {
+public:
+    /**
+     * @brief Signal parameters. Amplitudes are in millivolts at the electrodes.
+     */
+    struct Config {
+        float heartRateBpm;         // Heart rate
+        float noiseMv;              // RMS of the white noise
+        float baselineWanderMv;     // Amplitude of the respiratory baseline wander
+        float baselineWanderHz;     // Frequency of the baseline wander
+        float mainsHumMv;           // Amplitude of the mains interference
+        float mainsHz;              // Mains frequency
+        uint32_t leadOffEveryMs;    // Interval between lead-off events, 0 for none
+        uint32_t leadOffDurationMs; // Length of each lead-off event
+        uint32_t seed;              // Noise seed (non-zero)
+    };
+
+    /**
+     * @brief Returns a clean 72 bpm signal with mild noise, wander and 50 Hz hum and no lead-off.
+     */
+    static Config defaultConfig();
+
+    /**
+     * @brief Constructor for the SyntheticECGSource class. Starts at 125 Hz with defaultConfig().
+     */
+    SyntheticECGSource();
+
+    /**
+     * @brief Sets the signal parameters and restarts the signal.
+     * @param rate The rate at which the acquisition engine will read the source.
+     * @param config The signal parameters.
+     */
+    void configure(ECGSampleRate rate, const Config &config);
+
+    /**
+     * @brief Forces a lead-off condition on or off, in addition to the configured events.
+     */
+    void setLeadOff(bool leadOff);
+
+    /**
+     * @brief Restarts the signal from its first sample.
+     */
+    void reset();
+
+    /**
+     * @brief Returns the number of samples produced since the last reset.
+     */
+    uint32_t getSampleIndex() const;
+
+    bool isSensorConnected() override;
+    int readECG() override;
+
+private:
+    Config _config;
+    uint16_t _sampleRateHz;
+    int16_t _beat[SYNTHETIC_ECG_MAX_BEAT_SAMPLES]; // One beat in ADC counts around mid-scale
+    uint16_t _beatLength;
+    uint16_t _beatPosition;
+    uint32_t _sampleIndex;
+    float _wanderPhase; // In cycles, 0-1
+    float _mainsPhase;  // In cycles, 0-1
+    uint32_t _noiseState;
+    uint32_t _leadOffEverySamples;
+    uint32_t _leadOffDurationSamples;
+    bool _forcedLeadOff;
+    bool _leadOff;
+
+    void _renderBeat();
+    float _nextNoise();
+};
+
+// Bit of a trace sample that marks lead-off; the low 12 bits hold the ADC reading.
+#define ECG_TRACE_LEAD_OFF_BIT 0x8000
+
+/**
+ * @brief Replays a recorded trace of raw readings.
+ *
+ * A trace is a headerless array of little-endian 16-bit words, one per sample, with the
+ * ADC reading in the low 12 bits and ECG_TRACE_LEAD_OFF_BIT set for lead-off samples.
+ * On a host the file is memory-mapped, so traces of any length replay without copying.
+ * On the ESP32 traces are replayed from memory, e.g. a const array in (memory-mapped) flash.
+ */
+class TraceECGSource : public ECGSource {
+public:
+    /**
+     * @brief Constructor for a trace stored in a file; call begin() to map it.
+     * @param path Path of the trace file.
+     * @param loop true to restart at the end of the trace, false to hold the last sample.
+     */
+    TraceECGSource(const char *path, bool loop = true);
+
+    /**
+     * @brief Constructor for a trace already in memory. The data must outlive the source.
+     * @param data The trace words.
+     * @param length Length of the data in bytes.
+     * @param loop true to restart at the end of the trace, false to hold the last sample.
+     */
+    TraceECGSource(const uint8_t *data, size_t length, bool loop = true);
+    ~TraceECGSource() override;
+
+    /**
+     * @brief Maps the trace file. Not needed for in-memory traces.
+     * @return true if the trace holds at least one sample.
+     */
+    bool begin();
+
+    /**
+     * @brief Returns the number of samples in the trace.
+     */
+    size_t sampleCount() const;
+
+    /**
+     * @brief Returns true once a non-looping trace has played its last sample.
+     */
+    bool isFinished() const;
+
+    /**
+     * @brief Restarts the replay from the first sample.
+     */
+    void rewind();
+
+    bool isSensorConnected() override;
+    int readECG() override;
+
+private:
+    const char *_path;
+    const uint8_t *_data;
+    size_t _count;
+    size_t _position;
+    bool _loop;
+    bool _mapped;
+    uint16_t _current;
+};
+
+#endif // ECG_SOURCE_H
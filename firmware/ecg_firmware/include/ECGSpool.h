@@ -0,0 +1,159 @@
+// ECGSpool.h
+// This header file defines the ECGSpool class, a circular flash spool for frames captured while offline.
+
+#ifndef ECG_SPOOL_H
+#define ECG_SPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief Byte-addressable backing store for an ECGSpool.
+ */
+class SpoolStorage {
+public:
+    virtual ~SpoolStorage() {}
+
+    /**
+     * @brief Returns the usable size of the store in bytes.
+     */
+    virtual size_t capacity() const = 0;
+
+    /**
+     * @brief Reads len bytes starting at offset.
+     * @return true on success.
+     */
+    virtual bool read(size_t offset, uint8_t *data, size_t len) = 0;
+
+    /**
+     * @brief Writes len bytes starting at offset.
+     * @return true on success.
+     */
+    virtual bool write(size_t offset, const uint8_t *data, size_t len) = 0;
+};
+
+/**
+ * @brief SpoolStorage backed by a fixed-size file accessed through stdio.
+ *
+ * On the ESP32 the file lives on the LittleFS partition, which the Arduino core mounts
+ * into the VFS (e.g. "/littlefs/ecg_spool.bin"), so LittleFS handles wear levelling.
+ * On a Linux host the same class works on an ordinary file.
+ */
+class FileSpoolStorage : public SpoolStorage {
+public:
+    /**
+     * @brief Constructor for the FileSpoolStorage class.
+     * @param path Full VFS path of the spool file.
+     * @param capacity Size of the spool file in bytes.
+     */
+    FileSpoolStorage(const char *path, size_t capacity);
+    ~FileSpoolStorage() override;
+
+    /**
+     * @brief Opens the spool file, creating and pre-sizing it if needed.
+     * The filesystem must already be mounted.
+     * @return true if the file is ready for use.
+     */
+    bool begin();
+
+    size_t capacity() const override;
+    bool read(size_t offset, uint8_t *data, size_t len) override;
+    bool write(size_t offset, const uint8_t *data, size_t len) override;
+
+private:
+    const char *_path;
+    size_t _capacity;
+    FILE *_file;
+};
+
+/**
+ * @brief A circular store-and-forward spool for encoded ECG frames.
+ *
+ * While the uplink is down, complete encoded frames (see ECGFrame.h) are appended as
+ * length-prefixed records. Frames keep their original sequence numbers and timestamps,
+ * so they can be streamed back unchanged once the link recovers. When the spool is full,
+ * the oldest records are overwritten.
+ *
+ * The read and write positions are kept in RAM only; the spool starts empty after a
+ * reboot, so each append costs exactly one write of the record.
+ */
+class ECGSpool {
+public:
+    /**
+     * @brief Counters describing spool activity since begin().
+     */
+    struct Stats {
+        uint32_t framesSpooled;     // Frames appended
+        uint32_t framesForwarded;   // Frames removed with pop() after being sent
+        uint32_t framesOverwritten; // Oldest frames discarded to make room
+        uint32_t writeErrors;       // Failed storage writes
+    };
+
+    /**
+     * @brief Constructor for the ECGSpool class.
+     * @param storage The backing store. Must outlive the spool.
+     */
+    ECGSpool(SpoolStorage &storage);
+
+    /**
+     * @brief Empties the spool and resets the statistics.
+     */
+    void begin();
+
+    /**
+     * @brief Appends one encoded frame, overwriting the oldest frames if there is no room.
+     * @param frame The encoded frame.
+     * @param length Length of the frame in bytes.
+     * @return true if the frame was stored.
+     */
+    bool append(const uint8_t *frame, size_t length);
+
+    /**
+     * @brief Copies the oldest frame without removing it.
+     * @param out Destination buffer.
+     * @param capacity Size of the destination buffer.
+     * @return The length of the frame, or 0 if the spool is empty.
+     */
+    size_t peek(uint8_t *out, size_t capacity);
+
+    /**
+     * @brief Removes the oldest frame, after it has been forwarded successfully.
+     */
+    void pop();
+
+    /**
+     * @brief Returns true if no frames are waiting.
+     */
+    bool isEmpty() const;
+
+    /**
+     * @brief Returns the number of frames waiting.
+     */
+    uint32_t frameCount() const;
+
+    /**
+     * @brief Returns the number of bytes in use, including record headers.
+     */
+    size_t usedBytes() const;
+
+    /**
+     * @brief Returns the spool statistics.
+     */
+    Stats getStats() const;
+
+private:
+    SpoolStorage &_storage;
+    size_t _capacity;
+    size_t _head;      // Write position
+    size_t _tail;      // Read position
+    size_t _used;      // Bytes between tail and head, including skipped space at the end
+    uint32_t _records; // Records between tail and head
+    Stats _stats;
+
+    void _skipWrapAtTail();
+    bool _readRecordLength(size_t &length);
+    void _dropOldest();
+};
+
+#endif // ECG_SPOOL_H
@@ -7,6 +7,23 @@
 
 #include <Arduino.h>
 #include <ArduinoWebsockets.h>
+#include "DeviceCommand.h"
+#include "ECGFrame.h"
+#include "ECGSpool.h"
+#include "UplinkRateController.h"
+
+// Maximum number of spooled frames sent per loop() call, so backfill never delays live frames by much
+#define ECG_BACKFILL_FRAMES_PER_LOOP 2
+// Largest factor by which the adaptive uplink lowers the output rate
+#define ECG_UPLINK_MAX_DECIMATION 5
+// Output rate of StreamMode::Preview, reached by averaging; every ECGSampleRate divides by it
+#define ECG_PREVIEW_RATE_HZ 25
+// Batch length in StreamMode::Preview, so the radio wakes once a second
+#define ECG_PREVIEW_BATCH_MS 1000
+// Commands received but not yet taken with takeCommand()
+#define ECG_COMMAND_QUEUE_SIZE 4
+// Answers to the latest commands, repeated when the server resends one whose ack it missed
+#define ECG_COMMAND_OUTCOMES 8
 
 using namespace websockets;
 
@@ -16,9 +33,77 @@ using namespace websockets;
  *
  * This class establishes and maintains a WebSocket connection to a specified server
  * and provides a method to send integer values, typically raw ECG readings.
+ *
+ * For streaming, samples are queued with queueECGSamples() and packed into binary
+ * frames (see ECGFrame.h). A frame is sent once the batch reaches the configured
+ * sample count or once its oldest sample is older than the configured delay.
+ *
+ * If a spool is attached, frames that cannot be sent are stored in it and streamed
+ * back from loop() once the connection is up, marked with ECG_FRAME_FLAG_BACKFILL.
+ * Live frames are always sent first; backfill only uses what is left of each loop().
+ *
+ * Queued samples taken with a lead off are not sent. When the lead state changes the
+ * pending batch is closed and a lead event frame (ECG_FRAME_TYPE_LEAD_EVENT) is sent
+ * instead, so streaming stops and resumes exactly at the first sample in the new state.
+ *
+ * Every frame carries a send-time trailer (ECG_FRAME_FLAG_SEND_TIME). The server
+ * measures the device clock by sending {"type":"time_sync","server_us":T} text
+ * messages, which are answered with the same message plus "device_us", the device
+ * monotonic time in microseconds. With both it can compute one-way latency per frame.
+ *
+ * With setAdaptive() the client backs off when the link cannot keep up, instead of
+ * letting blocked sends stall everything upstream. An UplinkRateController watches the
+ * send times, the samples waiting upstream and the RSSI, and picks a level:
+ *   0: the configured batch policy and compression
+ *   1: 500 ms batches, compressed (fewer, larger sends)
+ *   2: 1 s batches, compressed
+ *   3: 1 s batches, compressed, output rate lowered by averaging 2-5 samples
+ * Each change is reported as {"type":"uplink_rate", ...}, and the frames carry the
+ * rate they were sent at.
+ *
+ * Multi-lead recordings are queued with queueECGMultiSamples() and sent as
+ * multi-channel frames (ECG_FRAME_TYPE_MULTI_SAMPLES) under the same batch policy,
+ * spool and adaptive batching, but always at the full rate. A lead that comes off is
+ * marked in the frame's per-channel lead-off bitmaps while the others keep streaming,
+ * so no lead events are sent for them.
+ *
+ * The server controls the stream at runtime with {"type":"command"} messages (see
+ * DeviceCommand.h). The "stream" command selects the StreamMode: full rate for a
+ * recording session, a preview averaged down to ECG_PREVIEW_RATE_HZ in
+ * ECG_PREVIEW_BATCH_MS batches otherwise, or off. The client applies that one itself
+ * and reports it with the uplink level. Every other command is queued for the
+ * application, which takes it with takeCommand(), applies it and answers with
+ * ackCommand(). Sequence numbers start afresh with each connection and must increase.
+ * A command is applied at most once: a resend gets the ack the command already had
+ * ("ok" or "error"), or "duplicate" while it is still being applied, so the server can
+ * safely resend when an ack is lost and wait for the final status. A command rejected
+ * on arrival (malformed, or the queue full) does not use up its seq.
+ * Multi-channel frames keep the full rate in preview too, sent in the same batches.
  */
 class ECGWebSocketClient {
 public:
+    /**
+     * @brief Transmit counters since boot, except where noted.
+     */
+    struct Stats {
+        uint32_t framesSent;        // Live frames sent
+        uint32_t samplesSent;       // Samples in live frames sent
+        uint32_t framesSpooled;     // Frames that could not be sent and went to the spool
+        uint32_t samplesDropped;    // Samples in frames that could be neither sent nor spooled
+        uint32_t framesBackfilled;  // Spooled frames sent after reconnecting
+        uint32_t samplesBackfilled; // Samples in backfilled frames
+        uint32_t lastSendUs;        // Duration of the last frame send
+        uint32_t maxSendUs;         // Longest frame send since the last getStats()
+        uint32_t timeSyncReplies;   // Clock-sync requests answered
+        uint32_t leadEvents;        // Lead-off and reattach events sent or spooled
+        uint32_t samplesLeadOff;    // Queued samples withheld because a lead was off
+        uint32_t uplinkChanges;     // Adaptive uplink level changes
+        uint8_t uplinkLevel;        // Current adaptive uplink level
+        uint16_t pendingSamples;    // Samples queued for the next frame
+        uint32_t commandsReceived;  // Commands from the server, including rejected and duplicate ones
+        uint32_t samplesPaused;     // Queued samples not sent because the stream mode is off
+    };
+
     /**
      * @brief Constructor for the ECGWebSocketClient class.
      * Initializes the WebSocket client instance and sets up event handlers.
@@ -42,6 +127,151 @@ public:
      */
     bool sendECGValue(int ecgValue);
 
+    /**
+     * @brief Sends a device status message (a JSON object with a "type" field) as a text frame.
+     * @param json The null-terminated JSON text.
+     * @return true if the message was sent, false if not connected.
+     */
+    bool sendStatus(const char *json);
+
+    /**
+     * @brief Configures when a queued batch is sent.
+     * A batch is flushed as soon as either limit is reached.
+     * @param maxSamples Maximum samples per frame (1 to ECG_FRAME_MAX_SAMPLES).
+     * @param maxDelayMs Maximum age in milliseconds of the oldest queued sample, 0 to batch by count only.
+     */
+    void setBatchPolicy(uint16_t maxSamples, uint16_t maxDelayMs);
+
+    /**
+     * @brief Enables or disables the adaptive uplink. While disabled (the default) the
+     * configured batch policy and compression are always used.
+     */
+    void setAdaptive(bool enabled);
+
+    /**
+     * @brief Feeds the link conditions to the adaptive uplink. Call once per network loop,
+     * before queueing the samples.
+     * @param queuedSamples Samples waiting upstream of this client, e.g. in the DSP output buffer.
+     * @param rssi WiFi signal strength in dBm, 0 if unknown.
+     */
+    void updateLink(size_t queuedSamples, int8_t rssi);
+
+    /**
+     * @brief Returns the adaptive uplink level in use (0 when not adaptive).
+     */
+    uint8_t getUplinkLevel() const;
+
+    /**
+     * @brief Selects how much of the signal is sent (StreamMode::Full by default).
+     * Pending samples go out first, at the previous mode's rate.
+     */
+    void setStreamMode(StreamMode mode);
+
+    /**
+     * @brief Returns the stream mode in use.
+     */
+    StreamMode getStreamMode() const;
+
+    /**
+     * @brief Takes the oldest command received from the server that the client does not
+     * apply itself. The caller must answer it with ackCommand().
+     * @param command Receives the command.
+     * @return false if none is waiting.
+     */
+    bool takeCommand(DeviceCommand &command);
+
+    /**
+     * @brief Acknowledges a command taken with takeCommand().
+     * @param command The command.
+     * @param error nullptr if it was applied, otherwise why it was rejected. Must stay valid
+     * (a string literal), as resends of the command are answered with it.
+     */
+    void ackCommand(const DeviceCommand &command, const char *error);
+
+    /**
+     * @brief Sets the sampling rate reported in the header of outgoing frames.
+     * A change first sends the pending samples at the previous rate.
+     * @param sampleRateHz The acquisition sampling rate in Hz.
+     */
+    void setSampleRate(uint16_t sampleRateHz);
+
+    /**
+     * @brief Enables or disables delta-zigzag-varint compression of outgoing frames.
+     * @param enabled true to compress sample payloads, false to send raw uint16 values.
+     */
+    void setCompression(bool enabled);
+
+    /**
+     * @brief Updates the heart-rate summary attached to the following frames.
+     * Until this is called with a known rate, and again after it is called with 0, 0 (the
+     * detector restarted), frames carry no heart-rate trailer.
+     * @param bpmX10 Instantaneous heart rate in tenths of BPM, 0 if unknown.
+     * @param rrIntervalMs Last R-R interval in milliseconds, 0 if unknown.
+     */
+    void setHeartRate(uint16_t bpmX10, uint16_t rrIntervalMs);
+
+    /**
+     * @brief Marks a beat confirmed after its R-peak sample was queued. The sample is flagged
+     * if it has not been sent yet; otherwise the beat goes in the next frame's earlier-beats
+     * trailer with its own time.
+     * @param beatTimeUs Capture time of the R peak, no later than the newest queued sample.
+     */
+    void markBeat(uint32_t beatTimeUs);
+
+    /**
+     * @brief Attaches a spool that keeps frames which could not be sent.
+     * @param spool The spool, or nullptr to drop unsent frames.
+     */
+    void setSpool(ECGSpool *spool);
+
+    /**
+     * @brief Sends a batch of samples as a single binary frame, bypassing the queue.
+     * The frame is labelled with the current output rate (see setAdaptive()).
+     * @param samples The samples to send, oldest first.
+     * @param count Number of samples (at most ECG_FRAME_MAX_SAMPLES).
+     * @return true if the frame was sent, false if not connected or the batch is invalid.
+     * Frames that were encoded but not sent go to the spool, if one is attached.
+     */
+    bool sendECGBatch(const ECGSample *samples, size_t count);
+
+    /**
+     * @brief Sets how many channels of each ECGMultiSample are sent (1 to ECG_MAX_CHANNELS).
+     */
+    void setChannelCount(uint8_t channels);
+
+    /**
+     * @brief Sends a batch of multi-channel samples as a single frame, bypassing the queue.
+     * @param samples The samples to send, oldest first.
+     * @param count Number of samples (at most ECG_FRAME_MAX_SAMPLES).
+     * @return true if the frame was sent, false if not connected or the batch is invalid.
+     * Frames that were encoded but not sent go to the spool, if one is attached.
+     */
+    bool sendECGMultiBatch(const ECGMultiSample *samples, size_t count);
+
+    /**
+     * @brief Appends multi-channel samples to the pending batch, sending frames whenever the
+     * batch policy is met. Samples with leads off are sent and flagged per channel.
+     * @param samples The samples to queue, oldest first.
+     * @param count Number of samples.
+     * @return false if a frame had to be sent and sending failed, true otherwise.
+     */
+    bool queueECGMultiSamples(const ECGMultiSample *samples, size_t count);
+
+    /**
+     * @brief Appends samples to the pending batch, sending frames whenever the batch policy is met.
+     * Samples with ECG_SAMPLE_FLAG_LEAD_OFF are dropped and lead events are sent instead.
+     * @param samples The samples to queue, oldest first.
+     * @param count Number of samples.
+     * @return false if a frame had to be sent and sending failed, true otherwise.
+     */
+    bool queueECGSamples(const ECGSample *samples, size_t count);
+
+    /**
+     * @brief Sends the pending batches (single and multi-channel) immediately, if they hold any samples.
+     * @return true if the batches were sent or empty, false if sending failed.
+     */
+    bool flushECGBatch();
+
     /**
      * @brief Checks if the WebSocket client is currently connected to the server.
      * This uses the client's available() method from ArduinoWebsockets.
@@ -57,13 +287,138 @@ public:
     /**
      * @brief Must be called regularly in the Arduino loop() function.
      * This function processes incoming WebSocket events and maintains the connection.
-     * It internally calls websocketsClient.poll().
+     * It internally calls websocketsClient.poll(), sends the pending batch once it
+     * exceeds the configured maximum delay and then sends up to
+     * ECG_BACKFILL_FRAMES_PER_LOOP spooled frames.
      */
     void loop();
 
+    /**
+     * @brief Returns the transmit counters and restarts the longest-send measurement.
+     */
+    Stats getStats();
+
 private:
     WebsocketsClient _webSocket; // The WebSocket client instance from ArduinoWebsockets
 
+    uint16_t _batchMaxSamples;   // Flush when this many samples are pending
+    uint32_t _batchMaxDelayUs;   // Flush when the oldest pending sample is this old (0 = disabled)
+    uint16_t _sampleRateHz;      // Sampling rate of the queued samples
+    bool _compressFrames;        // Whether frames use ECG_FRAME_FLAG_DELTA_VARINT
+    uint8_t _channelCount;       // Channels sent from each queued ECGMultiSample
+    StreamMode _streamMode;      // How much of the signal is sent
+
+    // Adaptive uplink. The configured policy is kept as level 0; the fields above hold
+    // the settings of the level in use.
+    UplinkRateController _uplink;
+    bool _adaptive;
+    uint8_t _uplinkLevel;           // Level whose settings are applied
+    bool _uplinkReportPending;      // The level still has to be reported to the server
+    uint16_t _baseBatchMaxSamples;
+    uint32_t _baseBatchMaxDelayUs;
+    bool _baseCompressFrames;
+    uint8_t _decimation;            // Queued samples averaged into each sent sample
+    uint8_t _decimationCount;       // Samples in the current group
+    uint8_t _decimationFlags;       // ECG_SAMPLE_FLAG_* bits of the group
+    uint32_t _decimationSum;
+    uint32_t _decimationStartUs;    // Timestamp of the first sample of the group
+
+    ECGHeartRate _heartRate;     // Latest heart-rate summary for the frame trailer
+    bool _heartRateEnabled;      // Whether a heart-rate trailer is attached
+    uint32_t _frameSequence;     // Sequence number of the next frame
+    ECGTimestampExtender _timestampExtender; // Widens sample timestamps for frame headers
+    ECGSpool *_spool;            // Store for frames that could not be sent, may be nullptr
+    Stats _stats;                // Transmit counters
+    bool _leadsOff;              // Lead state of the last queued sample
+
+    DeviceCommand _commands[ECG_COMMAND_QUEUE_SIZE]; // Received, waiting for takeCommand()
+    uint8_t _commandHead;        // Index of the oldest queued command
+    uint8_t _commandCount;       // Number of queued commands
+    uint32_t _lastCommandSeq;    // Highest command seq accepted on this connection
+    bool _commandSeqValid;       // Whether _lastCommandSeq is set for this connection
+
+    /**
+     * @brief The answer to a recent command of this connection.
+     */
+    struct CommandOutcome {
+        uint32_t seq;
+        bool valid;        // false until a command of this connection used the slot
+        bool done;         // false while the command is queued or being applied
+        const char *error; // Why it was rejected, nullptr if it was applied
+    };
+    CommandOutcome _commandOutcomes[ECG_COMMAND_OUTCOMES]; // Indexed by seq % ECG_COMMAND_OUTCOMES
+
+    ECGSample _pendingSamples[ECG_FRAME_MAX_SAMPLES]; // Samples waiting to be framed
+    size_t _pendingCount;                             // Number of valid entries in _pendingSamples
+    ECGMultiSample _pendingMultiSamples[ECG_FRAME_MAX_SAMPLES]; // Multi-channel samples waiting to be framed
+    size_t _pendingMultiCount;                                  // Number of valid entries in _pendingMultiSamples
+    // Reused encode and backfill buffer, sized for the largest multi-channel frame (which also fits any other)
+    uint8_t _frameBuffer[ecgMultiFrameMaxSize(ECG_FRAME_MAX_SAMPLES, ECG_MAX_CHANNELS)];
+
+    /**
+     * @brief Sends up to ECG_BACKFILL_FRAMES_PER_LOOP frames from the spool, oldest first.
+     */
+    void sendBackfill();
+
+    /**
+     * @brief Sends (or spools) a lead event frame.
+     * @param leadOff true if the leads came off, false if they were reattached.
+     * @param timestampUs Capture time of the first sample in the new state.
+     * @return true if the event was sent.
+     */
+    bool sendLeadEvent(bool leadOff, uint32_t timestampUs);
+
+    /**
+     * @brief Applies the settings of the controller's level and reports the change.
+     * Waits for the end of a decimation group, so no sample is split across rates.
+     */
+    void applyUplinkLevel();
+
+    /**
+     * @brief Sends the current uplink level as a status message, if connected.
+     */
+    void reportUplinkLevel();
+
+    /**
+     * @brief Adds a queued sample to the decimation group.
+     * @param sample The sample.
+     * @param out Receives the averaged sample when the group is complete.
+     * @return true if out holds a sample to send.
+     */
+    bool decimate(const ECGSample &sample, ECGSample &out);
+
+    /**
+     * @brief Sends a frame from _frameBuffer and times the call.
+     * @return true if the frame was sent.
+     */
+    bool sendFrame(size_t length);
+
+    /**
+     * @brief Answers a clock-sync request with the current device time.
+     * @param serverUs The server timestamp from the request, echoed back.
+     */
+    void replyTimeSync(uint64_t serverUs);
+
+    /**
+     * @brief Checks the sequence number of a command message, then applies or queues it.
+     * @param doc The parsed message.
+     */
+    void receiveCommand(JsonDocument &doc);
+
+    /**
+     * @brief Records the outcome of a command and, once it is done, sends its "ok" or "error" ack.
+     * @param done false for a command accepted but not yet applied; nothing is sent then.
+     * @param error The reason it was rejected, nullptr if it was applied.
+     */
+    void finishCommand(uint32_t seq, DeviceCommandType type, bool done, const char *error);
+
+    /**
+     * @brief Sends {"type":"command_ack", ...}.
+     * @param status "ok", "error" or "duplicate".
+     * @param error The reason for "error", nullptr otherwise.
+     */
+    void sendCommandAck(uint32_t seq, DeviceCommandType type, const char *status, const char *error);
+
     /**
      * @brief Internal handler for incoming WebSocket messages.
      * @param message The received WebSocket message.
@@ -9,7 +9,25 @@
 #include <Arduino.h>
 #include <ESPAsyncWebServer.h>
 #include <ArduinoJson.h> 
+#include <atomic>
 #include "WirelessCommunication.h"
+#include "DeviceSettings.h"
+#include "ECGLiveStream.h"
+
+// Scan results are served from the cache until they are this old; the next request then starts a new scan
+#define WIFI_SCAN_CACHE_TTL_MS 30000
+// Most networks kept from a scan, strongest first as the driver reports them
+#define WIFI_SCAN_MAX_NETWORKS 16
+// Buffer for the cached networks array; each entry takes at most ~80 bytes
+#define WIFI_SCAN_JSON_SIZE 1400
+// Buffer for the /scanNetworks response: the networks array plus the status fields
+#define WIFI_SCAN_RESPONSE_SIZE (WIFI_SCAN_JSON_SIZE + 64)
+// Browsers reuse the setup page for a week without asking; after that the ETag makes it a 304
+#define SETUP_PAGE_CACHE_CONTROL "public, max-age=604800"
+// Buffer for the /deviceSettings response
+#define DEVICE_SETTINGS_JSON_SIZE 512
+// Time between saving device settings and the restart that applies them, so the response gets out
+#define DEVICE_RESTART_DELAY_MS 1000
 
 class HotspotWebServer;
 
@@ -18,9 +36,27 @@ class HotspotWebServer;
  * when the ESP32 is operating as a WiFi Hotspot.
  *
  * This server provides endpoints to:
- * - Serve a basic HTML page for WiFi credential input.
+ * - Serve a basic HTML page for WiFi credential input (web/setup.html, embedded
+ *   gzip-compressed at build time, with ETag revalidation).
  * - Get device status and information.
  * - Receive and save new WiFi credentials, then trigger a connection attempt.
+ * - Show and change the device settings (see DeviceSettings): GET /deviceSettings and
+ *   POST /setupDevice, which takes any subset of the fields of the GET response and
+ *   requests a restart, since the settings are only loaded at boot.
+ * - Stream the live ECG over a WebSocket at /live (see ECGLiveStream), so the signal
+ *   can be watched on a phone connected to the hotspot.
+ *
+ * /scanNetworks never blocks the AsyncTCP task: scans run asynchronously and the
+ * endpoint answers at once with the cached result,
+ * {"status":"scanning"|"done"|"failed","age_ms":N,"networks":[{"ssid","rssi","channel"}]},
+ * starting a new scan when the cache is older than WIFI_SCAN_CACHE_TTL_MS. Clients poll
+ * while the status is "scanning". The scan state is only touched from request handlers,
+ * which all run on the AsyncTCP task.
+ *
+ * Credentials posted to /setupWifi are not saved from the AsyncTCP task: the handler
+ * copies them and raises the WiFi switch request, and the network task, which owns the
+ * WiFi settings, saves them (getRequestedSsid(), getRequestedPassword()) before it
+ * resets the request. A post that arrives before that is answered with 503.
  */
 class HotspotWebServer {
 public:
@@ -28,8 +64,9 @@ public:
      * @brief Constructor for the HotspotWebServer class.
      * @param comm A reference to the WirelessCommunication object, allowing the server
      * to save new WiFi credentials and initiate connection attempts.
+     * @param settings The device settings shown and saved by the setup page.
      */
-    HotspotWebServer(WirelessCommunication& comm);
+    HotspotWebServer(WirelessCommunication& comm, DeviceSettings& settings);
 
     /**
      * @brief Starts the web server and defines all its routes (endpoints).
@@ -43,28 +80,85 @@ public:
      */
     void end();
 
+    /**
+     * @brief Returns the live ECG stream served at /live. The network task feeds it
+     * samples and calls its loop() while the server is running.
+     */
+    ECGLiveStream &liveStream();
+
     /**
      * @brief Checks if a WiFi switch (from Hotspot to Station) has been requested by the web interface.
      * @return true if a switch has been requested, false otherwise.
      */
     bool isWifiSwitchRequested();
 
+    /**
+     * @brief The credentials posted with the pending WiFi switch request. Valid from
+     * isWifiSwitchRequested() returning true until resetWifiSwitchRequest().
+     */
+    const char *getRequestedSsid() const;
+    const char *getRequestedPassword() const;
+
     /**
      * @brief Resets the flag indicating a WiFi switch request.
      * This should be called by the main loop after handling the switch.
      */
     void resetWifiSwitchRequest();
 
+    /**
+     * @brief Checks if the web interface saved new device settings, which need a restart.
+     * Only true once DEVICE_RESTART_DELAY_MS have passed since the save.
+     * @return true if the device should restart now, false otherwise.
+     */
+    bool isRestartRequested();
+
+    /**
+     * @brief Resets the flag indicating a restart request.
+     */
+    void resetRestartRequest();
+
 private:
     AsyncWebServer _server; // The instance of the asynchronous web server
     WirelessCommunication& _wirelessComm; // Reference to the wireless communication handler
-    bool _wifiSwitchRequested; // Flag to indicate if a WiFi mode switch has been requested
+    ECGLiveStream _liveStream; // Live ECG WebSocket endpoint (/live)
+    DeviceSettings& _deviceSettings; // Settings shown and saved by the setup page
+    std::atomic<bool> _wifiSwitchRequested; // Set by the AsyncTCP task once _requestedSsid/_requestedPassword are filled in
+    char _requestedSsid[WIFI_MAX_SSID_LENGTH + 1];         // Credentials waiting for the network task
+    char _requestedPassword[WIFI_MAX_PASSWORD_LENGTH + 1];
+    bool _restartRequested;    // Flag to indicate that new device settings wait for a restart
+    uint32_t _restartRequestMs; // When the device settings were saved
+    char _settingsJson[DEVICE_SETTINGS_JSON_SIZE]; // Reused for every /deviceSettings response
+
+    char _scanJson[WIFI_SCAN_JSON_SIZE];         // Cached networks array, rebuilt when a scan finishes
+    char _scanResponse[WIFI_SCAN_RESPONSE_SIZE]; // Reused for every /scanNetworks response
+    bool _scanCached;     // Whether _scanJson holds a completed scan
+    bool _scanFailed;     // Whether the last scan could not be started or failed
+    uint32_t _scanTimeMs; // When the cached scan finished
+
+    /**
+     * @brief Collects a finished scan into the cache, starts a new scan if the cache is
+     * stale, and serializes the response into _scanResponse.
+     * @return The response body (_scanResponse).
+     */
+    const char *getScannedNetworksJson();
+
+    /**
+     * @brief Serializes the networks of a finished scan into _scanJson and frees the results.
+     * @param count Number of networks found.
+     */
+    void cacheScanResults(int16_t count);
+
+    /**
+     * @brief Serializes the stored device settings into _settingsJson.
+     * @return The response body (_settingsJson).
+     */
+    const char *getDeviceSettingsJson();
 
     /**
-     * @brief Helper function to perform a WiFi scan and return results as a JSON array.
-     * @return A String containing scanned networks in JSON format.
+     * @brief Applies the fields present in a /setupDevice request to values.
+     * @return nullptr on success, otherwise a message naming the bad field.
      */
-    String getScannedNetworksJson();
+    static const char *parseDeviceSettings(JsonDocument &doc, DeviceSettingsValues &values);
 };
 
 #endif // HOTSPOT_WEB_SERVER_H
\ No newline at end of file
@@ -0,0 +1,83 @@
+// LEDPattern.h
+// This header file defines RGB LED patterns as data and the LEDPatternPlayer class that plays them.
+
+#ifndef LED_PATTERN_H
+#define LED_PATTERN_H
+
+#include <stdint.h>
+
+/**
+ * @brief An RGB color, 0-255 per channel.
+ */
+struct LEDColor {
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+};
+
+/**
+ * @brief One step of a pattern.
+ */
+struct LEDStep {
+    LEDColor color;      // Color at the end of the step
+    uint16_t durationMs; // Length of the step, at least 1
+    bool fade;           // Ramp from the previous step's color to this one; otherwise hold it
+};
+
+/**
+ * @brief A sequence of steps. The step before the first is the last one, so a fading
+ * pattern loops smoothly.
+ */
+struct LEDPattern {
+    const LEDStep *steps;
+    uint8_t stepCount;
+    uint8_t repeats; // Times the steps play, 0 = until stopped or replaced
+};
+
+// Red, green and blue once, then back to the steady color
+extern const LEDPattern LED_PATTERN_BOOT;
+// Green on and off every 300 ms: not connected, or hotspot without viewers
+extern const LEDPattern LED_PATTERN_BLINK_GREEN;
+// Green fading in and out over 2 s: hotspot with live viewers
+extern const LEDPattern LED_PATTERN_BREATHE_GREEN;
+
+/**
+ * @brief Computes the color of a pattern over time.
+ *
+ * The player only does arithmetic on the time it is given; the caller ticks it and
+ * writes the color to the LED, so it runs the same on the device and on synthetic time.
+ */
+class LEDPatternPlayer {
+public:
+    /**
+     * @brief Constructor for the LEDPatternPlayer class. Nothing is playing.
+     */
+    LEDPatternPlayer();
+
+    /**
+     * @brief Starts a pattern from its first step.
+     * @param pattern The pattern, which must outlive playback, or nullptr to stop.
+     * @param nowMs Current time in milliseconds.
+     */
+    void play(const LEDPattern *pattern, uint32_t nowMs);
+
+    /**
+     * @brief Returns the pattern last started, or nullptr.
+     */
+    const LEDPattern *current() const;
+
+    /**
+     * @brief Computes the color of the playing pattern.
+     * @param nowMs Current time in milliseconds, not before the start.
+     * @param color Set to the color if a pattern is playing.
+     * @return false if no pattern is playing or it has played all its repeats.
+     */
+    bool colorAt(uint32_t nowMs, LEDColor &color) const;
+
+private:
+    const LEDPattern *_pattern;
+    uint32_t _startMs;
+    uint32_t _cycleMs; // Sum of the step durations
+};
+
+#endif // LED_PATTERN_H
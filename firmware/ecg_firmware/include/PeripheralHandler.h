@@ -5,10 +5,19 @@
 #define PERIPHERAL_HANDLER_H
 
 #include <Arduino.h>
-
-#define CLICK_DEBOUNCE_MS 180 // Minimum time in ms between two distinct press detections
-
-#define MULTI_CLICK_TIMEOUT_MS 1000 // Time in ms after a press to wait for more presses
+#include <esp_timer.h>
+#include <atomic>
+#include "ClickClassifier.h"
+#include "LEDPattern.h"
+#include "SPSCRingBuffer.h"
+
+// Period of the LED pattern tick
+#define LED_TICK_MS 20
+// LEDC PWM used for the LED brightness
+#define LED_PWM_FREQUENCY_HZ 5000
+#define LED_PWM_RESOLUTION_BITS 8
+// Button edges buffered between the ISR and takeButtonEvent()
+#define BUTTON_EDGE_QUEUE_SIZE 16
 
 class PeripheralHandler;
 
@@ -20,8 +29,8 @@ extern PeripheralHandler* globalPeripheralHandler;
 
 /**
  * @brief Interrupt Service Routine (ISR) for the button.
- * This function is called every time the button state changes (falling edge).
- * It updates the button press state and counts presses, handling debouncing.
+ * This function is called every time the button state changes (both edges).
+ * It only records the new level and its time; classification happens later.
  *
  * NOTE: IRAM_ATTR is applied only to the definition in the .cpp file, not here,
  * to avoid compilation warnings related to conflicting section attributes.
@@ -35,10 +44,15 @@ void onButtonInterrupt();
  *
  * This class provides methods to initialize the RGB LED pins and set specific
  * colors (blue, green, red) to indicate the device's connection status.
- * It also manages a button, detecting single and double clicks using an ISR
- * and providing a non-blocking method to retrieve click counts.
- * It assumes a common cathode RGB LED, where HIGH turns the LED segment ON,
- * and an INPUT_PULLUP button, where a falling edge indicates a press.
+ * Patterns (see LEDPattern.h) play on top of that steady color: an esp_timer ticks
+ * an LEDPatternPlayer every LED_TICK_MS and writes the result through LEDC PWM, so
+ * blinking and fading never block the caller.
+ *
+ * The button ISR queues raw edges; takeButtonEvent() feeds them to a ClickClassifier
+ * and returns single-click, double-click and long-press events without waiting.
+ *
+ * It assumes a common cathode RGB LED, where a higher duty is brighter,
+ * and an INPUT_PULLUP button, where a low level means pressed.
  */
 class PeripheralHandler {
 public:
@@ -53,7 +67,8 @@ public:
 
     /**
      * @brief Initializes the RGB LED and button pins.
-     * This method sets the pin modes and attaches the interrupt to the button pin.
+     * This method attaches the LED pins to LEDC, attaches the interrupt to the button pin
+     * and starts the pattern tick. Calling it again has no further effect.
      */
     void begin();
 
@@ -74,26 +89,40 @@ public:
 
     /**
      * @brief Turns off all segments of the RGB LED.
+     * Like the setters above, this changes the steady color; a playing pattern stays in front of it.
      */
     void turnOff();
 
-    void toggleGreenSixTimes(unsigned long delayTime);
+    /**
+     * @brief Plays a pattern over the steady color. Returns immediately.
+     * Does nothing if the pattern is already playing, so it can be called on every loop iteration.
+     * @param pattern The pattern; it must stay valid while playing (the LED_PATTERN_* constants do).
+     */
+    void playPattern(const LEDPattern &pattern);
+
+    /**
+     * @brief Stops the playing pattern and shows the steady color again.
+     * @param pattern If given, the pattern is only stopped if it is this one.
+     */
+    void stopPattern(const LEDPattern *pattern = nullptr);
+
+    /**
+     * @brief Returns true while a pattern is playing.
+     */
+    bool isPatternPlaying() const;
 
     /**
-     * @brief Checks for button clicks and returns the number of clicks detected.
-     * This function should be called regularly in the main loop to process button presses.
-     * It handles debouncing and aggregation of rapid clicks into a single/double click count
-     * based on the `MULTI_CLICK_TIMEOUT_MS`.
-     * @return The number of clicks detected (e.g., 1 for single, 2 for double), or 0 if no clicks.
+     * @brief Classifies the button edges since the last call and returns the next event.
+     * This function should be called regularly in the main loop; it never waits.
+     * @return The oldest pending event, or ButtonEvent::None.
      */
-    unsigned int getAndResetClickCount();
+    ButtonEvent takeButtonEvent();
 
     /**
-     * @brief Public method called by the ISR to handle a button press.
-     * It applies debouncing and increments the press counter.
+     * @brief Public method called by the ISR to record a button edge.
      * This method is public so the global ISR can access it.
      */
-    void _handleButtonPress();
+    void _handleButtonEdge();
 
 private:
     int _redPin;   // Pin for the Red LED segment
@@ -102,23 +131,45 @@ private:
     int _buttonPin; // Pin for the button
 
     /**
-     * @brief Structure to hold button state and click count.
-     * Members are volatile because they are modified within an ISR.
+     * @brief A button level change, as recorded by the ISR.
      */
-    struct Button {
-        volatile unsigned long lastPressTime; // Time of the last detected press
-        volatile unsigned int nPresses;     // Number of rapid presses within the timeout window
-    } _button;
+    struct ButtonEdge {
+        uint32_t timeMs;
+        bool pressed;
+    };
+
+    SPSCRingBuffer<ButtonEdge, BUTTON_EDGE_QUEUE_SIZE> _edges; // ISR -> takeButtonEvent()
+    ClickClassifier _clicks; // Owned by the caller of takeButtonEvent()
+
+    // Requests from the application, read by the pattern tick (esp_timer task)
+    std::atomic<uint32_t> _steadyColor;               // 0xRRGGBB shown when no pattern plays
+    std::atomic<const LEDPattern *> _requestedPattern; // nullptr = none; cleared when it ends
+
+    // Owned by the pattern tick
+    esp_timer_handle_t _ledTimer;
+    LEDPatternPlayer _player;
+    LEDColor _shown; // Last color written to the pins
 
     /**
-     * @brief Helper function to set the state of the RGB LED segments.
-     * Assumes common cathode: HIGH for ON, LOW for OFF.
-     * If common anode, invert logic (LOW for ON, HIGH for OFF).
-     * @param rState Digital state for Red (HIGH/LOW).
-     * @param gState Digital state for Green (HIGH/LOW).
-     * @param bState Digital state for Blue (HIGH/LOW).
+     * @brief Sets or clears one channel of the steady color.
+     * @param shift Bit position of the channel in _steadyColor.
+     * @param state Nonzero for full brightness, 0 for off.
      */
-    void _setColor(int rState, int gState, int bState);
+    void _setSteadyChannel(int shift, int state);
+
+    /**
+     * @brief Writes a color to the LED if it differs from the one shown.
+     * Assumes common cathode: a higher duty is brighter.
+     * If common anode, invert the duty (255 - value).
+     */
+    void _setColor(const LEDColor &color);
+
+    /**
+     * @brief Advances the pattern and updates the LED (esp_timer task).
+     */
+    void _tick();
+
+    static void _onLedTimer(void *arg);
 };
 
 #endif // PERIPHERAL_HANDLER_H
\ No newline at end of file
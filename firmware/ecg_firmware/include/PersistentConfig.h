@@ -0,0 +1,126 @@
+// PersistentConfig.h
+// This header file defines the PersistentConfig class, a RAM-cached settings store backed by NVS.
+
+#ifndef PERSISTENT_CONFIG_H
+#define PERSISTENT_CONFIG_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+// Maximum number of settings one PersistentConfig can hold.
+#define CONFIG_MAX_ENTRIES 16
+
+// Changes are written to flash once no further change has been made for this long.
+#define CONFIG_COMMIT_DELAY_MS 1000
+
+/**
+ * @brief A small settings store that keeps every value in RAM and writes NVS sparingly.
+ *
+ * The Preferences namespace is opened once in begin() and each setting is read from
+ * flash once, when it is registered with addString() or addUInt(). After that, reads are
+ * served from RAM. Setters only mark a value dirty if it actually changed. Dirty values
+ * are written together by loop() once the settings have been quiet for
+ * CONFIG_COMMIT_DELAY_MS, or straight away by commit(). Every key written to flash
+ * is counted in getWriteCount().
+ */
+class PersistentConfig {
+public:
+    /**
+     * @brief Constructor for the PersistentConfig class.
+     * @param ns The Preferences namespace (at most 15 characters).
+     */
+    PersistentConfig(const char *ns);
+
+    /**
+     * @brief Opens the Preferences namespace. Safe to call more than once.
+     * @return true if the namespace is open.
+     */
+    bool begin();
+
+    /**
+     * @brief Registers a string setting and loads its stored value.
+     * @param key The NVS key (at most 15 characters). Must stay valid for the lifetime of the object.
+     * @param defaultValue The value used if nothing is stored.
+     * @return false if the table is full.
+     */
+    bool addString(const char *key, const char *defaultValue);
+
+    /**
+     * @brief Registers an unsigned integer setting and loads its stored value.
+     * @param key The NVS key (at most 15 characters). Must stay valid for the lifetime of the object.
+     * @param defaultValue The value used if nothing is stored.
+     * @return false if the table is full.
+     */
+    bool addUInt(const char *key, uint32_t defaultValue);
+
+    /**
+     * @brief Returns a string setting from RAM, or an empty string for an unknown key.
+     */
+    const String &getString(const char *key) const;
+
+    /**
+     * @brief Returns an unsigned integer setting from RAM, or 0 for an unknown key.
+     */
+    uint32_t getUInt(const char *key) const;
+
+    /**
+     * @brief Updates a string setting. Nothing is scheduled for writing if the value is unchanged.
+     * @return false for an unknown key.
+     */
+    bool setString(const char *key, const char *value);
+
+    /**
+     * @brief Updates an unsigned integer setting. Nothing is scheduled for writing if the value is unchanged.
+     * @return false for an unknown key.
+     */
+    bool setUInt(const char *key, uint32_t value);
+
+    /**
+     * @brief Writes all changed settings to flash now.
+     * @return true if every write succeeded.
+     */
+    bool commit();
+
+    /**
+     * @brief Commits pending changes once they have been quiet for CONFIG_COMMIT_DELAY_MS.
+     * Call regularly; returns immediately when nothing is pending.
+     * @param nowMs The current time in milliseconds.
+     */
+    void loop(uint32_t nowMs);
+
+    /**
+     * @brief Returns true if some setting has changed since the last commit.
+     */
+    bool isDirty() const;
+
+    /**
+     * @brief Returns the number of keys written to flash since boot.
+     */
+    uint32_t getWriteCount() const;
+
+private:
+    enum class EntryType : uint8_t { String, UInt };
+
+    struct Entry {
+        const char *key;
+        EntryType type;
+        bool dirty;
+        String text;
+        uint32_t number;
+    };
+
+    Preferences _prefs;
+    const char *_namespace;
+    bool _open;
+    Entry _entries[CONFIG_MAX_ENTRIES];
+    uint8_t _entryCount;
+    bool _dirty;
+    uint32_t _lastChangeMs;
+    uint32_t _writeCount;
+
+    Entry *_find(const char *key);
+    const Entry *_find(const char *key) const;
+    void _markDirty(Entry &entry);
+};
+
+#endif // PERSISTENT_CONFIG_H
@@ -0,0 +1,155 @@
+// QRSDetector.h
+// This header file defines the QRSDetector class, a streaming Pan-Tompkins R-peak detector.
+
+#ifndef QRS_DETECTOR_H
+#define QRS_DETECTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ECGSample.h"
+
+// Moving-window integration length (150 ms) at the highest supported sampling rate.
+#define QRS_MAX_WINDOW_SAMPLES 150
+
+// Number of recent R-R intervals averaged for the heart rate and search-back logic.
+#define QRS_RR_HISTORY 8
+
+// Beats processSamples() holds for takeEarlierBeat() because their R peak was in an earlier block.
+#define QRS_EARLIER_BEATS 4
+
+/**
+ * @brief A streaming R-peak detector based on the Pan-Tompkins algorithm.
+ *
+ * Samples are processed one at a time with fixed memory: a five-point derivative,
+ * squaring, a 150 ms moving-window integrator and adaptive signal/noise thresholds
+ * with a 200 ms refractory period and search-back for missed beats. Input should
+ * already be band-limited (see ECGFilter).
+ *
+ * Beat times are taken from the largest filtered amplitude on the integrator's rising
+ * edge rather than from the integrator peak, so they land on the R wave itself and
+ * R-R intervals are not smeared by the integration window.
+ */
+class QRSDetector {
+public:
+    /**
+     * @brief Constructor for the QRSDetector class. Configured for 125 Hz until configure() is called.
+     */
+    QRSDetector();
+
+    /**
+     * @brief Sets the sampling rate of the incoming samples and resets the detector, dropping
+     * any beats waiting for takeEarlierBeat().
+     * @param rate The sampling rate.
+     */
+    void configure(ECGSampleRate rate);
+
+    /**
+     * @brief Resets all detector state, including the learned thresholds.
+     */
+    void reset();
+
+    /**
+     * @brief Feeds one filtered sample into the detector.
+     * @param value The filtered sample value (centred on the ADC mid-scale).
+     * @param timestampUs The sample's capture time.
+     * @param beatTimeUs Set to the capture time of the beat's R peak when one is confirmed.
+     * The R peak precedes the confirming sample: by a few samples normally, and by up to
+     * ~1.7 R-R intervals for a beat found by search-back.
+     * @return true if a beat was confirmed on this sample.
+     */
+    bool process(int value, uint32_t timestampUs, uint32_t &beatTimeUs);
+
+    /**
+     * @brief Runs the detector over a block of samples and sets ECG_SAMPLE_FLAG_BEAT on the
+     * R-peak sample of each beat confirmed. Beats whose R peak lies in an earlier block are
+     * kept for takeEarlierBeat() instead. Samples with a lead off reset the detector.
+     * @param samples The samples, oldest first.
+     * @param count Number of samples.
+     * @return The number of beats confirmed in the block.
+     */
+    size_t processSamples(ECGSample *samples, size_t count);
+
+    /**
+     * @brief Takes the oldest beat processSamples() confirmed after its R-peak sample had left.
+     * Only the newest QRS_EARLIER_BEATS are kept. reset() keeps them, as they were real beats.
+     * @param beatTimeUs Set to the capture time of the beat's R peak.
+     * @return false if there is none.
+     */
+    bool takeEarlierBeat(uint32_t &beatTimeUs);
+
+    /**
+     * @brief Returns the most recent R-R interval in milliseconds, or 0 before two beats were
+     * seen and once no beat has come for 3 s (the longest interval taken as a heart rate).
+     */
+    uint16_t getLastRRIntervalMs() const;
+
+    /**
+     * @brief Returns the instantaneous heart rate (from the last R-R interval) in tenths of BPM,
+     * or 0 if unknown, as for getLastRRIntervalMs().
+     */
+    uint16_t getInstantHeartRateX10() const;
+
+    /**
+     * @brief Returns the heart rate averaged over the last QRS_RR_HISTORY intervals in tenths of BPM,
+     * or 0 if unknown, as for getLastRRIntervalMs().
+     */
+    uint16_t getAverageHeartRateX10() const;
+
+    /**
+     * @brief Returns the capture time of the last detected R peak.
+     */
+    uint32_t getLastBeatTimestampUs() const;
+
+private:
+    uint16_t _sampleRateHz;
+    uint16_t _windowLength;     // Integration window in samples
+    uint32_t _refractoryUs;     // Minimum spacing between beats
+    uint32_t _learningUs;       // Duration of the initial threshold learning phase
+
+    // Derivative input history (x[n-1] .. x[n-4])
+    int32_t _history[4];
+
+    // Moving-window integrator
+    uint32_t _window[QRS_MAX_WINDOW_SAMPLES];
+    uint16_t _windowIndex;
+    uint64_t _windowSum;
+
+    // Peak tracking on the integrated signal
+    uint32_t _candidatePeak;        // Highest integrated value since the signal last rose
+    bool _rising;                   // Whether the integrated signal is climbing towards a peak
+    int32_t _candidateRAmplitude;   // Largest |x| seen on the current rising edge
+    uint32_t _candidateRTimeUs;     // Timestamp of _candidateRAmplitude, i.e. the R wave
+
+    // Adaptive thresholds (Pan-Tompkins SPKI / NPKI)
+    uint32_t _signalPeak;
+    uint32_t _noisePeak;
+    uint32_t _learningMax;
+    uint64_t _learningSum;
+    uint32_t _learningCount;
+    uint32_t _startTimeUs;
+    bool _learning;
+    bool _started;
+
+    // Search-back: best sub-threshold peak since the last beat
+    uint32_t _searchBackPeak;
+    uint32_t _searchBackTimeUs;
+
+    // Beat history
+    bool _haveBeat;
+    uint32_t _lastBeatUs;
+    uint16_t _rrHistory[QRS_RR_HISTORY];
+    uint8_t _rrCount;
+    uint8_t _rrIndex;
+    uint32_t _rrSum;
+
+    // Beats for takeEarlierBeat(), oldest first
+    uint32_t _earlierBeatsUs[QRS_EARLIER_BEATS];
+    uint8_t _earlierBeatCount;
+
+    uint32_t _threshold() const;
+    bool _acceptBeat(uint32_t beatTimeUs);
+    void _clearRRHistory();
+    void _onPeak(uint32_t peak, uint32_t beatTimeUs, bool &beat);
+};
+
+#endif // QRS_DETECTOR_H
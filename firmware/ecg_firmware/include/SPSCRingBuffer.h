@@ -0,0 +1,206 @@
+// SPSCRingBuffer.h
+// This header file defines a fixed-capacity, lock-free single-producer/single-consumer ring buffer.
+
+#ifndef SPSC_RING_BUFFER_H
+#define SPSC_RING_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * @brief A lock-free ring buffer for passing items from exactly one producer to exactly one consumer.
+ *
+ * Storage is a plain member array, so the buffer never touches the heap; declare it
+ * as a global or static object so it lives in internal DRAM. The producer side
+ * (push/pushBulk) only writes the head index and the consumer side (pop/popBulk/
+ * peekContiguous/consume/clear) only writes the tail index, which makes it safe to
+ * produce from a timer callback or ISR on one core and consume from the main loop on
+ * another without disabling interrupts.
+ *
+ * When the buffer is full, new items are rejected (the producer cannot discard old
+ * items without racing the consumer) and the overrun counter is incremented.
+ *
+ * @tparam T The item type. Must be trivially copyable.
+ * @tparam Capacity The number of slots. Must be a power of two.
+ */
+template <typename T, size_t Capacity>
+class SPSCRingBuffer {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "SPSCRingBuffer capacity must be a power of two");
+    static_assert(Capacity <= 0x80000000UL, "SPSCRingBuffer capacity too large for 32-bit indices");
+    static_assert(std::atomic<uint32_t>::is_always_lock_free,
+                  "SPSCRingBuffer requires lock-free 32-bit atomics");
+
+public:
+    SPSCRingBuffer() : _head(0), _tail(0), _overruns(0), _highWaterMark(0) {}
+
+    SPSCRingBuffer(const SPSCRingBuffer &) = delete;
+    SPSCRingBuffer &operator=(const SPSCRingBuffer &) = delete;
+
+    /**
+     * @brief Returns the number of slots in the buffer.
+     */
+    static constexpr size_t capacity() { return Capacity; }
+
+    /**
+     * @brief Producer: appends one item.
+     * @param item The item to append.
+     * @return true if the item was stored, false if the buffer was full (counted as an overrun).
+     */
+    bool push(const T &item) {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        uint32_t tail = _tail.load(std::memory_order_acquire);
+        uint32_t used = head - tail;
+        if (used >= Capacity) {
+            _overruns.store(_overruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+        _buffer[head & kMask] = item;
+        _head.store(head + 1, std::memory_order_release);
+        _updateHighWaterMark(used + 1);
+        return true;
+    }
+
+    /**
+     * @brief Producer: appends as many items as fit.
+     * Items that do not fit are counted as overruns.
+     * @param items Array of items to append.
+     * @param count Number of items in the array.
+     * @return The number of items stored.
+     */
+    size_t pushBulk(const T *items, size_t count) {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        uint32_t tail = _tail.load(std::memory_order_acquire);
+        size_t space = Capacity - (head - tail);
+        size_t n = (count < space) ? count : space;
+        for (size_t i = 0; i < n; i++) {
+            _buffer[(head + i) & kMask] = items[i];
+        }
+        _head.store(head + n, std::memory_order_release);
+        if (n < count) {
+            _overruns.store(_overruns.load(std::memory_order_relaxed) + (count - n), std::memory_order_relaxed);
+        }
+        _updateHighWaterMark(static_cast<uint32_t>((head - tail) + n));
+        return n;
+    }
+
+    /**
+     * @brief Consumer: removes the oldest item.
+     * @param out Receives the item.
+     * @return true if an item was removed, false if the buffer was empty.
+     */
+    bool pop(T &out) {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        uint32_t head = _head.load(std::memory_order_acquire);
+        if (head == tail) {
+            return false;
+        }
+        out = _buffer[tail & kMask];
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Consumer: removes up to maxItems of the oldest items in one pass.
+     * @param out Destination array.
+     * @param maxItems Capacity of the destination array.
+     * @return The number of items copied into out.
+     */
+    size_t popBulk(T *out, size_t maxItems) {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        uint32_t head = _head.load(std::memory_order_acquire);
+        size_t n = head - tail;
+        if (n > maxItems) {
+            n = maxItems;
+        }
+        for (size_t i = 0; i < n; i++) {
+            out[i] = _buffer[(tail + i) & kMask];
+        }
+        _tail.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    /**
+     * @brief Consumer: exposes the oldest items in place, without copying.
+     * Only the run up to the physical end of the storage array is returned; call
+     * again after consume() to get the wrapped-around remainder.
+     * @param items Receives a pointer to the first readable item.
+     * @return The number of contiguous readable items (0 if empty).
+     */
+    size_t peekContiguous(const T **items) const {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        uint32_t head = _head.load(std::memory_order_acquire);
+        size_t n = head - tail;
+        size_t untilEnd = Capacity - (tail & kMask);
+        *items = &_buffer[tail & kMask];
+        return (n < untilEnd) ? n : untilEnd;
+    }
+
+    /**
+     * @brief Consumer: releases items previously returned by peekContiguous().
+     * @param count Number of items to release. Must not exceed size().
+     */
+    void consume(size_t count) {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        _tail.store(tail + count, std::memory_order_release);
+    }
+
+    /**
+     * @brief Consumer: discards everything currently in the buffer.
+     */
+    void clear() {
+        _tail.store(_head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    /**
+     * @brief Returns the number of items currently stored. Exact from the consumer side,
+     * a lower bound from any other context.
+     */
+    size_t size() const {
+        uint32_t head = _head.load(std::memory_order_acquire);
+        uint32_t tail = _tail.load(std::memory_order_acquire);
+        return head - tail;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    bool full() const { return size() >= Capacity; }
+
+    /**
+     * @brief Returns the number of items rejected because the buffer was full.
+     */
+    uint32_t overrunCount() const { return _overruns.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Returns the highest fill level observed since the last reset.
+     */
+    uint32_t highWaterMark() const { return _highWaterMark.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Resets the overrun counter and high-water mark.
+     * Should be called while the producer is idle, otherwise a concurrent update may be lost.
+     */
+    void resetStats() {
+        _overruns.store(0, std::memory_order_relaxed);
+        _highWaterMark.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr uint32_t kMask = static_cast<uint32_t>(Capacity - 1);
+
+    T _buffer[Capacity];
+    // Free-running indices; the difference head - tail is the fill level even across wrap-around.
+    std::atomic<uint32_t> _head;          // Written only by the producer
+    std::atomic<uint32_t> _tail;          // Written only by the consumer
+    std::atomic<uint32_t> _overruns;      // Written only by the producer
+    std::atomic<uint32_t> _highWaterMark; // Written only by the producer
+
+    void _updateHighWaterMark(uint32_t used) {
+        if (used > _highWaterMark.load(std::memory_order_relaxed)) {
+            _highWaterMark.store(used, std::memory_order_relaxed);
+        }
+    }
+};
+
+#endif // SPSC_RING_BUFFER_H
@@ -0,0 +1,143 @@
+// TaskRuntime.h
+// This header file defines the PeriodicTask class, a small task abstraction over FreeRTOS and POSIX threads.
+
+#ifndef TASK_RUNTIME_H
+#define TASK_RUNTIME_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Pass as TaskConfig::core to let the scheduler pick a core.
+#define TASK_ANY_CORE -1
+
+/**
+ * @brief Parameters of a PeriodicTask.
+ */
+struct TaskConfig {
+    const char *name;    // Task name (at most 15 characters on FreeRTOS)
+    uint32_t stackBytes; // Stack size in bytes
+    uint8_t priority;    // FreeRTOS priority; ignored by the POSIX backend
+    int8_t core;         // Core to pin the task to, or TASK_ANY_CORE
+    uint32_t periodMs;   // Sleep between two calls of the step function
+};
+
+/**
+ * @brief A task that calls a step function, sleeps for periodMs and repeats.
+ *
+ * On the ESP32 this is a FreeRTOS task pinned with xTaskCreatePinnedToCore(). On
+ * other platforms it is a pthread with a stack allocated and pre-filled by the runtime,
+ * so stack usage can be measured the same way FreeRTOS does. On Linux it is pinned
+ * with pthread_setaffinity_np() when the core exists.
+ *
+ * The runtime times every step, so getStats() can report the task's CPU load
+ * without FreeRTOS run-time statistics being enabled.
+ *
+ * With TASK_RUNTIME_MANUAL defined (the native environment) tasks are not threads:
+ * start() only registers them and taskSleepMs() steps a simulated clock, running each
+ * task whose period has elapsed (see taskSetSimulatedClock()). The firmware then runs
+ * on one thread, deterministically and faster than real time, while step times are
+ * still measured on the real clock. A step that calls taskSleepMs() itself lets the
+ * other tasks run meanwhile, as a blocked task would.
+ */
+class PeriodicTask {
+public:
+    typedef void (*StepFunction)(void *arg);
+
+    /**
+     * @brief Load and stack figures for one task.
+     */
+    struct Stats {
+        uint32_t stackHighWaterBytes; // Least free stack seen so far
+        uint16_t cpuLoadPermille;     // Share of wall time spent in the step function since the last getStats()
+        uint32_t maxStepUs;           // Longest single step since the last getStats()
+        uint32_t iterations;          // Steps run since start()
+        uint32_t busyUs;              // Total time spent in the step function since start()
+    };
+
+    /**
+     * @brief Constructor for the PeriodicTask class.
+     * @param config Task parameters. The name must stay valid for the lifetime of the task.
+     * @param step Function called once per period.
+     * @param arg Argument passed to step.
+     */
+    PeriodicTask(const TaskConfig &config, StepFunction step, void *arg = nullptr);
+    ~PeriodicTask();
+
+    /**
+     * @brief Creates and starts the task.
+     * @return true if the task is running.
+     */
+    bool start();
+
+    /**
+     * @brief Asks the task to stop after its current step and waits for it to finish.
+     * Must not be called from the task itself.
+     */
+    void stop();
+
+    /**
+     * @brief Returns true between start() and stop().
+     */
+    bool isRunning() const;
+
+    /**
+     * @brief Returns the task name.
+     */
+    const char *getName() const;
+
+    /**
+     * @brief Returns the task statistics. The CPU load and longest step cover the time
+     * since the previous call, so call it from a single place at a regular interval.
+     */
+    Stats getStats();
+
+private:
+    TaskConfig _config;
+    StepFunction _step;
+    void *_arg;
+    void *_handle; // TaskHandle_t or the pthread state, depending on the backend
+    std::atomic<bool> _running;
+    std::atomic<bool> _stopRequested;
+    std::atomic<uint32_t> _busyUs;
+    std::atomic<uint32_t> _maxStepUs;
+    std::atomic<uint32_t> _iterations;
+    uint32_t _lastBusyUs;
+    uint32_t _lastStatsUs;
+    uint32_t _lastRunMs; // Manual scheduling only
+
+    static void _body(void *self);
+    void _run();
+    void _stepOnce();
+
+    friend void taskRunDue();
+};
+
+/**
+ * @brief Returns a monotonic time in microseconds (wraps after ~71 minutes).
+ */
+uint32_t taskMicros();
+
+/**
+ * @brief Puts the calling task to sleep.
+ * @param ms Sleep time in milliseconds.
+ */
+void taskSleepMs(uint32_t ms);
+
+#if defined(TASK_RUNTIME_MANUAL)
+/**
+ * @brief Connects manual scheduling to a simulated clock. Until this is called,
+ * taskSleepMs() sleeps in real time and no task runs.
+ * @param nowMs Returns the simulated time in milliseconds.
+ * @param advanceMs Moves the simulated clock forward.
+ */
+void taskSetSimulatedClock(uint32_t (*nowMs)(), void (*advanceMs)(uint32_t ms));
+
+/**
+ * @brief Runs one step of every started task whose period has elapsed on the simulated clock,
+ * skipping tasks that are inside their own step.
+ */
+void taskRunDue();
+#endif
+
+#endif // TASK_RUNTIME_H
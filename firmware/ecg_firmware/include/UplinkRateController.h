@@ -0,0 +1,96 @@
+// UplinkRateController.h
+// This header file defines the UplinkRateController class, which picks how much the ECG uplink
+// sends from the observed send times, transmit backlog and signal strength.
+
+#ifndef UPLINK_RATE_CONTROLLER_H
+#define UPLINK_RATE_CONTROLLER_H
+
+#include <stdint.h>
+
+// Levels, from full quality (0) to the lightest uplink
+#define UPLINK_LEVEL_COUNT 4
+// A frame send slower than this (smoothed) means the link is congested...
+#define UPLINK_SLOW_SEND_US 30000
+// ...and faster than this means it has room again
+#define UPLINK_FAST_SEND_US 5000
+// Samples waiting to be sent, in milliseconds of signal, above which the link is falling behind...
+#define UPLINK_BACKLOG_HIGH_MS 1000
+// ...and below which it has caught up
+#define UPLINK_BACKLOG_LOW_MS 250
+// Below this RSSI the uplink never runs above level 1; the floor lifts again above UPLINK_GOOD_RSSI
+#define UPLINK_WEAK_RSSI -80
+#define UPLINK_GOOD_RSSI -72
+// Minimum time between two steps down, so each step can take effect before the next
+#define UPLINK_DEGRADE_HOLD_MS 2000
+// How long the link must look healthy before stepping back up one level
+#define UPLINK_RECOVER_HOLD_MS 15000
+
+/**
+ * @brief Chooses the uplink level with hysteresis.
+ *
+ * The level only says how hard to save bandwidth and CPU; ECGWebSocketClient maps it to
+ * settings (larger batches first, then compression, then a lower output rate). Steps
+ * down are fast (one every UPLINK_DEGRADE_HOLD_MS while congested), steps up are slow
+ * (one after UPLINK_RECOVER_HOLD_MS of good conditions), so a marginal link does not
+ * flap between levels. The logic is clock-agnostic and takes the time as an argument.
+ */
+class UplinkRateController {
+public:
+    /**
+     * @brief Why the level last changed.
+     */
+    enum class Reason : uint8_t {
+        None,
+        SlowSend,    // Smoothed send time above UPLINK_SLOW_SEND_US
+        Backlog,     // Backlog above UPLINK_BACKLOG_HIGH_MS
+        WeakSignal,  // RSSI below UPLINK_WEAK_RSSI
+        Recovered    // Conditions good for UPLINK_RECOVER_HOLD_MS
+    };
+
+    /**
+     * @brief Constructor for the UplinkRateController class. Starts at level 0.
+     */
+    UplinkRateController();
+
+    /**
+     * @brief Returns to level 0 and forgets the send history, e.g. on a new connection.
+     */
+    void reset();
+
+    /**
+     * @brief Records the duration of one frame send.
+     */
+    void onSend(uint32_t durationUs);
+
+    /**
+     * @brief Re-evaluates the level; call regularly.
+     * @param nowMs The current time in milliseconds.
+     * @param backlogMs Signal waiting to be sent, in milliseconds.
+     * @param rssi WiFi signal strength in dBm, 0 if unknown.
+     * @return true if the level changed.
+     */
+    bool update(uint32_t nowMs, uint32_t backlogMs, int8_t rssi);
+
+    uint8_t getLevel() const;
+    Reason getReason() const;
+
+    /**
+     * @brief Returns the smoothed frame send time in microseconds.
+     */
+    uint32_t getSmoothedSendUs() const;
+
+    /**
+     * @brief Returns a short name for a reason, as reported to the server.
+     */
+    static const char *reasonName(Reason reason);
+
+private:
+    uint8_t _level;
+    Reason _reason;
+    uint32_t _smoothedSendUs; // Exponential average of the send time, 1/8 weight per send
+    bool _weakSignal;
+    uint32_t _lastChangeMs;
+    uint32_t _healthySinceMs; // When conditions last turned good, 0 while they are not
+};
+
+#endif // UPLINK_RATE_CONTROLLER_H
@@ -0,0 +1,194 @@
+// WiFiStateMachine.h
+// This header file defines the WiFiStateMachine class, a non-blocking WiFi connection manager.
+
+#ifndef WIFI_STATE_MACHINE_H
+#define WIFI_STATE_MACHINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Longest SSID and WPA2 passphrase, excluding the terminator
+#define WIFI_MAX_SSID_LENGTH 32
+#define WIFI_MAX_PASSWORD_LENGTH 64
+
+// Default timing
+#define WIFI_CONNECT_TIMEOUT_MS 10000
+#define WIFI_BACKOFF_BASE_MS 1000
+#define WIFI_BACKOFF_MAX_MS 60000
+
+/**
+ * @brief Link events reported by a WiFiDriver.
+ */
+enum class WiFiLinkEvent : uint8_t {
+    None,
+    Connected,   // Station associated and got an IP address
+    Disconnected // Station lost or failed to establish the link
+};
+
+/**
+ * @brief The radio operations the state machine needs.
+ *
+ * EspWiFiDriver (WirelessCommunication.h) implements this on the ESP32, and
+ * FakeWiFiDriver (test/test_wifi_state_machine) implements it for the host tests.
+ * None of the methods may block.
+ */
+class WiFiDriver {
+public:
+    virtual ~WiFiDriver() {}
+
+    /**
+     * @brief Starts connecting in station mode. The outcome is reported through takeEvent().
+     */
+    virtual void startStation(const char *ssid, const char *password) = 0;
+
+    /**
+     * @brief Starts an access point.
+     * @return true if the access point is up.
+     */
+    virtual bool startAccessPoint(const char *ssid, const char *password) = 0;
+
+    /**
+     * @brief Stops station and access point modes.
+     */
+    virtual void stop() = 0;
+
+    /**
+     * @brief Returns and clears the most recent link event, or WiFiLinkEvent::None.
+     * May be fed from another task; only the latest event is kept.
+     */
+    virtual WiFiLinkEvent takeEvent() = 0;
+
+    /**
+     * @brief Returns a random value used to jitter the backoff delays.
+     */
+    virtual uint32_t random() = 0;
+};
+
+/**
+ * @brief States of the WiFi connection.
+ */
+enum class WiFiState : uint8_t {
+    Idle,       // Radio off or no credentials
+    Connecting, // Station connect in progress
+    Connected,  // Station has an IP address
+    Backoff,    // Waiting before the next connect attempt
+    Hotspot     // Access point mode
+};
+
+/**
+ * @brief An event-driven WiFi connection state machine.
+ *
+ * Nothing here blocks. Requests (connect(), startHotspot(), stop()) only change the
+ * state, and poll() advances it from driver events and the current time in O(1).
+ * Failed or lost connections are retried with exponential backoff and "equal jitter":
+ * the n-th retry waits between half and all of min(base * 2^n, max), so a room full of
+ * devices does not hammer the access point in lockstep.
+ *
+ * Time is passed in by the caller (millis() on the device), so transitions and their
+ * timing can be driven deterministically on a host with FakeWiFiDriver.
+ */
+class WiFiStateMachine {
+public:
+    /**
+     * @brief Counters describing connection activity.
+     */
+    struct Stats {
+        uint32_t connectAttempts; // Station connects started
+        uint32_t connections;     // Attempts that reached Connected
+        uint32_t failures;        // Attempts that failed or timed out
+        uint32_t linkLosses;      // Drops from Connected
+    };
+
+    /**
+     * @brief Constructor for the WiFiStateMachine class.
+     * @param driver The radio driver. Must outlive the state machine.
+     */
+    WiFiStateMachine(WiFiDriver &driver);
+
+    /**
+     * @brief Overrides the default timing.
+     * @param connectTimeoutMs How long a connect attempt may take before it counts as failed.
+     * @param backoffBaseMs Delay before the first retry.
+     * @param backoffMaxMs Upper bound on the retry delay.
+     */
+    void setTiming(uint32_t connectTimeoutMs, uint32_t backoffBaseMs, uint32_t backoffMaxMs);
+
+    /**
+     * @brief Starts connecting to a network as a station. Retries continue until stop()
+     * or startHotspot(). Does nothing if ssid is empty.
+     * @param ssid The network SSID.
+     * @param password The network password.
+     * @param nowMs The current time in milliseconds.
+     */
+    void connect(const char *ssid, const char *password, uint32_t nowMs);
+
+    /**
+     * @brief Switches to access point mode.
+     * @param ssid The hotspot SSID.
+     * @param password The hotspot password, or nullptr for an open network.
+     * @param nowMs The current time in milliseconds.
+     * @return true if the access point started.
+     */
+    bool startHotspot(const char *ssid, const char *password, uint32_t nowMs);
+
+    /**
+     * @brief Turns the radio off and stops retrying.
+     * @param nowMs The current time in milliseconds.
+     */
+    void stop(uint32_t nowMs);
+
+    /**
+     * @brief Advances the state machine. Call from loop().
+     * @param nowMs The current time in milliseconds.
+     */
+    void poll(uint32_t nowMs);
+
+    /**
+     * @brief Returns the current state.
+     */
+    WiFiState getState() const;
+
+    /**
+     * @brief Returns true in the Connected state.
+     */
+    bool isConnected() const;
+
+    /**
+     * @brief Returns the time the current state was entered.
+     */
+    uint32_t getStateSinceMs() const;
+
+    /**
+     * @brief Returns the time of the next connect attempt while in Backoff.
+     */
+    uint32_t getNextAttemptMs() const;
+
+    /**
+     * @brief Returns the number of consecutive failed attempts.
+     */
+    uint8_t getRetryCount() const;
+
+    /**
+     * @brief Returns the connection statistics.
+     */
+    Stats getStats() const;
+
+private:
+    WiFiDriver &_driver;
+    WiFiState _state;
+    uint32_t _stateSinceMs;
+    uint32_t _nextAttemptMs;
+    uint8_t _retryCount;
+    uint32_t _connectTimeoutMs;
+    uint32_t _backoffBaseMs;
+    uint32_t _backoffMaxMs;
+    char _ssid[WIFI_MAX_SSID_LENGTH + 1];
+    char _password[WIFI_MAX_PASSWORD_LENGTH + 1];
+    Stats _stats;
+
+    void _enter(WiFiState state, uint32_t nowMs);
+    void _startAttempt(uint32_t nowMs);
+    void _scheduleRetry(uint32_t nowMs);
+};
+
+#endif // WIFI_STATE_MACHINE_H
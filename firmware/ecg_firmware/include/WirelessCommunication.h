@@ -6,33 +6,85 @@
 
 #include <Arduino.h>
 #include <WiFi.h>
-#include <Preferences.h>
+#include <atomic>
+#include "PersistentConfig.h"
+#include "WiFiStateMachine.h"
 
 // Namespace for Preferences storage.
 #define WIFI_CREDS "wifi_creds"
 
+// Setting keys in the WIFI_CREDS namespace
+#define CONFIG_KEY_SSID "ssid"
+#define CONFIG_KEY_PASSWORD "password"
+#define CONFIG_KEY_MODE "mode"
+
+/**
+ * @brief Wireless mode, stored in NVS under CONFIG_KEY_MODE as "off", "wifi" or "hotspot".
+ */
+enum class WirelessMode : uint8_t {
+    Off,
+    WiFi,
+    Hotspot
+};
+
+/**
+ * @brief WiFiDriver for the ESP32 Arduino WiFi library.
+ *
+ * Link events arrive from the WiFi event task through WiFi.onEvent() and are handed
+ * to the state machine via an atomic, so nothing on the loop() side waits on the radio.
+ */
+class EspWiFiDriver : public WiFiDriver {
+public:
+    EspWiFiDriver();
+
+    /**
+     * @brief Registers the WiFi event handler. Call once from setup().
+     */
+    void begin();
+
+    void startStation(const char *ssid, const char *password) override;
+    bool startAccessPoint(const char *ssid, const char *password) override;
+    void stop() override;
+    WiFiLinkEvent takeEvent() override;
+    uint32_t random() override;
+
+private:
+    std::atomic<uint8_t> _event; // Latest WiFiLinkEvent, written by the WiFi event task
+    bool _registered;
+};
+
 /**
  * @brief A class to handle wireless communication (WiFi Station and Access Point modes)
- * and persist WiFi credentials using ESP32 Preferences (NVS).
+ * and persist WiFi credentials using ESP32 Preferences (NVS) through a PersistentConfig.
+ *
+ * Connecting never blocks: activateWiFiMode() only starts a connection, and loop()
+ * drives a WiFiStateMachine that retries with exponential backoff until the link is up.
  */
 class WirelessCommunication {
 public:
     /**
      * @brief Constructor for the WirelessCommunication class.
-     * Initializes the class and loads saved WiFi credentials from NVS.
+     * @param config The settings store holding the credentials and mode (WIFI_CREDS namespace).
      */
-    WirelessCommunication();
+    WirelessCommunication(PersistentConfig &config);
 
     /**
      * @brief Initializes the wireless communication system.
      * This method should be called in setup() to prepare the WiFi module.
+     * Loads the saved WiFi credentials and mode into RAM.
      */
     void begin();
 
     /**
-     * @brief Activates WiFi Station (client) mode and attempts to connect to a saved network.
-     * If no credentials are saved, it prints a message and returns.
-     * It will retry connection multiple times.
+     * @brief Must be called regularly in the Arduino loop() function.
+     * Advances the connection state machine and commits changed settings; returns immediately.
+     */
+    void loop();
+
+    /**
+     * @brief Activates WiFi Station (client) mode and starts connecting to the saved network.
+     * If no credentials are saved, it returns without changing anything.
+     * Returns immediately; retries continue in the background from loop().
      */
     void activateWiFiMode();
 
@@ -43,13 +95,22 @@ public:
     bool isConnected();
 
     /**
-     * @brief Attempts to connect to a previously saved WiFi network.
-     * This method can be called to re-establish a connection if lost,
-     * or to connect after saving new credentials.
-     * @return true if successfully connected, false otherwise.
+     * @brief Starts connecting to the previously saved WiFi network, unless a connection
+     * is already up or in progress. Returns immediately.
+     * @return true if already connected, false otherwise.
      */
     bool connectWiFi();
 
+    /**
+     * @brief Returns the state of the WiFi connection state machine.
+     */
+    WiFiState getWiFiState() const;
+
+    /**
+     * @brief Returns the connection statistics of the WiFi state machine.
+     */
+    WiFiStateMachine::Stats getWiFiStats() const;
+
     /**
      * @brief Activates WiFi Access Point (hotspot) mode.
      * @param ssid The SSID (name) of the hotspot.
@@ -65,44 +126,59 @@ public:
     /**
      * @brief Saves the provided WiFi SSID and password to non-volatile storage (NVS).
      * These credentials will be used for subsequent WiFi connections.
+     * Flash is only written if they differ from the saved ones. Call from the task that
+     * runs loop(); HotspotWebServer hands posted credentials over to it.
      * @param _ssid The WiFi network SSID to save.
      * @param _password The WiFi network password to save.
      */
     void saveWiFiCredentials(const char *_ssid, const char *_password);
 
     /**
-     * @brief Retrieves the saved WiFi SSID from NVS.
+     * @brief Retrieves the saved WiFi SSID (cached in RAM).
      * @return The saved SSID as a String, or an empty String if none is saved.
      */
     String getSavedSSID();
 
     /**
-     * @brief Retrieves the saved WiFi password from NVS.
+     * @brief Retrieves the saved WiFi password (cached in RAM).
      * @return The saved password as a String, or an empty String if none is saved.
      */
     String getSavedPassword();
 
     /**
-     * @brief Retrieves the currently set wireless mode from NVS (e.g., "wifi", "hotspot", "off").
-     * @return The current mode as a String.
+     * @brief Retrieves the currently set wireless mode.
+     * The mode is cached in RAM and persisted to NVS when it changes, so this is cheap
+     * enough to call on every loop iteration.
+     * @return The current mode.
      */
-    String getMode();
+    WirelessMode getMode() const;
 
-    String getLocalMode();
+    /**
+     * @brief Same as getMode().
+     */
+    WirelessMode getLocalMode() const;
 
     IPAddress getIP();
 
+    /**
+     * @brief Selects the station's power save mode. With it on, the radio sleeps through
+     * all but every few beacons (WIFI_PS_MAX_MODEM) and wakes to transmit; off, it wakes
+     * for every beacon (WIFI_PS_MIN_MODEM, the default). Survives reconnects.
+     */
+    void setPowerSave(bool enabled);
+
 private:
-    Preferences prefs; // Instance of the Preferences library for NVS access
-    String ssid;       // Stored WiFi SSID
-    String password;   // Stored WiFi password
-    String mode;       // Current wireless mode (e.g., "wifi", "hotspot", "off")
+    PersistentConfig &config; // RAM-cached credentials and mode, written to NVS only on change
+    EspWiFiDriver driver;  // Radio driver fed by WiFi events
+    WiFiStateMachine link; // Non-blocking connection state machine
+    WirelessMode mode;     // Current mode, mirrored in config under CONFIG_KEY_MODE
 
     /**
-     * @brief Saves the current wireless mode (e.g., "wifi", "hotspot", "off") to NVS.
-     * @param mode A C-style string representing the mode.
+     * @brief Sets the current wireless mode.
+     * It is written to NVS shortly afterwards, and only if it changed.
+     * @param newMode The mode.
      */
-    void setMode(const char *mode);
+    void setMode(WirelessMode newMode);
 };
 
 #endif // WIRELESS_COMMUNICATION_H
\ No newline at end of file
@@ -0,0 +1,134 @@
+"""
+Embeds the hotspot setup page into the firmware as a gzip-compressed PROGMEM array.
+
+Runs before every PlatformIO build (extra_scripts in platformio.ini): web/setup.html is
+minified, gzipped and written with its ETag to SetupPage.h in the build directory, which
+is added to the include path. It is only rewritten when the page changes, so an unchanged
+page does not trigger a rebuild.
+
+It can also be run by hand, e.g. for a build outside PlatformIO:
+
+    python scripts/embed_web.py <output directory>
+"""
+
+import gzip
+import hashlib
+import os
+import re
+import sys
+
+PAGE = os.path.join("web", "setup.html")
+HEADER = "SetupPage.h"
+
+
+def minify(html: str) -> str:
+    """
+    Shrink the page without changing what it does.
+
+    Indentation, blank lines and comments are removed; line breaks are kept, so script
+    statements that rely on them stay intact.
+
+    Args:
+        html (str): The page source.
+
+    Returns:
+        str: The minified page.
+    """
+    html = re.sub(r"<!--.*?-->", "", html, flags=re.S)
+    html = re.sub(r"/\*.*?\*/", "", html, flags=re.S)
+    lines = []
+    in_script = False
+    for line in html.splitlines():
+        line = line.strip()
+        if "<script" in line:
+            in_script = True
+        if in_script:
+            if line.startswith("//"):
+                continue
+            # Trailing comment after a statement; strings here never hold "//" after these characters
+            line = re.sub(r"([;{},)])\s+//.*$", r"\1", line)
+        if "</script>" in line:
+            in_script = False
+        if line:
+            lines.append(line)
+    return "\n".join(lines)
+
+
+def render_header(page: bytes, etag: str, raw_length: int) -> str:
+    """
+    Render the C++ header holding the compressed page.
+
+    Args:
+        page (bytes): The gzip-compressed page.
+        etag (str): The quoted entity tag of the page.
+        raw_length (int): Size of the page before minifying, for the comment.
+
+    Returns:
+        str: The header source.
+    """
+    rows = []
+    for start in range(0, len(page), 16):
+        rows.append("    " + ", ".join(f"0x{b:02x}" for b in page[start:start + 16]) + ",")
+    return (
+        "// SetupPage.h\n"
+        f"// Generated by scripts/embed_web.py from {PAGE} ({raw_length} bytes); do not edit.\n"
+        "\n"
+        "#ifndef SETUP_PAGE_H\n"
+        "#define SETUP_PAGE_H\n"
+        "\n"
+        "#include <Arduino.h>\n"
+        "\n"
+        f"#define SETUP_PAGE_ETAG \"{etag.replace(chr(34), chr(92) + chr(34))}\"\n"
+        f"#define SETUP_PAGE_GZ_LENGTH {len(page)}\n"
+        "\n"
+        "static const uint8_t SETUP_PAGE_GZ[SETUP_PAGE_GZ_LENGTH] PROGMEM = {\n"
+        + "\n".join(rows) + "\n"
+        "};\n"
+        "\n"
+        "#endif // SETUP_PAGE_H\n"
+    )
+
+
+def embed(project_dir: str, output_dir: str) -> str:
+    """
+    Write SetupPage.h for the page in project_dir, unless it is already up to date.
+
+    Args:
+        project_dir (str): The firmware project directory.
+        output_dir (str): Where to write the header.
+
+    Returns:
+        str: The path of the header.
+    """
+    with open(os.path.join(project_dir, PAGE), encoding="utf-8") as f:
+        html = f.read()
+    minified = minify(html).encode("utf-8")
+    # mtime=0 keeps the output, and so the ETag, identical across builds
+    page = gzip.compress(minified, compresslevel=9, mtime=0)
+    etag = '"' + hashlib.sha256(minified).hexdigest()[:16] + '"'
+    header = render_header(page, etag, len(html.encode("utf-8")))
+
+    os.makedirs(output_dir, exist_ok=True)
+    path = os.path.join(output_dir, HEADER)
+    try:
+        with open(path, encoding="utf-8") as f:
+            if f.read() == header:
+                return path
+    except OSError:
+        pass
+    with open(path, "w", encoding="utf-8") as f:
+        f.write(header)
+    print(f"embed_web: {PAGE} {len(html)} -> {len(minified)} minified -> {len(page)} gzip bytes")
+    return path
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO
+except NameError:
+    if __name__ == "__main__":
+        embed(os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."),
+              sys.argv[1] if len(sys.argv) > 1 else ".")
+else:
+    generated = os.path.join(env.subst("$BUILD_DIR"), "generated")  # noqa: F821
+    embed(env.subst("$PROJECT_DIR"), generated)  # noqa: F821
+    env.Append(CPPPATH=[generated])  # noqa: F821
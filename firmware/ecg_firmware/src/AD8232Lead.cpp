@@ -0,0 +1,56 @@
+// AD8232Lead.cpp
+// This file implements the methods defined in the AD8232Lead class.
+#include "AD8232Lead.h"
+
+AD8232Lead::AD8232Lead(int outputPin, int loPlusPin, int loMinusPin)
+    : _outputPin(outputPin),
+      _loPlusPin(loPlusPin),
+      _loMinusPin(loMinusPin),
+      _leadOffState(0),
+      _leadChanges(0) {}
+
+void AD8232Lead::begin() {
+    pinMode(_loPlusPin, INPUT);
+    pinMode(_loMinusPin, INPUT);
+    pinMode(_outputPin, INPUT);
+
+    _readLeadState();
+    attachInterruptArg(digitalPinToInterrupt(_loPlusPin), &AD8232Lead::_onLeadChange, this, CHANGE);
+    attachInterruptArg(digitalPinToInterrupt(_loMinusPin), &AD8232Lead::_onLeadChange, this, CHANGE);
+}
+
+bool AD8232Lead::isSensorConnected() {
+    // If both are LOW (0), then leads are connected.
+    // If either is HIGH (1), then at least one lead is off.
+    return _leadOffState == 0;
+}
+
+uint8_t AD8232Lead::getLeadOffState() const {
+    return _leadOffState;
+}
+
+uint32_t AD8232Lead::getLeadChangeCount() const {
+    return _leadChanges;
+}
+
+void IRAM_ATTR AD8232Lead::_onLeadChange(void *arg) {
+    AD8232Lead *self = static_cast<AD8232Lead *>(arg);
+    self->_readLeadState();
+    self->_leadChanges = self->_leadChanges + 1;
+}
+
+void IRAM_ATTR AD8232Lead::_readLeadState() {
+    // Both pins are read on either edge, so a missed edge on one pin heals on the next.
+    uint8_t state = 0;
+    if (digitalRead(_loPlusPin) != LOW) {
+        state |= AD8232_LEAD_OFF_PLUS;
+    }
+    if (digitalRead(_loMinusPin) != LOW) {
+        state |= AD8232_LEAD_OFF_MINUS;
+    }
+    _leadOffState = state;
+}
+
+int AD8232Lead::readECG() {
+    return analogRead(_outputPin);
+}
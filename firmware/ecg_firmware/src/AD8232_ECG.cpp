@@ -2,31 +2,237 @@
 // This file implements the methods defined in the AD8232_ECG class.
 #include "AD8232_ECG.h"
 
-AD8232_ECG::AD8232_ECG(int outputPin, int loPlusPin, int loMinusPin) {
-    _outputPin = outputPin;
-    _loPlusPin = loPlusPin;
-    _loMinusPin = loMinusPin;
-}
+// Layout of the conversion results written by the DMA
+#if SOC_ADC_DIGI_RESULT_BYTES == 2
+#define AD8232_ADC_OUTPUT_FORMAT ADC_DIGI_OUTPUT_FORMAT_TYPE1
+#define AD8232_ADC_RESULT_DATA(result) ((result)->type1.data)
+#else
+#define AD8232_ADC_OUTPUT_FORMAT ADC_DIGI_OUTPUT_FORMAT_TYPE2
+#define AD8232_ADC_RESULT_DATA(result) ((result)->type2.data)
+#endif
+
+AD8232_ECG::AD8232_ECG(int outputPin, int loPlusPin, int loMinusPin)
+    : AD8232Lead(outputPin, loPlusPin, loMinusPin),
+      _source(this),
+      _sampleTimer(nullptr),
+      _sampleRateHz(0),
+      _rawRateHz(0),
+      _adc(nullptr),
+      _oversampling(false),
+      _adcStartUs(0),
+      _adcConversionIndex(0),
+      _adcConversions(0),
+      _groupDelayUs(0),
+      _lastSampleUs(0),
+      _samplesCaptured(0),
+      _minIntervalUs(UINT32_MAX),
+      _maxIntervalUs(0) {}
 
 void AD8232_ECG::begin() {
-    pinMode(_loPlusPin, INPUT);
-    pinMode(_loMinusPin, INPUT);
-    pinMode(_outputPin, INPUT);
+    AD8232Lead::begin();
+    _calibration.begin(_outputPin);
+}
+
+void AD8232_ECG::setSource(ECGSource *source) {
+    _source = source != nullptr ? source : this;
+}
+
+void AD8232_ECG::setOversampling(uint32_t rawRateHz) {
+    _rawRateHz = rawRateHz;
+}
+
+bool AD8232_ECG::isOversampling() const {
+    return _oversampling;
+}
+
+bool AD8232_ECG::isCalibrated() const {
+    return _calibration.isCalibrated();
+}
+
+bool AD8232_ECG::startSampling(ECGSampleRate rate) {
+    stopSampling();
+
+    if (_sampleTimer == nullptr) {
+        // The callback runs in the esp_timer task rather than in an ISR, because
+        // analogRead() takes a lock inside the ADC driver and is not ISR-safe.
+        esp_timer_create_args_t timerArgs = {};
+        timerArgs.callback = &AD8232_ECG::_onSampleTimer;
+        timerArgs.arg = this;
+        timerArgs.dispatch_method = ESP_TIMER_TASK;
+        timerArgs.name = "ecg_sample";
+        if (esp_timer_create(&timerArgs, &_sampleTimer) != ESP_OK) {
+            // Serial.println("[AD8232_ECG] Failed to create sample timer.");
+            _sampleTimer = nullptr;
+            return false;
+        }
+    }
+
+    _sampleRateHz = static_cast<uint16_t>(rate);
+    resetSamplingStats();
+
+    // Falls back to one analogRead() per sample if the continuous ADC cannot run at this rate.
+    _oversampling = _source == this && _rawRateHz > 0 && _startContinuous(_sampleRateHz);
+
+    // esp_timer schedules periodic alarms against absolute deadlines, so the
+    // period does not drift even if an individual callback runs late.
+    uint64_t periodUs = 1000000ULL / _sampleRateHz;
+    if (esp_timer_start_periodic(_sampleTimer, periodUs) != ESP_OK) {
+        // Serial.println("[AD8232_ECG] Failed to start sample timer.");
+        stopSampling();
+        _sampleRateHz = 0;
+        return false;
+    }
+    return true;
+}
+
+void AD8232_ECG::stopSampling() {
+    if (_sampleTimer != nullptr && esp_timer_is_active(_sampleTimer)) {
+        esp_timer_stop(_sampleTimer);
+    }
+    if (_oversampling) {
+        adc_continuous_stop(_adc);
+        _oversampling = false;
+    }
+}
+
+bool AD8232_ECG::isSampling() const {
+    return _sampleTimer != nullptr && esp_timer_is_active(_sampleTimer);
 }
 
-bool AD8232_ECG::isSensorConnected() {
+uint16_t AD8232_ECG::getSampleRateHz() const {
+    return _sampleRateHz;
+}
+
+size_t AD8232_ECG::availableSamples() const {
+    return _sampleBuffer.size();
+}
+
+size_t AD8232_ECG::readSamples(ECGSample *out, size_t maxSamples) {
+    return _sampleBuffer.popBulk(out, maxSamples);
+}
+
+AD8232_ECG::SamplingStats AD8232_ECG::getSamplingStats() const {
+    SamplingStats stats;
+    stats.samplesCaptured = _samplesCaptured;
+    stats.samplesDropped = _sampleBuffer.overrunCount();
+    stats.bufferHighWater = _sampleBuffer.highWaterMark();
+    stats.minIntervalUs = (_minIntervalUs == UINT32_MAX) ? 0 : _minIntervalUs;
+    stats.maxIntervalUs = _maxIntervalUs;
+    stats.adcConversions = _adcConversions.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void AD8232_ECG::resetSamplingStats() {
+    _samplesCaptured = 0;
+    _sampleBuffer.resetStats();
+    _minIntervalUs = UINT32_MAX;
+    _maxIntervalUs = 0;
+}
+
+void AD8232_ECG::_onSampleTimer(void *arg) {
+    static_cast<AD8232_ECG *>(arg)->_captureSample();
+}
+
+void AD8232_ECG::_captureSample() {
+    if (_oversampling) {
+        _captureOversampled();
+        return;
+    }
 
+    ECGSample sample;
+    sample.timestampUs = static_cast<uint32_t>(esp_timer_get_time());
+    sample.value = static_cast<uint16_t>(_source->readECG());
+    sample.flags = _source->isSensorConnected() ? 0 : ECG_SAMPLE_FLAG_LEAD_OFF;
+    sample.reserved = 0;
+    _pushSample(sample);
+}
 
-    // We want both to be LOW (connected) for the sensor to be considered "connected".
-    bool loPlusStatus = digitalRead(_loPlusPin);
-    bool loMinusStatus = digitalRead(_loMinusPin);
+void AD8232_ECG::_captureOversampled() {
+    uint32_t length = 0;
+    while (adc_continuous_read(_adc, _adcBuffer, sizeof(_adcBuffer), &length, 0) == ESP_OK && length > 0) {
+        for (uint32_t offset = 0; offset + SOC_ADC_DIGI_RESULT_BYTES <= length; offset += SOC_ADC_DIGI_RESULT_BYTES) {
+            const adc_digi_output_data_t *result = reinterpret_cast<const adc_digi_output_data_t *>(_adcBuffer + offset);
+            uint64_t conversions = ++_adcConversionIndex;
+            _adcConversions.store(static_cast<uint32_t>(conversions), std::memory_order_relaxed);
 
-    // If both are LOW (0), then leads are connected.
-    // If either is HIGH (1), then at least one lead is off.
-    return (loPlusStatus == LOW && loMinusStatus == LOW);
+            int32_t millivoltsQ4;
+            if (!_decimator.push(_calibration.toMillivoltsQ4(AD8232_ADC_RESULT_DATA(result)), millivoltsQ4)) {
+                continue;
+            }
+            // Conversion k completes at start + k / rate; the output describes the signal a filter delay earlier.
+            uint64_t completedUs = _adcStartUs + conversions * 1000000ULL / _rawRateHz;
+
+            ECGSample sample;
+            sample.timestampUs = static_cast<uint32_t>(completedUs - _groupDelayUs);
+            sample.value = ADCCalibration::millivoltsQ4ToCounts(millivoltsQ4);
+            sample.flags = _leadOffState != 0 ? ECG_SAMPLE_FLAG_LEAD_OFF : 0;
+            sample.reserved = 0;
+            _pushSample(sample);
+        }
+    }
 }
 
-int AD8232_ECG::readECG() {
-    return analogRead(_outputPin);
+bool AD8232_ECG::_startContinuous(uint16_t rateHz) {
+    if (_rawRateHz % rateHz != 0 || !_decimator.configure(AD8232_CIC_ORDER, _rawRateHz / rateHz)) {
+        return false;
+    }
+    adc_unit_t unit;
+    adc_channel_t channel;
+    // ADC2 is taken by the WiFi driver
+    if (adc_continuous_io_to_channel(_outputPin, &unit, &channel) != ESP_OK || unit != ADC_UNIT_1) {
+        return false;
+    }
+
+    if (_adc == nullptr) {
+        adc_continuous_handle_cfg_t handleConfig = {};
+        handleConfig.max_store_buf_size = AD8232_ADC_POOL_BYTES;
+        handleConfig.conv_frame_size = AD8232_ADC_READ_BYTES;
+        if (adc_continuous_new_handle(&handleConfig, &_adc) != ESP_OK) {
+            // Serial.println("[AD8232_ECG] Failed to create the continuous ADC driver.");
+            _adc = nullptr;
+            return false;
+        }
+    }
+
+    adc_digi_pattern_config_t pattern = {};
+    pattern.atten = ADC_ATTEN_DB_12;
+    pattern.channel = static_cast<uint8_t>(channel);
+    pattern.unit = static_cast<uint8_t>(unit);
+    pattern.bit_width = ADC_BITWIDTH_12;
+
+    adc_continuous_config_t config = {};
+    config.pattern_num = 1;
+    config.adc_pattern = &pattern;
+    config.sample_freq_hz = _rawRateHz;
+    config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+    config.format = AD8232_ADC_OUTPUT_FORMAT;
+    if (adc_continuous_config(_adc, &config) != ESP_OK || adc_continuous_start(_adc) != ESP_OK) {
+        // Serial.println("[AD8232_ECG] Continuous ADC refused the configuration.");
+        return false;
+    }
+
+    _groupDelayUs = static_cast<uint32_t>(static_cast<uint64_t>(_decimator.getGroupDelayInputs()) * 1000000ULL /
+                                          _rawRateHz);
+    _adcStartUs = static_cast<uint64_t>(esp_timer_get_time());
+    _adcConversionIndex = 0;
+    _adcConversions.store(0, std::memory_order_relaxed);
+    return true;
 }
 
+void AD8232_ECG::_pushSample(const ECGSample &sample) {
+    uint32_t now = sample.timestampUs;
+    if (_samplesCaptured > 0) {
+        uint32_t interval = now - _lastSampleUs;
+        if (interval < _minIntervalUs) {
+            _minIntervalUs = interval;
+        }
+        if (interval > _maxIntervalUs) {
+            _maxIntervalUs = interval;
+        }
+    }
+    _lastSampleUs = now;
+    _samplesCaptured = _samplesCaptured + 1;
+
+    // If the consumer has fallen behind the sample is dropped and counted as an overrun.
+    _sampleBuffer.push(sample);
+}
@@ -0,0 +1,114 @@
+// ADCCalibration.cpp
+// This file implements the methods defined in the ADCCalibration class.
+
+#include "ADCCalibration.h"
+
+#include <esp_adc/adc_cali.h>
+#include <esp_adc/adc_cali_scheme.h>
+#include <esp_adc/adc_continuous.h>
+
+#define ADC_CALIBRATION_MAX_Q4 0xFFFF
+#define ADC_NOMINAL_FULL_SCALE_Q4 (ADC_NOMINAL_FULL_SCALE_MV << ADC_CALIBRATION_FRACTION_BITS)
+
+static uint16_t clampQ4(int32_t value) {
+    if (value < 0) {
+        return 0;
+    }
+    return value > ADC_CALIBRATION_MAX_Q4 ? ADC_CALIBRATION_MAX_Q4 : static_cast<uint16_t>(value);
+}
+
+static int caliRawToMillivolts(int raw, void *context) {
+    int millivolts = 0;
+    adc_cali_raw_to_voltage(static_cast<adc_cali_handle_t>(context), raw, &millivolts);
+    return millivolts;
+}
+
+ADCCalibration::ADCCalibration() {
+    buildNominal();
+}
+
+bool ADCCalibration::begin(uint8_t pin) {
+    adc_unit_t unit;
+    adc_channel_t channel;
+    if (adc_continuous_io_to_channel(pin, &unit, &channel) != ESP_OK) {
+        buildNominal();
+        return false;
+    }
+
+    adc_cali_handle_t handle = nullptr;
+    esp_err_t err = ESP_FAIL;
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+    adc_cali_curve_fitting_config_t config = {};
+    config.unit_id = unit;
+    config.chan = channel;
+    config.atten = ADC_ATTEN_DB_12;
+    config.bitwidth = ADC_BITWIDTH_12;
+    err = adc_cali_create_scheme_curve_fitting(&config, &handle);
+#elif ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+    // No default_vref: chips without eFuse values keep the nominal table.
+    adc_cali_line_fitting_config_t config = {};
+    config.unit_id = unit;
+    config.atten = ADC_ATTEN_DB_12;
+    config.bitwidth = ADC_BITWIDTH_12;
+    err = adc_cali_create_scheme_line_fitting(&config, &handle);
+#endif
+    if (err != ESP_OK) {
+        // Serial.println("[ADCCalibration] No eFuse calibration, using the nominal range.");
+        buildNominal();
+        return false;
+    }
+
+    build(caliRawToMillivolts, handle);
+    _calibrated = true;
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+    adc_cali_delete_scheme_curve_fitting(handle);
+#elif ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+    adc_cali_delete_scheme_line_fitting(handle);
+#endif
+    return true;
+}
+
+void ADCCalibration::build(RawToMillivolts rawToMillivolts, void *context) {
+    int32_t startCode = 0;
+    int32_t startQ4 = clampQ4(rawToMillivolts(0, context) << ADC_CALIBRATION_FRACTION_BITS);
+    _table[0] = static_cast<uint16_t>(startQ4);
+
+    while (startCode < ADC_CALIBRATION_CODES - 1) {
+        int32_t endCode = startCode + ADC_CALIBRATION_KNOT_STEP;
+        if (endCode > ADC_CALIBRATION_CODES - 1) {
+            endCode = ADC_CALIBRATION_CODES - 1;
+        }
+        int32_t endQ4 = clampQ4(rawToMillivolts(endCode, context) << ADC_CALIBRATION_FRACTION_BITS);
+        int32_t span = endCode - startCode;
+        for (int32_t code = startCode + 1; code <= endCode; code++) {
+            // Rounded linear interpolation; the doubled terms keep the rounding symmetric for falling segments.
+            int32_t numerator = 2 * (endQ4 - startQ4) * (code - startCode);
+            int32_t step = (numerator >= 0 ? numerator + span : numerator - span) / (2 * span);
+            _table[code] = clampQ4(startQ4 + step);
+        }
+        startCode = endCode;
+        startQ4 = endQ4;
+    }
+    _calibrated = false;
+}
+
+void ADCCalibration::buildNominal() {
+    for (int32_t code = 0; code < ADC_CALIBRATION_CODES; code++) {
+        _table[code] = static_cast<uint16_t>(
+            (code * ADC_NOMINAL_FULL_SCALE_Q4 + (ADC_CALIBRATION_CODES - 1) / 2) / (ADC_CALIBRATION_CODES - 1));
+    }
+    _calibrated = false;
+}
+
+bool ADCCalibration::isCalibrated() const {
+    return _calibrated;
+}
+
+uint16_t ADCCalibration::millivoltsQ4ToCounts(int32_t millivoltsQ4) {
+    if (millivoltsQ4 <= 0) {
+        return 0;
+    }
+    int32_t counts =
+        (millivoltsQ4 * (ADC_CALIBRATION_CODES - 1) + ADC_NOMINAL_FULL_SCALE_Q4 / 2) / ADC_NOMINAL_FULL_SCALE_Q4;
+    return counts > ADC_CALIBRATION_CODES - 1 ? ADC_CALIBRATION_CODES - 1 : static_cast<uint16_t>(counts);
+}
@@ -0,0 +1,75 @@
+// BurstScheduler.cpp
+// This file implements the methods defined in the BurstScheduler class.
+
+#include "BurstScheduler.h"
+
+BurstScheduler::BurstScheduler() : _intervalMs(0) {
+    reset();
+}
+
+void BurstScheduler::setInterval(uint16_t intervalMs) {
+    _intervalMs = intervalMs;
+    reset();
+}
+
+uint16_t BurstScheduler::getInterval() const {
+    return _intervalMs;
+}
+
+bool BurstScheduler::isEnabled() const {
+    return _intervalMs > 0;
+}
+
+void BurstScheduler::reset() {
+    _started = false;
+    _burstStartUs = 0;
+    _lastBurstUs = 0;
+    _cycleTotalUs = 0;
+    _burstTotalUs = 0;
+    _latencyTotalMs = 0;
+    _stats = {};
+}
+
+bool BurstScheduler::isDue(uint32_t nowUs, uint32_t bufferedMs, uint32_t capacityMs) const {
+    if (_intervalMs == 0 || !_started) {
+        return true;
+    }
+    return nowUs - _burstStartUs >= static_cast<uint32_t>(_intervalMs) * 1000 ||
+           bufferedMs * 100 >= capacityMs * BURST_EARLY_FILL_PERCENT;
+}
+
+void BurstScheduler::beginBurst(uint32_t nowUs, uint32_t oldestAgeUs) {
+    if (_started) {
+        // The previous cycle ends here: its burst and the sleep after it.
+        uint32_t cycleUs = nowUs - _burstStartUs;
+        _cycleTotalUs += cycleUs;
+        _burstTotalUs += _lastBurstUs;
+        _stats.dutyPermille = static_cast<uint16_t>(_burstTotalUs * 1000 / (_cycleTotalUs > 0 ? _cycleTotalUs : 1));
+        _stats.lastDutyPermille = static_cast<uint16_t>(static_cast<uint64_t>(_lastBurstUs) * 1000 / (cycleUs > 0 ? cycleUs : 1));
+        if (cycleUs < static_cast<uint32_t>(_intervalMs) * 1000) {
+            _stats.earlyBursts++;
+        }
+    }
+    _started = true;
+    _burstStartUs = nowUs;
+
+    uint32_t latencyMs = oldestAgeUs / 1000;
+    _latencyTotalMs += latencyMs;
+    if (latencyMs > _stats.maxLatencyMs) {
+        _stats.maxLatencyMs = latencyMs;
+    }
+}
+
+void BurstScheduler::endBurst(uint32_t nowUs) {
+    _lastBurstUs = nowUs - _burstStartUs;
+    _stats.bursts++;
+    _stats.lastBurstUs = _lastBurstUs;
+    if (_lastBurstUs > _stats.maxBurstUs) {
+        _stats.maxBurstUs = _lastBurstUs;
+    }
+    _stats.meanLatencyMs = static_cast<uint32_t>(_latencyTotalMs / _stats.bursts);
+}
+
+BurstScheduler::Stats BurstScheduler::getStats() const {
+    return _stats;
+}
@@ -0,0 +1,95 @@
+// CICDecimator.cpp
+// This file implements the methods defined in the CICDecimator class.
+
+#include "CICDecimator.h"
+
+#include <math.h>
+#include <string.h>
+
+CICDecimator::CICDecimator() {
+    _order = 0;
+    configure(3, 8);
+}
+
+bool CICDecimator::configure(uint8_t order, uint16_t ratio, bool compensate) {
+    if (order < 1 || order > CIC_MAX_ORDER || ratio < 1 || ratio > CIC_MAX_RATIO) {
+        return false;
+    }
+    _order = order;
+    _ratio = ratio;
+    _compensate = compensate;
+
+    _gain = 1;
+    for (uint8_t i = 0; i < order; i++) {
+        _gain *= ratio;
+    }
+
+    // CIC magnitude at a quarter of the output rate: (sin(pi / 4) / (R sin(pi / 4R)))^N.
+    // The compensator [-a, 1 + 2a, -a] has gain 1 + 2a there, so a = (1 / droop - 1) / 2.
+    double droop = pow(sin(M_PI / 4.0) / (ratio * sin(M_PI / (4.0 * ratio))), order);
+    _compensation = static_cast<float>((1.0 / droop - 1.0) / 2.0);
+
+    reset();
+    return true;
+}
+
+void CICDecimator::reset() {
+    memset(_integrators, 0, sizeof(_integrators));
+    memset(_combDelays, 0, sizeof(_combDelays));
+    _history[0] = 0;
+    _history[1] = 0;
+    _phase = 0;
+    // The CIC impulse response spans order outputs, the compensator two more.
+    _warmup = _order + (_compensate ? 2 : 0);
+}
+
+bool CICDecimator::push(int32_t input, int32_t &output) {
+    // Two's complement in modular arithmetic: the integrators overflow on any DC input and
+    // the combs take the overflow out again.
+    uint64_t acc = static_cast<uint64_t>(static_cast<int64_t>(input));
+    for (uint8_t i = 0; i < _order; i++) {
+        _integrators[i] += acc;
+        acc = _integrators[i];
+    }
+    if (++_phase < _ratio) {
+        return false;
+    }
+    _phase = 0;
+
+    for (uint8_t i = 0; i < _order; i++) {
+        uint64_t delayed = _combDelays[i];
+        _combDelays[i] = acc;
+        acc -= delayed;
+    }
+    int64_t value = static_cast<int64_t>(acc);
+    // Round to nearest, also for negative values
+    int32_t cic = static_cast<int32_t>((value >= 0 ? value + _gain / 2 : value - _gain / 2) / _gain);
+
+    int32_t result = cic;
+    if (_compensate) {
+        float mixed = (1.0f + 2.0f * _compensation) * _history[0] - _compensation * (cic + _history[1]);
+        result = static_cast<int32_t>(lroundf(mixed));
+        _history[1] = _history[0];
+        _history[0] = cic;
+    }
+
+    if (_warmup > 0) {
+        _warmup--;
+        return false;
+    }
+    output = result;
+    return true;
+}
+
+uint8_t CICDecimator::getOrder() const {
+    return _order;
+}
+
+uint16_t CICDecimator::getRatio() const {
+    return _ratio;
+}
+
+uint32_t CICDecimator::getGroupDelayInputs() const {
+    // The CIC is symmetric over order * (ratio - 1) + 1 inputs; the compensator adds one output.
+    return static_cast<uint32_t>(_order) * (_ratio - 1) / 2 + (_compensate ? _ratio : 0);
+}
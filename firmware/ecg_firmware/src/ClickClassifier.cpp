@@ -0,0 +1,73 @@
+// ClickClassifier.cpp
+// This file implements the methods defined in the ClickClassifier class.
+
+#include "ClickClassifier.h"
+
+ClickClassifier::ClickClassifier()
+    : _rawPressed(false),
+      _rawChangeMs(0),
+      _pressed(false),
+      _pressMs(0),
+      _releaseMs(0),
+      _clicks(0),
+      _longPressSent(false) {}
+
+void ClickClassifier::edge(bool pressed, uint32_t timeMs) {
+    // The previous level may have settled before this edge arrived.
+    settle(timeMs);
+    _rawPressed = pressed;
+    _rawChangeMs = timeMs;
+}
+
+void ClickClassifier::poll(uint32_t nowMs) {
+    settle(nowMs);
+
+    if (_pressed && !_longPressSent && nowMs - _pressMs >= LONG_PRESS_MS) {
+        _longPressSent = true;
+        _clicks = 0;
+        _events.push(ButtonEvent::LongPress);
+    }
+    if (!_pressed && _clicks > 0 && nowMs - _releaseMs >= MULTI_CLICK_TIMEOUT_MS) {
+        if (_clicks == 1) {
+            _events.push(ButtonEvent::SingleClick);
+        } else if (_clicks == 2) {
+            _events.push(ButtonEvent::DoubleClick);
+        }
+        _clicks = 0;
+    }
+}
+
+ButtonEvent ClickClassifier::takeEvent() {
+    ButtonEvent event;
+    return _events.pop(event) ? event : ButtonEvent::None;
+}
+
+bool ClickClassifier::isPressed() const {
+    return _pressed;
+}
+
+void ClickClassifier::settle(uint32_t nowMs) {
+    if (_rawPressed != _pressed && nowMs - _rawChangeMs >= CLICK_DEBOUNCE_MS) {
+        // The change happened at the first edge of the stable level, not when it settled.
+        onLevel(_rawPressed, _rawChangeMs);
+    }
+}
+
+void ClickClassifier::onLevel(bool pressed, uint32_t timeMs) {
+    _pressed = pressed;
+    if (pressed) {
+        _pressMs = timeMs;
+        _longPressSent = false;
+        return;
+    }
+    if (!_longPressSent && timeMs - _pressMs >= LONG_PRESS_MS) {
+        // Held long enough, but released before a poll() could report it
+        _clicks = 0;
+        _events.push(ButtonEvent::LongPress);
+    } else if (!_longPressSent) {
+        if (_clicks < UINT8_MAX) {
+            _clicks++;
+        }
+        _releaseMs = timeMs;
+    }
+}
@@ -0,0 +1,98 @@
+// DeviceCommand.cpp
+// This file implements the command parsing declared in DeviceCommand.h.
+
+#include "DeviceCommand.h"
+
+// Indexed by DeviceCommandType
+static const char *const kCommandNames[] = {"stream", "batch", "acquisition", "unknown"};
+static const char *const kStreamModeNames[] = {"full", "preview", "off"};
+
+// Reads an optional 16-bit field, setting bit in command.fields when present.
+template <typename TField>
+static bool readNumber(TField field, uint16_t &dest, uint16_t bit, DeviceCommand &command) {
+    if (field.isNull()) {
+        return true;
+    }
+    if (!field.template is<uint16_t>()) {
+        return false;
+    }
+    dest = field.template as<uint16_t>();
+    command.fields |= bit;
+    return true;
+}
+
+// Reads an optional boolean field, setting bit in command.fields when present.
+template <typename TField>
+static bool readFlag(TField field, bool &dest, uint16_t bit, DeviceCommand &command) {
+    if (field.isNull()) {
+        return true;
+    }
+    if (!field.template is<bool>()) {
+        return false;
+    }
+    dest = field.template as<bool>();
+    command.fields |= bit;
+    return true;
+}
+
+const char *parseDeviceCommand(JsonDocument &doc, DeviceCommand &command) {
+    command = {};
+    command.seq = doc["seq"].as<uint32_t>();
+    command.type = DeviceCommandType::Unknown;
+    const char *name = doc["name"];
+    for (uint8_t i = 0; name != nullptr && i < static_cast<uint8_t>(DeviceCommandType::Unknown); i++) {
+        if (strcmp(name, kCommandNames[i]) == 0) {
+            command.type = static_cast<DeviceCommandType>(i);
+        }
+    }
+
+    switch (command.type) {
+    case DeviceCommandType::Stream: {
+        const char *mode = doc["mode"];
+        for (uint8_t i = 0; mode != nullptr && i < sizeof(kStreamModeNames) / sizeof(kStreamModeNames[0]); i++) {
+            if (strcmp(mode, kStreamModeNames[i]) == 0) {
+                command.mode = static_cast<StreamMode>(i);
+                return nullptr;
+            }
+        }
+        return "Mode must be full, preview or off";
+    }
+    case DeviceCommandType::Batch:
+        if (!readNumber(doc["samples"], command.batchSamples, DEVICE_COMMAND_BATCH_SAMPLES, command) ||
+            !readNumber(doc["delay_ms"], command.batchDelayMs, DEVICE_COMMAND_BATCH_DELAY, command)) {
+            return "Batch samples and delay must be numbers";
+        }
+        if (!readFlag(doc["compress"], command.compress, DEVICE_COMMAND_COMPRESS, command)) {
+            return "Compression must be true or false";
+        }
+        break;
+    case DeviceCommandType::Acquisition: {
+        uint16_t mains = 0;
+        if (!readNumber(doc["sample_rate_hz"], command.sampleRateHz, DEVICE_COMMAND_SAMPLE_RATE, command) ||
+            !readNumber(doc["mains_hz"], mains, DEVICE_COMMAND_MAINS, command)) {
+            return "Sample rate and mains frequency must be numbers";
+        }
+        if ((command.fields & DEVICE_COMMAND_MAINS) && mains != 50 && mains != 60) {
+            return "Mains frequency must be 50 or 60 Hz";
+        }
+        command.mainsHz = static_cast<uint8_t>(mains);
+        if (!readFlag(doc["high_pass"], command.highPass, DEVICE_COMMAND_HIGH_PASS, command) ||
+            !readFlag(doc["notch"], command.notch, DEVICE_COMMAND_NOTCH, command) ||
+            !readFlag(doc["low_pass"], command.lowPass, DEVICE_COMMAND_LOW_PASS, command)) {
+            return "Filter stages must be true or false";
+        }
+        break;
+    }
+    case DeviceCommandType::Unknown:
+        return "Unknown command";
+    }
+    return command.fields != 0 ? nullptr : "No parameters given";
+}
+
+const char *deviceCommandName(DeviceCommandType type) {
+    return kCommandNames[static_cast<uint8_t>(type)];
+}
+
+const char *streamModeName(StreamMode mode) {
+    return kStreamModeNames[static_cast<uint8_t>(mode)];
+}
@@ -0,0 +1,180 @@
+// DeviceSettings.cpp
+// This file implements the methods defined in the DeviceSettings class.
+
+#include "DeviceSettings.h"
+#include "BurstScheduler.h"
+#include "ECGFrame.h"
+#include <esp_mac.h>
+
+// Copies a stored string into a fixed field; false if it does not fit.
+static bool copyField(char *dest, size_t size, const String &value) {
+    if (value.length() >= size) {
+        dest[0] = '\0';
+        return false;
+    }
+    memcpy(dest, value.c_str(), value.length() + 1);
+    return true;
+}
+
+static bool isIdChar(char c) {
+    return isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == '.';
+}
+
+static bool isHostChar(char c) {
+    return isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '.';
+}
+
+DeviceSettings::DeviceSettings(PersistentConfig &config)
+    : _config(config), _active{}, _stored{}, _defaultDeviceId{}, _streamPath{} {}
+
+void DeviceSettings::begin(const DeviceSettingsValues &defaults) {
+    // The factory MAC is read from eFuse, so it is known before WiFi starts.
+    uint8_t mac[6] = {};
+    esp_efuse_mac_get_default(mac);
+    snprintf(_defaultDeviceId, sizeof(_defaultDeviceId), DEVICE_ID_MAC_PREFIX "%02x%02x%02x", mac[3], mac[4], mac[5]);
+
+    // Open the DEVICE_SETTINGS namespace once and load every setting into RAM.
+    _config.begin();
+    _config.addString(CONFIG_KEY_DEVICE_ID, "");
+    _config.addString(CONFIG_KEY_SERVER_HOST, defaults.serverHost);
+    _config.addUInt(CONFIG_KEY_SERVER_PORT, defaults.serverPort);
+    _config.addString(CONFIG_KEY_SERVER_PATH, defaults.serverPath);
+    _config.addUInt(CONFIG_KEY_SAMPLE_RATE, defaults.sampleRateHz);
+    _config.addUInt(CONFIG_KEY_BATCH_SAMPLES, defaults.batchSamples);
+    _config.addUInt(CONFIG_KEY_BATCH_DELAY, defaults.batchDelayMs);
+    _config.addUInt(CONFIG_KEY_COMPRESS, defaults.compress ? 1 : 0);
+    _config.addUInt(CONFIG_KEY_BURST_INTERVAL, defaults.burstIntervalMs);
+    _load();
+
+    if (validate(_stored) == nullptr) {
+        _active = _stored;
+    } else {
+        // Serial.println("[DeviceSettings] Stored settings are invalid, using the defaults.");
+        _active = defaults;
+        _active.deviceId[0] = '\0';
+    }
+    if (_active.deviceId[0] == '\0') {
+        memcpy(_active.deviceId, _defaultDeviceId, sizeof(_defaultDeviceId));
+    }
+    snprintf(_streamPath, sizeof(_streamPath), "%s?device_id=%s", _active.serverPath, _active.deviceId);
+}
+
+const DeviceSettingsValues &DeviceSettings::active() const {
+    return _active;
+}
+
+const DeviceSettingsValues &DeviceSettings::stored() const {
+    return _stored;
+}
+
+const char *DeviceSettings::getDefaultDeviceId() const {
+    return _defaultDeviceId;
+}
+
+ECGSampleRate DeviceSettings::getSampleRate() const {
+    return static_cast<ECGSampleRate>(_active.sampleRateHz);
+}
+
+const char *DeviceSettings::getStreamPath() const {
+    return _streamPath;
+}
+
+const char *DeviceSettings::validate(const DeviceSettingsValues &values) {
+    size_t idLength = strnlen(values.deviceId, sizeof(values.deviceId));
+    if (idLength > DEVICE_ID_MAX_LENGTH) {
+        return "Device ID is too long";
+    }
+    for (size_t i = 0; i < idLength; i++) {
+        if (!isIdChar(values.deviceId[i])) {
+            return "Device ID may only contain letters, digits, '-', '_' and '.'";
+        }
+    }
+
+    size_t hostLength = strnlen(values.serverHost, sizeof(values.serverHost));
+    if (hostLength == 0 || hostLength > SERVER_HOST_MAX_LENGTH) {
+        return "Server host must be 1 to 63 characters";
+    }
+    for (size_t i = 0; i < hostLength; i++) {
+        if (!isHostChar(values.serverHost[i])) {
+            return "Server host must be a host name or IPv4 address";
+        }
+    }
+    if (values.serverPort == 0) {
+        return "Server port must be 1 to 65535";
+    }
+
+    size_t pathLength = strnlen(values.serverPath, sizeof(values.serverPath));
+    if (pathLength == 0 || pathLength > SERVER_PATH_MAX_LENGTH || values.serverPath[0] != '/') {
+        return "Server path must start with '/' and be at most 63 characters";
+    }
+    for (size_t i = 0; i < pathLength; i++) {
+        char c = values.serverPath[i];
+        if (c <= ' ' || c > '~' || c == '?' || c == '#') {
+            return "Server path may not contain spaces, '?' or '#'";
+        }
+    }
+
+    switch (static_cast<ECGSampleRate>(values.sampleRateHz)) {
+    case ECGSampleRate::Hz125:
+    case ECGSampleRate::Hz250:
+    case ECGSampleRate::Hz500:
+    case ECGSampleRate::Hz1000:
+        break;
+    default:
+        return "Sample rate must be 125, 250, 500 or 1000 Hz";
+    }
+    if (values.batchSamples == 0 || values.batchSamples > ECG_FRAME_MAX_SAMPLES) {
+        return "Batch size must be 1 to 250 samples";
+    }
+    if (values.batchDelayMs > BATCH_DELAY_MAX_MS) {
+        return "Batch delay must be at most 5000 ms";
+    }
+    if (values.burstIntervalMs != 0 &&
+        (values.burstIntervalMs < BURST_INTERVAL_MIN_MS || values.burstIntervalMs > BURST_INTERVAL_MAX_MS)) {
+        return "Burst interval must be 0 (off) or 100 to 5000 ms";
+    }
+    return nullptr;
+}
+
+const char *DeviceSettings::save(const DeviceSettingsValues &values) {
+    const char *error = validate(values);
+    if (error != nullptr) {
+        return error;
+    }
+    _config.setString(CONFIG_KEY_DEVICE_ID, values.deviceId);
+    _config.setString(CONFIG_KEY_SERVER_HOST, values.serverHost);
+    _config.setUInt(CONFIG_KEY_SERVER_PORT, values.serverPort);
+    _config.setString(CONFIG_KEY_SERVER_PATH, values.serverPath);
+    _config.setUInt(CONFIG_KEY_SAMPLE_RATE, values.sampleRateHz);
+    _config.setUInt(CONFIG_KEY_BATCH_SAMPLES, values.batchSamples);
+    _config.setUInt(CONFIG_KEY_BATCH_DELAY, values.batchDelayMs);
+    _config.setUInt(CONFIG_KEY_COMPRESS, values.compress ? 1 : 0);
+    _config.setUInt(CONFIG_KEY_BURST_INTERVAL, values.burstIntervalMs);
+    // Settings come from the user and a restart follows; don't leave them to the commit delay
+    if (!_config.commit()) {
+        return "Settings could not be written to flash";
+    }
+    _load();
+    return nullptr;
+}
+
+void DeviceSettings::_load() {
+    bool fits = copyField(_stored.deviceId, sizeof(_stored.deviceId), _config.getString(CONFIG_KEY_DEVICE_ID));
+    fits = copyField(_stored.serverHost, sizeof(_stored.serverHost), _config.getString(CONFIG_KEY_SERVER_HOST)) && fits;
+    fits = copyField(_stored.serverPath, sizeof(_stored.serverPath), _config.getString(CONFIG_KEY_SERVER_PATH)) && fits;
+    uint32_t port = _config.getUInt(CONFIG_KEY_SERVER_PORT);
+    uint32_t rate = _config.getUInt(CONFIG_KEY_SAMPLE_RATE);
+    uint32_t batch = _config.getUInt(CONFIG_KEY_BATCH_SAMPLES);
+    uint32_t delayMs = _config.getUInt(CONFIG_KEY_BATCH_DELAY);
+    uint32_t burstMs = _config.getUInt(CONFIG_KEY_BURST_INTERVAL);
+    // Out-of-range numbers become 0, which validate() rejects (or, for the delay, the maximum + 1)
+    _stored.serverPort = port <= UINT16_MAX ? port : 0;
+    _stored.sampleRateHz = rate <= UINT16_MAX ? rate : 0;
+    _stored.batchSamples = batch <= UINT16_MAX ? batch : 0;
+    _stored.batchDelayMs = delayMs <= BATCH_DELAY_MAX_MS ? delayMs : BATCH_DELAY_MAX_MS + 1;
+    _stored.compress = _config.getUInt(CONFIG_KEY_COMPRESS) != 0;
+    _stored.burstIntervalMs = burstMs <= BURST_INTERVAL_MAX_MS ? burstMs : BURST_INTERVAL_MAX_MS + 1;
+    if (!fits) {
+        _stored.serverHost[0] = '\0'; // Makes validate() reject the set
+    }
+}
@@ -0,0 +1,69 @@
+// ECGCodec.cpp
+// This file implements the methods defined in the ECGDeltaEncoder and ECGDeltaDecoder classes.
+
+#include "ECGCodec.h"
+
+#include <string.h>
+
+size_t ECGDeltaEncoder::encode(uint16_t value, uint8_t *out) {
+    int32_t delta = static_cast<int32_t>(value) - static_cast<int32_t>(_previous);
+    _previous = value;
+
+    // Zigzag: move the sign bit to bit 0 so small magnitudes become small unsigned values.
+    uint32_t zigzag = (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31);
+
+    size_t n = 0;
+    while (zigzag >= 0x80) {
+        out[n++] = static_cast<uint8_t>(zigzag | 0x80);
+        zigzag >>= 7;
+    }
+    out[n++] = static_cast<uint8_t>(zigzag);
+    return n;
+}
+
+size_t ECGDeltaEncoder::encodeBlock(const uint16_t *values, size_t count, uint8_t *out, size_t capacity) {
+    size_t written = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (capacity - written >= ECG_CODEC_MAX_BYTES_PER_VALUE) {
+            written += encode(values[i], out + written);
+            continue;
+        }
+        // Near the end of the buffer: encode to scratch space and copy only if it fits.
+        uint8_t scratch[ECG_CODEC_MAX_BYTES_PER_VALUE];
+        size_t n = encode(values[i], scratch);
+        if (n > capacity - written) {
+            return 0;
+        }
+        memcpy(out + written, scratch, n);
+        written += n;
+    }
+    return written;
+}
+
+size_t ECGDeltaDecoder::decode(const uint8_t *in, size_t length, uint16_t &value) {
+    uint32_t zigzag = 0;
+    size_t n = 0;
+    for (unsigned shift = 0; n < length && n < ECG_CODEC_MAX_BYTES_PER_VALUE; shift += 7) {
+        uint8_t byte = in[n++];
+        zigzag |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            int32_t delta = static_cast<int32_t>(zigzag >> 1) ^ -static_cast<int32_t>(zigzag & 1);
+            _previous = static_cast<uint16_t>(_previous + delta);
+            value = _previous;
+            return n;
+        }
+    }
+    return 0;
+}
+
+size_t ECGDeltaDecoder::decodeBlock(const uint8_t *in, size_t length, uint16_t *values, size_t count) {
+    size_t consumed = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t n = decode(in + consumed, length - consumed, values[i]);
+        if (n == 0) {
+            return 0;
+        }
+        consumed += n;
+    }
+    return consumed;
+}
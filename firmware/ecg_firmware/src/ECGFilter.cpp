@@ -0,0 +1,180 @@
+// ECGFilter.cpp
+// This file implements the methods defined in the ECGFilter class.
+
+#include "ECGFilter.h"
+
+#include <string.h>
+
+// --- Compile-time filter design ---
+// std::sin/std::cos are not constexpr, so the RBJ designs use a small Taylor-series implementation.
+
+static constexpr double kPi = 3.14159265358979323846;
+
+static constexpr double reduceAngle(double x) {
+    while (x > kPi) {
+        x -= 2.0 * kPi;
+    }
+    while (x < -kPi) {
+        x += 2.0 * kPi;
+    }
+    return x;
+}
+
+static constexpr double constexprSin(double x) {
+    x = reduceAngle(x);
+    double term = x;
+    double sum = x;
+    for (int n = 1; n < 20; n++) {
+        term *= -x * x / ((2.0 * n) * (2.0 * n + 1.0));
+        sum += term;
+    }
+    return sum;
+}
+
+static constexpr double constexprCos(double x) {
+    return constexprSin(x + kPi / 2.0);
+}
+
+static constexpr int32_t toFixed(double v) {
+    return static_cast<int32_t>(v * (1LL << ECG_FILTER_COEFF_SHIFT) + (v >= 0 ? 0.5 : -0.5));
+}
+
+static constexpr BiquadCoefficients normalise(double b0, double b1, double b2, double a0, double a1, double a2) {
+    return BiquadCoefficients{toFixed(b0 / a0), toFixed(b1 / a0), toFixed(b2 / a0), toFixed(a1 / a0), toFixed(a2 / a0)};
+}
+
+static constexpr BiquadCoefficients designHighPass(double fs, double fc, double q) {
+    double w = 2.0 * kPi * fc / fs;
+    double cw = constexprCos(w);
+    double alpha = constexprSin(w) / (2.0 * q);
+    return normalise((1.0 + cw) / 2.0, -(1.0 + cw), (1.0 + cw) / 2.0, 1.0 + alpha, -2.0 * cw, 1.0 - alpha);
+}
+
+static constexpr BiquadCoefficients designLowPass(double fs, double fc, double q) {
+    double w = 2.0 * kPi * fc / fs;
+    double cw = constexprCos(w);
+    double alpha = constexprSin(w) / (2.0 * q);
+    return normalise((1.0 - cw) / 2.0, 1.0 - cw, (1.0 - cw) / 2.0, 1.0 + alpha, -2.0 * cw, 1.0 - alpha);
+}
+
+static constexpr BiquadCoefficients designNotch(double fs, double f0, double q) {
+    double w = 2.0 * kPi * f0 / fs;
+    double cw = constexprCos(w);
+    double alpha = constexprSin(w) / (2.0 * q);
+    return normalise(1.0, -2.0 * cw, 1.0, 1.0 + alpha, -2.0 * cw, 1.0 - alpha);
+}
+
+static constexpr double kButterworthQ = 0.70710678118654752;
+static constexpr double kNotchQ = 30.0; // ~1.7 Hz wide at 50 Hz
+
+struct FilterBankDesign {
+    BiquadCoefficients stages[3]; // High-pass, notch, low-pass
+};
+
+static constexpr FilterBankDesign designBank(double fs, double mains) {
+    return FilterBankDesign{{
+        designHighPass(fs, ECG_FILTER_HIGH_PASS_HZ, kButterworthQ),
+        designNotch(fs, mains, kNotchQ),
+        designLowPass(fs, ECG_FILTER_LOW_PASS_HZ, kButterworthQ),
+    }};
+}
+
+// Indexed by [sample rate][mains]: rates 125/250/500/1000 Hz, mains 50/60 Hz.
+static constexpr FilterBankDesign kFilterBanks[4][2] = {
+    {designBank(125.0, 50.0), designBank(125.0, 60.0)},
+    {designBank(250.0, 50.0), designBank(250.0, 60.0)},
+    {designBank(500.0, 50.0), designBank(500.0, 60.0)},
+    {designBank(1000.0, 50.0), designBank(1000.0, 60.0)},
+};
+
+// The notch zeros must sit on the unit circle (b0 == b2) and the high-pass must block DC.
+static_assert(kFilterBanks[0][0].stages[1].b0 == kFilterBanks[0][0].stages[1].b2, "notch design is not symmetric");
+static_assert(kFilterBanks[3][0].stages[0].b0 + kFilterBanks[3][0].stages[0].b1 + kFilterBanks[3][0].stages[0].b2 <= 1 &&
+              kFilterBanks[3][0].stages[0].b0 + kFilterBanks[3][0].stages[0].b1 + kFilterBanks[3][0].stages[0].b2 >= -1,
+              "high-pass design does not block DC");
+
+// --- ECGFilter ---
+
+ECGFilter::ECGFilter() {
+    for (uint8_t i = 0; i < kStageCount; i++) {
+        _stageEnabled[i] = true;
+    }
+    configure(ECGSampleRate::Hz125, MainsFrequency::Hz50);
+}
+
+void ECGFilter::configure(ECGSampleRate rate, MainsFrequency mains) {
+    int rateIndex;
+    switch (rate) {
+        case ECGSampleRate::Hz250:
+            rateIndex = 1;
+            break;
+        case ECGSampleRate::Hz500:
+            rateIndex = 2;
+            break;
+        case ECGSampleRate::Hz1000:
+            rateIndex = 3;
+            break;
+        case ECGSampleRate::Hz125:
+        default:
+            rateIndex = 0;
+            break;
+    }
+    int mainsIndex = (mains == MainsFrequency::Hz60) ? 1 : 0;
+    _coefficients = kFilterBanks[rateIndex][mainsIndex].stages;
+    clear();
+}
+
+void ECGFilter::setStages(bool highPass, bool notch, bool lowPass) {
+    _stageEnabled[0] = highPass;
+    _stageEnabled[1] = notch;
+    _stageEnabled[2] = lowPass;
+}
+
+int ECGFilter::filter(int rawValue) {
+    int32_t x = static_cast<int32_t>(rawValue - ECG_FILTER_ADC_MIDSCALE) * (1 << ECG_FILTER_INPUT_SHIFT);
+
+    for (uint8_t i = 0; i < kStageCount; i++) {
+        if (_stageEnabled[i]) {
+            x = _processStage(_coefficients[i], _state[i], x);
+        }
+    }
+
+    // Round back to ADC counts and re-centre.
+    int32_t out = ((x + (1 << (ECG_FILTER_INPUT_SHIFT - 1))) >> ECG_FILTER_INPUT_SHIFT) + ECG_FILTER_ADC_MIDSCALE;
+    if (out < 0) {
+        out = 0;
+    } else if (out > ECG_FILTER_ADC_MAX) {
+        out = ECG_FILTER_ADC_MAX;
+    }
+    return out;
+}
+
+void ECGFilter::filterSamples(ECGSample *samples, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        samples[i].value = static_cast<uint16_t>(filter(samples[i].value));
+    }
+}
+
+void ECGFilter::clear() {
+    memset(_state, 0, sizeof(_state));
+}
+
+int32_t ECGFilter::_processStage(const BiquadCoefficients &c, BiquadState &s, int32_t x) {
+    int64_t acc = s.error;
+    acc += static_cast<int64_t>(c.b0) * x;
+    acc += static_cast<int64_t>(c.b1) * s.x1;
+    acc += static_cast<int64_t>(c.b2) * s.x2;
+    acc -= static_cast<int64_t>(c.a1) * s.y1;
+    acc -= static_cast<int64_t>(c.a2) * s.y2;
+
+    int32_t y = static_cast<int32_t>(acc >> ECG_FILTER_COEFF_SHIFT);
+    // Keep the truncated fraction and feed it back next time; this removes the DC bias and
+    // limit cycles that plain truncation causes in low-frequency sections.
+    s.error = acc - static_cast<int64_t>(y) * (int64_t{1} << ECG_FILTER_COEFF_SHIFT);
+
+    s.x2 = s.x1;
+    s.x1 = x;
+    s.y2 = s.y1;
+    s.y1 = y;
+    return y;
+}
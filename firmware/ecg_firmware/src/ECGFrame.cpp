@@ -0,0 +1,288 @@
+// ECGFrame.cpp
+// This file implements the encoding and decoding helpers declared in ECGFrame.h.
+
+#include "ECGFrame.h"
+
+#include <string.h>
+
+static inline void writeU16(uint8_t *p, uint16_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+}
+
+static inline void writeU32(uint8_t *p, uint32_t v) {
+    writeU16(p, static_cast<uint16_t>(v));
+    writeU16(p + 2, static_cast<uint16_t>(v >> 16));
+}
+
+static inline void writeU64(uint8_t *p, uint64_t v) {
+    writeU32(p, static_cast<uint32_t>(v));
+    writeU32(p + 4, static_cast<uint32_t>(v >> 32));
+}
+
+static inline uint16_t readU16(const uint8_t *p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t readU32(const uint8_t *p) {
+    return readU16(p) | (static_cast<uint32_t>(readU16(p + 2)) << 16);
+}
+
+static inline uint64_t readU64(const uint8_t *p) {
+    return readU32(p) | (static_cast<uint64_t>(readU32(p + 4)) << 32);
+}
+
+static void writeHeader(const ECGFrameHeader &header, uint8_t *out) {
+    out[0] = ECG_FRAME_VERSION;
+    out[1] = header.type;
+    out[2] = header.flags;
+    out[3] = header.channels;
+    writeU32(out + 4, header.sequence);
+    writeU64(out + 8, header.startTimeUs);
+    writeU16(out + 16, header.sampleRateHz);
+    writeU16(out + 18, header.sampleCount);
+}
+
+/**
+ * @brief Returns the room the trailers of a frame may take.
+ */
+static size_t trailerCapacity(const ECGFrameHeader &header, const ECGHeartRate *heartRate) {
+    size_t size = (header.flags & ECG_FRAME_FLAG_SEND_TIME) ? 4 : 0;
+    if (heartRate) {
+        size += 5 + ECG_FRAME_MAX_BEATS;
+        if (heartRate->earlierBeatCount > 0) {
+            size += 1 + 4 * static_cast<size_t>(heartRate->earlierBeatCount);
+        }
+    }
+    return size;
+}
+
+/**
+ * @brief Sets or clears the heart-rate and earlier-beats flags for the trailers to write.
+ */
+static void setTrailerFlags(ECGFrameHeader &header, const ECGHeartRate *heartRate) {
+    header.flags = heartRate ? (header.flags | ECG_FRAME_FLAG_HEART_RATE)
+                             : (header.flags & ~ECG_FRAME_FLAG_HEART_RATE);
+    header.flags = heartRate && heartRate->earlierBeatCount > 0 ? (header.flags | ECG_FRAME_FLAG_EARLIER_BEATS)
+                                                                : (header.flags & ~ECG_FRAME_FLAG_EARLIER_BEATS);
+}
+
+/**
+ * @brief Writes the heart-rate, earlier-beats and send-time trailers selected by the header flags.
+ * @return The position just past the trailers.
+ */
+template <typename Sample>
+static uint8_t *writeTrailers(const ECGFrameHeader &header, const Sample *samples, size_t count,
+                              const ECGHeartRate *heartRate, uint8_t *p) {
+    if (heartRate) {
+        writeU16(p, heartRate->bpmX10);
+        writeU16(p + 2, heartRate->rrIntervalMs);
+        uint8_t *beatCount = p + 4;
+        p += 5;
+        *beatCount = 0;
+        for (size_t i = 0; i < count && *beatCount < ECG_FRAME_MAX_BEATS; i++) {
+            if (samples[i].flags & ECG_SAMPLE_FLAG_BEAT) {
+                *p++ = static_cast<uint8_t>(i);
+                (*beatCount)++;
+            }
+        }
+    }
+
+    if (header.flags & ECG_FRAME_FLAG_EARLIER_BEATS) {
+        *p++ = heartRate->earlierBeatCount;
+        for (uint8_t i = 0; i < heartRate->earlierBeatCount; i++) {
+            // Sample timestamps wrap, so the difference is taken on their 32 bits.
+            writeU32(p, samples[0].timestampUs - heartRate->earlierBeatsUs[i]);
+            p += 4;
+        }
+    }
+
+    if (header.flags & ECG_FRAME_FLAG_SEND_TIME) {
+        writeU32(p, header.sendDelayUs);
+        p += 4;
+    }
+    return p;
+}
+
+size_t encodeECGFrame(ECGFrameHeader &header, const ECGSample *samples, size_t count,
+                      uint8_t *out, size_t capacity, const ECGHeartRate *heartRate) {
+    if (count == 0 || count > ECG_FRAME_MAX_SAMPLES) {
+        return 0;
+    }
+
+    bool anyLeadOff = false;
+    for (size_t i = 0; i < count; i++) {
+        if (samples[i].flags & ECG_SAMPLE_FLAG_LEAD_OFF) {
+            anyLeadOff = true;
+            break;
+        }
+    }
+
+    bool compressed = (header.flags & ECG_FRAME_FLAG_DELTA_VARINT) != 0;
+    size_t bitmapSize = anyLeadOff ? (count + 7) / 8 : 0;
+    size_t trailerSize = trailerCapacity(header, heartRate);
+    size_t worstCase = ECG_FRAME_HEADER_SIZE + count * (compressed ? ECG_CODEC_MAX_BYTES_PER_VALUE : 2) +
+                       bitmapSize + trailerSize;
+    if (worstCase > capacity) {
+        return 0;
+    }
+
+    header.sampleCount = static_cast<uint16_t>(count);
+    header.channels = 0;
+    header.flags = anyLeadOff ? (header.flags | ECG_FRAME_FLAG_LEAD_OFF)
+                              : (header.flags & ~ECG_FRAME_FLAG_LEAD_OFF);
+    setTrailerFlags(header, heartRate);
+
+    writeHeader(header, out);
+
+    uint8_t *p = out + ECG_FRAME_HEADER_SIZE;
+    if (compressed) {
+        // A fresh predictor per frame keeps every frame independently decodable.
+        ECGDeltaEncoder encoder;
+        for (size_t i = 0; i < count; i++) {
+            p += encoder.encode(samples[i].value, p);
+        }
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            writeU16(p, samples[i].value);
+            p += 2;
+        }
+    }
+
+    if (anyLeadOff) {
+        memset(p, 0, bitmapSize);
+        for (size_t i = 0; i < count; i++) {
+            if (samples[i].flags & ECG_SAMPLE_FLAG_LEAD_OFF) {
+                p[i >> 3] |= static_cast<uint8_t>(1u << (i & 7));
+            }
+        }
+        p += bitmapSize;
+    }
+
+    p = writeTrailers(header, samples, count, heartRate, p);
+    return static_cast<size_t>(p - out);
+}
+
+size_t encodeECGMultiFrame(ECGFrameHeader &header, const ECGMultiSample *samples, size_t count, uint8_t channels,
+                           uint8_t *out, size_t capacity, const ECGHeartRate *heartRate) {
+    if (count == 0 || count > ECG_FRAME_MAX_SAMPLES || channels == 0 || channels > ECG_MAX_CHANNELS) {
+        return 0;
+    }
+
+    uint8_t leadOffMask = 0;
+    for (size_t i = 0; i < count; i++) {
+        leadOffMask |= samples[i].leadOffMask;
+    }
+
+    bool compressed = (header.flags & ECG_FRAME_FLAG_DELTA_VARINT) != 0;
+    size_t bitmapSize = leadOffMask != 0 ? (count + 7) / 8 : 0;
+    size_t trailerSize = trailerCapacity(header, heartRate);
+    size_t worstCase = ECG_FRAME_HEADER_SIZE +
+                       channels * (count * (compressed ? ECG_CODEC_MAX_BYTES_PER_VALUE : 2) + bitmapSize) + trailerSize;
+    if (worstCase > capacity) {
+        return 0;
+    }
+
+    header.type = ECG_FRAME_TYPE_MULTI_SAMPLES;
+    header.channels = channels;
+    header.sampleCount = static_cast<uint16_t>(count);
+    header.flags = leadOffMask != 0 ? (header.flags | ECG_FRAME_FLAG_LEAD_OFF)
+                                    : (header.flags & ~ECG_FRAME_FLAG_LEAD_OFF);
+    setTrailerFlags(header, heartRate);
+
+    writeHeader(header, out);
+
+    // One block per channel: the samples are interleaved in memory, the frame is not.
+    uint8_t *p = out + ECG_FRAME_HEADER_SIZE;
+    for (uint8_t c = 0; c < channels; c++) {
+        if (compressed) {
+            ECGDeltaEncoder encoder;
+            for (size_t i = 0; i < count; i++) {
+                p += encoder.encode(samples[i].values[c], p);
+            }
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                writeU16(p, samples[i].values[c]);
+                p += 2;
+            }
+        }
+    }
+
+    if (leadOffMask != 0) {
+        memset(p, 0, channels * bitmapSize);
+        for (uint8_t c = 0; c < channels; c++) {
+            for (size_t i = 0; i < count; i++) {
+                if (samples[i].leadOffMask & (1u << c)) {
+                    p[i >> 3] |= static_cast<uint8_t>(1u << (i & 7));
+                }
+            }
+            p += bitmapSize;
+        }
+    }
+
+    p = writeTrailers(header, samples, count, heartRate, p);
+    return static_cast<size_t>(p - out);
+}
+
+size_t encodeECGLeadEvent(ECGFrameHeader &header, bool leadOff, uint8_t *out, size_t capacity) {
+    bool sendTime = (header.flags & ECG_FRAME_FLAG_SEND_TIME) != 0;
+    size_t length = ECG_FRAME_HEADER_SIZE + (sendTime ? 4 : 0);
+    if (length > capacity) {
+        return 0;
+    }
+
+    header.type = ECG_FRAME_TYPE_LEAD_EVENT;
+    header.sampleCount = 0;
+    header.channels = 0;
+    header.flags = leadOff ? (header.flags | ECG_FRAME_FLAG_LEAD_OFF)
+                           : (header.flags & ~ECG_FRAME_FLAG_LEAD_OFF);
+    writeHeader(header, out);
+    if (sendTime) {
+        writeU32(out + ECG_FRAME_HEADER_SIZE, header.sendDelayUs);
+    }
+    return length;
+}
+
+template <typename Sample>
+static bool markBeat(Sample *samples, size_t count, uint32_t beatTimeUs) {
+    for (size_t i = count; i > 0; i--) {
+        // Sample timestamps wrap, so they are compared by their difference.
+        if (static_cast<int32_t>(beatTimeUs - samples[i - 1].timestampUs) >= 0) {
+            samples[i - 1].flags |= ECG_SAMPLE_FLAG_BEAT;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool markECGBeat(ECGSample *samples, size_t count, uint32_t beatTimeUs) {
+    return markBeat(samples, count, beatTimeUs);
+}
+
+bool markECGBeat(ECGMultiSample *samples, size_t count, uint32_t beatTimeUs) {
+    return markBeat(samples, count, beatTimeUs);
+}
+
+void addEarlierBeat(ECGHeartRate &heartRate, uint32_t beatTimeUs) {
+    if (heartRate.earlierBeatCount >= ECG_FRAME_MAX_EARLIER_BEATS) {
+        memmove(heartRate.earlierBeatsUs, heartRate.earlierBeatsUs + 1,
+                sizeof(heartRate.earlierBeatsUs[0]) * (ECG_FRAME_MAX_EARLIER_BEATS - 1));
+        heartRate.earlierBeatCount = ECG_FRAME_MAX_EARLIER_BEATS - 1;
+    }
+    heartRate.earlierBeatsUs[heartRate.earlierBeatCount++] = beatTimeUs;
+}
+
+bool decodeECGFrameHeader(const uint8_t *data, size_t length, ECGFrameHeader &header) {
+    if (length < ECG_FRAME_HEADER_SIZE || data[0] != ECG_FRAME_VERSION) {
+        return false;
+    }
+    header.type = data[1];
+    header.flags = data[2];
+    header.sequence = readU32(data + 4);
+    header.startTimeUs = readU64(data + 8);
+    header.sampleRateHz = readU16(data + 16);
+    header.sampleCount = readU16(data + 18);
+    header.channels = data[3];
+    header.sendDelayUs = 0; // Trailer, not part of the fixed header
+    return true;
+}
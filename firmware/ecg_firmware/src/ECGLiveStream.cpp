@@ -0,0 +1,152 @@
+// ECGLiveStream.cpp
+// This file implements the methods defined in the ECGLiveStream class.
+
+#include "ECGLiveStream.h"
+
+ECGLiveStream::ECGLiveStream(const char *path)
+    : _socket(path),
+      _sampleRateHz(0),
+      _heartRate{},
+      _pendingCount(0),
+      _nextFrame(0),
+      _stats{},
+      _rejected(0) {
+    for (int i = 0; i < LIVE_STREAM_MAX_CLIENTS; i++) {
+        _clientIds[i].store(0);
+        _slotOwner[i] = 0;
+        _slotNextFrame[i] = 0;
+    }
+    _socket.onEvent([this](AsyncWebSocket *, AsyncWebSocketClient *client, AwsEventType type, void *, uint8_t *,
+                           size_t) { onEvent(client, type); });
+}
+
+void ECGLiveStream::attach(AsyncWebServer &server) {
+    server.addHandler(&_socket);
+}
+
+void ECGLiveStream::detach(AsyncWebServer &server) {
+    _socket.closeAll();
+    server.removeHandler(&_socket);
+}
+
+void ECGLiveStream::setSampleRate(uint16_t sampleRateHz) {
+    if (sampleRateHz != _sampleRateHz && _pendingCount > 0) {
+        completeFrame(); // A frame has a single rate
+    }
+    _sampleRateHz = sampleRateHz;
+}
+
+void ECGLiveStream::setHeartRate(uint16_t bpmX10, uint16_t rrIntervalMs) {
+    _heartRate.bpmX10 = bpmX10;
+    _heartRate.rrIntervalMs = rrIntervalMs;
+}
+
+void ECGLiveStream::markBeat(uint32_t beatTimeUs) {
+    if (!markECGBeat(_pendingSamples, _pendingCount, beatTimeUs)) {
+        addEarlierBeat(_heartRate, beatTimeUs);
+    }
+}
+
+bool ECGLiveStream::hasClients() const {
+    for (int i = 0; i < LIVE_STREAM_MAX_CLIENTS; i++) {
+        if (_clientIds[i].load() != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ECGLiveStream::queueSamples(const ECGSample *samples, size_t count) {
+    if (!hasClients()) {
+        _pendingCount = 0; // Nobody to show them to; the next viewer starts from live samples
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        _pendingSamples[_pendingCount++] = samples[i];
+        if (_pendingCount >= LIVE_STREAM_FRAME_SAMPLES) {
+            completeFrame();
+        }
+    }
+}
+
+void ECGLiveStream::completeFrame() {
+    ECGFrameHeader header = {};
+    header.type = ECG_FRAME_TYPE_SAMPLES;
+    header.flags = ECG_FRAME_FLAG_DELTA_VARINT;
+    header.sequence = _nextFrame;
+    header.startTimeUs = _timestampExtender.extend(_pendingSamples[0].timestampUs);
+    header.sampleRateHz = _sampleRateHz;
+
+    Frame &frame = _frames[_nextFrame % LIVE_STREAM_HISTORY_FRAMES];
+    const ECGHeartRate *heartRate = _heartRate.bpmX10 != 0 ? &_heartRate : nullptr;
+    frame.length = static_cast<uint16_t>(
+        encodeECGFrame(header, _pendingSamples, _pendingCount, frame.data, sizeof(frame.data), heartRate));
+    _pendingCount = 0;
+    if (heartRate != nullptr) {
+        _heartRate.earlierBeatCount = 0;
+    }
+    if (frame.length > 0) {
+        _nextFrame++;
+        _stats.framesEncoded++;
+    }
+}
+
+void ECGLiveStream::loop() {
+    _socket.cleanupClients(LIVE_STREAM_MAX_CLIENTS);
+
+    uint32_t oldest = _nextFrame > LIVE_STREAM_HISTORY_FRAMES ? _nextFrame - LIVE_STREAM_HISTORY_FRAMES : 0;
+    for (int i = 0; i < LIVE_STREAM_MAX_CLIENTS; i++) {
+        uint32_t id = _clientIds[i].load();
+        if (id == 0) {
+            continue;
+        }
+        if (id != _slotOwner[i]) {
+            // New viewer: start with the next frame; older ones may be from a previous viewer's session.
+            _slotOwner[i] = id;
+            _slotNextFrame[i] = _nextFrame;
+        }
+        if (_slotNextFrame[i] < oldest) {
+            _stats.framesDropped += oldest - _slotNextFrame[i]; // Overwritten while the viewer was behind
+            _slotNextFrame[i] = oldest;
+        }
+        while (_slotNextFrame[i] < _nextFrame && _socket.availableForWrite(id)) {
+            const Frame &frame = _frames[_slotNextFrame[i] % LIVE_STREAM_HISTORY_FRAMES];
+            _socket.binary(id, frame.data, frame.length);
+            _slotNextFrame[i]++;
+            _stats.framesSent++;
+        }
+    }
+}
+
+ECGLiveStream::Stats ECGLiveStream::getStats() const {
+    Stats stats = _stats;
+    stats.rejected = _rejected.load();
+    stats.clients = 0;
+    for (int i = 0; i < LIVE_STREAM_MAX_CLIENTS; i++) {
+        if (_clientIds[i].load() != 0) {
+            stats.clients++;
+        }
+    }
+    return stats;
+}
+
+void ECGLiveStream::onEvent(AsyncWebSocketClient *client, AwsEventType type) {
+    uint32_t id = client->id();
+    if (type == WS_EVT_CONNECT) {
+        for (int i = 0; i < LIVE_STREAM_MAX_CLIENTS; i++) {
+            uint32_t free = 0;
+            if (_clientIds[i].compare_exchange_strong(free, id)) {
+                return;
+            }
+        }
+        _rejected.fetch_add(1);
+        client->close();
+    } else if (type == WS_EVT_DISCONNECT) {
+        for (int i = 0; i < LIVE_STREAM_MAX_CLIENTS; i++) {
+            uint32_t expected = id;
+            if (_clientIds[i].compare_exchange_strong(expected, 0)) {
+                return;
+            }
+        }
+    }
+}
@@ -0,0 +1,137 @@
+// ECGMultiChannel.cpp
+// This file implements the methods defined in the ECGMultiChannel class.
+#include "ECGMultiChannel.h"
+
+ECGMultiChannel::ECGMultiChannel()
+    : _sources{},
+      _channelCount(0),
+      _sampleTimer(nullptr),
+      _sampleRateHz(0),
+      _lastSampleUs(0),
+      _samplesCaptured(0),
+      _minIntervalUs(UINT32_MAX),
+      _maxIntervalUs(0),
+      _maxSkewUs(0) {}
+
+bool ECGMultiChannel::addChannel(ECGSource *source) {
+    if (source == nullptr || _channelCount >= ECG_MAX_CHANNELS) {
+        return false;
+    }
+    _sources[_channelCount++] = source;
+    return true;
+}
+
+uint8_t ECGMultiChannel::getChannelCount() const {
+    return _channelCount;
+}
+
+bool ECGMultiChannel::startSampling(ECGSampleRate rate) {
+    stopSampling();
+    if (_channelCount == 0) {
+        return false;
+    }
+
+    if (_sampleTimer == nullptr) {
+        // Runs in the esp_timer task, as analogRead() is not ISR-safe (see AD8232_ECG).
+        esp_timer_create_args_t timerArgs = {};
+        timerArgs.callback = &ECGMultiChannel::_onSampleTimer;
+        timerArgs.arg = this;
+        timerArgs.dispatch_method = ESP_TIMER_TASK;
+        timerArgs.name = "ecg_multi_sample";
+        if (esp_timer_create(&timerArgs, &_sampleTimer) != ESP_OK) {
+            // Serial.println("[ECGMultiChannel] Failed to create sample timer.");
+            _sampleTimer = nullptr;
+            return false;
+        }
+    }
+
+    _sampleRateHz = static_cast<uint16_t>(rate);
+    resetSamplingStats();
+
+    uint64_t periodUs = 1000000ULL / _sampleRateHz;
+    if (esp_timer_start_periodic(_sampleTimer, periodUs) != ESP_OK) {
+        // Serial.println("[ECGMultiChannel] Failed to start sample timer.");
+        _sampleRateHz = 0;
+        return false;
+    }
+    return true;
+}
+
+void ECGMultiChannel::stopSampling() {
+    if (_sampleTimer != nullptr && esp_timer_is_active(_sampleTimer)) {
+        esp_timer_stop(_sampleTimer);
+    }
+}
+
+bool ECGMultiChannel::isSampling() const {
+    return _sampleTimer != nullptr && esp_timer_is_active(_sampleTimer);
+}
+
+uint16_t ECGMultiChannel::getSampleRateHz() const {
+    return _sampleRateHz;
+}
+
+size_t ECGMultiChannel::availableSamples() const {
+    return _sampleBuffer.size();
+}
+
+size_t ECGMultiChannel::readSamples(ECGMultiSample *out, size_t maxSamples) {
+    return _sampleBuffer.popBulk(out, maxSamples);
+}
+
+ECGMultiChannel::SamplingStats ECGMultiChannel::getSamplingStats() const {
+    SamplingStats stats;
+    stats.samplesCaptured = _samplesCaptured;
+    stats.samplesDropped = _sampleBuffer.overrunCount();
+    stats.bufferHighWater = _sampleBuffer.highWaterMark();
+    stats.minIntervalUs = (_minIntervalUs == UINT32_MAX) ? 0 : _minIntervalUs;
+    stats.maxIntervalUs = _maxIntervalUs;
+    stats.maxSkewUs = _maxSkewUs;
+    return stats;
+}
+
+void ECGMultiChannel::resetSamplingStats() {
+    _samplesCaptured = 0;
+    _sampleBuffer.resetStats();
+    _minIntervalUs = UINT32_MAX;
+    _maxIntervalUs = 0;
+    _maxSkewUs = 0;
+}
+
+void ECGMultiChannel::_onSampleTimer(void *arg) {
+    static_cast<ECGMultiChannel *>(arg)->_captureSample();
+}
+
+void ECGMultiChannel::_captureSample() {
+    ECGMultiSample sample = {};
+    sample.timestampUs = static_cast<uint32_t>(esp_timer_get_time());
+    // All channels back to back, before any bookkeeping, to keep the skew small.
+    for (uint8_t c = 0; c < _channelCount; c++) {
+        sample.values[c] = static_cast<uint16_t>(_sources[c]->readECG());
+    }
+    uint32_t skew = static_cast<uint32_t>(esp_timer_get_time()) - sample.timestampUs;
+    for (uint8_t c = 0; c < _channelCount; c++) {
+        if (!_sources[c]->isSensorConnected()) {
+            sample.leadOffMask |= static_cast<uint8_t>(1u << c);
+        }
+    }
+    sample.flags = sample.leadOffMask != 0 ? ECG_SAMPLE_FLAG_LEAD_OFF : 0;
+
+    if (skew > _maxSkewUs) {
+        _maxSkewUs = skew;
+    }
+    if (_samplesCaptured > 0) {
+        uint32_t interval = sample.timestampUs - _lastSampleUs;
+        if (interval < _minIntervalUs) {
+            _minIntervalUs = interval;
+        }
+        if (interval > _maxIntervalUs) {
+            _maxIntervalUs = interval;
+        }
+    }
+    _lastSampleUs = sample.timestampUs;
+    _samplesCaptured = _samplesCaptured + 1;
+
+    // If the consumer has fallen behind the sample is dropped and counted as an overrun.
+    _sampleBuffer.push(sample);
+}
@@ -0,0 +1,235 @@
+// ECGSource.cpp
+// This file implements the methods defined in the SyntheticECGSource and TraceECGSource classes.
+
+#include "ECGSource.h"
+
+#include <math.h>
+
+#if !defined(ESP_PLATFORM)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define ECG_SOURCE_FULL_SCALE 4095
+
+// One beat at 60 bpm: offset of each wave from the start of the beat, width and amplitude.
+// Offsets shrink with the R-R interval at higher rates; widths stay fixed.
+struct SyntheticWave {
+    float offsetS;
+    float widthS;
+    float amplitudeMv;
+};
+
+static const SyntheticWave SYNTHETIC_WAVES[] = {
+    {0.20f, 0.025f, 0.15f},  // P
+    {0.36f, 0.008f, -0.10f}, // Q
+    {0.38f, 0.010f, 1.20f},  // R
+    {0.40f, 0.008f, -0.25f}, // S
+    {0.62f, 0.040f, 0.30f},  // T
+};
+
+SyntheticECGSource::Config SyntheticECGSource::defaultConfig() {
+    Config config;
+    config.heartRateBpm = 72.0f;
+    config.noiseMv = 0.01f;
+    config.baselineWanderMv = 0.05f;
+    config.baselineWanderHz = 0.3f;
+    config.mainsHumMv = 0.02f;
+    config.mainsHz = 50.0f;
+    config.leadOffEveryMs = 0;
+    config.leadOffDurationMs = 0;
+    config.seed = 0x2545F491;
+    return config;
+}
+
+SyntheticECGSource::SyntheticECGSource() {
+    configure(ECGSampleRate::Hz125, defaultConfig());
+}
+
+void SyntheticECGSource::configure(ECGSampleRate rate, const Config &config) {
+    _config = config;
+    _sampleRateHz = static_cast<uint16_t>(rate);
+    _leadOffEverySamples =
+        static_cast<uint32_t>(static_cast<uint64_t>(config.leadOffEveryMs) * _sampleRateHz / 1000);
+    _leadOffDurationSamples =
+        static_cast<uint32_t>(static_cast<uint64_t>(config.leadOffDurationMs) * _sampleRateHz / 1000);
+    _forcedLeadOff = false;
+    _renderBeat();
+    reset();
+}
+
+void SyntheticECGSource::setLeadOff(bool leadOff) {
+    _forcedLeadOff = leadOff;
+}
+
+void SyntheticECGSource::reset() {
+    _beatPosition = 0;
+    _sampleIndex = 0;
+    _wanderPhase = 0.0f;
+    _mainsPhase = 0.0f;
+    _noiseState = _config.seed != 0 ? _config.seed : 1;
+    _leadOff = false;
+}
+
+uint32_t SyntheticECGSource::getSampleIndex() const {
+    return _sampleIndex;
+}
+
+bool SyntheticECGSource::isSensorConnected() {
+    return !_leadOff;
+}
+
+int SyntheticECGSource::readECG() {
+    float extraMv = _config.baselineWanderMv * sinf(2.0f * static_cast<float>(M_PI) * _wanderPhase) +
+                    _config.mainsHumMv * sinf(2.0f * static_cast<float>(M_PI) * _mainsPhase);
+    if (_config.noiseMv > 0.0f) {
+        extraMv += _config.noiseMv * _nextNoise();
+    }
+    int value = ECG_SOURCE_MID_SCALE + _beat[_beatPosition] +
+                static_cast<int>(lroundf(extraMv * ECG_SOURCE_COUNTS_PER_MV));
+
+    _leadOff = _forcedLeadOff ||
+               (_leadOffEverySamples > 0 &&
+                (_sampleIndex % _leadOffEverySamples) >= _leadOffEverySamples - _leadOffDurationSamples);
+
+    _sampleIndex++;
+    if (++_beatPosition >= _beatLength) {
+        _beatPosition = 0;
+    }
+    _wanderPhase += _config.baselineWanderHz / _sampleRateHz;
+    if (_wanderPhase >= 1.0f) {
+        _wanderPhase -= 1.0f;
+    }
+    _mainsPhase += _config.mainsHz / _sampleRateHz;
+    if (_mainsPhase >= 1.0f) {
+        _mainsPhase -= 1.0f;
+    }
+
+    if (_leadOff) {
+        return ECG_SOURCE_FULL_SCALE; // The AD8232 output rails when an electrode comes off
+    }
+    if (value < 0) {
+        return 0;
+    }
+    return value > ECG_SOURCE_FULL_SCALE ? ECG_SOURCE_FULL_SCALE : value;
+}
+
+void SyntheticECGSource::_renderBeat() {
+    float bpm = _config.heartRateBpm > 0.0f ? _config.heartRateBpm : 60.0f;
+    float rrS = 60.0f / bpm;
+    long length = lroundf(rrS * _sampleRateHz);
+    if (length < 1) {
+        length = 1;
+    } else if (length > SYNTHETIC_ECG_MAX_BEAT_SAMPLES) {
+        length = SYNTHETIC_ECG_MAX_BEAT_SAMPLES;
+    }
+    _beatLength = static_cast<uint16_t>(length);
+
+    float scale = rrS < 1.0f ? rrS : 1.0f;
+    for (uint16_t i = 0; i < _beatLength; i++) {
+        float t = static_cast<float>(i) / _sampleRateHz;
+        float mv = 0.0f;
+        for (const SyntheticWave &wave : SYNTHETIC_WAVES) {
+            float x = (t - wave.offsetS * scale) / wave.widthS;
+            mv += wave.amplitudeMv * expf(-0.5f * x * x);
+        }
+        _beat[i] = static_cast<int16_t>(lroundf(mv * ECG_SOURCE_COUNTS_PER_MV));
+    }
+}
+
+float SyntheticECGSource::_nextNoise() {
+    // Sum of four uniform values from xorshift32, scaled to unit variance.
+    float sum = 0.0f;
+    for (int i = 0; i < 4; i++) {
+        _noiseState ^= _noiseState << 13;
+        _noiseState ^= _noiseState >> 17;
+        _noiseState ^= _noiseState << 5;
+        sum += static_cast<float>(_noiseState) / 4294967296.0f - 0.5f;
+    }
+    return sum * 1.7320508f;
+}
+
+TraceECGSource::TraceECGSource(const char *path, bool loop)
+    : _path(path),
+      _data(nullptr),
+      _count(0),
+      _position(0),
+      _loop(loop),
+      _mapped(false),
+      _current(ECG_SOURCE_MID_SCALE) {}
+
+TraceECGSource::TraceECGSource(const uint8_t *data, size_t length, bool loop)
+    : _path(nullptr),
+      _data(data),
+      _count(length / 2),
+      _position(0),
+      _loop(loop),
+      _mapped(false),
+      _current(ECG_SOURCE_MID_SCALE) {}
+
+TraceECGSource::~TraceECGSource() {
+#if !defined(ESP_PLATFORM)
+    if (_mapped) {
+        munmap(const_cast<uint8_t *>(_data), _count * 2);
+    }
+#endif
+}
+
+bool TraceECGSource::begin() {
+    if (_path == nullptr || _mapped) {
+        return _count > 0;
+    }
+#if defined(ESP_PLATFORM)
+    // No mmap for VFS files on the ESP32; link the trace into flash and use the in-memory constructor.
+    return false;
+#else
+    int fd = open(_path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    size_t length = fstat(fd, &info) == 0 ? static_cast<size_t>(info.st_size) : 0;
+    void *data = length >= 2 ? mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd); // The mapping keeps the file open
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    madvise(data, length, MADV_SEQUENTIAL);
+    _data = static_cast<const uint8_t *>(data);
+    _count = length / 2;
+    _position = 0;
+    _mapped = true;
+    return true;
+#endif
+}
+
+size_t TraceECGSource::sampleCount() const {
+    return _count;
+}
+
+bool TraceECGSource::isFinished() const {
+    return !_loop && _position >= _count;
+}
+
+void TraceECGSource::rewind() {
+    _position = 0;
+}
+
+bool TraceECGSource::isSensorConnected() {
+    return (_current & ECG_TRACE_LEAD_OFF_BIT) == 0;
+}
+
+int TraceECGSource::readECG() {
+    if (_position >= _count) {
+        if (!_loop || _count == 0) {
+            return _current & 0x0FFF; // Hold the last sample
+        }
+        _position = 0;
+    }
+    const uint8_t *word = _data + _position * 2;
+    _current = static_cast<uint16_t>(word[0] | (word[1] << 8));
+    _position++;
+    return _current & 0x0FFF;
+}
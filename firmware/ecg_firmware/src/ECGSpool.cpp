@@ -0,0 +1,228 @@
+// ECGSpool.cpp
+// This file implements the methods defined in the FileSpoolStorage and ECGSpool classes.
+
+#include "ECGSpool.h"
+
+#include <string.h>
+
+/*
+ * Record layout in the spool: a 4-byte header followed by the frame.
+ *   uint8  magic    kRecordMagic for a frame, kWrapMagic if the rest of the store is unused
+ *   uint8  reserved
+ *   uint16 length   Frame length, little-endian
+ * When fewer than 4 bytes remain before the end of the store, the wrap is implicit.
+ */
+static const uint8_t kRecordMagic = 0xEC;
+static const uint8_t kWrapMagic = 0xEE;
+static const size_t kRecordHeaderSize = 4;
+
+// --- FileSpoolStorage ---
+
+FileSpoolStorage::FileSpoolStorage(const char *path, size_t capacity)
+    : _path(path), _capacity(capacity), _file(nullptr) {}
+
+FileSpoolStorage::~FileSpoolStorage() {
+    if (_file != nullptr) {
+        fclose(_file);
+    }
+}
+
+bool FileSpoolStorage::begin() {
+    if (_file != nullptr) {
+        return true;
+    }
+    _file = fopen(_path, "r+b");
+    if (_file == nullptr) {
+        _file = fopen(_path, "w+b");
+        if (_file == nullptr) {
+            // Serial.printf("[Spool] Could not create %s\n", _path);
+            return false;
+        }
+    }
+
+    // Reserve the full size up front so appends never have to grow the file.
+    if (fseek(_file, 0, SEEK_END) != 0) {
+        return false;
+    }
+    long size = ftell(_file);
+    if (size < 0 || static_cast<size_t>(size) < _capacity) {
+        if (fseek(_file, static_cast<long>(_capacity) - 1, SEEK_SET) != 0 || fputc(0, _file) == EOF) {
+            return false;
+        }
+        fflush(_file);
+    }
+    return true;
+}
+
+size_t FileSpoolStorage::capacity() const {
+    return _capacity;
+}
+
+bool FileSpoolStorage::read(size_t offset, uint8_t *data, size_t len) {
+    if (_file == nullptr || offset + len > _capacity) {
+        return false;
+    }
+    if (fseek(_file, static_cast<long>(offset), SEEK_SET) != 0) {
+        return false;
+    }
+    return fread(data, 1, len, _file) == len;
+}
+
+bool FileSpoolStorage::write(size_t offset, const uint8_t *data, size_t len) {
+    if (_file == nullptr || offset + len > _capacity) {
+        return false;
+    }
+    if (fseek(_file, static_cast<long>(offset), SEEK_SET) != 0) {
+        return false;
+    }
+    if (fwrite(data, 1, len, _file) != len) {
+        return false;
+    }
+    return fflush(_file) == 0;
+}
+
+// --- ECGSpool ---
+
+ECGSpool::ECGSpool(SpoolStorage &storage) : _storage(storage) {
+    begin();
+}
+
+void ECGSpool::begin() {
+    _capacity = _storage.capacity();
+    _head = 0;
+    _tail = 0;
+    _used = 0;
+    _records = 0;
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+bool ECGSpool::append(const uint8_t *frame, size_t length) {
+    size_t needed = kRecordHeaderSize + length;
+    if (length == 0 || length > 0xFFFF || needed > _capacity / 2) {
+        return false;
+    }
+
+    // Space at the end of the store that has to be skipped if the record does not fit there.
+    size_t skipped = (_head + needed > _capacity) ? _capacity - _head : 0;
+    while (_records > 0 && _capacity - _used < needed + skipped) {
+        _dropOldest();
+        if (_records == 0) {
+            // Everything was dropped; restart at the beginning to avoid skipping space.
+            skipped = 0;
+        }
+    }
+
+    if (skipped > 0) {
+        if (skipped >= kRecordHeaderSize) {
+            uint8_t marker[kRecordHeaderSize] = {kWrapMagic, 0, 0, 0};
+            _storage.write(_head, marker, sizeof(marker));
+        }
+        _head = 0;
+        _used += skipped;
+    }
+
+    uint8_t header[kRecordHeaderSize] = {kRecordMagic, 0, static_cast<uint8_t>(length),
+                                         static_cast<uint8_t>(length >> 8)};
+    if (!_storage.write(_head, header, sizeof(header)) ||
+        !_storage.write(_head + kRecordHeaderSize, frame, length)) {
+        _stats.writeErrors++;
+        return false;
+    }
+
+    _head += needed;
+    if (_head == _capacity) {
+        _head = 0;
+    }
+    _used += needed;
+    _records++;
+    _stats.framesSpooled++;
+    return true;
+}
+
+size_t ECGSpool::peek(uint8_t *out, size_t capacity) {
+    while (_records > 0) {
+        size_t length;
+        if (!_readRecordLength(length)) {
+            // Unreadable or corrupt record: discard it rather than stall the backfill.
+            _dropOldest();
+            continue;
+        }
+        if (length > capacity || !_storage.read(_tail + kRecordHeaderSize, out, length)) {
+            _dropOldest();
+            continue;
+        }
+        return length;
+    }
+    return 0;
+}
+
+void ECGSpool::pop() {
+    if (_records == 0) {
+        return;
+    }
+    _dropOldest();
+    // _dropOldest() counts an overwrite; this record was forwarded instead.
+    _stats.framesOverwritten--;
+    _stats.framesForwarded++;
+}
+
+bool ECGSpool::isEmpty() const {
+    return _records == 0;
+}
+
+uint32_t ECGSpool::frameCount() const {
+    return _records;
+}
+
+size_t ECGSpool::usedBytes() const {
+    return _used;
+}
+
+ECGSpool::Stats ECGSpool::getStats() const {
+    return _stats;
+}
+
+void ECGSpool::_skipWrapAtTail() {
+    size_t remaining = _capacity - _tail;
+    bool wrap = remaining < kRecordHeaderSize;
+    if (!wrap) {
+        uint8_t magic;
+        wrap = _storage.read(_tail, &magic, 1) && magic == kWrapMagic;
+    }
+    if (wrap) {
+        _used -= remaining;
+        _tail = 0;
+    }
+}
+
+bool ECGSpool::_readRecordLength(size_t &length) {
+    _skipWrapAtTail();
+    uint8_t header[kRecordHeaderSize];
+    if (!_storage.read(_tail, header, sizeof(header)) || header[0] != kRecordMagic) {
+        return false;
+    }
+    length = header[2] | (header[3] << 8);
+    return length > 0 && kRecordHeaderSize + length <= _capacity - _tail;
+}
+
+void ECGSpool::_dropOldest() {
+    size_t length;
+    if (_records <= 1 || !_readRecordLength(length)) {
+        // Last record, or the chain is broken: nothing after it can be trusted, start over.
+        _stats.framesOverwritten += _records;
+        _head = 0;
+        _tail = 0;
+        _used = 0;
+        _records = 0;
+        return;
+    }
+
+    size_t size = kRecordHeaderSize + length;
+    _tail += size;
+    if (_tail == _capacity) {
+        _tail = 0;
+    }
+    _used -= size;
+    _records--;
+    _stats.framesOverwritten++;
+}
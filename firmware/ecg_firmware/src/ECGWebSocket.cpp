@@ -3,9 +3,69 @@
 
 #include "ECGWebSocket.h"
 
+#include <ArduinoJson.h>
+#include <esp_timer.h>
+#include <string.h>
+
 using namespace websockets;
 
-ECGWebSocketClient::ECGWebSocketClient() {
+// Batch length of each adaptive uplink level in milliseconds of signal; level 0 uses the configured policy
+static const uint16_t UPLINK_BATCH_MS[UPLINK_LEVEL_COUNT] = {0, 500, 1000, 1000};
+// The level from which the output rate is lowered
+#define UPLINK_DECIMATION_LEVEL 3
+
+/**
+ * @brief Returns the smallest factor (2 to ECG_UPLINK_MAX_DECIMATION) that divides the rate,
+ * so the lowered rate is still a whole number of Hz, or 1 if there is none.
+ */
+static uint8_t uplinkDecimation(uint16_t sampleRateHz) {
+    for (uint8_t factor = 2; factor <= ECG_UPLINK_MAX_DECIMATION; factor++) {
+        if (sampleRateHz % factor == 0) {
+            return factor;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Returns the factor that averages the rate down to ECG_PREVIEW_RATE_HZ.
+ */
+static uint8_t previewDecimation(uint16_t sampleRateHz) {
+    uint32_t factor = sampleRateHz / ECG_PREVIEW_RATE_HZ;
+    return factor < 1 ? 1 : (factor > UINT8_MAX ? UINT8_MAX : static_cast<uint8_t>(factor));
+}
+
+ECGWebSocketClient::ECGWebSocketClient()
+    : _batchMaxSamples(ECG_FRAME_MAX_SAMPLES),
+      _batchMaxDelayUs(0),
+      _sampleRateHz(0),
+      _compressFrames(false),
+      _channelCount(1),
+      _streamMode(StreamMode::Full),
+      _adaptive(false),
+      _uplinkLevel(0),
+      _uplinkReportPending(false),
+      _baseBatchMaxSamples(ECG_FRAME_MAX_SAMPLES),
+      _baseBatchMaxDelayUs(0),
+      _baseCompressFrames(false),
+      _decimation(1),
+      _decimationCount(0),
+      _decimationFlags(0),
+      _decimationSum(0),
+      _decimationStartUs(0),
+      _heartRate{},
+      _heartRateEnabled(false),
+      _frameSequence(0),
+      _spool(nullptr),
+      _stats(),
+      _leadsOff(false),
+      _commandHead(0),
+      _commandCount(0),
+      _lastCommandSeq(0),
+      _commandSeqValid(false),
+      _commandOutcomes(),
+      _pendingCount(0),
+      _pendingMultiCount(0) {
     _webSocket.onMessage([this](WebsocketsMessage message) {
         this->onWsMessage(message);
     });
@@ -30,8 +90,9 @@ bool ECGWebSocketClient::connect(const char *ip, uint16_t port, const char *path
 
 bool ECGWebSocketClient::sendECGValue(int ecgValue) {
     if (_webSocket.available()) {                       // Check connection status
-        String data = String(ecgValue);                 // Convert integer to String
-        _webSocket.send(data);                          // Send the data as a text message
+        char data[12];                                  // Fits any int; a String would allocate
+        int length = snprintf(data, sizeof(data), "%d", ecgValue);
+        _webSocket.send(data, length);                  // Send the data as a text message
         return true;
     } else {
 
@@ -41,6 +102,384 @@ bool ECGWebSocketClient::sendECGValue(int ecgValue) {
     }
 }
 
+bool ECGWebSocketClient::sendStatus(const char *json) {
+    if (!_webSocket.available()) {
+        return false;
+    }
+    return _webSocket.send(json, strlen(json));
+}
+
+void ECGWebSocketClient::setBatchPolicy(uint16_t maxSamples, uint16_t maxDelayMs) {
+    if (maxSamples == 0) {
+        maxSamples = 1;
+    }
+    if (maxSamples > ECG_FRAME_MAX_SAMPLES) {
+        maxSamples = ECG_FRAME_MAX_SAMPLES;
+    }
+    _baseBatchMaxSamples = maxSamples;
+    _baseBatchMaxDelayUs = static_cast<uint32_t>(maxDelayMs) * 1000UL;
+    applyUplinkLevel();
+}
+
+void ECGWebSocketClient::setSampleRate(uint16_t sampleRateHz) {
+    if (sampleRateHz != _sampleRateHz) {
+        flushECGBatch();      // A frame has a single rate
+        _decimationCount = 0; // A partial group would average across the change
+        _uplinkReportPending = _adaptive || _streamMode != StreamMode::Full; // full_rate_hz moved
+    }
+    _sampleRateHz = sampleRateHz;
+    applyUplinkLevel();
+}
+
+void ECGWebSocketClient::setCompression(bool enabled) {
+    _baseCompressFrames = enabled;
+    applyUplinkLevel();
+}
+
+void ECGWebSocketClient::setStreamMode(StreamMode mode) {
+    if (mode == _streamMode) {
+        return;
+    }
+    flushECGBatch();
+    _decimationCount = 0;
+    _streamMode = mode;
+    _uplinkReportPending = true; // Tells the server the new output rate
+    applyUplinkLevel();
+}
+
+StreamMode ECGWebSocketClient::getStreamMode() const {
+    return _streamMode;
+}
+
+void ECGWebSocketClient::setAdaptive(bool enabled) {
+    _adaptive = enabled;
+    _uplink.reset();
+    _uplinkReportPending = enabled;
+    applyUplinkLevel();
+}
+
+void ECGWebSocketClient::updateLink(size_t queuedSamples, int8_t rssi) {
+    if (!_adaptive || _sampleRateHz == 0) {
+        return;
+    }
+    uint32_t backlogMs = static_cast<uint32_t>(queuedSamples * 1000UL / _sampleRateHz);
+    if (_uplink.update(millis(), backlogMs, rssi)) {
+        _stats.uplinkChanges++;
+    }
+    applyUplinkLevel();
+}
+
+uint8_t ECGWebSocketClient::getUplinkLevel() const {
+    return _uplinkLevel;
+}
+
+void ECGWebSocketClient::applyUplinkLevel() {
+    uint8_t level = _adaptive ? _uplink.getLevel() : 0;
+    if (_decimationCount != 0) {
+        return; // Retried from queueECGSamples() once the group is complete
+    }
+    bool changed = level != _uplinkLevel;
+
+    uint16_t batchSamples = _baseBatchMaxSamples;
+    uint32_t batchDelayUs = _baseBatchMaxDelayUs;
+    bool compress = _baseCompressFrames;
+    uint8_t decimation = 1;
+    uint32_t batchMs = 0;
+    if (level > 0) {
+        // Multi-channel frames keep the full rate, so every lead stays diagnostic.
+        decimation = level >= UPLINK_DECIMATION_LEVEL && _channelCount <= 1 ? uplinkDecimation(_sampleRateHz) : 1;
+        batchMs = UPLINK_BATCH_MS[level];
+    }
+    if (_streamMode == StreamMode::Preview) {
+        // Only a trace to look at: a low rate, sent once a second.
+        decimation = _channelCount <= 1 ? previewDecimation(_sampleRateHz) : 1;
+        batchMs = batchMs > ECG_PREVIEW_BATCH_MS ? batchMs : ECG_PREVIEW_BATCH_MS;
+    }
+    if (batchMs > 0) {
+        uint32_t samples = static_cast<uint32_t>(_sampleRateHz) / decimation * batchMs / 1000;
+        batchSamples = samples > ECG_FRAME_MAX_SAMPLES ? ECG_FRAME_MAX_SAMPLES : (samples > 0 ? samples : 1);
+        batchDelayUs = batchMs * 1000UL > batchDelayUs ? batchMs * 1000UL : batchDelayUs;
+        compress = true;
+    }
+
+    if (decimation != _decimation || compress != _compressFrames) {
+        flushECGBatch(); // A frame has a single rate and coding
+    }
+    _batchMaxSamples = batchSamples;
+    _batchMaxDelayUs = batchDelayUs;
+    _compressFrames = compress;
+    _decimation = decimation;
+    _uplinkLevel = level;
+
+    if (changed) {
+        _uplinkReportPending = true;
+    }
+    if (_uplinkReportPending) {
+        reportUplinkLevel();
+    }
+}
+
+void ECGWebSocketClient::reportUplinkLevel() {
+    if (!_webSocket.available()) {
+        return; // Reported after reconnecting
+    }
+    char message[256];
+    snprintf(message, sizeof(message),
+             "{\"type\":\"uplink_rate\",\"level\":%u,\"reason\":\"%s\",\"stream\":\"%s\",\"batch_samples\":%u,"
+             "\"batch_ms\":%lu,\"compressed\":%s,\"sample_rate_hz\":%u,\"full_rate_hz\":%u,\"send_us\":%lu}",
+             _uplinkLevel, UplinkRateController::reasonName(_uplink.getReason()), streamModeName(_streamMode),
+             _batchMaxSamples,
+             (unsigned long)(_batchMaxDelayUs / 1000), _compressFrames ? "true" : "false",
+             _sampleRateHz / _decimation, _sampleRateHz, (unsigned long)_uplink.getSmoothedSendUs());
+    _uplinkReportPending = !_webSocket.send(message, strlen(message));
+}
+
+bool ECGWebSocketClient::decimate(const ECGSample &sample, ECGSample &out) {
+    if (_decimation <= 1) {
+        out = sample;
+        return true;
+    }
+    if (_decimationCount == 0) {
+        _decimationStartUs = sample.timestampUs;
+        _decimationSum = 0;
+        _decimationFlags = 0;
+    }
+    _decimationSum += sample.value;
+    _decimationFlags |= sample.flags; // Keeps beat marks
+    if (++_decimationCount < _decimation) {
+        return false;
+    }
+    out.timestampUs = _decimationStartUs;
+    out.value = static_cast<uint16_t>((_decimationSum + _decimation / 2) / _decimation);
+    out.flags = _decimationFlags;
+    out.reserved = 0;
+    _decimationCount = 0;
+    return true;
+}
+
+void ECGWebSocketClient::setHeartRate(uint16_t bpmX10, uint16_t rrIntervalMs) {
+    _heartRate.bpmX10 = bpmX10;
+    _heartRate.rrIntervalMs = rrIntervalMs;
+    _heartRateEnabled = bpmX10 != 0 || rrIntervalMs != 0;
+}
+
+void ECGWebSocketClient::markBeat(uint32_t beatTimeUs) {
+    // Still being averaged into a decimated sample
+    if (_decimationCount > 0 && static_cast<int32_t>(beatTimeUs - _decimationStartUs) >= 0) {
+        _decimationFlags |= ECG_SAMPLE_FLAG_BEAT;
+        return;
+    }
+    if (markECGBeat(_pendingSamples, _pendingCount, beatTimeUs) ||
+        markECGBeat(_pendingMultiSamples, _pendingMultiCount, beatTimeUs)) {
+        return;
+    }
+    addEarlierBeat(_heartRate, beatTimeUs);
+}
+
+void ECGWebSocketClient::setSpool(ECGSpool *spool) {
+    _spool = spool;
+}
+
+bool ECGWebSocketClient::sendECGBatch(const ECGSample *samples, size_t count) {
+    if (!_webSocket.available() && _spool == nullptr) {
+        _stats.samplesDropped += count;
+        return false;
+    }
+
+    ECGFrameHeader header = {};
+    header.type = ECG_FRAME_TYPE_SAMPLES;
+    header.flags = ECG_FRAME_FLAG_SEND_TIME | (_compressFrames ? ECG_FRAME_FLAG_DELTA_VARINT : 0);
+    header.sequence = _frameSequence;
+    header.startTimeUs = _timestampExtender.extend(samples[0].timestampUs);
+    header.sampleRateHz = _sampleRateHz / _decimation;
+    header.sendDelayUs = static_cast<uint32_t>(micros()) - samples[0].timestampUs;
+
+    size_t length = encodeECGFrame(header, samples, count, _frameBuffer, sizeof(_frameBuffer),
+                                   _heartRateEnabled ? &_heartRate : nullptr);
+    if (length == 0) {
+        return false;
+    }
+    if (_heartRateEnabled) {
+        _heartRate.earlierBeatCount = 0;
+    }
+
+    _frameSequence++;
+    if (_webSocket.available() && sendFrame(length)) {
+        _stats.framesSent++;
+        _stats.samplesSent += count;
+        return true;
+    }
+
+    // Keep the frame, with its original sequence number and timestamp, for later.
+    if (_spool != nullptr && _spool->append(_frameBuffer, length)) {
+        _stats.framesSpooled++;
+    } else {
+        _stats.samplesDropped += count;
+    }
+    return false;
+}
+
+void ECGWebSocketClient::setChannelCount(uint8_t channels) {
+    if (channels == 0) {
+        channels = 1;
+    }
+    if (channels > ECG_MAX_CHANNELS) {
+        channels = ECG_MAX_CHANNELS;
+    }
+    flushECGBatch(); // A frame has a single channel count
+    _channelCount = channels;
+    applyUplinkLevel();
+}
+
+bool ECGWebSocketClient::sendECGMultiBatch(const ECGMultiSample *samples, size_t count) {
+    if (!_webSocket.available() && _spool == nullptr) {
+        _stats.samplesDropped += count;
+        return false;
+    }
+
+    ECGFrameHeader header = {};
+    header.flags = ECG_FRAME_FLAG_SEND_TIME | (_compressFrames ? ECG_FRAME_FLAG_DELTA_VARINT : 0);
+    header.sequence = _frameSequence;
+    header.startTimeUs = _timestampExtender.extend(samples[0].timestampUs);
+    header.sampleRateHz = _sampleRateHz;
+    header.sendDelayUs = static_cast<uint32_t>(micros()) - samples[0].timestampUs;
+
+    size_t length = encodeECGMultiFrame(header, samples, count, _channelCount, _frameBuffer, sizeof(_frameBuffer),
+                                        _heartRateEnabled ? &_heartRate : nullptr);
+    if (length == 0) {
+        return false;
+    }
+    if (_heartRateEnabled) {
+        _heartRate.earlierBeatCount = 0;
+    }
+
+    _frameSequence++;
+    if (_webSocket.available() && sendFrame(length)) {
+        _stats.framesSent++;
+        _stats.samplesSent += count;
+        return true;
+    }
+
+    if (_spool != nullptr && _spool->append(_frameBuffer, length)) {
+        _stats.framesSpooled++;
+    } else {
+        _stats.samplesDropped += count;
+    }
+    return false;
+}
+
+bool ECGWebSocketClient::sendLeadEvent(bool leadOff, uint32_t timestampUs) {
+    if (!_webSocket.available() && _spool == nullptr) {
+        return false;
+    }
+
+    ECGFrameHeader header = {};
+    header.flags = ECG_FRAME_FLAG_SEND_TIME;
+    header.sequence = _frameSequence;
+    header.startTimeUs = _timestampExtender.extend(timestampUs);
+    header.sampleRateHz = _sampleRateHz / _decimation;
+    header.sendDelayUs = static_cast<uint32_t>(micros()) - timestampUs;
+
+    size_t length = encodeECGLeadEvent(header, leadOff, _frameBuffer, sizeof(_frameBuffer));
+    _frameSequence++;
+    _stats.leadEvents++;
+    if (_webSocket.available() && sendFrame(length)) {
+        return true;
+    }
+    if (_spool != nullptr && _spool->append(_frameBuffer, length)) {
+        _stats.framesSpooled++;
+    }
+    return false;
+}
+
+bool ECGWebSocketClient::sendFrame(size_t length) {
+    uint32_t start = micros();
+    bool sent = _webSocket.sendBinary(reinterpret_cast<const char *>(_frameBuffer), length);
+    _stats.lastSendUs = micros() - start;
+    if (_stats.lastSendUs > _stats.maxSendUs) {
+        _stats.maxSendUs = _stats.lastSendUs;
+    }
+    _uplink.onSend(_stats.lastSendUs);
+    return sent;
+}
+
+bool ECGWebSocketClient::queueECGSamples(const ECGSample *samples, size_t count) {
+    if (_streamMode == StreamMode::Off) {
+        _stats.samplesPaused += count;
+        return true;
+    }
+    bool ok = true;
+    for (size_t i = 0; i < count; i++) {
+        if (_decimationCount == 0 && _uplinkLevel != (_adaptive ? _uplink.getLevel() : 0)) {
+            applyUplinkLevel();
+        }
+
+        bool leadOff = (samples[i].flags & ECG_SAMPLE_FLAG_LEAD_OFF) != 0;
+        if (leadOff != _leadsOff) {
+            // Close the batch at the change, so no frame mixes the two states.
+            ok = flushECGBatch() && ok;
+            _leadsOff = leadOff;
+            _decimationCount = 0; // A partial group would average across the gap
+            ok = sendLeadEvent(leadOff, samples[i].timestampUs) && ok;
+        }
+        if (leadOff) {
+            _stats.samplesLeadOff++;
+            continue; // Only noise while a lead is off
+        }
+
+        ECGSample sample;
+        if (!decimate(samples[i], sample)) {
+            continue;
+        }
+        _pendingSamples[_pendingCount++] = sample;
+
+        bool full = _pendingCount >= _batchMaxSamples;
+        bool expired = _batchMaxDelayUs != 0 &&
+                       (sample.timestampUs - _pendingSamples[0].timestampUs) >= _batchMaxDelayUs;
+        if (full || expired) {
+            ok = flushECGBatch() && ok;
+        }
+    }
+    return ok;
+}
+
+bool ECGWebSocketClient::queueECGMultiSamples(const ECGMultiSample *samples, size_t count) {
+    if (_streamMode == StreamMode::Off) {
+        _stats.samplesPaused += count;
+        return true;
+    }
+    bool ok = true;
+    for (size_t i = 0; i < count; i++) {
+        if (_uplinkLevel != (_adaptive ? _uplink.getLevel() : 0)) {
+            applyUplinkLevel();
+        }
+
+        _pendingMultiSamples[_pendingMultiCount++] = samples[i];
+
+        bool full = _pendingMultiCount >= _batchMaxSamples;
+        bool expired = _batchMaxDelayUs != 0 &&
+                       (samples[i].timestampUs - _pendingMultiSamples[0].timestampUs) >= _batchMaxDelayUs;
+        if (full || expired) {
+            ok = flushECGBatch() && ok;
+        }
+    }
+    return ok;
+}
+
+bool ECGWebSocketClient::flushECGBatch() {
+    // The batches are released even if the send fails so acquisition never backs up behind them.
+    bool sent = true;
+    if (_pendingCount > 0) {
+        sent = sendECGBatch(_pendingSamples, _pendingCount);
+        _pendingCount = 0;
+    }
+    if (_pendingMultiCount > 0) {
+        sent = sendECGMultiBatch(_pendingMultiSamples, _pendingMultiCount) && sent;
+        _pendingMultiCount = 0;
+    }
+    return sent;
+}
+
 bool ECGWebSocketClient::isConnected() {
     return _webSocket.available();
 }
@@ -57,6 +496,61 @@ void ECGWebSocketClient::loop() {
     // to process WebSocket events like sending/receiving pings, handling data,
     // and managing the connection state.
     _webSocket.poll();
+
+    // Time-based flush, for when samples stop arriving (e.g. sampling stopped).
+    if (_batchMaxDelayUs != 0 &&
+        ((_pendingCount > 0 &&
+          (static_cast<uint32_t>(micros()) - _pendingSamples[0].timestampUs) >= _batchMaxDelayUs) ||
+         (_pendingMultiCount > 0 &&
+          (static_cast<uint32_t>(micros()) - _pendingMultiSamples[0].timestampUs) >= _batchMaxDelayUs))) {
+        flushECGBatch();
+    }
+
+    if (_uplinkReportPending) {
+        reportUplinkLevel();
+    }
+    sendBackfill();
+}
+
+void ECGWebSocketClient::sendBackfill() {
+    if (_spool == nullptr || _spool->isEmpty() || !_webSocket.available()) {
+        return;
+    }
+    for (int i = 0; i < ECG_BACKFILL_FRAMES_PER_LOOP; i++) {
+        size_t length = _spool->peek(_frameBuffer, sizeof(_frameBuffer));
+        if (length == 0) {
+            return;
+        }
+        _frameBuffer[ECG_FRAME_FLAGS_OFFSET] |= ECG_FRAME_FLAG_BACKFILL;
+        if (!sendFrame(length)) {
+            return; // Leave it in the spool and retry on the next loop()
+        }
+        _spool->pop();
+
+        ECGFrameHeader header;
+        if (decodeECGFrameHeader(_frameBuffer, length, header)) {
+            _stats.framesBackfilled++;
+            _stats.samplesBackfilled += header.sampleCount;
+        }
+    }
+}
+
+ECGWebSocketClient::Stats ECGWebSocketClient::getStats() {
+    Stats stats = _stats;
+    stats.uplinkLevel = _uplinkLevel;
+    stats.pendingSamples = static_cast<uint16_t>(_pendingCount + _pendingMultiCount);
+    _stats.maxSendUs = 0;
+    return stats;
+}
+
+void ECGWebSocketClient::replyTimeSync(uint64_t serverUs) {
+    // Taken as late as possible, so the reply delay only adds to the measured round trip.
+    char reply[96];
+    snprintf(reply, sizeof(reply), "{\"type\":\"time_sync\",\"server_us\":%llu,\"device_us\":%llu}",
+             (unsigned long long)serverUs, (unsigned long long)esp_timer_get_time());
+    if (_webSocket.send(reply, strlen(reply))) {
+        _stats.timeSyncReplies++;
+    }
 }
 
 // Private methods for handling WebSocket events
@@ -64,6 +558,98 @@ void ECGWebSocketClient::onWsMessage(WebsocketsMessage message) {
     // Handle incoming text messages from the server.
     // Serial.print("[WS] Got Message: ");
     // Serial.println(message.data());
+    if (!message.isText()) {
+        return;
+    }
+    JsonDocument doc;
+    if (deserializeJson(doc, message.data())) {
+        return;
+    }
+    const char *type = doc["type"];
+    if (type != nullptr && strcmp(type, "time_sync") == 0) {
+        replyTimeSync(doc["server_us"].as<uint64_t>());
+    } else if (type != nullptr && strcmp(type, "command") == 0) {
+        receiveCommand(doc);
+    }
+}
+
+void ECGWebSocketClient::receiveCommand(JsonDocument &doc) {
+    if (!doc["seq"].is<uint32_t>()) {
+        return; // Could not be acknowledged
+    }
+    _stats.commandsReceived++;
+    DeviceCommand command;
+    const char *error = parseDeviceCommand(doc, command);
+    const CommandOutcome &outcome = _commandOutcomes[command.seq % ECG_COMMAND_OUTCOMES];
+    bool known = outcome.valid && outcome.seq == command.seq;
+    if (known && outcome.done) {
+        // A resend whose ack went missing: answer it again.
+        sendCommandAck(command.seq, command.type, outcome.error == nullptr ? "ok" : "error", outcome.error);
+        return;
+    }
+    if (known || (_commandSeqValid && command.seq <= _lastCommandSeq)) {
+        sendCommandAck(command.seq, command.type, "duplicate", nullptr); // The final ack follows, or was lost long ago
+        return;
+    }
+
+    if (error == nullptr && command.type != DeviceCommandType::Stream && _commandCount >= ECG_COMMAND_QUEUE_SIZE) {
+        error = "Too many commands pending";
+    }
+    if (error != nullptr) {
+        // Not accepted, so the seq stays free and a resend is checked again.
+        sendCommandAck(command.seq, command.type, "error", error);
+        return;
+    }
+    _lastCommandSeq = command.seq;
+    _commandSeqValid = true;
+    finishCommand(command.seq, command.type, false, nullptr);
+
+    if (command.type == DeviceCommandType::Stream) {
+        setStreamMode(command.mode);
+        finishCommand(command.seq, command.type, true, nullptr);
+        return;
+    }
+    _commands[(_commandHead + _commandCount) % ECG_COMMAND_QUEUE_SIZE] = command;
+    _commandCount++;
+}
+
+bool ECGWebSocketClient::takeCommand(DeviceCommand &command) {
+    if (_commandCount == 0) {
+        return false;
+    }
+    command = _commands[_commandHead];
+    _commandHead = (_commandHead + 1) % ECG_COMMAND_QUEUE_SIZE;
+    _commandCount--;
+    return true;
+}
+
+void ECGWebSocketClient::ackCommand(const DeviceCommand &command, const char *error) {
+    finishCommand(command.seq, command.type, true, error);
+}
+
+void ECGWebSocketClient::finishCommand(uint32_t seq, DeviceCommandType type, bool done, const char *error) {
+    CommandOutcome &outcome = _commandOutcomes[seq % ECG_COMMAND_OUTCOMES];
+    if (!done) {
+        outcome = {seq, true, false, nullptr};
+        return;
+    }
+    // A command queued before a reconnect has no slot on this connection; only its ack goes out.
+    if (outcome.valid && outcome.seq == seq) {
+        outcome.done = true;
+        outcome.error = error;
+    }
+    sendCommandAck(seq, type, error == nullptr ? "ok" : "error", error);
+}
+
+void ECGWebSocketClient::sendCommandAck(uint32_t seq, DeviceCommandType type, const char *status, const char *error) {
+    char message[160];
+    int length = snprintf(message, sizeof(message), "{\"type\":\"command_ack\",\"seq\":%lu,\"name\":\"%s\",\"status\":\"%s\"",
+                          (unsigned long)seq, deviceCommandName(type), status);
+    if (error != nullptr) {
+        length += snprintf(message + length, sizeof(message) - length, ",\"error\":\"%s\"", error);
+    }
+    snprintf(message + length, sizeof(message) - length, "}");
+    _webSocket.send(message, strlen(message)); // A lost ack makes the server resend, which gets the same answer
 }
 
 void ECGWebSocketClient::onWsEvent(WebsocketsEvent event, String data) {
@@ -71,6 +657,9 @@ void ECGWebSocketClient::onWsEvent(WebsocketsEvent event, String data) {
     switch (event) {
         case WebsocketsEvent::ConnectionOpened:
             // Serial.println("[WS] Connnection Opened");
+            _uplinkReportPending = _adaptive || _streamMode != StreamMode::Full; // The server starts each connection without it
+            _commandSeqValid = false; // The server numbers each connection's commands afresh
+            memset(_commandOutcomes, 0, sizeof(_commandOutcomes));
             // No need to manually set _connected flag, as _webSocket.available() handles it.
             break;
         case WebsocketsEvent::ConnectionClosed:
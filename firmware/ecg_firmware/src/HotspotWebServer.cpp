@@ -2,264 +2,49 @@
 // This file implements the methods defined in the HotspotWebServer class.
 
 #include "HotspotWebServer.h" // Include the corresponding header file
+#include "SetupPage.h"        // Generated from web/setup.html by scripts/embed_web.py
 
 // Constructor definition
-HotspotWebServer::HotspotWebServer(WirelessCommunication &comm)
-    : _server(80), _wirelessComm(comm), _wifiSwitchRequested(false)
+HotspotWebServer::HotspotWebServer(WirelessCommunication &comm, DeviceSettings &settings)
+    : _server(80), _wirelessComm(comm), _liveStream("/live"), _deviceSettings(settings), _wifiSwitchRequested(false),
+      _restartRequested(false), _restartRequestMs(0), _scanCached(false), _scanFailed(false), _scanTimeMs(0)
 {
     // The server is initialized on port 80 (standard HTTP port).
     // The reference to WirelessCommunication is stored for later use.
     // The wifi switch request flag is initialized to false.
+    strcpy(_scanJson, "[]");
+    _requestedSsid[0] = '\0';
+    _requestedPassword[0] = '\0';
+    _scanResponse[0] = '\0';
+    _settingsJson[0] = '\0';
 }
 
 // Starts the web server and configures its routes.
 void HotspotWebServer::begin()
 {
-    // Define the root route ("/") to serve the WiFi configuration HTML page.
-    // This HTML is a simple form to allow users to input SSID and Password.
+    // Start scanning right away, so the page's first request finds results soon.
+    if (!_scanCached && WiFi.scanComplete() != WIFI_SCAN_RUNNING) {
+        _scanFailed = WiFi.scanNetworks(true) == WIFI_SCAN_FAILED;
+    }
+
+    // Define the root route ("/") to serve the WiFi configuration page, stored gzip-compressed
+    // in flash (see scripts/embed_web.py). Repeat loads revalidate with the ETag and get a 304.
     _server.on("/", HTTP_GET, [](AsyncWebServerRequest *request)
                {
-                   request->send(200, "text/html", R"rawliteral(
-        <!DOCTYPE html>
-        <html>
-            <head>
-                <title>CardiacAI Hotspot Setup</title>
-                <meta name="viewport" content="width=device-width, initial-scale=1" />
-                <style>
-                    body {
-                        font-family: Arial, sans-serif;
-                        background-color: #f0f0f0;
-                        margin: 0;
-                        padding: 20px;
-                    }
-                    .container {
-                        background-color: #fff;
-                        padding: 20px;
-                        border-radius: 8px;
-                        box-shadow: 0 2px 4px rgba(0, 0, 0, 0.1);
-                        max-width: 400px;
-                        margin: 20px auto;
-                    }
-                    h2 {
-                        color: #333;
-                        text-align: center;
-                    }
-                    label {
-                        display: block;
-                        margin-bottom: 5px;
-                        color: #555;
-                    }
-                    .ssid,
-                    .password-container {
-                        width: calc(100% - 22px);
-                        padding: 10px;
-                        margin-bottom: 15px;
-                        border: 1px solid #ddd;
-                        border-radius: 4px;
-                    }
-
-                    .password-container {
-                        padding: 0 0;
-                        width: 100%;
-                    }
-                    .password-focus {
-                        border: 2px solid #007bff;
-                    }
-
-                    .password-text {
-                        display: inline-block;
-                    }
-                    .hidden {
-                        display: none;
-                    }
-                    #password {
-                        border: 0;
-                        padding: 10px;
-                        width: 80%;
-                        height: 100%;
-                    }
-                    #password:focus-visible {
-                        outline: 0;
-                    }
-                    button {
-                        background-color: #007bff;
-                        color: white;
-                        padding: 10px 15px;
-                        border: none;
-                        border-radius: 4px;
-                        cursor: pointer;
-                        width: 100%;
-                        font-size: 16px;
-                    }
-                    button:hover {
-                        background-color: #0056b3;
-                    }
-                    p {
-                        text-align: center;
-                        color: #666;
-                        font-size: 0.9em;
-                    }
-                    .status {
-                        text-align: center;
-                        margin-top: 15px;
-                        font-weight: bold;
-                    }
-                    #networksList {
-                        list-style: none;
-                        padding: 0;
-                        margin-top: 15px;
-                        border-top: 1px solid #eee;
-                    }
-                    #networksList li {
-                        padding: 8px 0;
-                        border-bottom: 1px solid #eee;
-                        cursor: pointer;
-                    }
-                    #networksList li:hover {
-                        background-color: #f9f9f9;
-                    }
-                </style>
-            </head>
-            <body>
-                <div class="container">
-                    <h2>CardiacAI WiFi Setup</h2>
-                    <form id="wifiForm">
-                        <label for="ssid">WiFi SSID:</label>
-                        <input
-                            type="text"
-                            class="ssid"
-                            id="ssid"
-                            name="ssid"
-                            tabindex="0"
-                            required
-                        /><br />
-                        <label for="password">WiFi Password:</label>
-                        <div class="password-container" tabindex="0">
-                            <input type="password" id="password" name="password" required />
-                            <p id="show-password" class="password-text">Show</p>
-                            <p id="hide-password" class="password-text hidden">Hide</p>
-                        </div>
-                        <br />
-                        <button type="submit">Save & Connect</button>
-                    </form>
-                    <p class="status" id="responseStatus"></p>
-
-                    <hr />
-                    <h3>Available WiFi Networks</h3>
-                    <button id="scanButton">Scan Networks</button>
-                    <p id="scanStatus"></p>
-                    <ul id="networksList"></ul>
-                </div>
-                <script>
-                    const showPassword = document.getElementById("show-password");
-                    const hidePassword = document.getElementById("hide-password");
-                    const passwordContainer = document.querySelector(".password-container");
-                    document
-                        .getElementById("wifiForm")
-                        .addEventListener("submit", async function (event) {
-                            event.preventDefault(); // Prevent default form submission
-                            const ssid = document.getElementById("ssid").value;
-                            const password = document.getElementById("password").value;
-                            const responseStatus = document.getElementById("responseStatus");
-
-                            responseStatus.textContent = "Saving...";
-                            responseStatus.style.color = "orange";
-
-                            try {
-                                // Send credentials as JSON to the /setupWifi endpoint
-                                const response = await fetch("/setupWifi", {
-                                    method: "POST",
-                                    headers: {
-                                        "Content-Type": "application/json",
-                                    },
-                                    body: JSON.stringify({ ssid: ssid, password: password }),
-                                });
-                                const data = await response.json(); // Parse the JSON response from the server
-
-                                if (response.ok) {
-                                    // Check if the HTTP status code is 2xx (success)
-                                    responseStatus.textContent =
-                                        data.message || "Credentials saved! Connecting to WiFi...";
-                                    responseStatus.style.color = "green";
-                                    // You might want to automatically redirect the user or provide further instructions here
-                                } else {
-                                    responseStatus.textContent =
-                                        data.error || "Failed to save credentials.";
-                                    responseStatus.style.color = "red";
-                                }
-                            } catch (error) {
-                                console.error("Error:", error); // Log any network or fetch errors
-                                responseStatus.textContent = "Network error. Try again.";
-                                responseStatus.style.color = "red";
-                            }
-                        });
-
-                    document
-                        .getElementById("scanButton")
-                        .addEventListener("click", async function () {
-                            const networksList = document.getElementById("networksList");
-                            const scanStatus = document.getElementById("scanStatus");
-                            scanStatus.textContent = "Scanning...";
-                            networksList.innerHTML = ""; // Clear previous list
-
-                            try {
-                                const response = await fetch("/scanNetworks");
-                                const networks = await response.json();
-
-                                if (networks.length === 0) {
-                                    scanStatus.textContent = "No networks found.";
-                                } else {
-                                    scanStatus.textContent = `Found ${networks.length} networks:`;
-                                    networks.forEach((net) => {
-                                        const li = document.createElement("li");
-                                        li.textContent = `${net.ssid} (RSSI: ${net.rssi})`;
-                                        li.dataset.ssid = net.ssid; // Store SSID in data attribute
-                                        li.addEventListener("click", function () {
-                                            document.getElementById("ssid").value = this.dataset.ssid;
-                                        });
-                                        networksList.appendChild(li);
-                                    });
-                                }
-                            } catch (error) {
-                                console.error("Error scanning networks:", error);
-                                scanStatus.textContent = "Error scanning networks.";
-                            }
-                        });
-
-                    // Optional: Trigger a scan on page load
-                    document.addEventListener("DOMContentLoaded", function () {
-                        document.getElementById("scanButton").click();
-                    });
-                    passwordContainer.addEventListener("click", (e) => {
-                        document.getElementById("password").focus();
-
-                        passwordContainer.classList.add("password-focus");
-                    });
-
-                    document.getElementById("password").addEventListener("blur", () => {
-                        passwordContainer.classList.remove("password-focus");
-                    });
-
-                    showPassword.addEventListener("click", () => {
-                        hidePassword.classList.remove("hidden");
-                        showPassword.classList.add("hidden");
-
-                        document.getElementById("password").type = "text";
-                    });
-
-                    hidePassword.addEventListener("click", () => {
-                        showPassword.classList.remove("hidden");
-                        hidePassword.classList.add("hidden");
-
-                        document.getElementById("password").type = "password";
-                    });
-                </script>
-            </body>
-        </html>
-        )rawliteral"); // R"rawliteral(...)rawliteral" allows multi-line string without escaping
+                   AsyncWebServerResponse *response;
+                   if (request->hasHeader("If-None-Match") &&
+                       request->header("If-None-Match").indexOf(SETUP_PAGE_ETAG) >= 0) {
+                       response = request->beginResponse(304);
+                   } else {
+                       response = request->beginResponse(200, "text/html", SETUP_PAGE_GZ, SETUP_PAGE_GZ_LENGTH);
+                       response->addHeader("Content-Encoding", "gzip");
+                   }
+                   response->addHeader("ETag", SETUP_PAGE_ETAG);
+                   response->addHeader("Cache-Control", SETUP_PAGE_CACHE_CONTROL);
+                   request->send(response);
                });
 
-    // Define the new /scanNetworks route to perform and return WiFi scan results.
+    // Define the /scanNetworks route to return the cached WiFi scan results without blocking.
     _server.on("/scanNetworks", HTTP_GET, [this](AsyncWebServerRequest *request)
                { request->send(200, "application/json", getScannedNetworksJson()); });
 
@@ -294,18 +79,68 @@ void HotspotWebServer::begin()
                 return;
             }
 
-            // Serial.printf("[HotspotWebServer] Received new credentials: SSID='%s'\n", ssid);
+            if (strlen(ssid) > WIFI_MAX_SSID_LENGTH || strlen(password) > WIFI_MAX_PASSWORD_LENGTH) {
+                request->send(400, "application/json", "{\"error\":\"SSID or password too long\"}");
+                return;
+            }
 
-            // Save the new WiFi credentials using the WirelessCommunication instance.
-            _wirelessComm.saveWiFiCredentials(ssid, password);
+            // The network task still has the previous credentials to take.
+            if (_wifiSwitchRequested) {
+                request->send(503, "application/json", "{\"error\":\"Busy, try again\"}");
+                return;
+            }
+
+            // Serial.printf("[HotspotWebServer] Received new credentials: SSID='%s'\n", ssid);
 
-            // Set the flag to indicate that a WiFi switch is requested.
-            // The actual mode change will be handled in the main loop.
+            // Hand the credentials to the network task, which saves them (the WiFi settings
+            // are not safe to change from this task) and then switches to station mode.
+            strcpy(_requestedSsid, ssid);
+            strcpy(_requestedPassword, password);
             _wifiSwitchRequested = true;
 
             // Send success response FIRST, then set flag for main loop to switch WiFi mode.
             request->send(200, "application/json", "{\"message\":\"WiFi credentials saved! Attempting to connect to WiFi in a moment...\"}"); });
 
+    // Define the /deviceSettings route to return the stored device settings.
+    _server.on("/deviceSettings", HTTP_GET, [this](AsyncWebServerRequest *request)
+               { request->send(200, "application/json", getDeviceSettingsJson()); });
+
+    // Define the /setupDevice POST route to receive new device settings.
+    _server.on("/setupDevice", HTTP_POST,
+               [](AsyncWebServerRequest *request) {}, // No file upload handler
+               NULL,
+               [this](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+               {
+            JsonDocument doc;
+            DeserializationError error = deserializeJson(doc, data, len);
+            if (error) {
+                request->send(400, "application/json", "{\"error\":\"Invalid JSON format\"}");
+                return;
+            }
+
+            // Fields left out keep their stored value.
+            DeviceSettingsValues values = _deviceSettings.stored();
+            const char *problem = parseDeviceSettings(doc, values);
+            if (problem == nullptr) {
+                problem = _deviceSettings.save(values); // Validates and commits to flash
+            }
+            if (problem != nullptr) {
+                JsonDocument reply;
+                reply["error"] = problem;
+                String body;
+                serializeJson(reply, body);
+                request->send(400, "application/json", body);
+                return;
+            }
+
+            // The settings are only loaded at boot; the main loop restarts once this response is out.
+            _restartRequested = true;
+            _restartRequestMs = millis();
+            request->send(200, "application/json", "{\"message\":\"Device settings saved! Restarting in a moment...\"}"); });
+
+    // WebSocket endpoint streaming the live ECG to the setup page and other local viewers.
+    _liveStream.attach(_server);
+
     _server.begin(); // Start the server, making it listen for incoming connections.
     // Serial.println("[HotspotWebServer] Web server started on Hotspot mode (port 80).");
 }
@@ -313,36 +148,72 @@ void HotspotWebServer::begin()
 // Stops the web server.
 void HotspotWebServer::end()
 {
+    _liveStream.detach(_server); // Closes any live viewers
     _server.end(); // Stops the server instance.
     // Serial.println("[HotspotWebServer] Web server stopped.");
 }
 
-// Helper function to perform a WiFi scan and return results as a JSON array.
-String HotspotWebServer::getScannedNetworksJson()
+// Returns the cached scan results, collecting a finished scan and starting a new one when stale.
+const char *HotspotWebServer::getScannedNetworksJson()
+{
+    int16_t state = WiFi.scanComplete();
+    if (state >= 0)
+    {
+        // Serial.printf("[HotspotWebServer] Scan done. Found %d networks.\n", state);
+        cacheScanResults(state);
+        state = WIFI_SCAN_FAILED; // Results freed; no scan running
+    }
+
+    uint32_t now = millis();
+    bool stale = !_scanCached || now - _scanTimeMs >= WIFI_SCAN_CACHE_TTL_MS;
+    if (stale && state != WIFI_SCAN_RUNNING)
+    {
+        // Serial.println("[HotspotWebServer] Starting WiFi scan...");
+        // Asynchronous: returns at once, the results are collected by a later request.
+        state = WiFi.scanNetworks(true);
+        _scanFailed = state == WIFI_SCAN_FAILED;
+    }
+
+    const char *status = state == WIFI_SCAN_RUNNING ? "scanning" : (_scanFailed && !_scanCached ? "failed" : "done");
+    snprintf(_scanResponse, sizeof(_scanResponse), "{\"status\":\"%s\",\"age_ms\":%lu,\"networks\":%s}", status,
+             _scanCached ? (unsigned long)(now - _scanTimeMs) : 0UL, _scanJson);
+    return _scanResponse;
+}
+
+// Serializes a finished scan into the cache buffer.
+void HotspotWebServer::cacheScanResults(int16_t count)
 {
-    // Serial.println("[HotspotWebServer] Starting WiFi scan...");
-    // Scan for WiFi networks. 'true' for hidden networks, 'false' for blocking scan.
-    // For a web server, a blocking scan is generally not ideal as it can freeze the server.
-    // However, for simplicity here, we use blocking. Consider asynchronous scanning for production.
-    int n = WiFi.scanNetworks();
-    // Serial.printf("[HotspotWebServer] Scan done. Found %d networks.\n", n);
-
-    JsonDocument doc; // Adjust size based on expected number of networks
+    JsonDocument doc;
     JsonArray networksArray = doc.to<JsonArray>();
 
-    for (int i = 0; i < n; ++i)
+    for (int i = 0; i < count && networksArray.size() < WIFI_SCAN_MAX_NETWORKS; ++i)
     {
+        String ssid = WiFi.SSID(i);
+        if (ssid.length() == 0)
+        {
+            continue; // Hidden network; it cannot be picked from the list
+        }
         JsonObject network = networksArray.add<JsonObject>();
-        network["ssid"] = WiFi.SSID(i);
+        network["ssid"] = ssid;
         network["rssi"] = WiFi.RSSI(i); // Signal strength
         network["channel"] = WiFi.channel(i);
-        // Add more details like encryption type if needed: WiFi.encryptionType(i)
+        if (measureJson(doc) >= sizeof(_scanJson))
+        {
+            networksArray.remove(networksArray.size() - 1); // Keep the array whole within the buffer
+            break;
+        }
     }
 
-    String jsonOutput;
-    // SerializeJson(doc, jsonOutput);
+    serializeJson(doc, _scanJson, sizeof(_scanJson));
     WiFi.scanDelete(); // Clear scan results to free memory
-    return jsonOutput;
+    _scanCached = true;
+    _scanFailed = false;
+    _scanTimeMs = millis();
+}
+
+ECGLiveStream &HotspotWebServer::liveStream()
+{
+    return _liveStream;
 }
 
 bool HotspotWebServer::isWifiSwitchRequested()
@@ -350,7 +221,126 @@ bool HotspotWebServer::isWifiSwitchRequested()
     return _wifiSwitchRequested;
 }
 
+const char *HotspotWebServer::getRequestedSsid() const
+{
+    return _requestedSsid;
+}
+
+const char *HotspotWebServer::getRequestedPassword() const
+{
+    return _requestedPassword;
+}
+
 void HotspotWebServer::resetWifiSwitchRequest()
 {
     _wifiSwitchRequested = false;
 }
+
+bool HotspotWebServer::isRestartRequested()
+{
+    return _restartRequested && millis() - _restartRequestMs >= DEVICE_RESTART_DELAY_MS;
+}
+
+void HotspotWebServer::resetRestartRequest()
+{
+    _restartRequested = false;
+}
+
+// Serializes the stored settings; device_id is empty while the MAC-derived ID is in use.
+const char *HotspotWebServer::getDeviceSettingsJson()
+{
+    const DeviceSettingsValues &stored = _deviceSettings.stored();
+    JsonDocument doc;
+    doc["device_id"] = stored.deviceId;
+    doc["default_device_id"] = _deviceSettings.getDefaultDeviceId();
+    doc["active_device_id"] = _deviceSettings.active().deviceId;
+    doc["server_host"] = stored.serverHost;
+    doc["server_port"] = stored.serverPort;
+    doc["server_path"] = stored.serverPath;
+    doc["sample_rate_hz"] = stored.sampleRateHz;
+    doc["batch_samples"] = stored.batchSamples;
+    doc["batch_delay_ms"] = stored.batchDelayMs;
+    doc["compress"] = stored.compress;
+    doc["burst_interval_ms"] = stored.burstIntervalMs;
+    doc["restart_pending"] = _restartRequested;
+    serializeJson(doc, _settingsJson, sizeof(_settingsJson));
+    return _settingsJson;
+}
+
+// Copies a string field into a fixed buffer; a missing field leaves it alone.
+template <typename TField>
+static bool readText(TField field, char *dest, size_t size)
+{
+    if (field.isNull())
+    {
+        return true;
+    }
+    const char *text = field.template as<const char *>();
+    if (!field.template is<const char *>() || strlen(text) >= size)
+    {
+        return false;
+    }
+    memcpy(dest, text, strlen(text) + 1);
+    return true;
+}
+
+// Reads a 16-bit unsigned field; a missing field leaves dest alone.
+template <typename TField>
+static bool readNumber(TField field, uint16_t &dest)
+{
+    if (field.isNull())
+    {
+        return true;
+    }
+    if (!field.template is<uint16_t>())
+    {
+        return false;
+    }
+    dest = field.template as<uint16_t>();
+    return true;
+}
+
+const char *HotspotWebServer::parseDeviceSettings(JsonDocument &doc, DeviceSettingsValues &values)
+{
+    if (!readText(doc["device_id"], values.deviceId, sizeof(values.deviceId)))
+    {
+        return "device_id must be a string of at most 32 characters";
+    }
+    if (!readText(doc["server_host"], values.serverHost, sizeof(values.serverHost)))
+    {
+        return "server_host must be a string of at most 63 characters";
+    }
+    if (!readNumber(doc["server_port"], values.serverPort))
+    {
+        return "server_port must be a number from 1 to 65535";
+    }
+    if (!readText(doc["server_path"], values.serverPath, sizeof(values.serverPath)))
+    {
+        return "server_path must be a string of at most 63 characters";
+    }
+    if (!readNumber(doc["sample_rate_hz"], values.sampleRateHz))
+    {
+        return "sample_rate_hz must be a number";
+    }
+    if (!readNumber(doc["batch_samples"], values.batchSamples))
+    {
+        return "batch_samples must be a number";
+    }
+    if (!readNumber(doc["batch_delay_ms"], values.batchDelayMs))
+    {
+        return "batch_delay_ms must be a number";
+    }
+    if (!doc["compress"].isNull())
+    {
+        if (!doc["compress"].is<bool>())
+        {
+            return "compress must be true or false";
+        }
+        values.compress = doc["compress"].as<bool>();
+    }
+    if (!readNumber(doc["burst_interval_ms"], values.burstIntervalMs))
+    {
+        return "burst_interval_ms must be a number";
+    }
+    return nullptr;
+}
@@ -0,0 +1,83 @@
+// LEDPattern.cpp
+// This file defines the LED patterns and implements the methods of the LEDPatternPlayer class.
+
+#include "LEDPattern.h"
+
+#define LED_OFF {0, 0, 0}
+#define LED_RED {255, 0, 0}
+#define LED_GREEN {0, 255, 0}
+#define LED_BLUE {0, 0, 255}
+
+static const LEDStep kBootSteps[] = {
+    {LED_RED, 500, false},
+    {LED_GREEN, 500, false},
+    {LED_BLUE, 500, false},
+    {LED_OFF, 500, false},
+};
+const LEDPattern LED_PATTERN_BOOT = {kBootSteps, 4, 1};
+
+static const LEDStep kBlinkGreenSteps[] = {
+    {LED_GREEN, 300, false},
+    {LED_OFF, 300, false},
+};
+const LEDPattern LED_PATTERN_BLINK_GREEN = {kBlinkGreenSteps, 2, 0};
+
+static const LEDStep kBreatheGreenSteps[] = {
+    {LED_GREEN, 1000, true},
+    {LED_OFF, 1000, true},
+};
+const LEDPattern LED_PATTERN_BREATHE_GREEN = {kBreatheGreenSteps, 2, 0};
+
+/**
+ * @brief Returns the channel value a fraction elapsed/duration of the way from one value to another.
+ */
+static uint8_t ramp(uint8_t from, uint8_t to, uint32_t elapsed, uint32_t duration) {
+    int32_t delta = static_cast<int32_t>(to) - static_cast<int32_t>(from);
+    return static_cast<uint8_t>(from + delta * static_cast<int32_t>(elapsed) / static_cast<int32_t>(duration));
+}
+
+LEDPatternPlayer::LEDPatternPlayer() : _pattern(nullptr), _startMs(0), _cycleMs(0) {}
+
+void LEDPatternPlayer::play(const LEDPattern *pattern, uint32_t nowMs) {
+    _pattern = pattern;
+    _startMs = nowMs;
+    _cycleMs = 0;
+    for (uint8_t i = 0; pattern != nullptr && i < pattern->stepCount; i++) {
+        _cycleMs += pattern->steps[i].durationMs;
+    }
+    if (_cycleMs == 0) {
+        _pattern = nullptr; // Nothing to show
+    }
+}
+
+const LEDPattern *LEDPatternPlayer::current() const {
+    return _pattern;
+}
+
+bool LEDPatternPlayer::colorAt(uint32_t nowMs, LEDColor &color) const {
+    if (_pattern == nullptr) {
+        return false;
+    }
+    uint32_t elapsed = nowMs - _startMs;
+    if (_pattern->repeats != 0 && elapsed / _cycleMs >= _pattern->repeats) {
+        return false;
+    }
+    uint32_t position = elapsed % _cycleMs;
+    for (uint8_t i = 0; i < _pattern->stepCount; i++) {
+        const LEDStep &step = _pattern->steps[i];
+        if (position >= step.durationMs) {
+            position -= step.durationMs;
+            continue;
+        }
+        if (!step.fade) {
+            color = step.color;
+            return true;
+        }
+        const LEDColor &from = _pattern->steps[i > 0 ? i - 1 : _pattern->stepCount - 1].color;
+        color.red = ramp(from.red, step.color.red, position, step.durationMs);
+        color.green = ramp(from.green, step.color.green, position, step.durationMs);
+        color.blue = ramp(from.blue, step.color.blue, position, step.durationMs);
+        return true;
+    }
+    return false; // Not reached: position < _cycleMs
+}
@@ -3,6 +3,11 @@
 
 #include "PeripheralHandler.h" // Include the corresponding header file
 
+// Bit positions of the channels in the packed steady color
+#define STEADY_RED_SHIFT 16
+#define STEADY_GREEN_SHIFT 8
+#define STEADY_BLUE_SHIFT 0
+
 // Initialize the global pointer to null initially
 PeripheralHandler* globalPeripheralHandler = nullptr;
 
@@ -12,7 +17,10 @@ PeripheralHandler::PeripheralHandler(int redPin, int greenPin, int bluePin, int
     _greenPin(greenPin),
     _bluePin(bluePin),
     _buttonPin(buttonPin),
-    _button({.lastPressTime = 0, .nPresses = 0})
+    _steadyColor(0),
+    _requestedPattern(nullptr),
+    _ledTimer(nullptr),
+    _shown{0, 0, 0}
 {
     // Set the global pointer to this instance.
     // This allows the static ISR function to call a member function of this object.
@@ -21,100 +29,143 @@ PeripheralHandler::PeripheralHandler(int redPin, int greenPin, int bluePin, int
 
 // Initializes pins for LED and button
 void PeripheralHandler::begin() {
-    pinMode(_redPin, OUTPUT);
-    pinMode(_greenPin, OUTPUT);
-    pinMode(_bluePin, OUTPUT);
-    turnOff();
+    if (_ledTimer != nullptr) {
+        return; // Already running
+    }
+    ledcAttach(_redPin, LED_PWM_FREQUENCY_HZ, LED_PWM_RESOLUTION_BITS);
+    ledcAttach(_greenPin, LED_PWM_FREQUENCY_HZ, LED_PWM_RESOLUTION_BITS);
+    ledcAttach(_bluePin, LED_PWM_FREQUENCY_HZ, LED_PWM_RESOLUTION_BITS);
+    ledcWrite(_redPin, 0);
+    ledcWrite(_greenPin, 0);
+    ledcWrite(_bluePin, 0);
+    _shown = {0, 0, 0};
 
     pinMode(_buttonPin, INPUT_PULLUP);
-    attachInterrupt(digitalPinToInterrupt(_buttonPin), onButtonInterrupt, FALLING);
+    attachInterrupt(digitalPinToInterrupt(_buttonPin), onButtonInterrupt, CHANGE);
+
+    // The tick runs in the esp_timer task, so patterns keep playing whatever the loop does.
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = &PeripheralHandler::_onLedTimer;
+    timerArgs.arg = this;
+    timerArgs.dispatch_method = ESP_TIMER_TASK;
+    timerArgs.name = "led_pattern";
+    if (esp_timer_create(&timerArgs, &_ledTimer) != ESP_OK) {
+        // Serial.println("[PeripheralHandler] Failed to create LED timer.");
+        _ledTimer = nullptr;
+        return;
+    }
+    esp_timer_start_periodic(_ledTimer, LED_TICK_MS * 1000ULL);
 
     // Serial.println("[PeripheralHandler] Initialized LED and Button.");
 }
 
 void PeripheralHandler::setBlue(int bState) {
-    digitalWrite(_bluePin, bState);
+    _setSteadyChannel(STEADY_BLUE_SHIFT, bState);
     // // Serial.println("[LED] Set to Blue (WiFi Connected, WS Connected)");
 }
 
 void PeripheralHandler::setGreen(int gState) {
-    digitalWrite(_greenPin, gState);
+    _setSteadyChannel(STEADY_GREEN_SHIFT, gState);
     // // Serial.println("[LED] Set to Green (WiFi Connected, WS Disconnected)");
 }
 
 void PeripheralHandler::setRed(int rState) {
-    digitalWrite(_redPin, rState);
+    _setSteadyChannel(STEADY_RED_SHIFT, rState);
     // // Serial.println("[LED] Set to Red (Hotspot Mode)");
 }
 
 void PeripheralHandler::turnOff() {
-    _setColor(LOW, LOW, LOW);
+    _steadyColor.store(0);
     // // Serial.println("[LED] Turned Off");
 }
 
-void PeripheralHandler::toggleGreenSixTimes(unsigned long delayTime = 300) {
-  bool originalState = digitalRead(_greenPin);
+void PeripheralHandler::playPattern(const LEDPattern &pattern) {
+    _requestedPattern.store(&pattern);
+}
+
+void PeripheralHandler::stopPattern(const LEDPattern *pattern) {
+    if (pattern == nullptr) {
+        _requestedPattern.store(nullptr);
+    } else {
+        _requestedPattern.compare_exchange_strong(pattern, nullptr);
+    }
+}
 
-  for (int i = 0; i < 6; i++) {
-    digitalWrite(_greenPin, !digitalRead(_greenPin));
-    delay(delayTime);
-  }
+bool PeripheralHandler::isPatternPlaying() const {
+    return _requestedPattern.load() != nullptr;
+}
 
-  // Ensure the pin returns to its original state
-  digitalWrite(_greenPin, originalState);
+ButtonEvent PeripheralHandler::takeButtonEvent() {
+    ButtonEdge edge;
+    while (_edges.pop(edge)) {
+        _clicks.edge(edge.pressed, edge.timeMs);
+    }
+    _clicks.poll(millis());
+    return _clicks.takeEvent();
 }
 
+void PeripheralHandler::_setSteadyChannel(int shift, int state) {
+    uint32_t mask = 0xFFUL << shift;
+    if (state) {
+        _steadyColor.fetch_or(mask);
+    } else {
+        _steadyColor.fetch_and(~mask);
+    }
+}
 
-// Helper function to set individual LED states
-void PeripheralHandler::_setColor(int rState, int gState, int bState) {
-    digitalWrite(_redPin, rState);
-    digitalWrite(_greenPin, gState);
-    digitalWrite(_bluePin, bState);
+// Helper function to write the LED channels that changed
+void PeripheralHandler::_setColor(const LEDColor &color) {
+    if (color.red != _shown.red) {
+        ledcWrite(_redPin, color.red);
+    }
+    if (color.green != _shown.green) {
+        ledcWrite(_greenPin, color.green);
+    }
+    if (color.blue != _shown.blue) {
+        ledcWrite(_bluePin, color.blue);
+    }
+    _shown = color;
 }
 
-unsigned int PeripheralHandler::getAndResetClickCount() {
-    unsigned int clicks = 0;
-    if (_button.nPresses > 0) {
-        unsigned long currentTime = millis();
-        if (currentTime - _button.lastPressTime > MULTI_CLICK_TIMEOUT_MS) {
-            // Disable interrupts briefly to safely read and reset volatile variables
-            noInterrupts();
-            clicks = _button.nPresses;
-            _button.nPresses = 0;
-            interrupts();
+void PeripheralHandler::_tick() {
+    uint32_t now = millis();
+    const LEDPattern *requested = _requestedPattern.load();
+    if (requested != _player.current()) {
+        _player.play(requested, now);
+    }
 
-            // Serial.printf("[PeripheralHandler] Detected %u clicks.\n", clicks);
-            return clicks;
-        }
-        else {
-            // If we are still within the timeout, we return the current count without resetting
-            // Serial.printf("[PeripheralHandler] Clicks in progress: %u\n", _button.nPresses);
-            delay(MULTI_CLICK_TIMEOUT_MS);
-            clicks = _button.nPresses; // Capture the current count
-            _button.nPresses = 0;
-            return clicks;
+    LEDColor color;
+    if (!_player.colorAt(now, color)) {
+        if (requested != nullptr) {
+            // Played all its repeats; unless a new pattern was requested meanwhile, it is done.
+            _requestedPattern.compare_exchange_strong(requested, nullptr);
+            _player.play(nullptr, now);
         }
+        uint32_t steady = _steadyColor.load();
+        color.red = static_cast<uint8_t>(steady >> STEADY_RED_SHIFT);
+        color.green = static_cast<uint8_t>(steady >> STEADY_GREEN_SHIFT);
+        color.blue = static_cast<uint8_t>(steady >> STEADY_BLUE_SHIFT);
     }
-    return 0;
+    _setColor(color);
+}
+
+void PeripheralHandler::_onLedTimer(void *arg) {
+    static_cast<PeripheralHandler *>(arg)->_tick();
 }
 
 
 // ISR function - called directly by the hardware interrupt
 void IRAM_ATTR onButtonInterrupt() {
     if (globalPeripheralHandler != nullptr) {
-        globalPeripheralHandler->_handleButtonPress();
+        globalPeripheralHandler->_handleButtonEdge();
     }
     else {
         // Serial.println("[PeripheralHandler] Error: Global instance pointer is null in ISR.");
     }
 }
 
-// Private method called by the ISR to handle button press logic
-void PeripheralHandler::_handleButtonPress() {
-    unsigned long currentTime = millis();
-    if (currentTime - _button.lastPressTime > CLICK_DEBOUNCE_MS) {
-        _button.lastPressTime = currentTime;
-        _button.nPresses = _button.nPresses + 1;
-        // Serial.printf("[PeripheralHandler] ISR: Press detected, count = %u\n", _button.nPresses);
-    }
-}
\ No newline at end of file
+// Public method called by the ISR to queue the new button level
+void PeripheralHandler::_handleButtonEdge() {
+    ButtonEdge edge = {static_cast<uint32_t>(millis()), digitalRead(_buttonPin) == LOW};
+    _edges.push(edge); // A full queue drops the edge; the classifier resyncs on the next one
+}
@@ -0,0 +1,145 @@
+// PersistentConfig.cpp
+// This file implements the methods defined in the PersistentConfig class.
+
+#include "PersistentConfig.h"
+
+static const String kEmptyString;
+
+PersistentConfig::PersistentConfig(const char *ns)
+    : _namespace(ns), _open(false), _entryCount(0), _dirty(false), _lastChangeMs(0), _writeCount(0) {}
+
+bool PersistentConfig::begin() {
+    if (!_open) {
+        // Kept open for the lifetime of the object; Preferences only touches flash on put/get.
+        _open = _prefs.begin(_namespace, false);
+    }
+    return _open;
+}
+
+bool PersistentConfig::addString(const char *key, const char *defaultValue) {
+    if (_find(key) != nullptr) {
+        return true;
+    }
+    if (_entryCount >= CONFIG_MAX_ENTRIES) {
+        return false;
+    }
+    Entry &entry = _entries[_entryCount++];
+    entry.key = key;
+    entry.type = EntryType::String;
+    entry.dirty = false;
+    entry.number = 0;
+    // isKey() first: reading a missing key makes the NVS driver log an error.
+    entry.text = (begin() && _prefs.isKey(key)) ? _prefs.getString(key, defaultValue) : String(defaultValue);
+    return true;
+}
+
+bool PersistentConfig::addUInt(const char *key, uint32_t defaultValue) {
+    if (_find(key) != nullptr) {
+        return true;
+    }
+    if (_entryCount >= CONFIG_MAX_ENTRIES) {
+        return false;
+    }
+    Entry &entry = _entries[_entryCount++];
+    entry.key = key;
+    entry.type = EntryType::UInt;
+    entry.dirty = false;
+    entry.number = (begin() && _prefs.isKey(key)) ? _prefs.getUInt(key, defaultValue) : defaultValue;
+    return true;
+}
+
+const String &PersistentConfig::getString(const char *key) const {
+    const Entry *entry = _find(key);
+    return (entry != nullptr && entry->type == EntryType::String) ? entry->text : kEmptyString;
+}
+
+uint32_t PersistentConfig::getUInt(const char *key) const {
+    const Entry *entry = _find(key);
+    return (entry != nullptr && entry->type == EntryType::UInt) ? entry->number : 0;
+}
+
+bool PersistentConfig::setString(const char *key, const char *value) {
+    Entry *entry = _find(key);
+    if (entry == nullptr || entry->type != EntryType::String) {
+        return false;
+    }
+    if (entry->text != value) {
+        entry->text = value;
+        _markDirty(*entry);
+    }
+    return true;
+}
+
+bool PersistentConfig::setUInt(const char *key, uint32_t value) {
+    Entry *entry = _find(key);
+    if (entry == nullptr || entry->type != EntryType::UInt) {
+        return false;
+    }
+    if (entry->number != value) {
+        entry->number = value;
+        _markDirty(*entry);
+    }
+    return true;
+}
+
+bool PersistentConfig::commit() {
+    if (!_dirty) {
+        return true;
+    }
+    if (!begin()) {
+        return false;
+    }
+
+    bool ok = true;
+    for (uint8_t i = 0; i < _entryCount; i++) {
+        Entry &entry = _entries[i];
+        if (!entry.dirty) {
+            continue;
+        }
+        size_t written = (entry.type == EntryType::String) ? _prefs.putString(entry.key, entry.text)
+                                                            : _prefs.putUInt(entry.key, entry.number);
+        if (written == 0) {
+            ok = false; // Stays dirty and is retried on the next commit
+            continue;
+        }
+        entry.dirty = false;
+        _writeCount++;
+    }
+    _dirty = !ok;
+    return ok;
+}
+
+void PersistentConfig::loop(uint32_t nowMs) {
+    if (_dirty && nowMs - _lastChangeMs >= CONFIG_COMMIT_DELAY_MS) {
+        if (!commit()) {
+            _lastChangeMs = nowMs; // Back off before retrying a failed write
+        }
+    }
+}
+
+bool PersistentConfig::isDirty() const {
+    return _dirty;
+}
+
+uint32_t PersistentConfig::getWriteCount() const {
+    return _writeCount;
+}
+
+PersistentConfig::Entry *PersistentConfig::_find(const char *key) {
+    for (uint8_t i = 0; i < _entryCount; i++) {
+        if (strcmp(_entries[i].key, key) == 0) {
+            return &_entries[i];
+        }
+    }
+    return nullptr;
+}
+
+const PersistentConfig::Entry *PersistentConfig::_find(const char *key) const {
+    return const_cast<PersistentConfig *>(this)->_find(key);
+}
+
+void PersistentConfig::_markDirty(Entry &entry) {
+    entry.dirty = true;
+    _dirty = true;
+    _lastChangeMs = millis();
+}
@@ -0,0 +1,256 @@
+// QRSDetector.cpp
+// This file implements the methods defined in the QRSDetector class.
+
+#include "QRSDetector.h"
+
+#include <string.h>
+
+// Raw samples are centred on the ADC mid-scale (see ECGFilter).
+static const int32_t kMidscale = 2048;
+
+// R-R intervals longer than this are treated as gaps in the signal, not as a heart rate.
+static const uint32_t kMaxRRIntervalMs = 3000;
+
+QRSDetector::QRSDetector() {
+    configure(ECGSampleRate::Hz125);
+}
+
+void QRSDetector::configure(ECGSampleRate rate) {
+    _sampleRateHz = static_cast<uint16_t>(rate);
+    _windowLength = static_cast<uint16_t>((_sampleRateHz * 150UL) / 1000UL);
+    if (_windowLength > QRS_MAX_WINDOW_SAMPLES) {
+        _windowLength = QRS_MAX_WINDOW_SAMPLES;
+    }
+    _refractoryUs = 200000UL;
+    _learningUs = 2000000UL;
+    _earlierBeatCount = 0;
+    reset();
+}
+
+void QRSDetector::reset() {
+    memset(_history, 0, sizeof(_history));
+    memset(_window, 0, sizeof(_window));
+    _windowIndex = 0;
+    _windowSum = 0;
+
+    _candidatePeak = 0;
+    _rising = false;
+    _candidateRAmplitude = 0;
+    _candidateRTimeUs = 0;
+
+    _signalPeak = 0;
+    _noisePeak = 0;
+    _learningMax = 0;
+    _learningSum = 0;
+    _learningCount = 0;
+    _startTimeUs = 0;
+    _learning = true;
+    _started = false;
+
+    _searchBackPeak = 0;
+    _searchBackTimeUs = 0;
+
+    _haveBeat = false;
+    _lastBeatUs = 0;
+    _clearRRHistory();
+}
+
+bool QRSDetector::process(int value, uint32_t timestampUs, uint32_t &beatTimeUs) {
+    if (!_started) {
+        _startTimeUs = timestampUs;
+        _started = true;
+    }
+
+    // Five-point derivative: emphasises the steep QRS slopes over P and T waves.
+    int32_t x = value - kMidscale;
+    int32_t d = 2 * x + _history[0] - _history[2] - 2 * _history[3];
+    _history[3] = _history[2];
+    _history[2] = _history[1];
+    _history[1] = _history[0];
+    _history[0] = x;
+
+    // Squaring and moving-window integration.
+    uint32_t squared = static_cast<uint32_t>(d * d);
+    _windowSum -= _window[_windowIndex];
+    _window[_windowIndex] = squared;
+    _windowSum += squared;
+    if (++_windowIndex >= _windowLength) {
+        _windowIndex = 0;
+    }
+    uint32_t integrated = static_cast<uint32_t>(_windowSum / _windowLength);
+
+    bool beat = false;
+
+    if (_learning) {
+        // Seed the thresholds from the first couple of seconds of signal.
+        if (integrated > _learningMax) {
+            _learningMax = integrated;
+        }
+        _learningSum += integrated;
+        _learningCount++;
+        if (timestampUs - _startTimeUs >= _learningUs) {
+            _signalPeak = _learningMax / 3;
+            _noisePeak = static_cast<uint32_t>(_learningSum / _learningCount) / 2;
+            _learning = false;
+        }
+    }
+
+    // A peak is complete once the integrated signal falls to half its maximum. While it
+    // rises, the largest filtered amplitude marks the R wave.
+    int32_t amplitude = (x < 0) ? -x : x;
+    if (integrated > _candidatePeak) {
+        if (!_rising) {
+            _candidateRAmplitude = 0;
+        }
+        _candidatePeak = integrated;
+        _rising = true;
+    } else if (_rising && integrated < _candidatePeak / 2) {
+        _rising = false;
+        if (!_learning) {
+            _onPeak(_candidatePeak, _candidateRTimeUs, beat);
+        }
+        _candidatePeak = integrated;
+    } else if (!_rising) {
+        _candidatePeak = integrated;
+    }
+    if (_rising && amplitude > _candidateRAmplitude) {
+        _candidateRAmplitude = amplitude;
+        _candidateRTimeUs = timestampUs;
+    }
+
+    // Search-back: no beat for 166% of the average R-R interval means one was probably
+    // missed; accept the best peak above half the threshold.
+    if (!beat && !_learning && _rrCount > 0 && _searchBackPeak > 0) {
+        uint32_t averageRRUs = (_rrSum / _rrCount) * 1000UL;
+        uint32_t sinceBeatUs = timestampUs - _lastBeatUs;
+        if (sinceBeatUs > (averageRRUs / 100UL) * 166UL && _searchBackPeak > _threshold() / 2) {
+            _signalPeak = (_searchBackPeak + 3 * _signalPeak) / 4;
+            beat = _acceptBeat(_searchBackTimeUs);
+            _searchBackPeak = 0;
+        }
+    }
+
+    if (beat) {
+        beatTimeUs = _lastBeatUs;
+    } else if (_rrCount > 0 && timestampUs - _lastBeatUs > kMaxRRIntervalMs * 1000UL) {
+        // No beat for longer than any heart rate allows (asystole, or the R waves got lost
+        // with the leads still on): the last rate no longer describes the signal.
+        _clearRRHistory();
+    }
+    return beat;
+}
+
+size_t QRSDetector::processSamples(ECGSample *samples, size_t count) {
+    size_t beats = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (samples[i].flags & ECG_SAMPLE_FLAG_LEAD_OFF) {
+            // Lead-off noise would poison the learned thresholds; start over once leads are back.
+            reset();
+            continue;
+        }
+        uint32_t beatTimeUs;
+        if (!process(samples[i].value, samples[i].timestampUs, beatTimeUs)) {
+            continue;
+        }
+        beats++;
+        // Flag the R peak, which is a few samples back or, after a search-back, possibly in
+        // a block that has already been passed on.
+        size_t r = i + 1;
+        while (r > 0 && samples[r - 1].timestampUs != beatTimeUs) {
+            r--;
+        }
+        if (r > 0) {
+            samples[r - 1].flags |= ECG_SAMPLE_FLAG_BEAT;
+            continue;
+        }
+        if (_earlierBeatCount == QRS_EARLIER_BEATS) {
+            memmove(_earlierBeatsUs, _earlierBeatsUs + 1, sizeof(_earlierBeatsUs[0]) * (QRS_EARLIER_BEATS - 1));
+            _earlierBeatCount--;
+        }
+        _earlierBeatsUs[_earlierBeatCount++] = beatTimeUs;
+    }
+    return beats;
+}
+
+bool QRSDetector::takeEarlierBeat(uint32_t &beatTimeUs) {
+    if (_earlierBeatCount == 0) {
+        return false;
+    }
+    beatTimeUs = _earlierBeatsUs[0];
+    _earlierBeatCount--;
+    memmove(_earlierBeatsUs, _earlierBeatsUs + 1, sizeof(_earlierBeatsUs[0]) * _earlierBeatCount);
+    return true;
+}
+
+uint16_t QRSDetector::getLastRRIntervalMs() const {
+    if (_rrCount == 0) {
+        return 0;
+    }
+    return _rrHistory[(_rrIndex + QRS_RR_HISTORY - 1) % QRS_RR_HISTORY];
+}
+
+uint16_t QRSDetector::getInstantHeartRateX10() const {
+    uint16_t rr = getLastRRIntervalMs();
+    return rr == 0 ? 0 : static_cast<uint16_t>(600000UL / rr);
+}
+
+uint16_t QRSDetector::getAverageHeartRateX10() const {
+    if (_rrCount == 0) {
+        return 0;
+    }
+    return static_cast<uint16_t>((600000UL * _rrCount) / _rrSum);
+}
+
+uint32_t QRSDetector::getLastBeatTimestampUs() const {
+    return _lastBeatUs;
+}
+
+void QRSDetector::_clearRRHistory() {
+    memset(_rrHistory, 0, sizeof(_rrHistory));
+    _rrCount = 0;
+    _rrIndex = 0;
+    _rrSum = 0;
+}
+
+uint32_t QRSDetector::_threshold() const {
+    if (_signalPeak <= _noisePeak) {
+        return _noisePeak;
+    }
+    return _noisePeak + (_signalPeak - _noisePeak) / 4;
+}
+
+void QRSDetector::_onPeak(uint32_t peak, uint32_t beatTimeUs, bool &beat) {
+    bool outsideRefractory = !_haveBeat || (beatTimeUs - _lastBeatUs) >= _refractoryUs;
+
+    if (peak > _threshold() && outsideRefractory) {
+        _signalPeak = (peak + 7 * _signalPeak) / 8;
+        beat = _acceptBeat(beatTimeUs);
+        _searchBackPeak = 0;
+    } else {
+        _noisePeak = (peak + 7 * _noisePeak) / 8;
+        if (outsideRefractory && peak > _searchBackPeak) {
+            _searchBackPeak = peak;
+            _searchBackTimeUs = beatTimeUs;
+        }
+    }
+}
+
+bool QRSDetector::_acceptBeat(uint32_t beatTimeUs) {
+    if (_haveBeat) {
+        uint32_t rrMs = (beatTimeUs - _lastBeatUs) / 1000UL;
+        if (rrMs <= kMaxRRIntervalMs) {
+            if (_rrCount == QRS_RR_HISTORY) {
+                _rrSum -= _rrHistory[_rrIndex];
+            } else {
+                _rrCount++;
+            }
+            _rrHistory[_rrIndex] = static_cast<uint16_t>(rrMs);
+            _rrSum += rrMs;
+            _rrIndex = (_rrIndex + 1) % QRS_RR_HISTORY;
+        }
+    }
+
+    _lastBeatUs = beatTimeUs;
+    _haveBeat = true;
+    return true;
+}
@@ -0,0 +1,344 @@
+// TaskRuntime.cpp
+// This file implements the methods defined in the PeriodicTask class, with a FreeRTOS
+// backend for the ESP32, a POSIX-thread backend for host builds and a manual backend
+// for simulations.
+
+#include "TaskRuntime.h"
+
+#if defined(ESP_PLATFORM)
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+
+uint32_t taskMicros() {
+    return static_cast<uint32_t>(esp_timer_get_time());
+}
+
+void taskSleepMs(uint32_t ms) {
+    TickType_t ticks = pdMS_TO_TICKS(ms);
+    vTaskDelay(ticks > 0 ? ticks : 1); // Always yield, even for periods shorter than a tick
+}
+
+static bool createTask(PeriodicTask *task, const TaskConfig &config, void (*body)(void *), void **handle) {
+    TaskHandle_t created = nullptr;
+    BaseType_t core = config.core == TASK_ANY_CORE ? tskNO_AFFINITY : config.core;
+    // ESP-IDF takes the stack depth in bytes.
+    if (xTaskCreatePinnedToCore(body, config.name, config.stackBytes, task, config.priority, &created, core) != pdPASS) {
+        return false;
+    }
+    *handle = created;
+    return true;
+}
+
+static void finishTask() {
+    vTaskDelete(nullptr);
+}
+
+static void joinTask(void *, const std::atomic<bool> &running) {
+    while (running.load()) {
+        taskSleepMs(1);
+    }
+}
+
+static uint32_t stackHighWater(void *handle) {
+    // Reports bytes on ESP-IDF.
+    return handle != nullptr ? uxTaskGetStackHighWaterMark(static_cast<TaskHandle_t>(handle)) : 0;
+}
+
+static void freeHandle(void *) {}
+
+#elif defined(TASK_RUNTIME_MANUAL)
+
+#include <time.h>
+
+#define TASK_MANUAL_MAX_TASKS 8
+
+static PeriodicTask *s_tasks[TASK_MANUAL_MAX_TASKS];
+static bool s_stepping[TASK_MANUAL_MAX_TASKS]; // Step in progress, sleeping in taskSleepMs()
+static uint32_t (*s_nowMs)() = nullptr;
+static void (*s_advanceMs)(uint32_t) = nullptr;
+
+uint32_t taskMicros() {
+    // Real time, so step durations reflect actual CPU cost.
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint32_t>(static_cast<uint64_t>(ts.tv_sec) * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+void taskSleepMs(uint32_t ms) {
+    if (s_advanceMs == nullptr) {
+        struct timespec ts = {static_cast<time_t>(ms / 1000), static_cast<long>((ms % 1000) * 1000000L)};
+        nanosleep(&ts, nullptr);
+        return;
+    }
+    // Sleep until a deadline rather than for a number of ticks: a step that blocks
+    // (and so advances the clock itself) shortens the sleep as it would on the device.
+    uint32_t until = s_nowMs() + ms;
+    while (static_cast<int32_t>(until - s_nowMs()) > 0) {
+        s_advanceMs(1);
+        taskRunDue();
+    }
+}
+
+void taskSetSimulatedClock(uint32_t (*nowMs)(), void (*advanceMs)(uint32_t ms)) {
+    s_nowMs = nowMs;
+    s_advanceMs = advanceMs;
+}
+
+void taskRunDue() {
+    uint32_t now = s_nowMs != nullptr ? s_nowMs() : 0;
+    for (int i = 0; i < TASK_MANUAL_MAX_TASKS; i++) {
+        PeriodicTask *task = s_tasks[i];
+        if (task == nullptr || s_stepping[i]) {
+            continue;
+        }
+        if (task->_iterations.load() == 0 || now - task->_lastRunMs >= task->_config.periodMs) {
+            task->_lastRunMs = now;
+            s_stepping[i] = true;
+            task->_stepOnce();
+            s_stepping[i] = false;
+        }
+    }
+}
+
+static bool createTask(PeriodicTask *task, const TaskConfig &, void (*)(void *), void **handle) {
+    for (int i = 0; i < TASK_MANUAL_MAX_TASKS; i++) {
+        if (s_tasks[i] == nullptr) {
+            s_tasks[i] = task;
+            *handle = &s_tasks[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+static void finishTask() {}
+
+static void joinTask(void *handle, const std::atomic<bool> &) {
+    *static_cast<PeriodicTask **>(handle) = nullptr;
+}
+
+static uint32_t stackHighWater(void *) {
+    return 0; // Steps run on the caller's stack
+}
+
+static void freeHandle(void *) {}
+
+#else // POSIX
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Unused stack is left with this pattern, like FreeRTOS does with tskSTACK_FILL_BYTE.
+static const uint8_t kStackFillByte = 0xA5;
+
+struct PosixTask {
+    pthread_t thread;
+    uint8_t *stack;
+    size_t stackBytes;
+};
+
+uint32_t taskMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint32_t>(static_cast<uint64_t>(ts.tv_sec) * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+void taskSleepMs(uint32_t ms) {
+    struct timespec ts = {static_cast<time_t>(ms / 1000), static_cast<long>((ms % 1000) * 1000000L)};
+    nanosleep(&ts, nullptr);
+}
+
+static void *posixEntry(void *arg) {
+    void **call = static_cast<void **>(arg);
+    void (*body)(void *) = reinterpret_cast<void (*)(void *)>(call[0]);
+    void *task = call[1];
+    delete[] call;
+    body(task);
+    return nullptr;
+}
+
+static bool createTask(PeriodicTask *task, const TaskConfig &config, void (*body)(void *), void **handle) {
+    PosixTask *posix = new PosixTask();
+    // Host threads need more room than the firmware sizes (libc, sanitizers).
+    posix->stackBytes = config.stackBytes < PTHREAD_STACK_MIN ? PTHREAD_STACK_MIN : config.stackBytes;
+    long page = sysconf(_SC_PAGESIZE);
+    posix->stackBytes = (posix->stackBytes + page - 1) / page * page;
+    if (posix_memalign(reinterpret_cast<void **>(&posix->stack), page, posix->stackBytes) != 0) {
+        delete posix;
+        return false;
+    }
+    memset(posix->stack, kStackFillByte, posix->stackBytes);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, posix->stack, posix->stackBytes);
+
+    void **call = new void *[2];
+    call[0] = reinterpret_cast<void *>(body);
+    call[1] = task;
+    if (pthread_create(&posix->thread, &attr, posixEntry, call) != 0) {
+        pthread_attr_destroy(&attr);
+        delete[] call;
+        free(posix->stack);
+        delete posix;
+        return false;
+    }
+    pthread_attr_destroy(&attr);
+
+#if defined(__linux__)
+    if (config.core != TASK_ANY_CORE && config.core < sysconf(_SC_NPROCESSORS_ONLN)) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(config.core, &cpus);
+        pthread_setaffinity_np(posix->thread, sizeof(cpus), &cpus);
+    }
+#endif
+#if defined(__linux__) || defined(__APPLE__)
+    pthread_setname_np(
+#if defined(__linux__)
+        posix->thread,
+#endif
+        config.name);
+#endif
+
+    *handle = posix;
+    return true;
+}
+
+static void finishTask() {}
+
+static void joinTask(void *handle, const std::atomic<bool> &) {
+    if (handle != nullptr) {
+        pthread_join(static_cast<PosixTask *>(handle)->thread, nullptr);
+    }
+}
+
+static uint32_t stackHighWater(void *handle) {
+    if (handle == nullptr) {
+        return 0;
+    }
+    // The stack grows down, so untouched fill bytes are at the low end.
+    PosixTask *posix = static_cast<PosixTask *>(handle);
+    size_t untouched = 0;
+    while (untouched < posix->stackBytes && posix->stack[untouched] == kStackFillByte) {
+        untouched++;
+    }
+    return static_cast<uint32_t>(untouched);
+}
+
+static void freeHandle(void *handle) {
+    PosixTask *posix = static_cast<PosixTask *>(handle);
+    if (posix != nullptr) {
+        free(posix->stack);
+        delete posix;
+    }
+}
+
+#endif
+
+PeriodicTask::PeriodicTask(const TaskConfig &config, StepFunction step, void *arg)
+    : _config(config),
+      _step(step),
+      _arg(arg),
+      _handle(nullptr),
+      _running(false),
+      _stopRequested(false),
+      _busyUs(0),
+      _maxStepUs(0),
+      _iterations(0),
+      _lastBusyUs(0),
+      _lastStatsUs(0),
+      _lastRunMs(0) {}
+
+PeriodicTask::~PeriodicTask() {
+    stop();
+}
+
+bool PeriodicTask::start() {
+    if (_running.load()) {
+        return true;
+    }
+    _stopRequested.store(false);
+    _busyUs.store(0);
+    _maxStepUs.store(0);
+    _iterations.store(0);
+    _lastBusyUs = 0;
+    _lastStatsUs = taskMicros();
+
+    _running.store(true);
+    if (!createTask(this, _config, _body, &_handle)) {
+        _running.store(false);
+        return false;
+    }
+    return true;
+}
+
+void PeriodicTask::stop() {
+    if (_handle == nullptr) {
+        return;
+    }
+    _stopRequested.store(true);
+    joinTask(_handle, _running);
+    freeHandle(_handle);
+    _handle = nullptr;
+    _running.store(false);
+}
+
+bool PeriodicTask::isRunning() const {
+    return _running.load();
+}
+
+const char *PeriodicTask::getName() const {
+    return _config.name;
+}
+
+PeriodicTask::Stats PeriodicTask::getStats() {
+    Stats stats;
+    stats.stackHighWaterBytes = stackHighWater(_handle);
+    stats.iterations = _iterations.load();
+    stats.maxStepUs = _maxStepUs.exchange(0);
+    stats.busyUs = _busyUs.load();
+
+    uint32_t now = taskMicros();
+    uint32_t busy = _busyUs.load();
+    uint32_t elapsed = now - _lastStatsUs;
+    uint32_t busyDelta = busy - _lastBusyUs;
+    stats.cpuLoadPermille = elapsed > 0 ? static_cast<uint16_t>((static_cast<uint64_t>(busyDelta) * 1000ULL) / elapsed) : 0;
+    if (stats.cpuLoadPermille > 1000) {
+        stats.cpuLoadPermille = 1000;
+    }
+    _lastStatsUs = now;
+    _lastBusyUs = busy;
+    return stats;
+}
+
+void PeriodicTask::_body(void *self) {
+    static_cast<PeriodicTask *>(self)->_run();
+}
+
+void PeriodicTask::_run() {
+    while (!_stopRequested.load()) {
+        _stepOnce();
+        taskSleepMs(_config.periodMs);
+    }
+    _running.store(false);
+    finishTask(); // Deletes the task on FreeRTOS; returning ends the thread on POSIX
+}
+
+void PeriodicTask::_stepOnce() {
+    uint32_t start = taskMicros();
+    _step(_arg);
+    uint32_t took = taskMicros() - start;
+
+    _busyUs.fetch_add(took);
+    if (took > _maxStepUs.load(std::memory_order_relaxed)) {
+        _maxStepUs.store(took, std::memory_order_relaxed);
+    }
+    _iterations.fetch_add(1);
+}
@@ -0,0 +1,97 @@
+// UplinkRateController.cpp
+// This file implements the methods defined in the UplinkRateController class.
+
+#include "UplinkRateController.h"
+
+UplinkRateController::UplinkRateController() {
+    reset();
+}
+
+void UplinkRateController::reset() {
+    _level = 0;
+    _reason = Reason::None;
+    _smoothedSendUs = 0;
+    _weakSignal = false;
+    _lastChangeMs = 0;
+    _healthySinceMs = 0;
+}
+
+void UplinkRateController::onSend(uint32_t durationUs) {
+    int32_t error = static_cast<int32_t>(durationUs) - static_cast<int32_t>(_smoothedSendUs);
+    _smoothedSendUs = static_cast<uint32_t>(static_cast<int32_t>(_smoothedSendUs) + error / 8);
+}
+
+bool UplinkRateController::update(uint32_t nowMs, uint32_t backlogMs, int8_t rssi) {
+    if (rssi != 0) {
+        if (rssi < UPLINK_WEAK_RSSI) {
+            _weakSignal = true;
+        } else if (rssi > UPLINK_GOOD_RSSI) {
+            _weakSignal = false;
+        }
+    }
+    uint8_t floor = _weakSignal ? 1 : 0;
+
+    bool slow = _smoothedSendUs > UPLINK_SLOW_SEND_US;
+    bool behind = backlogMs > UPLINK_BACKLOG_HIGH_MS;
+    bool healthy = _smoothedSendUs < UPLINK_FAST_SEND_US && backlogMs < UPLINK_BACKLOG_LOW_MS;
+
+    if (_level < floor) {
+        _level = floor;
+        _reason = Reason::WeakSignal;
+        _lastChangeMs = nowMs;
+        _healthySinceMs = 0;
+        return true;
+    }
+
+    if ((slow || behind) && _level < UPLINK_LEVEL_COUNT - 1 && nowMs - _lastChangeMs >= UPLINK_DEGRADE_HOLD_MS) {
+        _level++;
+        _reason = slow ? Reason::SlowSend : Reason::Backlog;
+        _lastChangeMs = nowMs;
+        _healthySinceMs = 0;
+        return true;
+    }
+
+    if (!healthy) {
+        _healthySinceMs = 0;
+        return false;
+    }
+    if (_healthySinceMs == 0) {
+        _healthySinceMs = nowMs != 0 ? nowMs : 1;
+        return false;
+    }
+    if (_level > floor && nowMs - _healthySinceMs >= UPLINK_RECOVER_HOLD_MS) {
+        _level--;
+        _reason = Reason::Recovered;
+        _lastChangeMs = nowMs;
+        _healthySinceMs = nowMs != 0 ? nowMs : 1; // The next step up waits a full hold again
+        return true;
+    }
+    return false;
+}
+
+uint8_t UplinkRateController::getLevel() const {
+    return _level;
+}
+
+UplinkRateController::Reason UplinkRateController::getReason() const {
+    return _reason;
+}
+
+uint32_t UplinkRateController::getSmoothedSendUs() const {
+    return _smoothedSendUs;
+}
+
+const char *UplinkRateController::reasonName(Reason reason) {
+    switch (reason) {
+        case Reason::SlowSend:
+            return "slow_send";
+        case Reason::Backlog:
+            return "backlog";
+        case Reason::WeakSignal:
+            return "weak_signal";
+        case Reason::Recovered:
+            return "recovered";
+        default:
+            return "none";
+    }
+}
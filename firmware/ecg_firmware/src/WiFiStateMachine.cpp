@@ -0,0 +1,153 @@
+// WiFiStateMachine.cpp
+// This file implements the methods defined in the WiFiStateMachine class.
+
+#include "WiFiStateMachine.h"
+
+#include <string.h>
+
+static void copyBounded(char *dest, const char *src, size_t capacity) {
+    if (src == nullptr) {
+        dest[0] = '\0';
+        return;
+    }
+    strncpy(dest, src, capacity - 1);
+    dest[capacity - 1] = '\0';
+}
+
+WiFiStateMachine::WiFiStateMachine(WiFiDriver &driver)
+    : _driver(driver),
+      _state(WiFiState::Idle),
+      _stateSinceMs(0),
+      _nextAttemptMs(0),
+      _retryCount(0),
+      _connectTimeoutMs(WIFI_CONNECT_TIMEOUT_MS),
+      _backoffBaseMs(WIFI_BACKOFF_BASE_MS),
+      _backoffMaxMs(WIFI_BACKOFF_MAX_MS) {
+    _ssid[0] = '\0';
+    _password[0] = '\0';
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+void WiFiStateMachine::setTiming(uint32_t connectTimeoutMs, uint32_t backoffBaseMs, uint32_t backoffMaxMs) {
+    _connectTimeoutMs = connectTimeoutMs;
+    _backoffBaseMs = backoffBaseMs > 0 ? backoffBaseMs : 1;
+    _backoffMaxMs = backoffMaxMs >= _backoffBaseMs ? backoffMaxMs : _backoffBaseMs;
+}
+
+void WiFiStateMachine::connect(const char *ssid, const char *password, uint32_t nowMs) {
+    if (ssid == nullptr || ssid[0] == '\0') {
+        return;
+    }
+    copyBounded(_ssid, ssid, sizeof(_ssid));
+    copyBounded(_password, password, sizeof(_password));
+
+    _driver.stop();
+    _retryCount = 0;
+    _startAttempt(nowMs);
+}
+
+bool WiFiStateMachine::startHotspot(const char *ssid, const char *password, uint32_t nowMs) {
+    _driver.stop();
+    _driver.takeEvent();
+    bool started = _driver.startAccessPoint(ssid, password);
+    _enter(WiFiState::Hotspot, nowMs);
+    return started;
+}
+
+void WiFiStateMachine::stop(uint32_t nowMs) {
+    _driver.stop();
+    _driver.takeEvent();
+    _enter(WiFiState::Idle, nowMs);
+}
+
+void WiFiStateMachine::poll(uint32_t nowMs) {
+    WiFiLinkEvent event = _driver.takeEvent();
+
+    switch (_state) {
+        case WiFiState::Connecting:
+            if (event == WiFiLinkEvent::Connected) {
+                _retryCount = 0;
+                _stats.connections++;
+                _enter(WiFiState::Connected, nowMs);
+            } else if (event == WiFiLinkEvent::Disconnected ||
+                       nowMs - _stateSinceMs >= _connectTimeoutMs) {
+                _stats.failures++;
+                _scheduleRetry(nowMs);
+            }
+            break;
+
+        case WiFiState::Connected:
+            if (event == WiFiLinkEvent::Disconnected) {
+                // A link that was up is worth retrying straight away.
+                _stats.linkLosses++;
+                _retryCount = 0;
+                _startAttempt(nowMs);
+            }
+            break;
+
+        case WiFiState::Backoff:
+            if (static_cast<int32_t>(nowMs - _nextAttemptMs) >= 0) {
+                _startAttempt(nowMs);
+            }
+            break;
+
+        case WiFiState::Idle:
+        case WiFiState::Hotspot:
+            break;
+    }
+}
+
+WiFiState WiFiStateMachine::getState() const {
+    return _state;
+}
+
+bool WiFiStateMachine::isConnected() const {
+    return _state == WiFiState::Connected;
+}
+
+uint32_t WiFiStateMachine::getStateSinceMs() const {
+    return _stateSinceMs;
+}
+
+uint32_t WiFiStateMachine::getNextAttemptMs() const {
+    return _nextAttemptMs;
+}
+
+uint8_t WiFiStateMachine::getRetryCount() const {
+    return _retryCount;
+}
+
+WiFiStateMachine::Stats WiFiStateMachine::getStats() const {
+    return _stats;
+}
+
+void WiFiStateMachine::_enter(WiFiState state, uint32_t nowMs) {
+    _state = state;
+    _stateSinceMs = nowMs;
+}
+
+void WiFiStateMachine::_startAttempt(uint32_t nowMs) {
+    _stats.connectAttempts++;
+    _driver.takeEvent(); // Anything pending belongs to the previous attempt
+    _driver.startStation(_ssid, _password);
+    _enter(WiFiState::Connecting, nowMs);
+}
+
+void WiFiStateMachine::_scheduleRetry(uint32_t nowMs) {
+    // base * 2^retries, capped; the shift is bounded so it cannot overflow.
+    uint32_t delayMs = _backoffMaxMs;
+    if (_retryCount < 16) {
+        uint32_t scaled = _backoffBaseMs << _retryCount;
+        if ((scaled >> _retryCount) == _backoffBaseMs && scaled < _backoffMaxMs) {
+            delayMs = scaled;
+        }
+    }
+    if (_retryCount < 255) {
+        _retryCount++;
+    }
+
+    uint32_t half = delayMs / 2;
+    _nextAttemptMs = nowMs + half + (half > 0 ? _driver.random() % (half + 1) : 0);
+    _driver.stop();
+    _enter(WiFiState::Backoff, nowMs);
+}
@@ -1,123 +1,143 @@
+// WirelessCommunication.cpp
+// This file implements the methods defined in the EspWiFiDriver and WirelessCommunication classes.
+
 #include "WirelessCommunication.h"
+#include <esp_random.h>
 
-WirelessCommunication::WirelessCommunication() {
-    // Serial.println("[WirelessCommunication] Initialized");
-}
+EspWiFiDriver::EspWiFiDriver() : _event(static_cast<uint8_t>(WiFiLinkEvent::None)), _registered(false) {}
 
-void WirelessCommunication::begin() {
-    // Initialize Preferences storage for WiFi credentials
-    prefs.begin(WIFI_CREDS, false);
+void EspWiFiDriver::begin() {
+    if (_registered) {
+        return;
+    }
+    _registered = true;
+
+    // Runs in the WiFi event task, so only the atomic is touched here.
+    WiFi.onEvent([this](arduino_event_id_t event, arduino_event_info_t info) {
+        if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+            _event.store(static_cast<uint8_t>(WiFiLinkEvent::Connected));
+        } else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED &&
+                   info.wifi_sta_disconnected.reason != WIFI_REASON_ASSOC_LEAVE) {
+            // ASSOC_LEAVE is our own disconnect() and not a link failure.
+            _event.store(static_cast<uint8_t>(WiFiLinkEvent::Disconnected));
+        }
+    });
+}
 
-    // Load saved WiFi credentials
-    ssid = getSavedSSID();
-    password = getSavedPassword();
+void EspWiFiDriver::startStation(const char *ssid, const char *password) {
+    WiFi.mode(WIFI_STA);
+    WiFi.setAutoReconnect(false); // Retries are paced by WiFiStateMachine
+    WiFi.begin(ssid, password);
+}
 
-    // Set initial mode to "off" if not already set
-    if (getMode().isEmpty()) {
-        setMode("off");
-        mode = "off"; // Initialize mode variable
+bool EspWiFiDriver::startAccessPoint(const char *ssid, const char *password) {
+    WiFi.mode(WIFI_AP);
+    // Start SoftAP with or without a password based on input
+    if (password && strlen(password) >= 8) { // Password must be at least 8 characters for WPA2
+        return WiFi.softAP(ssid, password);
     }
-    else {
-        mode = getMode();
+    return WiFi.softAP(ssid); // Open access point if no password or too short
+}
+
+void EspWiFiDriver::stop() {
+    WiFi.disconnect();
+    WiFi.mode(WIFI_OFF);
+}
+
+WiFiLinkEvent EspWiFiDriver::takeEvent() {
+    return static_cast<WiFiLinkEvent>(_event.exchange(static_cast<uint8_t>(WiFiLinkEvent::None)));
+}
+
+uint32_t EspWiFiDriver::random() {
+    return esp_random();
+}
+
+// Names of the WirelessMode values in NVS, in enum order
+static const char *const kModeNames[] = {"off", "wifi", "hotspot"};
+
+WirelessCommunication::WirelessCommunication(PersistentConfig &config)
+    : config(config), link(driver), mode(WirelessMode::Off) {
+    // Serial.println("[WirelessCommunication] Initialized");
+}
+
+void WirelessCommunication::begin() {
+    // Open the WIFI_CREDS namespace once and load the saved credentials and mode into RAM.
+    // The mode defaults to "off" if it was never set.
+    config.begin();
+    config.addString(CONFIG_KEY_SSID, "");
+    config.addString(CONFIG_KEY_PASSWORD, "");
+    config.addString(CONFIG_KEY_MODE, kModeNames[static_cast<uint8_t>(WirelessMode::Off)]);
+    const String &savedMode = config.getString(CONFIG_KEY_MODE);
+    for (uint8_t i = 0; i < sizeof(kModeNames) / sizeof(kModeNames[0]); i++) {
+        if (savedMode == kModeNames[i]) {
+            mode = static_cast<WirelessMode>(i);
+        }
     }
 
+    driver.begin();
     // Serial.println("[WirelessCommunication] Begin completed");
 }
 
+void WirelessCommunication::loop() {
+    uint32_t now = millis();
+    link.poll(now);
+    config.loop(now);
+}
+
 void WirelessCommunication::activateWiFiMode() {
 
+    const String &ssid = config.getString(CONFIG_KEY_SSID);
+    const String &password = config.getString(CONFIG_KEY_PASSWORD);
+
     // Check if credentials exist before attempting to connect
     if (ssid.isEmpty() || password.isEmpty()) {
         // Serial.println("No saved WiFi credentials found!");
         return;
     }
 
-    // Disconnect from any previous connections and set WiFi mode to Station
-    WiFi.disconnect(true); // true parameter releases IP and cleans up
-    WiFi.mode(WIFI_STA);
-    delay(100); // Small delay to allow mode change to take effect
-
-    // Attempt to connect to the saved WiFi network
-    WiFi.begin(ssid.c_str(), password.c_str());
-    // WiFi.begin("Electrify", "Victory111");
-    // Serial.print("Connecting to WiFi/nSSID:");
-    // Serial.print(ssid);
-
-    // Connection retry loop
-    int retries = 0;
-    while (WiFi.status() != WL_CONNECTED && retries < 40) { // Max 40 retries (4 seconds)
-        delay(100); // Wait for 100ms between retries
-        // Serial.print(".");
-        retries++;
-    }
-    setMode("wifi"); // Update the stored mode to "wifi"
-    mode = "wifi"; // Update the in-memory mode variable
-    // Check final connection status
-    if (WiFi.status() == WL_CONNECTED) {
-        // Serial.println("\nWiFi connected");
-        // Serial.print("IP Address: ");
-        // Serial.println(WiFi.localIP());
-    } else {
-        // Serial.println("\nFailed to connect to WiFi");
-    }
+    // Drops any previous connection or hotspot and starts connecting; loop() takes it from here.
+    link.connect(ssid.c_str(), password.c_str(), millis());
+    setMode(WirelessMode::WiFi); // Update the stored mode to "wifi"
 }
 
 bool WirelessCommunication::isConnected() {
-    // Return the current WiFi connection status
-    return (WiFi.status() == WL_CONNECTED);
+    return link.isConnected();
 }
 
 bool WirelessCommunication::connectWiFi() {
-    if (WiFi.status() == WL_CONNECTED) {
+    if (link.isConnected()) {
         return true;
     }
 
+    const String &ssid = config.getString(CONFIG_KEY_SSID);
+    const String &password = config.getString(CONFIG_KEY_PASSWORD);
+
     // Ensure credentials exist before attempting connection
     if (ssid.isEmpty() || password.isEmpty()) {
         // Serial.println("No saved WiFi credentials found!");
         return false;
     }
 
-    // Attempt to connect to the saved WiFi network
-    WiFi.begin(ssid.c_str(), password.c_str());
-    // Serial.print("Connecting to WiFi");
-
-    // Connection retry loop (longer timeout than activateWiFiMode for re-connection attempts)
-    int retries = 0;
-    while (WiFi.status() != WL_CONNECTED && retries < 50) { // Max 50 retries (5 seconds)
-        delay(100);
-        // Serial.print(".");
-        retries++;
+    // Connecting or backing off already means a connection is on its way.
+    WiFiState state = link.getState();
+    if (state == WiFiState::Idle || state == WiFiState::Hotspot) {
+        link.connect(ssid.c_str(), password.c_str(), millis());
     }
-    setMode("wifi");
+    setMode(WirelessMode::WiFi);
+    return false;
+}
 
-    // Check final connection status and update mode if successful
-    if (WiFi.status() == WL_CONNECTED) {
-        // Serial.print("\nWiFi connected: ");
-        // Serial.print("IP Address: ");
-        // Serial.println(WiFi.localIP());
-        return true;
-    } else {
-        // Serial.println("\nFailed to connect to WiFi");
-        return false;
-    }
+WiFiState WirelessCommunication::getWiFiState() const {
+    return link.getState();
 }
 
-void WirelessCommunication::activateHotspotMode(const char *ssid_ap, const char *password_ap) {
-    // Disconnect any existing connections and set mode to Access Point
-    WiFi.disconnect(true);
-    WiFi.mode(WIFI_AP);
-    delay(100);
+WiFiStateMachine::Stats WirelessCommunication::getWiFiStats() const {
+    return link.getStats();
+}
 
-    bool result;
-    // Start SoftAP with or without a password based on input
-    if (password_ap && strlen(password_ap) >= 8) { // Password must be at least 8 characters for WPA2
-        result = WiFi.softAP(ssid_ap, password_ap);
-    } else {
-        result = WiFi.softAP(ssid_ap); // Open access point if no password or too short
-    }
-    setMode("hotspot"); // Update the stored mode to "hotspot"
-    mode = "hotspot"; // Update the in-memory mode variable
+void WirelessCommunication::activateHotspotMode(const char *ssid_ap, const char *password_ap) {
+    bool result = link.startHotspot(ssid_ap, password_ap, millis());
+    setMode(WirelessMode::Hotspot); // Update the stored mode to "hotspot"
 
     // Report hotspot activation status
     if (result) {
@@ -130,63 +150,47 @@ void WirelessCommunication::activateHotspotMode(const char *ssid_ap, const char
 }
 
 void WirelessCommunication::turnOffWireless() {
-    WiFi.disconnect(true);
-    delay(100);
-    setMode("off");
-    mode = "off"; // Update the in-memory mode variable
+    link.stop(millis());
+    setMode(WirelessMode::Off);
     // Serial.println("Wireless turned off");
 }
 
 void WirelessCommunication::saveWiFiCredentials(const char *_sssid, const char *_passsword) {
-    prefs.begin(WIFI_CREDS, false);
-    prefs.putString("ssid", _sssid);
-    prefs.putString("password", _passsword);
-    prefs.end();
-
-    // Update the in-memory variables immediately
-    ssid = String(_sssid);
-    password = String(_passsword);
+    config.setString(CONFIG_KEY_SSID, _sssid);
+    config.setString(CONFIG_KEY_PASSWORD, _passsword);
+    config.commit(); // Credentials come from the user; don't leave them to the commit delay
 
     // Serial.println("WiFi credentials saved");
 }
 
 String WirelessCommunication::getSavedSSID() {
-    prefs.begin(WIFI_CREDS, false);
-    String saved_ssid = prefs.getString("ssid", "");
-    prefs.end();
-
-    // Serial.print("SSID: ");
-    // Serial.println(saved_ssid);
-    return saved_ssid;
+    return config.getString(CONFIG_KEY_SSID);
 }
 
 String WirelessCommunication::getSavedPassword() {
-    prefs.begin(WIFI_CREDS, false);
-    String saved_password = prefs.getString("password", "");
-    prefs.end();
-
-    // Serial.print("PASSWORD: ");
-    // Serial.println(saved_password);
-    return saved_password;
+    return config.getString(CONFIG_KEY_PASSWORD);
 }
 
-String WirelessCommunication::getMode() {
-    prefs.begin(WIFI_CREDS, false);
-    String mmode = prefs.getString("mode", "off");
-    prefs.end();
-    return mmode;
+WirelessMode WirelessCommunication::getMode() const {
+    return mode;
 }
 
-String WirelessCommunication::getLocalMode() {
-    return mode; 
+WirelessMode WirelessCommunication::getLocalMode() const {
+    return mode;
 }
 
-void WirelessCommunication::setMode(const char *mode) {
-    prefs.begin(WIFI_CREDS, false);
-    prefs.putString("mode", mode);
-    prefs.end();
+void WirelessCommunication::setMode(WirelessMode newMode) {
+    if (newMode == mode) {
+        return;
+    }
+    mode = newMode;
+    config.setString(CONFIG_KEY_MODE, kModeNames[static_cast<uint8_t>(newMode)]);
 }
 
 IPAddress WirelessCommunication::getIP() {
     return(WiFi.softAPIP());
+}
+
+void WirelessCommunication::setPowerSave(bool enabled) {
+    WiFi.setSleep(enabled ? WIFI_PS_MAX_MODEM : WIFI_PS_MIN_MODEM);
 }
\ No newline at end of file
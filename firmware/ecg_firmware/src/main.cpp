@@ -1,15 +1,41 @@
 #include <Arduino.h>               
 #include "AD8232_ECG.h"            
+#include "ECGMultiChannel.h"
 #include "ECGWebSocket.h"   
 #include "PeripheralHandler.h"    
 #include "HotspotWebServer.h"    
+#include "DeviceSettings.h"
+#include "BurstScheduler.h"
+#include "ECGFilter.h"
+#include "QRSDetector.h"
+#include "ECGSpool.h"
+#include "SPSCRingBuffer.h"
+#include "TaskRuntime.h"
+#include <LittleFS.h>
 #include <DNSServer.h>
+#include <esp_system.h>
+#include <esp_pm.h>
 
 // AD8232 ECG Sensor Pins
 const int ECG_OUTPUT_PIN = 32;
 const int LO_PLUS_PIN = 14;
 const int LO_MINUS_PIN = 35;
 
+// Number of AD8232 front ends recorded together, 1 to ECG_MAX_CHANNELS. With more than
+// one, the leads below are sampled in lockstep with the first and streamed as
+// multi-channel frames. Set with -DECG_CHANNEL_COUNT, so single-lead builds carry
+// none of the multi-channel buffers.
+#ifndef ECG_CHANNEL_COUNT
+#define ECG_CHANNEL_COUNT 1
+#endif
+// Further AD8232 front ends; their outputs must be on ADC1 (GPIO 32-39) like the first
+const int ECG2_OUTPUT_PIN = 33;
+const int ECG2_LO_PLUS_PIN = 25;
+const int ECG2_LO_MINUS_PIN = 26;
+const int ECG3_OUTPUT_PIN = 34;
+const int ECG3_LO_PLUS_PIN = 27;
+const int ECG3_LO_MINUS_PIN = 13;
+
 // RGB LED Pins (Common Cathode assumed: HIGH turns segment ON)
 const int RGB_RED_PIN = 18;
 const int RGB_GREEN_PIN = 4;
@@ -18,32 +44,155 @@ const int RGB_BLUE_PIN = 15;
 const int BUTTON_PIN = 19;
 
 // --- WebSocket Server Details ---
+// Defaults of the device settings, which the hotspot setup page can change (see DeviceSettings).
+// Each device connects to WS_SERVER_PATH?device_id=<ID>, the ID derived from its MAC unless set.
 const char* WS_SERVER_IP = "api.cardiacai.tech";
 // const char* WS_SERVER_IP = "192.168.153.93"; // For local testing
 const uint16_t WS_SERVER_PORT = 8000;
-const char* WS_SERVER_PATH = "/api/ws/device?device_id=cardiacai-123";
+const char* WS_SERVER_PATH = "/api/ws/device";
 
 const char* HOTSPOT_SSID = "CardiacAI";
 const char* HOTSPOT_PASSWORD = "ecg12345";
 
-// Attempt reconnect every 10 seconds
+// Default ECG sampling rate driven by the acquisition timer (a device setting)
+const ECGSampleRate ECG_SAMPLE_RATE = ECGSampleRate::Hz125;
+// The ADC converts continuously at this rate and each sample averages 160 conversions (at 125 Hz).
+// 20 kHz is the slowest rate of the ESP32's DMA ADC; 0 reads the ADC once per sample instead.
+const uint32_t ECG_ADC_RAW_RATE_HZ = 20000;
+// Mains frequency rejected by the notch filter
+const MainsFrequency ECG_MAINS_FREQUENCY = MainsFrequency::Hz50;
+// Maximum number of samples moved between buffers at a time
+const size_t ECG_DRAIN_CHUNK = 32;
+// Samples are sent in binary frames of up to this many samples... (device settings, as is compression)
+const uint16_t ECG_BATCH_SAMPLES = 25;
+// ...or as soon as the oldest queued sample is this old
+const uint16_t ECG_BATCH_MAX_DELAY_MS = 200;
+// Delta-zigzag-varint compress frame payloads
+const bool ECG_COMPRESS_FRAMES = true;
+// Back off to larger batches and, as a last resort, a lower rate when the link cannot keep up
+const bool ECG_ADAPTIVE_UPLINK = true;
+// Low-power streaming for battery units (a device setting; 0 keeps the radio ready at all times):
+// samples wait in processedSamples and go out in one burst this often, WiFi modem sleep keeps the
+// radio off in between, and the CPU clock drops to ECG_LOW_POWER_CPU_MHZ while every task idles.
+const uint16_t ECG_BURST_INTERVAL_MS = 0;
+// Lowest CPU clock WiFi runs at, and the full clock
+const int ECG_LOW_POWER_CPU_MHZ = 80;
+const int ECG_CPU_MHZ = 240;
+
+// Frames that cannot be sent are spooled to this file on the LittleFS partition
+const char* ECG_SPOOL_PATH = "/littlefs/ecg_spool.bin";
+// Spool size; about half an hour of compressed 125 Hz frames
+const size_t ECG_SPOOL_BYTES = 512 * 1024;
+
+// Attempt WebSocket reconnect every 10 seconds
 const unsigned long RECONNECT_INTERVAL_MS = 10000;
 
-unsigned long lastWiFiReconnectAttempt = 0;
+// --- Task layout ---
+// Filtering and beat detection run on the application core at high priority, so they
+// keep up with the acquisition timer whatever the network is doing. Networking, the
+// web server and the button/LED run on the protocol core next to the WiFi stack.
+const TaskConfig DSP_TASK_CONFIG = {"ecg_dsp", 4096, 10, 1, 4};
+const TaskConfig NETWORK_TASK_CONFIG = {"ecg_net", 8192, 3, 0, 1};
+// Task and link statistics are sent to the server this often
+const unsigned long TASK_STATS_INTERVAL_MS = 10000;
+// Filtered samples waiting for the network task; 8 s at 125 Hz rides out a blocked sender
+#define ECG_PROCESSED_BUFFER_SIZE 1024
+// Late-confirmed beats waiting for the network task; search-back yields at most one per beat
+#define ECG_EARLIER_BEATS_BUFFER_SIZE 16
+
+#if ECG_CHANNEL_COUNT > 1
+static_assert(ECG_CHANNEL_COUNT <= ECG_MAX_CHANNELS, "ECG_CHANNEL_COUNT exceeds ECG_MAX_CHANNELS");
+typedef ECGMultiSample ProcessedSample; // Every lead, captured by ecgLeads
+#else
+typedef ECGSample ProcessedSample; // The one lead, captured by ecgSensor
+#endif
+
+bool wifiWasConnected = false;
 unsigned long lastWsReconnectAttempt = 0;
 bool hotspotServerActive = false;
-unsigned int clicks;
+unsigned long lastTaskStatsReport = 0;
+ProcessedSample dspSamples[ECG_DRAIN_CHUNK];     // Owned by the DSP task
+ProcessedSample networkSamples[ECG_DRAIN_CHUNK]; // Owned by the network task
+char statusMessage[512];                         // Owned by the network task
+
+// --- Runtime commands ---
+// The server changes batching and acquisition of a running device with commands (see
+// DeviceCommand). The stored device settings stay as they are, so a restart returns to them.
+struct AcquisitionConfig {
+    uint16_t sampleRateHz;
+    MainsFrequency mains;
+    bool highPass;
+    bool notch;
+    bool lowPass;
+};
+DeviceSettingsValues uplinkSettings;    // Running stream settings; owned by the network task
+AcquisitionConfig acquisition;          // Running acquisition; owned by the network task
+AcquisitionConfig requestedAcquisition; // Written by the network task before acquisitionRequestSeq moves
+DeviceCommand acquisitionCommand;       // Acked once its first sample reaches the uplink
+bool acquisitionPending = false;        // Owned by the network task
+uint32_t dspAcquisitionSeq = 0;         // Request the DSP task restarted sampling for; owned by it
+// Network task -> DSP task: a new requestedAcquisition
+std::atomic<uint32_t> acquisitionRequestSeq(0);
+// DSP task -> network task: the request whose first sample is acquisitionBoundaryUs
+std::atomic<uint32_t> acquisitionAppliedSeq(0);
+std::atomic<uint32_t> acquisitionBoundaryUs(0);
+
+// DSP task -> network task
+SPSCRingBuffer<ProcessedSample, ECG_PROCESSED_BUFFER_SIZE> processedSamples;
+std::atomic<uint32_t> latestHeartRate(0); // bpmX10 << 16 | R-R interval in ms, 0 while unknown
+// R-peak times of beats confirmed after their sample was pushed to processedSamples
+SPSCRingBuffer<uint32_t, ECG_EARLIER_BEATS_BUFFER_SIZE> earlierBeats;
+uint32_t lastQueuedUs = 0; // Capture time of the newest sample given to an output; owned by the network task
 
 AD8232_ECG ecgSensor(ECG_OUTPUT_PIN, LO_PLUS_PIN, LO_MINUS_PIN);
-WirelessCommunication wirelessComm;
+#if ECG_CHANNEL_COUNT > 1
+AD8232Lead ecgLead2(ECG2_OUTPUT_PIN, ECG2_LO_PLUS_PIN, ECG2_LO_MINUS_PIN);
+AD8232Lead ecgLead3(ECG3_OUTPUT_PIN, ECG3_LO_PLUS_PIN, ECG3_LO_MINUS_PIN);
+ECGMultiChannel ecgLeads;                     // Samples ecgSensor and the leads above together
+ECGFilter leadFilters[ECG_CHANNEL_COUNT - 1]; // Leads after the first, which uses ecgFilter
+ECGSample liveSamples[ECG_DRAIN_CHUNK];       // First lead, for /live; owned by the network task
+#endif
+PersistentConfig wifiConfig(WIFI_CREDS);
+WirelessCommunication wirelessComm(wifiConfig);
+PersistentConfig deviceConfig(DEVICE_SETTINGS);
+DeviceSettings deviceSettings(deviceConfig);
 ECGWebSocketClient wsClient;
 PeripheralHandler ledHandler(RGB_RED_PIN, RGB_GREEN_PIN, RGB_BLUE_PIN, BUTTON_PIN);
-HotspotWebServer hotspotServer(wirelessComm);
+HotspotWebServer hotspotServer(wirelessComm, deviceSettings);
+ECGFilter ecgFilter;
+QRSDetector qrsDetector;
+FileSpoolStorage spoolStorage(ECG_SPOOL_PATH, ECG_SPOOL_BYTES);
+ECGSpool ecgSpool(spoolStorage);
+BurstScheduler burstScheduler; // Owned by the network task
+
+void dspTaskStep(void *);
+void networkTaskStep(void *);
+void configureConditioning(const AcquisitionConfig &config);
+bool startAcquisition(ECGSampleRate rate);
+void enableLowPower();
+PeriodicTask dspTask(DSP_TASK_CONFIG, dspTaskStep);
+PeriodicTask networkTask(NETWORK_TASK_CONFIG, networkTaskStep);
 
 void setup() {
     Serial.begin(115200);
     // Serial.println("\n--- ECG Machine Booting Up ---");
 
+    // Identity, endpoint and stream parameters are loaded once and stay fixed until the next boot.
+    DeviceSettingsValues defaults = {};
+    snprintf(defaults.serverHost, sizeof(defaults.serverHost), "%s", WS_SERVER_IP);
+    defaults.serverPort = WS_SERVER_PORT;
+    snprintf(defaults.serverPath, sizeof(defaults.serverPath), "%s", WS_SERVER_PATH);
+    defaults.sampleRateHz = static_cast<uint16_t>(ECG_SAMPLE_RATE);
+    defaults.batchSamples = ECG_BATCH_SAMPLES;
+    defaults.batchDelayMs = ECG_BATCH_MAX_DELAY_MS;
+    defaults.compress = ECG_COMPRESS_FRAMES;
+    defaults.burstIntervalMs = ECG_BURST_INTERVAL_MS;
+    deviceSettings.begin(defaults);
+    const DeviceSettingsValues &device = deviceSettings.active();
+    uplinkSettings = device;
+    acquisition = {device.sampleRateHz, ECG_MAINS_FREQUENCY, true, true, true};
+    // Serial.printf("Device ID: %s\n", device.deviceId);
+
     wirelessComm.begin();
     ecgSensor.begin();
     ledHandler.begin();
@@ -53,50 +202,446 @@ void setup() {
     ecgSensor.begin();
     ledHandler.begin();
 
-    clicks = ledHandler.getAndResetClickCount();
-
-    delay(2000);
-    ledHandler.setRed(1);
-    delay(500);
-    ledHandler.setRed(0);
-    ledHandler.setGreen(1);
-    delay(500);
-    ledHandler.setGreen(0);
-    ledHandler.setBlue(1);
-    delay(500);
-    ledHandler.setBlue(0);
-    delay(500);
+    // Boot light show; it plays from the LED timer while setup() carries on.
     ledHandler.setRed(1);
+    ledHandler.playPattern(LED_PATTERN_BOOT);
 
     // Serial.println("Attempting to connect to saved WiFi...");
-    wirelessComm.activateWiFiMode();                          // This will try to connect to previously saved WiFi
+    // Returns immediately; loop() connects the WebSocket once WiFi is up.
+    wirelessComm.activateWiFiMode();
+    ledHandler.setGreen(0);
 
-    unsigned long wifiConnectStartTime = millis();
-    if (wirelessComm.isConnected()) {
-        ledHandler.setGreen(1);
-        // Serial.println("\nWiFi connected successfully!");
-        // Serial.println("Attempting WebSocket connection...");
-        if(wsClient.connect(WS_SERVER_IP, WS_SERVER_PORT, WS_SERVER_PATH)) {
-            ledHandler.setBlue(1);
-            // Serial.println("WebSocket connected successfully!");
-        } else {
-            ledHandler.setBlue(0);
-            // Serial.println("Failed to connect to WebSocket server.");
-        }
+    burstScheduler.setInterval(device.burstIntervalMs);
+    if (burstScheduler.isEnabled()) {
+        enableLowPower();
+        uplinkSettings.batchSamples = ECG_FRAME_MAX_SAMPLES; // A burst is sent in as few frames as it takes
+    }
+
+    // Sampling is timer driven from here on; the two tasks below do all further work.
+    wsClient.setBatchPolicy(uplinkSettings.batchSamples, device.batchDelayMs);
+    wsClient.setSampleRate(device.sampleRateHz);
+    wsClient.setCompression(device.compress);
+    wsClient.setAdaptive(ECG_ADAPTIVE_UPLINK);
+    hotspotServer.liveStream().setSampleRate(device.sampleRateHz);
+    if (LittleFS.begin(true) && spoolStorage.begin()) {
+        ecgSpool.begin();
+        wsClient.setSpool(&ecgSpool);
+    } else {
+        // Serial.println("Spool unavailable, frames will be dropped while offline.");
     }
-    else {
-        ledHandler.setGreen(0);
-        // Serial.println("\nFailed to connect to WiFi. Will keep trying...");
+    configureConditioning(acquisition);
+#if ECG_CHANNEL_COUNT > 1
+    // One timer reads every lead; ecgSensor's own engine stays idle.
+    AD8232Lead *extraLeads[] = {&ecgLead2, &ecgLead3};
+    ecgLeads.addChannel(&ecgSensor);
+    for (uint8_t c = 1; c < ECG_CHANNEL_COUNT; c++) {
+        extraLeads[c - 1]->begin();
+        ecgLeads.addChannel(extraLeads[c - 1]);
     }
-    // Serial.println("Setup complete. Starting main loop.");
+    wsClient.setChannelCount(ECG_CHANNEL_COUNT);
+#else
+    ecgSensor.setOversampling(ECG_ADC_RAW_RATE_HZ);
+#endif
+    startAcquisition(deviceSettings.getSampleRate());
+    dspTask.start();
+    networkTask.start();
+    // Serial.println("Setup complete. Tasks started.");
 }
 
 void loop() {
+    // Everything runs in dspTask and networkTask.
+    taskSleepMs(1000);
+}
+
+/**
+ * @brief Puts the radio in modem sleep and lets the CPU clock down while idle.
+ */
+void enableLowPower() {
+    wirelessComm.setPowerSave(true);
+    // Light sleep stays off: the acquisition timer and the ADC DMA run throughout.
+    esp_pm_config_t pm = {};
+    pm.max_freq_mhz = ECG_CPU_MHZ;
+    pm.min_freq_mhz = ECG_LOW_POWER_CPU_MHZ;
+    pm.light_sleep_enable = false;
+    if (esp_pm_configure(&pm) != ESP_OK) {
+        // No frequency scaling in this build (CONFIG_PM_ENABLE); run at the low clock throughout.
+        setCpuFrequencyMhz(ECG_LOW_POWER_CPU_MHZ);
+    }
+}
+
+// --- Per-build sample handling ---
+// Overloads on the sample type, so the tasks below read the same for one lead or several.
+
+size_t readCaptured(ECGSample *out, size_t maxSamples) {
+    return ecgSensor.readSamples(out, maxSamples);
+}
+
+/**
+ * @brief Sets the filters and the beat detector up for an acquisition configuration.
+ */
+void configureConditioning(const AcquisitionConfig &config) {
+    ECGSampleRate rate = static_cast<ECGSampleRate>(config.sampleRateHz);
+    ecgFilter.configure(rate, config.mains);
+    ecgFilter.setStages(config.highPass, config.notch, config.lowPass);
+    qrsDetector.configure(rate);
+#if ECG_CHANNEL_COUNT > 1
+    for (uint8_t c = 1; c < ECG_CHANNEL_COUNT; c++) {
+        leadFilters[c - 1].configure(rate, config.mains);
+        leadFilters[c - 1].setStages(config.highPass, config.notch, config.lowPass);
+    }
+#endif
+}
+
+/**
+ * @brief Filters samples in place and marks the beats.
+ * @return The number of beats found.
+ */
+size_t conditionSamples(ECGSample *samples, size_t count) {
+    ecgFilter.filterSamples(samples, count);
+    size_t beats = qrsDetector.processSamples(samples, count);
+    uint32_t beatTimeUs;
+    while (qrsDetector.takeEarlierBeat(beatTimeUs)) {
+        earlierBeats.push(beatTimeUs);
+    }
+    return beats;
+}
+
+bool queueUplink(const ECGSample *samples, size_t count) {
+    if (count > 0) {
+        lastQueuedUs = samples[count - 1].timestampUs;
+    }
+    return wsClient.queueECGSamples(samples, count);
+}
+
+void queueLive(ECGLiveStream &live, const ECGSample *samples, size_t count) {
+    if (count > 0) {
+        lastQueuedUs = samples[count - 1].timestampUs;
+    }
+    live.queueSamples(samples, count);
+}
+
+#if ECG_CHANNEL_COUNT > 1
+size_t readCaptured(ECGMultiSample *out, size_t maxSamples) {
+    return ecgLeads.readSamples(out, maxSamples);
+}
+
+size_t conditionSamples(ECGMultiSample *samples, size_t count) {
+    size_t beats = 0;
+    for (size_t i = 0; i < count; i++) {
+        ECGMultiSample &sample = samples[i];
+        sample.values[0] = static_cast<uint16_t>(ecgFilter.filter(sample.values[0]));
+        for (uint8_t c = 1; c < ECG_CHANNEL_COUNT; c++) {
+            sample.values[c] = static_cast<uint16_t>(leadFilters[c - 1].filter(sample.values[c]));
+        }
+        // Beats come from the first lead and are flagged on their R peak, as in
+        // QRSDetector::processSamples().
+        uint32_t beatTimeUs;
+        if (sample.leadOffMask & 0x01) {
+            qrsDetector.reset();
+        } else if (qrsDetector.process(sample.values[0], sample.timestampUs, beatTimeUs)) {
+            beats++;
+            if (!markECGBeat(samples, i + 1, beatTimeUs)) {
+                earlierBeats.push(beatTimeUs);
+            }
+        }
+    }
+    return beats;
+}
+
+bool queueUplink(const ECGMultiSample *samples, size_t count) {
+    if (count > 0) {
+        lastQueuedUs = samples[count - 1].timestampUs;
+    }
+    return wsClient.queueECGMultiSamples(samples, count);
+}
+
+void queueLive(ECGLiveStream &live, const ECGMultiSample *samples, size_t count) {
+    if (count > 0) {
+        lastQueuedUs = samples[count - 1].timestampUs;
+    }
+    // /live shows the first lead.
+    for (size_t i = 0; i < count; i++) {
+        liveSamples[i].timestampUs = samples[i].timestampUs;
+        liveSamples[i].value = samples[i].values[0];
+        liveSamples[i].flags = (samples[i].flags & ECG_SAMPLE_FLAG_BEAT) |
+                               ((samples[i].leadOffMask & 0x01) ? ECG_SAMPLE_FLAG_LEAD_OFF : 0);
+        liveSamples[i].reserved = 0;
+    }
+    live.queueSamples(liveSamples, count);
+}
+
+uint32_t acquisitionDropped() {
+    return ecgLeads.getSamplingStats().samplesDropped;
+}
+
+bool startAcquisition(ECGSampleRate rate) {
+    return ecgLeads.startSampling(rate);
+}
+
+void stopAcquisition() {
+    ecgLeads.stopSampling();
+}
+#else
+uint32_t acquisitionDropped() {
+    return ecgSensor.getSamplingStats().samplesDropped;
+}
+
+bool startAcquisition(ECGSampleRate rate) {
+    return ecgSensor.startSampling(rate);
+}
+
+void stopAcquisition() {
+    ecgSensor.stopSampling();
+}
+#endif
+
+/**
+ * @brief Conditions n samples in dspSamples and hands them to the network task.
+ */
+void processCaptured(size_t n) {
+    conditionSamples(dspSamples, n);
+    // Back to 0 once the detector restarted (lead off, new acquisition), so no stale rate is sent.
+    latestHeartRate.store((static_cast<uint32_t>(qrsDetector.getInstantHeartRateX10()) << 16) |
+                          qrsDetector.getLastRRIntervalMs());
+    // If the network task falls this far behind, the overrun counter records the loss.
+    processedSamples.pushBulk(dspSamples, n);
+}
+
+/**
+ * @brief Restarts sampling with the settings the network task requested, if any.
+ */
+void applyAcquisitionRequest() {
+    uint32_t seq = acquisitionRequestSeq.load();
+    if (seq == dspAcquisitionSeq) {
+        return;
+    }
+    stopAcquisition();
+    // Samples taken at the old settings still go through the old filters.
+    size_t n;
+    while ((n = readCaptured(dspSamples, ECG_DRAIN_CHUNK)) > 0) {
+        processCaptured(n);
+    }
+    configureConditioning(requestedAcquisition);
+    startAcquisition(static_cast<ECGSampleRate>(requestedAcquisition.sampleRateHz));
+    dspAcquisitionSeq = seq;
+}
+
+/**
+ * @brief Filters the captured samples, detects beats and hands the result to the network task.
+ */
+void dspTaskStep(void *) {
+    applyAcquisitionRequest();
+    size_t n;
+    while ((n = readCaptured(dspSamples, ECG_DRAIN_CHUNK)) > 0) {
+        if (acquisitionAppliedSeq.load() != dspAcquisitionSeq) {
+            // The first sample at the new settings tells the network task where they begin.
+            acquisitionBoundaryUs.store(dspSamples[0].timestampUs);
+            acquisitionAppliedSeq.store(dspAcquisitionSeq);
+        }
+        processCaptured(n);
+    }
+}
+
+/**
+ * @brief Applies a batch command to the uplink, or hands an acquisition command to the
+ * DSP task. Stream commands never get here; the WebSocket client applies them itself.
+ */
+void handleCommand(const DeviceCommand &command) {
+    if (command.type == DeviceCommandType::Batch) {
+        DeviceSettingsValues next = uplinkSettings;
+        if (command.fields & DEVICE_COMMAND_BATCH_SAMPLES) next.batchSamples = command.batchSamples;
+        if (command.fields & DEVICE_COMMAND_BATCH_DELAY) next.batchDelayMs = command.batchDelayMs;
+        if (command.fields & DEVICE_COMMAND_COMPRESS) next.compress = command.compress;
+        const char *error = DeviceSettings::validate(next);
+        if (error == nullptr) {
+            uplinkSettings = next;
+            wsClient.setBatchPolicy(next.batchSamples, next.batchDelayMs);
+            wsClient.setCompression(next.compress);
+        }
+        wsClient.ackCommand(command, error);
+        return;
+    }
+
+    // Acquisition: one change at a time, acked when its first sample is sent.
+    if (acquisitionPending) {
+        wsClient.ackCommand(command, "An acquisition change is in progress");
+        return;
+    }
+    AcquisitionConfig next = acquisition;
+    if (command.fields & DEVICE_COMMAND_SAMPLE_RATE) next.sampleRateHz = command.sampleRateHz;
+    if (command.fields & DEVICE_COMMAND_MAINS) next.mains = static_cast<MainsFrequency>(command.mainsHz);
+    if (command.fields & DEVICE_COMMAND_HIGH_PASS) next.highPass = command.highPass;
+    if (command.fields & DEVICE_COMMAND_NOTCH) next.notch = command.notch;
+    if (command.fields & DEVICE_COMMAND_LOW_PASS) next.lowPass = command.lowPass;
+    DeviceSettingsValues check = uplinkSettings;
+    check.sampleRateHz = next.sampleRateHz;
+    const char *error = DeviceSettings::validate(check);
+    if (error != nullptr) {
+        wsClient.ackCommand(command, error);
+        return;
+    }
+    requestedAcquisition = next;
+    acquisitionCommand = command;
+    acquisitionPending = true;
+    acquisitionRequestSeq.fetch_add(1);
+}
+
+/**
+ * @brief Returns how many of the popped samples were taken before a pending acquisition
+ * change; all of them if none is pending or its first sample has not been taken yet.
+ */
+size_t samplesBeforeChange(const ProcessedSample *samples, size_t count) {
+    if (!acquisitionPending || acquisitionAppliedSeq.load() != acquisitionRequestSeq.load()) {
+        return count;
+    }
+    uint32_t boundary = acquisitionBoundaryUs.load();
+    for (size_t i = 0; i < count; i++) {
+        if (static_cast<int32_t>(samples[i].timestampUs - boundary) >= 0) {
+            return i;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Switches the outputs to the new acquisition settings and acks the command.
+ * Everything queued before this was taken at the old settings.
+ */
+void completeAcquisitionChange() {
+    acquisition = requestedAcquisition;
+    uplinkSettings.sampleRateHz = acquisition.sampleRateHz;
+    wsClient.setSampleRate(acquisition.sampleRateHz);
+    hotspotServer.liveStream().setSampleRate(acquisition.sampleRateHz);
+    acquisitionPending = false;
+    wsClient.ackCommand(acquisitionCommand, nullptr);
+}
+
+/**
+ * @brief Marks the late-confirmed beats on an output once it has been given their R-peak
+ * sample; the output flags the sample or, if it went out already, reports the beat later.
+ */
+template <typename Output>
+void forwardEarlierBeats(Output &output) {
+    const uint32_t *beatTimeUs;
+    while (earlierBeats.peekContiguous(&beatTimeUs) > 0 && static_cast<int32_t>(*beatTimeUs - lastQueuedUs) <= 0) {
+        output.markBeat(*beatTimeUs);
+        earlierBeats.consume(1);
+    }
+}
+
+/**
+ * @brief Hands up to backlog processed samples to the uplink.
+ */
+void sendProcessed(size_t backlog) {
+    size_t n;
+    while (backlog > 0 &&
+           (n = processedSamples.popBulk(networkSamples, backlog < ECG_DRAIN_CHUNK ? backlog : ECG_DRAIN_CHUNK)) > 0) {
+        size_t before = samplesBeforeChange(networkSamples, n);
+        queueUplink(networkSamples, before);
+        if (before < n) {
+            completeAcquisitionChange();
+            queueUplink(networkSamples + before, n - before);
+        }
+        forwardEarlierBeats(wsClient);
+        backlog -= n;
+    }
+}
+
+/**
+ * @brief Sends everything buffered in one go, so the radio can sleep until the next burst.
+ */
+void sendBurst(size_t backlog) {
+    const ProcessedSample *oldest;
+    uint32_t nowUs = static_cast<uint32_t>(esp_timer_get_time());
+    uint32_t oldestAgeUs = processedSamples.peekContiguous(&oldest) > 0 ? nowUs - oldest->timestampUs : 0;
+    burstScheduler.beginBurst(nowUs, oldestAgeUs);
+    sendProcessed(backlog);
+    wsClient.flushECGBatch(); // Nothing is left to the batch delay, which would wake the radio
+    burstScheduler.endBurst(static_cast<uint32_t>(esp_timer_get_time()));
+    // Only what arrived during the sends means the link is behind; the rest was held on purpose.
+    wsClient.updateLink(processedSamples.size(), WiFi.RSSI());
+}
+
+/**
+ * @brief Sends the per-task stack and CPU figures to the server as a JSON text message.
+ */
+void reportTaskStats() {
+    PeriodicTask *tasks[] = {&dspTask, &networkTask};
+    AD8232_ECG::SamplingStats sampling = ecgSensor.getSamplingStats();
+
+    int length = snprintf(statusMessage, sizeof(statusMessage), "{\"type\":\"task_stats\",\"tasks\":[");
+    for (size_t i = 0; i < sizeof(tasks) / sizeof(tasks[0]); i++) {
+        PeriodicTask::Stats stats = tasks[i]->getStats();
+        length += snprintf(statusMessage + length, sizeof(statusMessage) - length,
+                           "%s{\"name\":\"%s\",\"stack_free\":%lu,\"cpu_permille\":%u,\"max_step_us\":%lu}",
+                           i > 0 ? "," : "", tasks[i]->getName(), (unsigned long)stats.stackHighWaterBytes,
+                           stats.cpuLoadPermille, (unsigned long)stats.maxStepUs);
+    }
+    snprintf(statusMessage + length, sizeof(statusMessage) - length,
+             "],\"channels\":%u,\"acquisition_dropped\":%lu,\"dsp_dropped\":%lu,\"adc_oversampled\":%s,"
+             "\"adc_calibrated\":%s,\"adc_conversions\":%lu}",
+             ECG_CHANNEL_COUNT, (unsigned long)acquisitionDropped(), (unsigned long)processedSamples.overrunCount(),
+             ecgSensor.isOversampling() ? "true" : "false", ecgSensor.isCalibrated() ? "true" : "false",
+             (unsigned long)sampling.adcConversions);
+    wsClient.sendStatus(statusMessage);
+}
+
+/**
+ * @brief Sends the transmit path counters (queue depths, send time, dropped and backfilled samples).
+ */
+void reportLinkStats() {
+    ECGWebSocketClient::Stats link = wsClient.getStats();
+    ECGSpool::Stats spool = ecgSpool.getStats();
+
+    snprintf(statusMessage, sizeof(statusMessage),
+             "{\"type\":\"link_stats\",\"queue_depth\":%u,\"pending_samples\":%u,\"frames_sent\":%lu,"
+             "\"samples_sent\":%lu,\"last_send_us\":%lu,\"max_send_us\":%lu,\"samples_dropped\":%lu,"
+             "\"frames_spooled\":%lu,\"spool_frames\":%lu,\"spool_overwritten\":%lu,"
+             "\"samples_backfilled\":%lu,\"time_sync_replies\":%lu,\"lead_events\":%lu,"
+             "\"samples_lead_off\":%lu,\"uplink_level\":%u,\"uplink_changes\":%lu,\"commands\":%lu,"
+             "\"samples_paused\":%lu}",
+             (unsigned)processedSamples.size(), link.pendingSamples, (unsigned long)link.framesSent,
+             (unsigned long)link.samplesSent, (unsigned long)link.lastSendUs, (unsigned long)link.maxSendUs,
+             (unsigned long)link.samplesDropped, (unsigned long)link.framesSpooled,
+             (unsigned long)ecgSpool.frameCount(), (unsigned long)spool.framesOverwritten,
+             (unsigned long)link.samplesBackfilled, (unsigned long)link.timeSyncReplies,
+             (unsigned long)link.leadEvents, (unsigned long)link.samplesLeadOff, link.uplinkLevel,
+             (unsigned long)link.uplinkChanges, (unsigned long)link.commandsReceived,
+             (unsigned long)link.samplesPaused);
+    wsClient.sendStatus(statusMessage);
+}
+
+/**
+ * @brief Sends the duty cycle and queue latency of low-power streaming.
+ */
+void reportPowerStats() {
+    BurstScheduler::Stats burst = burstScheduler.getStats();
+    snprintf(statusMessage, sizeof(statusMessage),
+             "{\"type\":\"power_stats\",\"burst_interval_ms\":%u,\"bursts\":%lu,\"early_bursts\":%lu,"
+             "\"duty_permille\":%u,\"last_duty_permille\":%u,\"last_burst_us\":%lu,\"max_burst_us\":%lu,"
+             "\"queue_latency_ms\":%lu,\"max_queue_latency_ms\":%lu,\"cpu_min_mhz\":%d}",
+             burstScheduler.getInterval(), (unsigned long)burst.bursts, (unsigned long)burst.earlyBursts,
+             burst.dutyPermille, burst.lastDutyPermille, (unsigned long)burst.lastBurstUs,
+             (unsigned long)burst.maxBurstUs, (unsigned long)burst.meanLatencyMs, (unsigned long)burst.maxLatencyMs,
+             ECG_LOW_POWER_CPU_MHZ);
+    wsClient.sendStatus(statusMessage);
+}
+
+/**
+ * @brief Runs WiFi, the WebSocket, the hotspot server and the button/LED, and sends samples.
+ */
+void networkTaskStep(void *) {
+    wirelessComm.loop();
     wsClient.loop();
+    DeviceCommand command;
+    while (wsClient.takeCommand(command)) {
+        handleCommand(command);
+    }
 
     // --- Handle WiFi Switch Request from Hotspot Web Server ---
     if (hotspotServer.isWifiSwitchRequested()) {
         // Serial.println("WiFi switch requested by web interface. Attempting to connect to new WiFi...");
+        wirelessComm.saveWiFiCredentials(hotspotServer.getRequestedSsid(), hotspotServer.getRequestedPassword());
         hotspotServer.resetWifiSwitchRequest();
         if (hotspotServerActive) {
             // stopDNS();
@@ -105,22 +650,19 @@ void loop() {
         }
         
         wirelessComm.activateWiFiMode();
-        if (wirelessComm.isConnected()) {
-           if (wsClient.connect(WS_SERVER_IP, WS_SERVER_PORT, WS_SERVER_PATH)) {
-            // Serial.println("WebSocket connected successfully after WiFi switch!");
-            ledHandler.setBlue(1);
-            ledHandler.setGreen(1);
-           } else {
-            ledHandler.setBlue(0);
-            // Serial.println("Failed to connect to WebSocket server after WiFi switch.");
-            ledHandler.setGreen(1);
-           };
-        }
     }
 
+    // --- Apply device settings saved on the Hotspot Web Server ---
+    if (hotspotServer.isRestartRequested()) {
+        // Serial.println("Device settings changed, restarting to apply them...");
+        hotspotServer.resetRestartRequest();
+        wifiConfig.commit(); // Don't lose a mode change still waiting for the commit delay
+        esp_restart();
+    }
 
-    clicks = ledHandler.getAndResetClickCount();
-    if (clicks == 1) { // Single click: Attempt to switch to WiFi Station mode and connect to WebSocket
+    // Long presses are not bound to anything yet.
+    ButtonEvent button = ledHandler.takeButtonEvent();
+    if (button == ButtonEvent::SingleClick) { // Single click: Attempt to switch to WiFi Station mode and connect to WebSocket
         // Serial.println("Single click detected! Attempting to activate WiFi mode...");
         if (hotspotServerActive) {
             // stopDNS();
@@ -128,28 +670,11 @@ void loop() {
             hotspotServerActive = false;
         }
         wirelessComm.activateWiFiMode();
-        if (wirelessComm.isConnected()) {
-            ledHandler.setGreen(1); 
-            // Attempt to connect to WebSocket server
-           if (wsClient.connect(WS_SERVER_IP, WS_SERVER_PORT, WS_SERVER_PATH)) {
-            // Serial.println("WebSocket connected successfully after WiFi switch!");
-            ledHandler.setBlue(1);
-           } else {
-            // Serial.println("Failed to connect to WebSocket server after WiFi switch.");
-            ledHandler.setBlue(0);
-           }
-        }
-        else {
-            // Serial.println("Failed to connect to WiFi. Will keep trying after Some time.");
-            ledHandler.setGreen(0);
-
-        }
-    } else if (clicks == 2) { // Double click: Force switch to Hotspot mode
+    } else if (button == ButtonEvent::DoubleClick) { // Double click: Force switch to Hotspot mode
         // Serial.println("Double click detected! Activating Hotspot mode...");
         wsClient.disconnect();
         wirelessComm.activateHotspotMode(HOTSPOT_SSID, HOTSPOT_PASSWORD);
         ledHandler.setBlue(0);
-        ledHandler.toggleGreenSixTimes(300); // Blink green LED 6 times
         if (!hotspotServerActive) {
             hotspotServer.begin();
             hotspotServerActive = true;
@@ -157,34 +682,73 @@ void loop() {
         }
     }
 
-    String localMode = wirelessComm.getLocalMode();
-    if (localMode == "wifi") {
-        int ecgValue = ecgSensor.readECG();
-        // Serial.println(ecgValue);
-
-        // if (ecgSensor.isSensorConnected()) { // Check if ECG leads are properly attached
-        wsClient.sendECGValue(ecgValue);
-    }
-        else {
+    WirelessMode localMode = wirelessComm.getLocalMode();
+    if (localMode == WirelessMode::WiFi) {
+        // Send everything the DSP task produced since the last iteration.
+        uint32_t heartRate = latestHeartRate.load();
+        wsClient.setHeartRate(heartRate >> 16, heartRate & 0xFFFF);
+        size_t backlog = processedSamples.size();
+        if (!burstScheduler.isEnabled()) {
+            // What piled up while the last sends blocked tells the uplink how far behind it is.
+            wsClient.updateLink(backlog, WiFi.RSSI());
+            // Drain only that backlog: on a slow link the DSP refills the buffer while the
+            // sends block, and the uplink can only adapt once this step returns.
+            sendProcessed(backlog);
+        } else if (burstScheduler.isDue(static_cast<uint32_t>(esp_timer_get_time()),
+                                        backlog * 1000 / uplinkSettings.sampleRateHz,
+                                        processedSamples.capacity() * 1000 / uplinkSettings.sampleRateHz)) {
+            sendBurst(backlog);
+        }
+        // The steady color shows the link state again; a boot pattern still playing finishes.
+        ledHandler.stopPattern(&LED_PATTERN_BLINK_GREEN);
+        ledHandler.stopPattern(&LED_PATTERN_BREATHE_GREEN);
+    } else if (hotspotServerActive) {
+        // Hotspot mode: sampling keeps running and local viewers watch it on /live.
+        ECGLiveStream &live = hotspotServer.liveStream();
+        uint32_t heartRate = latestHeartRate.load();
+        live.setHeartRate(heartRate >> 16, heartRate & 0xFFFF);
+        size_t n;
+        while ((n = processedSamples.popBulk(networkSamples, ECG_DRAIN_CHUNK)) > 0) {
+            size_t before = samplesBeforeChange(networkSamples, n);
+            queueLive(live, networkSamples, before); // Never blocks; dropped when nobody watches
+            if (before < n) {
+                completeAcquisitionChange();
+                queueLive(live, networkSamples + before, n - before);
+            }
+            forwardEarlierBeats(live);
+        }
+        live.loop();
         // dnsServer.processNextRequest();
-        ledHandler.toggleGreenSixTimes(300); // Blink green LED 6 times if WiFi is not connected
+        // Breathe while someone watches, blink otherwise
+        ledHandler.playPattern(live.hasClients() ? LED_PATTERN_BREATHE_GREEN : LED_PATTERN_BLINK_GREEN);
+    } else {
+        // Not streaming: discard processed samples so the buffer does not sit full.
+        processedSamples.clear();
+        earlierBeats.clear();
+        if (acquisitionPending && acquisitionAppliedSeq.load() == acquisitionRequestSeq.load()) {
+            completeAcquisitionChange(); // Nothing was sent at the old settings
+        }
+        ledHandler.playPattern(LED_PATTERN_BLINK_GREEN); // Blink green LED if WiFi is not connected
     }
 
-    if (localMode == "wifi" && !wirelessComm.isConnected() && (millis() - lastWiFiReconnectAttempt > RECONNECT_INTERVAL_MS)) {
-        ledHandler.setGreen(0);
-        ledHandler.setBlue(0);
-        // Serial.println("WiFi lost or not connected. Re-attempting WiFi connection...");
-        wirelessComm.activateWiFiMode();
-        lastWiFiReconnectAttempt = millis();
-        if (wirelessComm.isConnected()) {
-            ledHandler.setGreen(1);
-            // Serial.println("Reconnected to WiFi successfully!");
+    // WiFi reconnects on its own (see WiFiStateMachine); only follow its state here.
+    bool wifiConnected = wirelessComm.isConnected();
+    if (wifiConnected != wifiWasConnected) {
+        wifiWasConnected = wifiConnected;
+        ledHandler.setGreen(wifiConnected);
+        if (wifiConnected) {
+            // Serial.println("WiFi connected.");
+            lastWsReconnectAttempt = millis() - RECONNECT_INTERVAL_MS - 1; // Connect the WebSocket right away
+        } else {
+            // Serial.println("WiFi lost, reconnecting in the background...");
+            ledHandler.setBlue(0);
         }
     }
-    if (localMode == "wifi" && wirelessComm.isConnected() && !wsClient.isConnected() && (millis() - lastWsReconnectAttempt > RECONNECT_INTERVAL_MS)) {
+    if (localMode == WirelessMode::WiFi && wirelessComm.isConnected() && !wsClient.isConnected() && (millis() - lastWsReconnectAttempt > RECONNECT_INTERVAL_MS)) {
         // Serial.println("WebSocket lost or not connected. Re-attempting WebSocket connection...");
         ledHandler.setGreen(1);
-        wsClient.connect(WS_SERVER_IP, WS_SERVER_PORT, WS_SERVER_PATH);
+        const DeviceSettingsValues &device = deviceSettings.active();
+        wsClient.connect(device.serverHost, device.serverPort, deviceSettings.getStreamPath());
         lastWsReconnectAttempt = millis();
         if (wsClient.isConnected()) {
             ledHandler.setBlue(1);
@@ -194,5 +758,12 @@ void loop() {
             // Serial.println("Failed to reconnect to WebSocket.");
         }
     }
-    delay(8);  // Sampling rate of 125Hz (8ms per sample)
+    if (wsClient.isConnected() && millis() - lastTaskStatsReport >= TASK_STATS_INTERVAL_MS) {
+        lastTaskStatsReport = millis();
+        reportTaskStats();
+        reportLinkStats();
+        if (burstScheduler.isEnabled()) {
+            reportPowerStats();
+        }
+    }
 }
@@ -0,0 +1,143 @@
+// Checks the CIC decimator and the ADC calibration table of oversampled capture against
+// known signals.
+
+#include <math.h>
+#include <unity.h>
+
+#include "ADCCalibration.h"
+#include "AD8232_ECG.h"
+#include "CICDecimator.h"
+
+// Conversion rate and decimation of main.cpp, and outputs measured per tone (4 s at 125 Hz)
+#define RAW_RATE_HZ 20000
+#define RATIO 160
+#define OUTPUTS 500
+
+static CICDecimator decimator;
+
+void setUp(void) {
+    decimator.configure(AD8232_CIC_ORDER, RATIO);
+}
+
+void tearDown(void) {}
+
+/**
+ * @brief Feeds a sine of frequencyHz at the conversion rate through the decimator and returns
+ * the output amplitude relative to the input amplitude.
+ */
+static double gainAt(double frequencyHz) {
+    const double amplitude = 16000.0; // 1 V in 1/16 mV, around mid-scale
+    double sum = 0;
+    double sumSquares = 0;
+    int outputs = 0;
+    for (uint64_t n = 0; outputs < OUTPUTS; n++) {
+        double input = 26400.0 + amplitude * sin(2.0 * M_PI * frequencyHz * n / RAW_RATE_HZ);
+        int32_t output;
+        if (decimator.push(static_cast<int32_t>(lround(input)), output)) {
+            sum += output;
+            sumSquares += static_cast<double>(output) * output;
+            outputs++;
+        }
+    }
+    double mean = sum / outputs;
+    return sqrt(2.0 * (sumSquares / outputs - mean * mean)) / amplitude;
+}
+
+/**
+ * @brief Example of a bent ADC response: 142 mV offset, 0.75 mV per code and a droop near the top.
+ */
+static int bentResponse(int raw, void *) {
+    double mv = 142.0 + 0.75 * raw;
+    if (raw > 3000) {
+        mv -= (raw - 3000) * (raw - 3000) / 8000.0;
+    }
+    return static_cast<int>(lround(mv));
+}
+
+static void test_dc_passes_unchanged(void) {
+    int32_t output = 0;
+    int outputs = 0;
+    for (int n = 0; n < RAW_RATE_HZ; n++) {
+        if (decimator.push(20000, output)) {
+            TEST_ASSERT_EQUAL_INT32(20000, output);
+            outputs++;
+        }
+    }
+    TEST_ASSERT_GREATER_THAN(100, outputs);
+}
+
+static void test_integrators_wrap_without_affecting_the_output(void) {
+    // The last integrator of a fourth-order CIC passes 2^63 within ~9000 full-scale inputs.
+    CICDecimator cic;
+    TEST_ASSERT_TRUE(cic.configure(CIC_MAX_ORDER, CIC_MAX_RATIO));
+    const int32_t levels[2] = {32767, -32768};
+    for (int32_t level : levels) {
+        cic.reset();
+        int32_t output = 0;
+        uint32_t outputs = 0;
+        for (uint32_t n = 0; n < 1000000; n++) {
+            if (cic.push(level, output)) {
+                TEST_ASSERT_EQUAL_INT32(level, output);
+                outputs++;
+            }
+        }
+        TEST_ASSERT_GREATER_THAN(3000, outputs);
+    }
+}
+
+static void test_passband_is_flat_to_a_quarter_of_the_output_rate(void) {
+    TEST_ASSERT_FLOAT_WITHIN(0.02f, 1.0f, gainAt(5.0));
+    TEST_ASSERT_FLOAT_WITHIN(0.02f, 1.0f, gainAt(31.25));
+}
+
+static void test_alias_of_10_hz_is_rejected(void) {
+    // 135 Hz folds onto 10 Hz at the 125 Hz output rate.
+    TEST_ASSERT_LESS_THAN(10, lround(gainAt(135.0) * 1000));
+}
+
+static void test_noise_is_averaged_down(void) {
+    // White noise of one code RMS must come out below a quarter code, two bits gained.
+    uint32_t state = 0x2545F491;
+    double sumSquares = 0;
+    int outputs = 0;
+    int32_t output;
+    while (outputs < OUTPUTS) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        double noise = (static_cast<double>(state) / 4294967296.0 - 0.5) * 3.4641016 * 16.0; // 1 code = 16
+        if (decimator.push(static_cast<int32_t>(lround(26400.0 + noise)), output)) {
+            sumSquares += (output - 26400.0) * (output - 26400.0);
+            outputs++;
+        }
+    }
+    TEST_ASSERT_LESS_THAN(250, lround(sqrt(sumSquares / outputs) / 16.0 * 1000));
+}
+
+static void test_nominal_table_round_trips(void) {
+    ADCCalibration calibration;
+    for (uint16_t code = 0; code < ADC_CALIBRATION_CODES; code++) {
+        TEST_ASSERT_EQUAL_UINT16(code, ADCCalibration::millivoltsQ4ToCounts(calibration.toMillivoltsQ4(code)));
+    }
+}
+
+static void test_table_follows_a_bent_curve(void) {
+    ADCCalibration calibration;
+    calibration.build(bentResponse, nullptr);
+    for (int code = 0; code < ADC_CALIBRATION_CODES; code++) {
+        double exactMv = 142.0 + 0.75 * code - (code > 3000 ? (code - 3000) * (code - 3000) / 8000.0 : 0.0);
+        TEST_ASSERT_FLOAT_WITHIN(0.75f, exactMv, calibration.toMillivoltsQ4(code) / 16.0);
+    }
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_dc_passes_unchanged);
+    RUN_TEST(test_integrators_wrap_without_affecting_the_output);
+    RUN_TEST(test_passband_is_flat_to_a_quarter_of_the_output_rate);
+    RUN_TEST(test_alias_of_10_hz_is_rejected);
+    RUN_TEST(test_noise_is_averaged_down);
+    RUN_TEST(test_nominal_table_round_trips);
+    RUN_TEST(test_table_follows_a_bent_curve);
+    return UNITY_END();
+}
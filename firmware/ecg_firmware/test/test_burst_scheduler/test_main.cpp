@@ -0,0 +1,76 @@
+// Drives the burst scheduler by hand: due on time, early when the buffer fills, and the
+// duty cycle and latency it reports.
+
+#include <unity.h>
+
+#include "BurstScheduler.h"
+
+#define INTERVAL_MS 500
+// A buffer of 8192 ms of signal starts a burst early at 6144 ms
+#define CAPACITY_MS 8192
+
+static BurstScheduler scheduler;
+
+void setUp(void) {
+    scheduler.setInterval(INTERVAL_MS);
+}
+
+void tearDown(void) {}
+
+static void test_disabled_is_always_due(void) {
+    BurstScheduler disabled;
+    TEST_ASSERT_FALSE(disabled.isEnabled());
+    TEST_ASSERT_TRUE(disabled.isDue(0, 0, 1000));
+}
+
+static void test_first_burst_is_due_at_once(void) {
+    TEST_ASSERT_TRUE(scheduler.isEnabled());
+    TEST_ASSERT_TRUE(scheduler.isDue(0, 0, CAPACITY_MS));
+}
+
+static void test_due_after_the_interval_or_when_filling_up(void) {
+    scheduler.beginBurst(0, 300000);
+    scheduler.endBurst(10000);
+    TEST_ASSERT_FALSE(scheduler.isDue(400000, 400, CAPACITY_MS));
+    TEST_ASSERT_TRUE(scheduler.isDue(500000, 500, CAPACITY_MS));
+    TEST_ASSERT_TRUE(scheduler.isDue(200000, 6200, CAPACITY_MS));
+    TEST_ASSERT_FALSE(scheduler.isDue(200000, 6000, CAPACITY_MS));
+}
+
+static void test_duty_cycle_and_latency(void) {
+    scheduler.beginBurst(0, 300000);
+    scheduler.endBurst(10000);
+    // Second cycle starts early, at 75 % fill
+    scheduler.beginBurst(200000, 200000);
+    scheduler.endBurst(250000);
+    // A cycle across the wrap of the 32-bit clock: a 50 ms burst in 500 ms
+    scheduler.beginBurst(0xFFFFFFFFu - 100000, 600000);
+    scheduler.endBurst(0xFFFFFFFFu - 50000);
+    scheduler.beginBurst(0xFFFFFFFFu - 100000 + 500000u, 500000);
+
+    BurstScheduler::Stats stats = scheduler.getStats();
+    TEST_ASSERT_EQUAL_UINT32(3, stats.bursts);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.earlyBursts);
+    TEST_ASSERT_EQUAL_UINT16(100, stats.lastDutyPermille);
+    TEST_ASSERT_EQUAL_UINT32(600, stats.maxLatencyMs);
+    // The latency mean covers the three completed bursts: (300 + 200 + 600) / 3
+    TEST_ASSERT_EQUAL_UINT32(366, stats.meanLatencyMs);
+}
+
+static void test_reset_forgets_the_last_burst(void) {
+    scheduler.beginBurst(0, 0);
+    scheduler.endBurst(1000);
+    scheduler.reset();
+    TEST_ASSERT_TRUE(scheduler.isDue(1000, 0, CAPACITY_MS));
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.getStats().bursts);
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_disabled_is_always_due);
+    RUN_TEST(test_first_burst_is_due_at_once);
+    RUN_TEST(test_due_after_the_interval_or_when_filling_up);
+    RUN_TEST(test_duty_cycle_and_latency);
+    RUN_TEST(test_reset_forgets_the_last_burst);
+    return UNITY_END();
+}
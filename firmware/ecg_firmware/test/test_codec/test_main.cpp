@@ -0,0 +1,133 @@
+// Round-trips the delta-zigzag-varint codec of ECGCodec.h through its edge cases: the
+// largest 12-bit steps, the 1/2/3-byte boundaries and deltas that wrap the uint16 range.
+
+#include <string.h>
+#include <unity.h>
+
+#include "ECGCodec.h"
+#include "ECGFrame.h"
+
+static ECGDeltaEncoder encoder;
+static ECGDeltaDecoder decoder;
+
+void setUp(void) {
+    encoder.reset();
+    decoder.reset();
+}
+
+void tearDown(void) {}
+
+/**
+ * @brief Encodes values as one block, decodes it and checks that every value comes back.
+ */
+static void roundTrip(const uint16_t *values, size_t count) {
+    uint8_t encoded[64 * ECG_CODEC_MAX_BYTES_PER_VALUE];
+    uint16_t decoded[64] = {};
+    TEST_ASSERT_TRUE(count <= 64);
+    size_t written = encoder.encodeBlock(values, count, encoded, sizeof(encoded));
+    TEST_ASSERT_GREATER_THAN(0, written);
+    TEST_ASSERT_EQUAL_UINT32(written, decoder.decodeBlock(encoded, written, decoded, count));
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(values, decoded, count);
+}
+
+/**
+ * @brief Returns the encoded size of value after previous.
+ */
+static size_t encodedSize(uint16_t previous, uint16_t value) {
+    uint8_t out[ECG_CODEC_MAX_BYTES_PER_VALUE];
+    ECGDeltaEncoder e;
+    e.encode(previous, out);
+    return e.encode(value, out);
+}
+
+static void test_full_scale_12_bit_steps(void) {
+    const uint16_t values[] = {0, 4095, 0, 4095, 4095, 2048, 4095, 0, 1, 4094, 2047, 2048};
+    roundTrip(values, sizeof(values) / sizeof(values[0]));
+    TEST_ASSERT_EQUAL_UINT32(2, encodedSize(0, 4095));
+    TEST_ASSERT_EQUAL_UINT32(2, encodedSize(4095, 0));
+}
+
+static void test_byte_boundaries(void) {
+    // Zigzag keeps deltas from -64 to 63 in one byte and -8192 to 8191 in two.
+    TEST_ASSERT_EQUAL_UINT32(1, encodedSize(1000, 1000));
+    TEST_ASSERT_EQUAL_UINT32(1, encodedSize(1000, 1063));
+    TEST_ASSERT_EQUAL_UINT32(1, encodedSize(1000, 936));
+    TEST_ASSERT_EQUAL_UINT32(2, encodedSize(1000, 1064));
+    TEST_ASSERT_EQUAL_UINT32(2, encodedSize(1000, 935));
+    TEST_ASSERT_EQUAL_UINT32(2, encodedSize(10000, 18191));
+    TEST_ASSERT_EQUAL_UINT32(2, encodedSize(10000, 1808));
+    TEST_ASSERT_EQUAL_UINT32(3, encodedSize(10000, 18192));
+    TEST_ASSERT_EQUAL_UINT32(3, encodedSize(10000, 1807));
+    const uint16_t values[] = {1000, 1063, 999, 935, 999, 1064, 10000, 18191, 10000, 1808, 10000, 18192, 1807};
+    roundTrip(values, sizeof(values) / sizeof(values[0]));
+}
+
+static void test_wraparound(void) {
+    // Full-range 16-bit steps take the worst case of three bytes and land back exactly.
+    const uint16_t values[] = {65535, 0, 65535, 1, 65534, 32768, 0, 32767, 65535, 65535, 0};
+    roundTrip(values, sizeof(values) / sizeof(values[0]));
+    TEST_ASSERT_EQUAL_UINT32(3, encodedSize(0, 65535));
+    TEST_ASSERT_EQUAL_UINT32(3, encodedSize(65535, 0));
+}
+
+static void test_every_step_from_the_edges(void) {
+    const uint16_t starts[] = {0, 2048, 4095, 65535};
+    uint8_t out[ECG_CODEC_MAX_BYTES_PER_VALUE];
+    for (size_t s = 0; s < sizeof(starts) / sizeof(starts[0]); s++) {
+        for (uint32_t value = 0; value <= 0xFFFF; value++) {
+            ECGDeltaEncoder e;
+            ECGDeltaDecoder d;
+            uint16_t decoded = 0;
+            size_t n = e.encode(starts[s], out);
+            TEST_ASSERT_EQUAL_UINT32(n, d.decode(out, n, decoded));
+            n = e.encode(static_cast<uint16_t>(value), out);
+            TEST_ASSERT_TRUE(n >= 1 && n <= ECG_CODEC_MAX_BYTES_PER_VALUE);
+            TEST_ASSERT_EQUAL_UINT32(n, d.decode(out, n, decoded));
+            TEST_ASSERT_EQUAL_UINT16(value, decoded);
+        }
+    }
+}
+
+static void test_malformed_input_is_refused(void) {
+    uint8_t out[ECG_CODEC_MAX_BYTES_PER_VALUE];
+    uint16_t value = 0;
+    size_t n = encoder.encode(65535, out);
+    TEST_ASSERT_EQUAL_UINT32(3, n);
+    // Truncated
+    TEST_ASSERT_EQUAL_UINT32(0, decoder.decode(out, 2, value));
+    // Longer than any uint16 delta
+    const uint8_t tooLong[] = {0xFF, 0xFF, 0xFF, 0x01};
+    TEST_ASSERT_EQUAL_UINT32(0, decoder.decode(tooLong, sizeof(tooLong), value));
+}
+
+static void test_frame_payload_round_trip(void) {
+    // The samples block of a frame starts a fresh predictor after the header.
+    ECGSample samples[8] = {};
+    const uint16_t values[8] = {4095, 0, 65535, 0, 2048, 2047, 4095, 4095};
+    for (size_t i = 0; i < 8; i++) {
+        samples[i].value = values[i];
+    }
+    ECGFrameHeader header = {};
+    header.type = ECG_FRAME_TYPE_SAMPLES;
+    header.flags = ECG_FRAME_FLAG_DELTA_VARINT;
+    header.sampleRateHz = 125;
+    uint8_t frame[ecgFrameMaxSize(8)];
+    size_t length = encodeECGFrame(header, samples, 8, frame, sizeof(frame));
+    TEST_ASSERT_GREATER_THAN(ECG_FRAME_HEADER_SIZE, length);
+    uint16_t decoded[8] = {};
+    TEST_ASSERT_EQUAL_UINT32(length - ECG_FRAME_HEADER_SIZE,
+                             decoder.decodeBlock(frame + ECG_FRAME_HEADER_SIZE, length - ECG_FRAME_HEADER_SIZE,
+                                                 decoded, 8));
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(values, decoded, 8);
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_full_scale_12_bit_steps);
+    RUN_TEST(test_byte_boundaries);
+    RUN_TEST(test_wraparound);
+    RUN_TEST(test_every_step_from_the_edges);
+    RUN_TEST(test_malformed_input_is_refused);
+    RUN_TEST(test_frame_payload_round_trip);
+    return UNITY_END();
+}
@@ -0,0 +1,148 @@
+// Sends server commands to a streaming device and checks the acks and the rate of every frame.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+
+#include "NativeSimulation.h"
+
+// Preview from 5 s, full rate again from 15 s, 250 Hz from 20 s
+#define RUN_SECONDS 40
+// Preview averages a single lead down to 25 Hz; multi-channel builds keep the full rate
+#if defined(ECG_CHANNEL_COUNT) && ECG_CHANNEL_COUNT > 1
+#define PREVIEW_RATE_HZ 125
+#else
+#define PREVIEW_RATE_HZ 25
+#endif
+#define MAX_ACKS 16
+
+struct CommandStep {
+    uint32_t atS;       // Simulated second it is sent in
+    const char *json;
+    const char *status; // Expected ack status
+};
+
+static const CommandStep SCRIPT[] = {
+    {5, "{\"type\":\"command\",\"seq\":1,\"name\":\"stream\",\"mode\":\"preview\"}", "ok"},
+    {15, "{\"type\":\"command\",\"seq\":2,\"name\":\"stream\",\"mode\":\"full\"}", "ok"},
+    {16, "{\"type\":\"command\",\"seq\":2,\"name\":\"stream\",\"mode\":\"full\"}", "ok"}, // Resend: same answer
+    {20, "{\"type\":\"command\",\"seq\":3,\"name\":\"acquisition\",\"sample_rate_hz\":250,\"mains_hz\":60}", "ok"},
+    {20, "{\"type\":\"command\",\"seq\":3,\"name\":\"acquisition\",\"sample_rate_hz\":250,\"mains_hz\":60}", "duplicate"}, // Still applying
+    {20, "{\"type\":\"command\",\"seq\":4,\"name\":\"acquisition\",\"notch\":false}", "error"}, // Busy
+    {22, "{\"type\":\"command\",\"seq\":3,\"name\":\"acquisition\",\"sample_rate_hz\":250,\"mains_hz\":60}", "ok"},
+    {22, "{\"type\":\"command\",\"seq\":4,\"name\":\"acquisition\",\"notch\":false}", "error"}, // The same error
+    {25, "{\"type\":\"command\",\"seq\":5,\"name\":\"reboot\"}", "error"},
+    {25, "{\"type\":\"command\",\"seq\":6,\"name\":\"batch\",\"sample_rate_hz\":1}", "error"}, // Nothing it takes
+    {30, "{\"type\":\"command\",\"seq\":7,\"name\":\"batch\",\"samples\":50,\"delay_ms\":400}", "ok"},
+    {32, "{\"type\":\"command\",\"seq\":8,\"name\":\"batch\",\"compress\":1}", "error"}, // Malformed
+    {33, "{\"type\":\"command\",\"seq\":8,\"name\":\"batch\",\"compress\":true}", "ok"}, // The seq was not used up
+};
+static const size_t STEPS = sizeof(SCRIPT) / sizeof(SCRIPT[0]);
+
+static size_t s_sent = 0;                  // SCRIPT entries sent so far
+static char s_acks[MAX_ACKS][16];          // "seq:status" of each ack, in arrival order
+static size_t s_ackCount = 0;
+static uint16_t s_expectedRateHz = 125;    // Rate every sample frame must have until the next ack
+static uint32_t s_framesByRate[3] = {};    // At 125 Hz, the preview rate (if lower) and 250 Hz
+static uint32_t s_wrongRateFrames = 0;
+
+/**
+ * @brief Sends the SCRIPT entries that are due; called once per simulated second.
+ */
+static void runScript(uint64_t nowUs) {
+    while (s_sent < STEPS && nowUs >= SCRIPT[s_sent].atS * 1000000ULL) {
+        websockets::LoopbackServer::instance().sendText(SCRIPT[s_sent].json);
+        s_sent++;
+    }
+}
+
+/**
+ * @brief Records a command_ack. Frames sent after an ok ack must be at the rate the
+ * command asked for, so the expected rate moves with the acks of seq 1 to 3.
+ */
+static void onText(const std::string &text) {
+    if (text.find("\"command_ack\"") == std::string::npos) {
+        return;
+    }
+    unsigned seq = 0;
+    char status[12] = "";
+    const char *field = strstr(text.c_str(), "\"seq\":");
+    if (field != nullptr) {
+        seq = static_cast<unsigned>(atoi(field + 6));
+    }
+    if ((field = strstr(text.c_str(), "\"status\":\"")) != nullptr) {
+        sscanf(field + 10, "%11[a-z]", status);
+    }
+    if (s_ackCount < MAX_ACKS) {
+        snprintf(s_acks[s_ackCount++], sizeof(s_acks[0]), "%u:%s", seq, status);
+    }
+    if (strcmp(status, "ok") == 0) {
+        static const uint16_t ratesAfter[] = {0, PREVIEW_RATE_HZ, 125, 250};
+        if (seq < sizeof(ratesAfter) / sizeof(ratesAfter[0])) {
+            s_expectedRateHz = ratesAfter[seq];
+        }
+    }
+}
+
+static void onFrame(const ECGFrameHeader &header, const uint8_t *, size_t) {
+    if (header.type == ECG_FRAME_TYPE_LEAD_EVENT) {
+        return;
+    }
+    int index = header.sampleRateHz == PREVIEW_RATE_HZ ? 1 : (header.sampleRateHz == 125 ? 0 : 2);
+    s_framesByRate[index]++;
+    if (header.sampleRateHz != s_expectedRateHz) {
+        s_wrongRateFrames++;
+    }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void test_every_command_is_acked(void) {
+    TEST_ASSERT_EQUAL_UINT32(STEPS, wsClient.getStats().commandsReceived);
+    TEST_ASSERT_EQUAL_UINT32(STEPS, s_ackCount);
+    // Acks come in the order the commands complete, so match them regardless of order.
+    bool used[MAX_ACKS] = {};
+    for (size_t i = 0; i < STEPS; i++) {
+        char expected[16];
+        snprintf(expected, sizeof(expected), "%u:%s", static_cast<unsigned>(atoi(strstr(SCRIPT[i].json, "\"seq\":") + 6)),
+                 SCRIPT[i].status);
+        bool found = false;
+        for (size_t a = 0; a < s_ackCount && !found; a++) {
+            if (!used[a] && strcmp(s_acks[a], expected) == 0) {
+                used[a] = found = true;
+            }
+        }
+        TEST_ASSERT_TRUE_MESSAGE(found, expected);
+    }
+}
+
+static void test_frames_have_the_rate_in_force(void) {
+    TEST_ASSERT_EQUAL_UINT32(0, s_wrongRateFrames);
+    TEST_ASSERT_GREATER_THAN(0, s_framesByRate[1]);
+    TEST_ASSERT_GREATER_THAN(0, s_framesByRate[2]);
+    TEST_ASSERT_EQUAL_UINT16(250, s_expectedRateHz);
+}
+
+static void test_no_sample_is_dropped(void) {
+    TEST_ASSERT_EQUAL_UINT32(0, NativeSim::samplingStats().samplesDropped);
+    TEST_ASSERT_EQUAL_UINT32(0, NativeSim::received().badFrames);
+}
+
+int main(int, char **) {
+    NativeSim::setTextHandler(onText);
+    NativeSim::setFrameHandler(onFrame);
+    NativeSim::Options options = NativeSim::defaultOptions();
+    options.leadScript = false;
+    NativeSim::begin(options);
+    NativeSim::runUntil(RUN_SECONDS, runScript);
+    NativeSim::end();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_every_command_is_acked);
+    RUN_TEST(test_frames_have_the_rate_in_force);
+    RUN_TEST(test_no_sample_is_dropped);
+    return UNITY_END();
+}
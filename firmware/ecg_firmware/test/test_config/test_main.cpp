@@ -0,0 +1,95 @@
+// Counts the flash writes of PersistentConfig on the simulated NVS: none for values that did
+// not change, and one per key for a burst of changes once the commit delay has passed.
+
+#include <unity.h>
+
+#include "NativeHAL.h"
+#include "PersistentConfig.h"
+
+#define TEST_NAMESPACE "test_config"
+
+static void advanceMs(uint32_t ms) {
+    NativeHAL::advanceMicros(static_cast<uint64_t>(ms) * 1000);
+}
+
+/**
+ * @brief Registers the settings the tests use, as main.cpp does at boot.
+ */
+static void addSettings(PersistentConfig &config) {
+    config.begin();
+    config.addString("ssid", "");
+    config.addUInt("interval", 500);
+}
+
+void setUp(void) {
+    Preferences::reset();
+}
+
+void tearDown(void) {}
+
+static void test_unchanged_values_are_not_written(void) {
+    PersistentConfig config(TEST_NAMESPACE);
+    addSettings(config);
+    config.setString("ssid", "lab");
+    config.commit();
+    uint32_t writes = Preferences::writeCount();
+    TEST_ASSERT_EQUAL_UINT32(1, writes);
+
+    for (int i = 0; i < 100; i++) {
+        config.setString("ssid", "lab");
+        config.setUInt("interval", 500); // The default, never stored
+        advanceMs(100);
+        config.loop(millis());
+    }
+    TEST_ASSERT_FALSE(config.isDirty());
+    TEST_ASSERT_TRUE(config.commit());
+    TEST_ASSERT_EQUAL_UINT32(writes, Preferences::writeCount());
+    TEST_ASSERT_EQUAL_UINT32(1, config.getWriteCount());
+}
+
+static void test_commit_delay_coalesces_writes(void) {
+    PersistentConfig config(TEST_NAMESPACE);
+    addSettings(config);
+
+    // A burst of changes, each within the commit delay of the previous one.
+    for (uint32_t i = 1; i <= 20; i++) {
+        config.setUInt("interval", 500 + i);
+        config.setString("ssid", i % 2 ? "lab" : "home");
+        advanceMs(CONFIG_COMMIT_DELAY_MS - 1);
+        config.loop(millis());
+        TEST_ASSERT_EQUAL_UINT32(0, Preferences::writeCount());
+    }
+    TEST_ASSERT_TRUE(config.isDirty());
+
+    // Quiet for the delay: both keys are written once, with their last values.
+    advanceMs(1);
+    config.loop(millis());
+    TEST_ASSERT_FALSE(config.isDirty());
+    TEST_ASSERT_EQUAL_UINT32(2, Preferences::writeCount());
+    TEST_ASSERT_EQUAL_UINT32(2, config.getWriteCount());
+    advanceMs(10 * CONFIG_COMMIT_DELAY_MS);
+    config.loop(millis());
+    TEST_ASSERT_EQUAL_UINT32(2, Preferences::writeCount());
+
+    PersistentConfig reloaded(TEST_NAMESPACE);
+    addSettings(reloaded);
+    TEST_ASSERT_EQUAL_UINT32(520, reloaded.getUInt("interval"));
+    TEST_ASSERT_EQUAL_STRING("home", reloaded.getString("ssid").c_str());
+}
+
+static void test_commit_writes_only_the_changed_key_at_once(void) {
+    PersistentConfig config(TEST_NAMESPACE);
+    addSettings(config);
+    config.setUInt("interval", 250);
+    TEST_ASSERT_TRUE(config.commit());
+    TEST_ASSERT_EQUAL_UINT32(1, Preferences::writeCount());
+    TEST_ASSERT_FALSE(config.isDirty());
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_unchanged_values_are_not_written);
+    RUN_TEST(test_commit_delay_coalesces_writes);
+    RUN_TEST(test_commit_writes_only_the_changed_key_at_once);
+    return UNITY_END();
+}
@@ -0,0 +1,112 @@
+// Measures the frequency response of the ECGFilter bank with sine inputs and compares it
+// with the response of the ideal (floating-point) design.
+
+#include <math.h>
+#include <unity.h>
+
+#include "ECGFilter.h"
+
+// Input sine around mid-scale, in ADC counts
+#define AMPLITUDE 1000.0
+// Settling time before measuring, and the measured window, which holds a whole number of
+// cycles of every frequency below (multiples of 0.025 Hz)
+#define SETTLE_S 10
+#define WINDOW_S 40
+// Allowed difference from the reference gain: rounding to ADC counts and Q2.29 coefficients
+#define GAIN_TOLERANCE 0.005
+
+/**
+ * @brief Gain of the high-pass, notch and low-pass cascade at one frequency.
+ */
+struct ResponsePoint {
+    double frequencyHz;
+    double gain;
+};
+
+// |H(f)| of the RBJ designs (0.5 Hz Butterworth high-pass, Q30 notch, 40 Hz Butterworth
+// low-pass) evaluated in double precision from the bilinear-transform formulas.
+static const ResponsePoint RESPONSE_125HZ_50HZ[] = {
+    {0.25, 0.2425}, {0.5, 0.7071}, {1, 0.9702}, {2, 0.9981},  {5, 0.9999},  {10, 0.9996}, {20, 0.9927}, {30, 0.9423},
+    {40, 0.7069},   {45, 0.4813},  {48, 0.3380}, {50, 0.0000}, {52, 0.1776}, {55, 0.0899}, {60, 0.0098},
+};
+static const ResponsePoint RESPONSE_250HZ_60HZ[] = {
+    {0.5, 0.7071}, {1, 0.9701},  {5, 0.9999},  {20, 0.9770}, {40, 0.7068}, {50, 0.4959},
+    {58, 0.3366},  {60, 0.0000}, {62, 0.2810}, {80, 0.1208}, {100, 0.0319},
+};
+
+static ECGFilter filter;
+
+/**
+ * @brief Filters a sine of frequencyHz sampled at rateHz and returns the output amplitude
+ * relative to the input amplitude, from its projection on the sine and cosine.
+ */
+static double measureGain(ECGSampleRate rate, MainsFrequency mains, double frequencyHz) {
+    const double rateHz = static_cast<double>(static_cast<uint16_t>(rate));
+    filter.configure(rate, mains);
+    const int settle = static_cast<int>(SETTLE_S * rateHz);
+    const int window = static_cast<int>(WINDOW_S * rateHz);
+    double in = 0;
+    double quadrature = 0;
+    for (int n = 0; n < settle + window; n++) {
+        double phase = 2.0 * M_PI * frequencyHz * n / rateHz;
+        int out = filter.filter(static_cast<int>(lround(ECG_FILTER_ADC_MIDSCALE + AMPLITUDE * sin(phase))));
+        if (n >= settle) {
+            in += (out - ECG_FILTER_ADC_MIDSCALE) * sin(phase);
+            quadrature += (out - ECG_FILTER_ADC_MIDSCALE) * cos(phase);
+        }
+    }
+    return 2.0 * sqrt(in * in + quadrature * quadrature) / window / AMPLITUDE;
+}
+
+static void checkResponse(ECGSampleRate rate, MainsFrequency mains, const ResponsePoint *points, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        double gain = measureGain(rate, mains, points[i].frequencyHz);
+        char message[64];
+        snprintf(message, sizeof(message), "%.2f Hz: gain %.4f, reference %.4f", points[i].frequencyHz, gain,
+                 points[i].gain);
+        TEST_ASSERT_TRUE_MESSAGE(fabs(gain - points[i].gain) < GAIN_TOLERANCE, message);
+    }
+}
+
+void setUp(void) {
+    filter.setStages(true, true, true);
+}
+
+void tearDown(void) {}
+
+static void test_response_125hz_50hz_mains(void) {
+    checkResponse(ECGSampleRate::Hz125, MainsFrequency::Hz50, RESPONSE_125HZ_50HZ,
+                  sizeof(RESPONSE_125HZ_50HZ) / sizeof(RESPONSE_125HZ_50HZ[0]));
+}
+
+static void test_response_250hz_60hz_mains(void) {
+    checkResponse(ECGSampleRate::Hz250, MainsFrequency::Hz60, RESPONSE_250HZ_60HZ,
+                  sizeof(RESPONSE_250HZ_60HZ) / sizeof(RESPONSE_250HZ_60HZ[0]));
+}
+
+static void test_dc_settles_to_mid_scale(void) {
+    // The high-pass blocks DC exactly; error feedback leaves no offset or limit cycle.
+    filter.configure(ECGSampleRate::Hz125, MainsFrequency::Hz50);
+    int out = 0;
+    for (int n = 0; n < 60 * 125; n++) {
+        out = filter.filter(3000);
+    }
+    TEST_ASSERT_EQUAL_INT(ECG_FILTER_ADC_MIDSCALE, out);
+}
+
+static void test_disabled_stages_pass_through(void) {
+    filter.configure(ECGSampleRate::Hz125, MainsFrequency::Hz50);
+    filter.setStages(false, false, false);
+    for (int value = 0; value <= ECG_FILTER_ADC_MAX; value += 97) {
+        TEST_ASSERT_EQUAL_INT(value, filter.filter(value));
+    }
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_response_125hz_50hz_mains);
+    RUN_TEST(test_response_250hz_60hz_mains);
+    RUN_TEST(test_dc_settles_to_mid_scale);
+    RUN_TEST(test_disabled_stages_pass_through);
+    return UNITY_END();
+}
@@ -0,0 +1,135 @@
+// Checks that single- and multi-channel frames carry their sample and channel counts, and
+// that beats confirmed late travel with their R-peak time.
+
+#include <unity.h>
+
+#include "ECGFrame.h"
+
+#define FRAME_SAMPLES 25
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void test_sample_frame_header_round_trips(void) {
+    ECGSample samples[FRAME_SAMPLES] = {};
+    for (size_t i = 0; i < FRAME_SAMPLES; i++) {
+        samples[i].timestampUs = 8000 * i;
+        samples[i].value = static_cast<uint16_t>(2048 + i);
+    }
+    uint8_t frame[ecgFrameMaxSize(FRAME_SAMPLES)];
+    ECGFrameHeader header = {};
+    header.type = ECG_FRAME_TYPE_SAMPLES;
+    header.flags = ECG_FRAME_FLAG_DELTA_VARINT;
+    header.sequence = 7;
+    header.startTimeUs = 0x100000000ULL;
+    header.sampleRateHz = 125;
+    size_t length = encodeECGFrame(header, samples, FRAME_SAMPLES, frame, sizeof(frame));
+
+    ECGFrameHeader decoded;
+    TEST_ASSERT_GREATER_THAN(ECG_FRAME_HEADER_SIZE, length);
+    TEST_ASSERT_TRUE(decodeECGFrameHeader(frame, length, decoded));
+    TEST_ASSERT_EQUAL_UINT8(ECG_FRAME_TYPE_SAMPLES, decoded.type);
+    TEST_ASSERT_EQUAL_UINT32(7, decoded.sequence);
+    TEST_ASSERT_TRUE(decoded.startTimeUs == header.startTimeUs);
+    TEST_ASSERT_EQUAL_UINT16(125, decoded.sampleRateHz);
+    TEST_ASSERT_EQUAL_UINT16(FRAME_SAMPLES, decoded.sampleCount);
+    TEST_ASSERT_EQUAL_UINT8(0, decoded.channels);
+}
+
+static void test_multi_channel_frames_carry_their_channel_count(void) {
+    ECGMultiSample samples[FRAME_SAMPLES] = {};
+    for (size_t i = 0; i < FRAME_SAMPLES; i++) {
+        samples[i].timestampUs = 8000 * i;
+        for (uint8_t c = 0; c < ECG_MAX_CHANNELS; c++) {
+            samples[i].values[c] = static_cast<uint16_t>(1000 * (c + 1) + i);
+        }
+    }
+    uint8_t frame[ecgMultiFrameMaxSize(FRAME_SAMPLES, ECG_MAX_CHANNELS)];
+    for (uint8_t channels = 1; channels <= ECG_MAX_CHANNELS; channels++) {
+        ECGFrameHeader header = {};
+        header.flags = ECG_FRAME_FLAG_DELTA_VARINT;
+        header.sampleRateHz = 125;
+        size_t length = encodeECGMultiFrame(header, samples, FRAME_SAMPLES, channels, frame, sizeof(frame));
+        ECGFrameHeader decoded;
+        TEST_ASSERT_GREATER_THAN(ECG_FRAME_HEADER_SIZE, length);
+        TEST_ASSERT_TRUE(decodeECGFrameHeader(frame, length, decoded));
+        TEST_ASSERT_EQUAL_UINT8(ECG_FRAME_TYPE_MULTI_SAMPLES, decoded.type);
+        TEST_ASSERT_EQUAL_UINT8(channels, decoded.channels);
+        TEST_ASSERT_EQUAL_UINT16(FRAME_SAMPLES, decoded.sampleCount);
+    }
+}
+
+static void test_invalid_channel_counts_are_refused(void) {
+    ECGMultiSample samples[1] = {};
+    uint8_t frame[ecgMultiFrameMaxSize(1, ECG_MAX_CHANNELS)];
+    ECGFrameHeader header = {};
+    TEST_ASSERT_EQUAL_size_t(0, encodeECGMultiFrame(header, samples, 1, 0, frame, sizeof(frame)));
+    TEST_ASSERT_EQUAL_size_t(0, encodeECGMultiFrame(header, samples, 1, ECG_MAX_CHANNELS + 1, frame, sizeof(frame)));
+}
+
+static void test_earlier_beats_trailer_carries_r_peak_times(void) {
+    ECGSample samples[FRAME_SAMPLES] = {};
+    for (size_t i = 0; i < FRAME_SAMPLES; i++) {
+        samples[i].timestampUs = 4000000000u + 8000 * i; // Wraps within the frame's first second
+        samples[i].value = 2048;
+    }
+    samples[3].flags = ECG_SAMPLE_FLAG_BEAT;
+    ECGHeartRate heartRate = {};
+    heartRate.bpmX10 = 720;
+    heartRate.rrIntervalMs = 833;
+    for (uint32_t b = 0; b < ECG_FRAME_MAX_EARLIER_BEATS + 1; b++) {
+        addEarlierBeat(heartRate, samples[0].timestampUs - 900000 + 8000 * b);
+    }
+    TEST_ASSERT_EQUAL_UINT8(ECG_FRAME_MAX_EARLIER_BEATS, heartRate.earlierBeatCount); // The oldest was dropped
+
+    uint8_t frame[ecgFrameMaxSize(FRAME_SAMPLES)];
+    ECGFrameHeader header = {};
+    header.type = ECG_FRAME_TYPE_SAMPLES;
+    header.flags = ECG_FRAME_FLAG_SEND_TIME;
+    header.startTimeUs = samples[0].timestampUs;
+    header.sampleRateHz = 125;
+    header.sendDelayUs = 1234;
+    size_t length = encodeECGFrame(header, samples, FRAME_SAMPLES, frame, sizeof(frame), &heartRate);
+    TEST_ASSERT_EQUAL_size_t(ECG_FRAME_HEADER_SIZE + 2 * FRAME_SAMPLES + 5 + 1 + 1 + 4 * ECG_FRAME_MAX_EARLIER_BEATS + 4,
+                             length);
+    TEST_ASSERT_EQUAL_UINT8(ECG_FRAME_FLAG_SEND_TIME | ECG_FRAME_FLAG_HEART_RATE | ECG_FRAME_FLAG_EARLIER_BEATS,
+                            frame[ECG_FRAME_FLAGS_OFFSET]);
+
+    const uint8_t *trailer = frame + ECG_FRAME_HEADER_SIZE + 2 * FRAME_SAMPLES;
+    TEST_ASSERT_EQUAL_UINT8(1, trailer[4]);
+    TEST_ASSERT_EQUAL_UINT8(3, trailer[5]);
+    TEST_ASSERT_EQUAL_UINT8(ECG_FRAME_MAX_EARLIER_BEATS, trailer[6]);
+    for (uint32_t b = 0; b < ECG_FRAME_MAX_EARLIER_BEATS; b++) {
+        const uint8_t *p = trailer + 7 + 4 * b;
+        uint32_t beforeStartUs = p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+        TEST_ASSERT_EQUAL_UINT32(900000 - 8000 * (b + 1), beforeStartUs);
+    }
+
+    // Without earlier beats the trailer and its flag are left out.
+    heartRate.earlierBeatCount = 0;
+    length = encodeECGFrame(header, samples, FRAME_SAMPLES, frame, sizeof(frame), &heartRate);
+    TEST_ASSERT_EQUAL_size_t(ECG_FRAME_HEADER_SIZE + 2 * FRAME_SAMPLES + 5 + 1 + 4, length);
+    TEST_ASSERT_EQUAL_UINT8(0, frame[ECG_FRAME_FLAGS_OFFSET] & ECG_FRAME_FLAG_EARLIER_BEATS);
+}
+
+static void test_beats_mark_the_sample_covering_them(void) {
+    ECGSample samples[4] = {};
+    for (size_t i = 0; i < 4; i++) {
+        samples[i].timestampUs = 100000 + 32000 * i; // Decimated by 4 at 125 Hz
+    }
+    TEST_ASSERT_TRUE(markECGBeat(samples, 4, 100000 + 32000 * 2 + 24000));
+    TEST_ASSERT_EQUAL_UINT8(ECG_SAMPLE_FLAG_BEAT, samples[2].flags);
+    TEST_ASSERT_FALSE(markECGBeat(samples, 4, 92000)); // In a frame already encoded
+    TEST_ASSERT_FALSE(markECGBeat(samples, 0, 100000));
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_sample_frame_header_round_trips);
+    RUN_TEST(test_multi_channel_frames_carry_their_channel_count);
+    RUN_TEST(test_invalid_channel_counts_are_refused);
+    RUN_TEST(test_earlier_beats_trailer_carries_r_peak_times);
+    RUN_TEST(test_beats_mark_the_sample_covering_them);
+    return UNITY_END();
+}
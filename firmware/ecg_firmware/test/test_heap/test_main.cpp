@@ -0,0 +1,39 @@
+// Streams for two minutes and checks that nothing is allocated on the heap once the device
+// is connected and streaming.
+
+#include <unity.h>
+
+#include "NativeHAL.h"
+#include "NativeSimulation.h"
+
+// Setup, connecting and the first reports may allocate, streaming after this may not
+#define WARMUP_SECONDS 30
+#define RUN_SECONDS 120
+
+static uint64_t s_warmupAllocations = 0;
+static uint64_t s_steadyAllocations = 0;
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void test_streaming_does_not_allocate(void) {
+    TEST_ASSERT_GREATER_THAN(0, NativeSim::received().frames);
+    TEST_ASSERT_EQUAL_UINT32(0, s_steadyAllocations);
+}
+
+int main(int, char **) {
+    NativeSim::Options options = NativeSim::defaultOptions();
+    // Receiving allocates inside the WebSocket library, so the server sends nothing.
+    options.timeSync = false;
+    NativeSim::begin(options);
+    NativeSim::runUntil(WARMUP_SECONDS);
+    s_warmupAllocations = NativeHAL::heapAllocations();
+    NativeSim::runUntil(RUN_SECONDS);
+    s_steadyAllocations = NativeHAL::heapAllocations() - s_warmupAllocations;
+    NativeSim::end();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_streaming_does_not_allocate);
+    return UNITY_END();
+}
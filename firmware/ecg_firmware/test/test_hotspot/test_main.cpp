@@ -0,0 +1,209 @@
+// Double-clicks into hotspot mode, watches /live with fast viewers, a slow one and one too
+// many, and saves new device settings from the setup page.
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <esp_timer.h>
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include "NativeHAL.h"
+#include "NativeSimulation.h"
+
+#define RUN_SECONDS 60
+// The double click that opens the hotspot, and when viewers connect to /live. There is one
+// viewer more than LIVE_STREAM_MAX_CLIENTS; the first is slow and takes a frame every
+// SLOW_VIEWER_MS (frames come every 200 ms).
+#define CLICK_AT_MS 5000
+#define VIEWERS_AT_MS 15000
+#define VIEWERS (LIVE_STREAM_MAX_CLIENTS + 1)
+#define SLOW_VIEWER_MS 500
+// The setup page posts a bad and then a good set of device settings when the viewers connect
+#define NEW_DEVICE_ID "ward3-bed12"
+#define SETTINGS_BAD "{\"server_port\":70000}"
+#define SETTINGS_GOOD "{\"device_id\":\"" NEW_DEVICE_ID "\",\"sample_rate_hz\":250}"
+
+struct Viewer {
+    uint32_t id;           // WebSocket client id, 0 before connecting
+    bool slow;             // Takes one frame every SLOW_VIEWER_MS
+    bool closed;           // The device closed the connection
+    uint32_t frames;
+    uint32_t gaps;         // Frames skipped between two received ones
+    uint32_t badFrames;
+    uint32_t lastSequence;
+    uint64_t firstSampleUs;
+    uint64_t lastSampleUs;
+};
+
+static AsyncWebSocket *s_socket = nullptr;
+static Viewer s_viewers[VIEWERS];
+static int s_clickStep = 0; // Button edges done so far
+static bool s_viewersConnected = false;
+static uint32_t s_lastSlowTakeMs = 0;
+static int s_badSettingsCode = 0;  // HTTP status of the rejected /setupDevice post
+static int s_goodSettingsCode = 0; // HTTP status of the accepted /setupDevice post
+
+/**
+ * @brief Takes one frame off a viewer's WebSocket queue and checks it.
+ * @return false if nothing was queued.
+ */
+static bool takeViewerFrame(AsyncWebSocketClient *client, Viewer &viewer) {
+    std::vector<uint8_t> message;
+    if (!client->takeMessage(message)) {
+        return false;
+    }
+    ECGFrameHeader header;
+    if (!decodeECGFrameHeader(message.data(), message.size(), header) || header.type != ECG_FRAME_TYPE_SAMPLES) {
+        viewer.badFrames++;
+        return true;
+    }
+    if (viewer.frames == 0) {
+        viewer.firstSampleUs = header.startTimeUs;
+    } else if (header.sequence != viewer.lastSequence + 1) {
+        viewer.gaps += header.sequence - viewer.lastSequence - 1;
+    }
+    viewer.frames++;
+    viewer.lastSequence = header.sequence;
+    viewer.lastSampleUs = header.startTimeUs;
+    return true;
+}
+
+/**
+ * @brief Posts a JSON body to /setupDevice, as the setup page does.
+ * @return The HTTP status of the response, 0 if the route is not served.
+ */
+static int postSettings(const char *json) {
+    AsyncWebServer *server = AsyncWebServer::find(80);
+    const AsyncWebRoute *route = server != nullptr ? server->route("/setupDevice", HTTP_POST) : nullptr;
+    if (route == nullptr || !route->onBody) {
+        return 0;
+    }
+    AsyncWebServerRequest request;
+    std::string body(json);
+    route->onBody(&request, reinterpret_cast<uint8_t *>(&body[0]), body.size(), 0, body.size());
+    return request.responseCode;
+}
+
+/**
+ * @brief Presses the button twice, connects the viewers and reads what they are sent.
+ * Runs from a 1 ms timer, so the button and the viewers carry on while the firmware delays.
+ */
+static void runScript(void *) {
+    uint32_t nowMs = millis();
+    // Two presses 300 ms apart, each held for 50 ms
+    static const uint32_t edgesMs[] = {0, 50, 300, 350};
+    while (s_clickStep < 4 && nowMs >= CLICK_AT_MS + edgesMs[s_clickStep]) {
+        NativeHAL::setDigitalInput(SIM_BUTTON_PIN, s_clickStep % 2 == 0 ? LOW : HIGH);
+        s_clickStep++;
+    }
+
+    if (!s_viewersConnected && nowMs >= VIEWERS_AT_MS) {
+        s_viewersConnected = true;
+        s_badSettingsCode = postSettings(SETTINGS_BAD);
+        s_goodSettingsCode = postSettings(SETTINGS_GOOD);
+        s_socket = AsyncWebSocket::find("/live");
+        for (int i = 0; s_socket != nullptr && i < VIEWERS; i++) {
+            s_viewers[i].slow = i == 0;
+            s_viewers[i].id = s_socket->connectClient()->id();
+        }
+        s_lastSlowTakeMs = nowMs;
+    }
+    if (s_socket == nullptr) {
+        return;
+    }
+
+    bool slowTurn = nowMs - s_lastSlowTakeMs >= SLOW_VIEWER_MS;
+    if (slowTurn) {
+        s_lastSlowTakeMs = nowMs;
+    }
+    for (Viewer &viewer : s_viewers) {
+        AsyncWebSocketClient *client = s_socket->client(viewer.id);
+        if (client == nullptr) {
+            viewer.closed = true;
+            continue;
+        }
+        if (viewer.slow) {
+            if (slowTurn) {
+                takeViewerFrame(client, viewer);
+            }
+        } else {
+            while (takeViewerFrame(client, viewer)) {
+            }
+        }
+    }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void test_extra_viewer_is_turned_away(void) {
+    ECGLiveStream::Stats live = hotspotServer.liveStream().getStats();
+    TEST_ASSERT_EQUAL_UINT32(1, live.rejected);
+    TEST_ASSERT_EQUAL_UINT32(LIVE_STREAM_MAX_CLIENTS, live.clients);
+    const Viewer &extra = s_viewers[VIEWERS - 1];
+    TEST_ASSERT_TRUE(extra.closed);
+    TEST_ASSERT_EQUAL_UINT32(0, extra.frames);
+}
+
+static void test_fast_viewers_get_every_frame(void) {
+    // Everything but the frame in progress and the latency of the batch
+    double watched = RUN_SECONDS - VIEWERS_AT_MS / 1000.0;
+    for (int i = 1; i < VIEWERS - 1; i++) {
+        const Viewer &viewer = s_viewers[i];
+        TEST_ASSERT_FALSE(viewer.closed);
+        TEST_ASSERT_EQUAL_UINT32(0, viewer.badFrames);
+        TEST_ASSERT_EQUAL_UINT32(0, viewer.gaps);
+        TEST_ASSERT_TRUE((viewer.lastSampleUs - viewer.firstSampleUs) / 1e6 > watched - 1.0);
+    }
+}
+
+static void test_slow_viewer_skips_frames_but_stays(void) {
+    const Viewer &slow = s_viewers[0];
+    TEST_ASSERT_FALSE(slow.closed);
+    TEST_ASSERT_EQUAL_UINT32(0, slow.badFrames);
+    TEST_ASSERT_GREATER_THAN(0, slow.frames);
+    TEST_ASSERT_GREATER_THAN(0, slow.gaps);
+}
+
+static void test_settings_apply_at_the_next_boot(void) {
+    TEST_ASSERT_EQUAL(400, s_badSettingsCode);
+    TEST_ASSERT_EQUAL(200, s_goodSettingsCode);
+    TEST_ASSERT_EQUAL_UINT32(1, NativeHAL::restartCount());
+    // The running device keeps its settings; the next boot loads the saved ones.
+    PersistentConfig nextConfig(DEVICE_SETTINGS);
+    DeviceSettings next(nextConfig);
+    next.begin(deviceSettings.active());
+    TEST_ASSERT_EQUAL_STRING(SIM_DEVICE_ID, deviceSettings.active().deviceId);
+    TEST_ASSERT_EQUAL_STRING(NEW_DEVICE_ID, next.active().deviceId);
+    TEST_ASSERT_EQUAL_UINT16(250, next.active().sampleRateHz);
+    TEST_ASSERT_EQUAL_STRING(deviceSettings.active().serverHost, next.active().serverHost);
+}
+
+static void test_no_sample_is_dropped(void) {
+    TEST_ASSERT_EQUAL_UINT32(0, NativeSim::samplingStats().samplesDropped);
+}
+
+int main(int, char **) {
+    NativeSim::Options options = NativeSim::defaultOptions();
+    options.leadScript = false;
+    NativeSim::begin(options);
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = runScript;
+    timerArgs.name = "hotspot_script";
+    esp_timer_handle_t timer;
+    esp_timer_create(&timerArgs, &timer);
+    esp_timer_start_periodic(timer, 1000);
+    NativeSim::runUntil(RUN_SECONDS);
+    NativeSim::end();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_extra_viewer_is_turned_away);
+    RUN_TEST(test_fast_viewers_get_every_frame);
+    RUN_TEST(test_slow_viewer_skips_frames_but_stays);
+    RUN_TEST(test_settings_apply_at_the_next_boot);
+    RUN_TEST(test_no_sample_is_dropped);
+    return UNITY_END();
+}
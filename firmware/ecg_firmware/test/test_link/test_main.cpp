@@ -0,0 +1,82 @@
+// Throttles the uplink to 200 bytes/s (250 per lead in multi-lead builds) with 10 % loss for
+// the second quarter of a four-minute run, and checks that the adaptive uplink backs off,
+// recovers and loses no signal.
+
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+
+#include "NativeSimulation.h"
+
+#define RUN_SECONDS 240
+#if defined(ECG_CHANNEL_COUNT) && ECG_CHANNEL_COUNT > 1
+// Multi-channel frames are never decimated (every lead stays diagnostic), so the link must
+// carry all leads at full rate, ~175 bytes/s each, even at the deepest uplink level.
+#define LINK_BYTES_PER_SECOND (250 * ECG_CHANNEL_COUNT)
+#else
+#define LINK_BYTES_PER_SECOND 200
+#endif
+#define LINK_LOSS_PERCENT 10
+// A send buffer of one TCP segment fills within seconds at this rate, and a retransmission
+// stalls the wire for a typical minimum RTO.
+#define LINK_SEND_BUFFER_BYTES 1460
+#define LINK_RETRANSMIT_US 200000
+
+static int s_level = 0;    // Last reported uplink level
+static int s_maxLevel = 0; // Highest reported uplink level
+static uint32_t s_reports = 0;
+
+/**
+ * @brief Follows the uplink level through the device's uplink_rate messages.
+ */
+static void onText(const std::string &text) {
+    const char *field = strstr(text.c_str(), "\"level\":");
+    if (text.find("\"uplink_rate\"") == std::string::npos || field == nullptr) {
+        return;
+    }
+    s_level = atoi(field + 8);
+    s_maxLevel = s_level > s_maxLevel ? s_level : s_maxLevel;
+    s_reports++;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void test_uplink_backs_off_and_recovers(void) {
+    TEST_ASSERT_GREATER_THAN(0, s_reports);
+    TEST_ASSERT_GREATER_THAN(0, s_maxLevel);
+    TEST_ASSERT_EQUAL(0, s_level);
+    TEST_ASSERT_GREATER_THAN(0, wsClient.getStats().uplinkChanges);
+}
+
+static void test_no_sample_is_lost(void) {
+    const NativeSim::ReceivedFrames &received = NativeSim::received();
+    TEST_ASSERT_EQUAL_UINT32(0, NativeSim::samplingStats().samplesDropped);
+    TEST_ASSERT_EQUAL_UINT32(0, wsClient.getStats().samplesDropped);
+    TEST_ASSERT_EQUAL_UINT32(0, received.badFrames);
+    // Every stretch of signal arrives, at some rate.
+    double streamed = (received.lastSampleEndUs - received.firstSampleUs) / 1e6;
+    TEST_ASSERT_TRUE(received.signalSeconds > streamed - 0.1);
+}
+
+int main(int, char **) {
+    websockets::LoopbackServer::Transport transport = {};
+    transport.bytesPerSecond = LINK_BYTES_PER_SECOND;
+    transport.lossPercent = LINK_LOSS_PERCENT;
+    transport.sendBufferBytes = LINK_SEND_BUFFER_BYTES;
+    transport.retransmitUs = LINK_RETRANSMIT_US;
+    NativeSim::impairLink(transport, RUN_SECONDS * 1000000ULL / 4, RUN_SECONDS * 1000000ULL / 2);
+    NativeSim::setTextHandler(onText);
+
+    NativeSim::Options options = NativeSim::defaultOptions();
+    options.leadScript = false;
+    NativeSim::begin(options);
+    NativeSim::runUntil(RUN_SECONDS);
+    NativeSim::end();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_uplink_backs_off_and_recovers);
+    RUN_TEST(test_no_sample_is_lost);
+    return UNITY_END();
+}
@@ -0,0 +1,93 @@
+// Streams in low-power bursts over a slow link and checks the burst rhythm, the queue
+// latency and that none of the signal is lost between bursts.
+
+#include <WiFi.h>
+#include <string>
+#include <unity.h>
+
+#include "NativeHAL.h"
+#include "NativeSimulation.h"
+
+#define RUN_SECONDS 60
+#define BURST_MS 500
+// Slow enough that bursts take measurable time
+#define BYTES_PER_SECOND 20000
+// Queue latency allowed on top of the interval: samples taken during the previous burst's
+// sends wait for the next one, and the DSP period and ADC averaging delay add a few ms
+#define LATENCY_SLACK_MS 50
+#define LOW_CPU_MHZ 80
+
+static uint64_t s_lastFrameUs = 0; // When the server last received a frame
+static uint32_t s_burstsSeen = 0;  // Frames arriving more than half an interval after the previous one
+static uint64_t s_maxGapUs = 0;    // Longest time without a frame
+static uint32_t s_reports = 0;     // power_stats messages received
+
+static void onFrame(const ECGFrameHeader &, const uint8_t *, size_t) {
+    uint64_t nowUs = NativeHAL::nowMicros();
+    if (s_lastFrameUs != 0) {
+        uint64_t gapUs = nowUs - s_lastFrameUs;
+        s_burstsSeen += gapUs > BURST_MS * 500ULL ? 1 : 0;
+        s_maxGapUs = gapUs > s_maxGapUs ? gapUs : s_maxGapUs;
+    }
+    s_lastFrameUs = nowUs;
+}
+
+static void onText(const std::string &text) {
+    if (text.find("\"power_stats\"") != std::string::npos) {
+        s_reports++;
+    }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void test_radio_and_cpu_save_power(void) {
+    TEST_ASSERT_EQUAL(WIFI_PS_MAX_MODEM, WiFi.getSleep());
+    TEST_ASSERT_EQUAL(LOW_CPU_MHZ, NativeHAL::pmConfig().min_freq_mhz);
+    TEST_ASSERT_GREATER_THAN(0, s_reports);
+}
+
+static void test_one_burst_per_interval(void) {
+    // One burst per interval once connected, each one arriving at the server as a group
+    BurstScheduler::Stats burst = burstScheduler.getStats();
+    uint32_t expected = RUN_SECONDS * 1000 / BURST_MS;
+    TEST_ASSERT_GREATER_OR_EQUAL(expected, burst.bursts + 2);
+    TEST_ASSERT_LESS_OR_EQUAL(expected + 1, burst.bursts);
+    TEST_ASSERT_GREATER_OR_EQUAL(burst.bursts, s_burstsSeen + 3);
+    TEST_ASSERT_GREATER_THAN(0, burst.dutyPermille);
+    TEST_ASSERT_LESS_THAN(200, burst.dutyPermille);
+}
+
+static void test_no_sample_waits_past_its_burst(void) {
+    TEST_ASSERT_LESS_OR_EQUAL(BURST_MS + LATENCY_SLACK_MS, burstScheduler.getStats().maxLatencyMs);
+}
+
+static void test_no_signal_is_lost(void) {
+    const NativeSim::ReceivedFrames &received = NativeSim::received();
+    double streamed = (received.lastSampleEndUs - received.firstSampleUs) / 1e6;
+    TEST_ASSERT_EQUAL_UINT32(0, NativeSim::samplingStats().samplesDropped);
+    TEST_ASSERT_EQUAL_UINT32(0, received.badFrames);
+    TEST_ASSERT_TRUE(received.signalSeconds > streamed - 0.1);
+}
+
+int main(int, char **) {
+    websockets::LoopbackServer::Transport transport = {};
+    transport.bytesPerSecond = BYTES_PER_SECOND;
+    websockets::LoopbackServer::instance().transport = transport;
+    NativeSim::setFrameHandler(onFrame);
+    NativeSim::setTextHandler(onText);
+    NativeSim::Options options = NativeSim::defaultOptions();
+    options.leadScript = false;
+    options.burstIntervalMs = BURST_MS;
+    NativeSim::begin(options);
+    NativeSim::runUntil(RUN_SECONDS);
+    NativeSim::end();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_radio_and_cpu_save_power);
+    RUN_TEST(test_one_burst_per_interval);
+    RUN_TEST(test_no_sample_waits_past_its_burst);
+    RUN_TEST(test_no_signal_is_lost);
+    return UNITY_END();
+}
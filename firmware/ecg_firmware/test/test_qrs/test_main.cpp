@@ -0,0 +1,268 @@
+// Checks that beats are placed on their R peak, whether the detector confirms them a few
+// samples later or, through search-back, in a later block.
+
+#include <math.h>
+#include <unity.h>
+
+#include "ECGFilter.h"
+#include "ECGSource.h"
+#include "QRSDetector.h"
+
+#define RUN_SECONDS 30
+#define MAX_BLOCK_SAMPLES 32
+#define MAX_BEATS 64
+// The filters delay the R wave by ~6 ms, mostly in the 40 Hz low-pass. A beat flagged where
+// it was confirmed would be over 50 ms late.
+#define R_PEAK_TOLERANCE_US 10000
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+/**
+ * @brief Returns the capture times of the beats found on a clean synthetic signal, whether
+ * flagged in their block or taken later with takeEarlierBeat().
+ */
+static size_t detectSyntheticBeats(ECGSampleRate rate, size_t blockSamples, uint32_t *beatsUs, size_t *earlier) {
+    SyntheticECGSource::Config config = SyntheticECGSource::defaultConfig();
+    config.noiseMv = 0.0f;
+    config.baselineWanderMv = 0.0f;
+    config.mainsHumMv = 0.0f;
+    SyntheticECGSource source;
+    source.configure(rate, config);
+    ECGFilter filter;
+    filter.configure(rate, MainsFrequency::Hz50);
+    QRSDetector detector;
+    detector.configure(rate);
+
+    uint32_t periodUs = 1000000UL / static_cast<uint16_t>(rate);
+    uint32_t total = RUN_SECONDS * static_cast<uint16_t>(rate);
+    size_t count = 0;
+    *earlier = 0;
+    ECGSample block[MAX_BLOCK_SAMPLES];
+    for (uint32_t done = 0; done + blockSamples <= total; done += blockSamples) {
+        for (size_t i = 0; i < blockSamples; i++) {
+            block[i] = {};
+            block[i].timestampUs = (done + i) * periodUs;
+            block[i].value = static_cast<uint16_t>(source.readECG());
+        }
+        filter.filterSamples(block, blockSamples);
+        detector.processSamples(block, blockSamples);
+        uint32_t beatTimeUs;
+        while (detector.takeEarlierBeat(beatTimeUs) && count < MAX_BEATS) {
+            beatsUs[count++] = beatTimeUs;
+            (*earlier)++;
+        }
+        for (size_t i = 0; i < blockSamples && count < MAX_BEATS; i++) {
+            if (block[i].flags & ECG_SAMPLE_FLAG_BEAT) {
+                beatsUs[count++] = block[i].timestampUs;
+            }
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Returns the index of the R peak within each beat of the synthetic source.
+ */
+static uint32_t syntheticRPeakIndex(ECGSampleRate rate, uint32_t *beatLength) {
+    SyntheticECGSource::Config config = SyntheticECGSource::defaultConfig();
+    config.noiseMv = 0.0f;
+    config.baselineWanderMv = 0.0f;
+    config.mainsHumMv = 0.0f;
+    SyntheticECGSource source;
+    source.configure(rate, config);
+    *beatLength = static_cast<uint32_t>(lroundf(60.0f / config.heartRateBpm * static_cast<uint16_t>(rate)));
+    uint32_t peak = 0;
+    int peakValue = -1;
+    for (uint32_t i = 0; i < *beatLength; i++) {
+        int value = source.readECG();
+        if (value > peakValue) {
+            peakValue = value;
+            peak = i;
+        }
+    }
+    return peak;
+}
+
+/**
+ * @brief Checks that every beat after the learning phase was found once, on its R peak.
+ */
+static void checkBeatsOnRPeaks(ECGSampleRate rate, size_t blockSamples) {
+    uint32_t beatsUs[MAX_BEATS];
+    size_t earlier;
+    size_t count = detectSyntheticBeats(rate, blockSamples, beatsUs, &earlier);
+    uint32_t beatLength;
+    uint32_t rIndex = syntheticRPeakIndex(rate, &beatLength);
+    uint32_t periodUs = 1000000UL / static_cast<uint16_t>(rate);
+
+    // Thresholds are learned over the first 2 s, so the first beats go unreported.
+    uint32_t expected = (RUN_SECONDS * static_cast<uint16_t>(rate) - rIndex) / beatLength + 1;
+    TEST_ASSERT_GREATER_OR_EQUAL(expected - 3, count);
+    TEST_ASSERT_LESS_OR_EQUAL(expected, count);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t sample = beatsUs[i] / periodUs;
+        uint32_t nearestR = (sample + beatLength / 2 - rIndex) / beatLength * beatLength + rIndex;
+        int32_t offsetUs = (static_cast<int32_t>(sample) - static_cast<int32_t>(nearestR)) * static_cast<int32_t>(periodUs);
+        TEST_ASSERT_INT32_WITHIN(R_PEAK_TOLERANCE_US, 0, offsetUs);
+        if (i > 0) {
+            TEST_ASSERT_GREATER_THAN_UINT32(beatsUs[i - 1], beatsUs[i]);
+        }
+    }
+    // With one-sample blocks the R peak has always been passed on by the time a beat is confirmed.
+    if (blockSamples == 1) {
+        TEST_ASSERT_EQUAL_size_t(count, earlier);
+    }
+}
+
+static void test_beats_are_flagged_on_the_r_peak_at_125_hz(void) {
+    checkBeatsOnRPeaks(ECGSampleRate::Hz125, MAX_BLOCK_SAMPLES);
+}
+
+static void test_beats_are_flagged_on_the_r_peak_at_500_hz(void) {
+    checkBeatsOnRPeaks(ECGSampleRate::Hz500, 20);
+}
+
+static void test_beats_confirmed_after_their_block_keep_their_r_peak(void) {
+    checkBeatsOnRPeaks(ECGSampleRate::Hz125, 1);
+}
+
+// Pulse train for search-back: one beat a second, with a weak one that stays under the
+// detection threshold but above half of it.
+#define PULSE_AMPLITUDE 800.0
+#define PULSE_WIDTH_S 0.015
+#define WEAK_PULSE 6
+#define WEAK_PULSE_SCALE 0.42
+
+static int pulseTrain(double t) {
+    double value = 0.0;
+    for (int k = static_cast<int>(t) - 1; k <= static_cast<int>(t) + 1; k++) {
+        double x = (t - (k + 0.5)) / PULSE_WIDTH_S;
+        value += (k == WEAK_PULSE ? WEAK_PULSE_SCALE : 1.0) * PULSE_AMPLITUDE * exp(-0.5 * x * x);
+    }
+    return 2048 + static_cast<int>(lround(value));
+}
+
+static void test_search_back_reports_the_missed_beat_at_its_r_peak(void) {
+    QRSDetector detector;
+    detector.configure(ECGSampleRate::Hz125);
+    const uint32_t periodUs = 8000;
+    const uint32_t weakRUs = (WEAK_PULSE * 1000000UL) + 500000UL;
+
+    bool found = false;
+    for (uint32_t n = 0; n < 10 * 125; n++) {
+        uint32_t timestampUs = n * periodUs;
+        uint32_t beatTimeUs;
+        if (!detector.process(pulseTrain(timestampUs / 1e6), timestampUs, beatTimeUs) ||
+            beatTimeUs - (weakRUs - 2 * periodUs) > 4 * periodUs) {
+            continue;
+        }
+        found = true;
+        TEST_ASSERT_UINT32_WITHIN(periodUs, weakRUs, beatTimeUs);
+        // Search-back waits for 166 % of the R-R interval after the last beat.
+        TEST_ASSERT_GREATER_THAN_UINT32(weakRUs + 600000UL, timestampUs);
+    }
+    TEST_ASSERT_TRUE(found);
+}
+
+static void test_search_back_beat_in_an_earlier_block_is_kept_for_later(void) {
+    QRSDetector detector;
+    detector.configure(ECGSampleRate::Hz125);
+    const uint32_t periodUs = 8000;
+    const uint32_t weakRUs = (WEAK_PULSE * 1000000UL) + 500000UL;
+
+    ECGSample block[MAX_BLOCK_SAMPLES];
+    bool found = false;
+    for (uint32_t done = 0; done < 10 * 125; done += MAX_BLOCK_SAMPLES) {
+        for (size_t i = 0; i < MAX_BLOCK_SAMPLES; i++) {
+            block[i] = {};
+            block[i].timestampUs = (done + i) * periodUs;
+            block[i].value = static_cast<uint16_t>(pulseTrain(block[i].timestampUs / 1e6));
+        }
+        detector.processSamples(block, MAX_BLOCK_SAMPLES);
+        // Beats whose R peak was at the end of the previous block come here too.
+        uint32_t beatTimeUs;
+        while (detector.takeEarlierBeat(beatTimeUs)) {
+            TEST_ASSERT_GREATER_THAN_UINT32(beatTimeUs, block[0].timestampUs);
+            if (beatTimeUs - (weakRUs - periodUs) <= 2 * periodUs) {
+                TEST_ASSERT_GREATER_THAN_UINT32(weakRUs + 600000UL, block[MAX_BLOCK_SAMPLES - 1].timestampUs);
+                found = true;
+            }
+        }
+    }
+    TEST_ASSERT_TRUE(found);
+}
+
+static void test_lead_off_resets_the_detector_but_keeps_earlier_beats(void) {
+    QRSDetector detector;
+    detector.configure(ECGSampleRate::Hz125);
+    const uint32_t periodUs = 8000;
+    const uint32_t weakRUs = (WEAK_PULSE * 1000000UL) + 500000UL;
+
+    ECGSample block[MAX_BLOCK_SAMPLES];
+    bool leadOff = false;
+    for (uint32_t done = 0; done < 10 * 125 && !leadOff; done += MAX_BLOCK_SAMPLES) {
+        for (size_t i = 0; i < MAX_BLOCK_SAMPLES; i++) {
+            block[i] = {};
+            block[i].timestampUs = (done + i) * periodUs;
+            block[i].value = static_cast<uint16_t>(pulseTrain(block[i].timestampUs / 1e6));
+        }
+        // The leads come off at the end of a block after the weak beat was confirmed.
+        if (block[0].timestampUs > weakRUs + 800000UL) {
+            block[MAX_BLOCK_SAMPLES - 1].flags = ECG_SAMPLE_FLAG_LEAD_OFF;
+            leadOff = true;
+        }
+        detector.processSamples(block, MAX_BLOCK_SAMPLES);
+    }
+    TEST_ASSERT_EQUAL_UINT16(0, detector.getInstantHeartRateX10());
+    bool found = false;
+    uint32_t beatTimeUs;
+    while (detector.takeEarlierBeat(beatTimeUs)) {
+        found = found || beatTimeUs - (weakRUs - periodUs) <= 2 * periodUs;
+    }
+    TEST_ASSERT_TRUE(found);
+}
+
+static void test_heart_rate_is_withdrawn_when_beats_stop(void) {
+    QRSDetector detector;
+    detector.configure(ECGSampleRate::Hz125);
+    const uint32_t periodUs = 8000;
+    const uint32_t lastRUs = 9500000UL; // The pulse train stops after its tenth beat
+    const uint32_t flatFromUs = 10000000UL;
+
+    ECGSample block[MAX_BLOCK_SAMPLES];
+    for (uint32_t done = 0; done < 14 * 125; done += MAX_BLOCK_SAMPLES) {
+        for (size_t i = 0; i < MAX_BLOCK_SAMPLES; i++) {
+            block[i] = {};
+            block[i].timestampUs = (done + i) * periodUs;
+            // A flat line with the leads still on, as in asystole.
+            block[i].value = static_cast<uint16_t>(
+                block[i].timestampUs < flatFromUs ? pulseTrain(block[i].timestampUs / 1e6) : 2048);
+        }
+        detector.processSamples(block, MAX_BLOCK_SAMPLES);
+        uint32_t endUs = block[MAX_BLOCK_SAMPLES - 1].timestampUs;
+        if (endUs >= flatFromUs - 10 * periodUs && endUs < flatFromUs) {
+            TEST_ASSERT_UINT32_WITHIN(20, 600, detector.getInstantHeartRateX10());
+            TEST_ASSERT_UINT32_WITHIN(20, 600, detector.getAverageHeartRateX10());
+        }
+        // The rate stands for the longest R-R interval taken as one (3 s), then goes.
+        if (endUs >= flatFromUs && endUs < lastRUs + 2900000UL) {
+            TEST_ASSERT_NOT_EQUAL(0, detector.getInstantHeartRateX10());
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT16(0, detector.getInstantHeartRateX10());
+    TEST_ASSERT_EQUAL_UINT16(0, detector.getAverageHeartRateX10());
+    TEST_ASSERT_EQUAL_UINT16(0, detector.getLastRRIntervalMs());
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_beats_are_flagged_on_the_r_peak_at_125_hz);
+    RUN_TEST(test_beats_are_flagged_on_the_r_peak_at_500_hz);
+    RUN_TEST(test_beats_confirmed_after_their_block_keep_their_r_peak);
+    RUN_TEST(test_search_back_reports_the_missed_beat_at_its_r_peak);
+    RUN_TEST(test_search_back_beat_in_an_earlier_block_is_kept_for_later);
+    RUN_TEST(test_lead_off_resets_the_detector_but_keeps_earlier_beats);
+    RUN_TEST(test_heart_rate_is_withdrawn_when_beats_stop);
+    return UNITY_END();
+}
@@ -0,0 +1,111 @@
+// Checks the sample timing of the timer-driven acquisition engine on the simulated clock,
+// with loop() blocked for long stretches and with timer callbacks dispatched late.
+
+#include <unity.h>
+
+#include "AD8232_ECG.h"
+#include "NativeHAL.h"
+
+#define PERIOD_US 8000 // 125 Hz
+#define RUN_US 10000000ULL
+#define SAMPLES (RUN_US / PERIOD_US)
+// How long loop() is kept from draining the buffer at a time; the buffer holds 4 s
+#define BLOCKED_US 250000
+#define MAX_LATENCY_US 1500
+
+static AD8232_ECG sensor(36, 14, 27);
+static ECGSample s_samples[ECG_SAMPLE_BUFFER_SIZE];
+static uint64_t s_lateDeadlineUs = 0; // The one deadline lateLatency() delays
+static uint32_t s_lateByUs = 0;
+static uint32_t s_random = 1;
+
+/**
+ * @brief Latency of a busy esp_timer task: up to MAX_LATENCY_US, different every time.
+ */
+static uint32_t randomLatency(uint64_t) {
+    s_random = s_random * 1103515245u + 12345u;
+    return (s_random >> 16) % (MAX_LATENCY_US + 1);
+}
+
+static uint32_t lateLatency(uint64_t deadlineUs) {
+    return deadlineUs == s_lateDeadlineUs ? s_lateByUs : 0;
+}
+
+/**
+ * @brief Runs the clock for RUN_US, draining the buffer every blockedUs like a loop() that
+ * blocks that long, and returns the number of samples read.
+ */
+static uint32_t run(uint64_t blockedUs) {
+    uint32_t read = 0;
+    for (uint64_t elapsed = 0; elapsed < RUN_US; elapsed += blockedUs) {
+        NativeHAL::advanceMicros(blockedUs);
+        read += sensor.readSamples(s_samples, ECG_SAMPLE_BUFFER_SIZE);
+    }
+    return read;
+}
+
+void setUp(void) {
+    NativeHAL::setTimerLatency(nullptr);
+    sensor.begin();
+    sensor.startSampling(ECGSampleRate::Hz125);
+}
+
+void tearDown(void) {
+    sensor.stopSampling();
+    NativeHAL::setTimerLatency(nullptr);
+    while (sensor.readSamples(s_samples, ECG_SAMPLE_BUFFER_SIZE) > 0) {
+    }
+}
+
+static void test_blocked_loop_does_not_move_samples(void) {
+    TEST_ASSERT_EQUAL_UINT32(SAMPLES, run(BLOCKED_US));
+    AD8232_ECG::SamplingStats stats = sensor.getSamplingStats();
+    TEST_ASSERT_EQUAL_UINT32(SAMPLES, stats.samplesCaptured);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.samplesDropped);
+    TEST_ASSERT_EQUAL_UINT32(PERIOD_US, stats.minIntervalUs);
+    TEST_ASSERT_EQUAL_UINT32(PERIOD_US, stats.maxIntervalUs);
+}
+
+static void test_dispatch_latency_bounds_the_jitter(void) {
+    NativeHAL::setTimerLatency(randomLatency);
+    TEST_ASSERT_EQUAL_UINT32(SAMPLES, run(BLOCKED_US));
+    AD8232_ECG::SamplingStats stats = sensor.getSamplingStats();
+    // Deadlines are absolute, so the latency jitters the intervals without costing samples.
+    TEST_ASSERT_EQUAL_UINT32(SAMPLES, stats.samplesCaptured);
+    TEST_ASSERT_GREATER_OR_EQUAL(PERIOD_US - MAX_LATENCY_US, stats.minIntervalUs);
+    TEST_ASSERT_LESS_OR_EQUAL(PERIOD_US + MAX_LATENCY_US, stats.maxIntervalUs);
+    TEST_ASSERT_LESS_THAN(PERIOD_US, stats.minIntervalUs);
+    TEST_ASSERT_GREATER_THAN(PERIOD_US, stats.maxIntervalUs);
+}
+
+static void test_one_late_callback(void) {
+    s_lateDeadlineUs = NativeHAL::nowMicros() + 100 * PERIOD_US;
+    s_lateByUs = 5000;
+    NativeHAL::setTimerLatency(lateLatency);
+    TEST_ASSERT_EQUAL_UINT32(SAMPLES, run(BLOCKED_US));
+    AD8232_ECG::SamplingStats stats = sensor.getSamplingStats();
+    // Late by 5 ms, then back on the next deadline
+    TEST_ASSERT_EQUAL_UINT32(PERIOD_US + 5000, stats.maxIntervalUs);
+    TEST_ASSERT_EQUAL_UINT32(PERIOD_US - 5000, stats.minIntervalUs);
+}
+
+static void test_callback_late_by_more_than_a_period(void) {
+    s_lateDeadlineUs = NativeHAL::nowMicros() + 100 * PERIOD_US;
+    s_lateByUs = 2 * PERIOD_US + 1000;
+    NativeHAL::setTimerLatency(lateLatency);
+    TEST_ASSERT_EQUAL_UINT32(SAMPLES, run(BLOCKED_US));
+    AD8232_ECG::SamplingStats stats = sensor.getSamplingStats();
+    // The two missed deadlines are caught up right behind the late one, none is skipped.
+    TEST_ASSERT_EQUAL_UINT32(SAMPLES, stats.samplesCaptured);
+    TEST_ASSERT_EQUAL_UINT32(PERIOD_US + s_lateByUs, stats.maxIntervalUs);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.minIntervalUs);
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_blocked_loop_does_not_move_samples);
+    RUN_TEST(test_dispatch_latency_bounds_the_jitter);
+    RUN_TEST(test_one_late_callback);
+    RUN_TEST(test_callback_late_by_more_than_a_period);
+    return UNITY_END();
+}
@@ -0,0 +1,113 @@
+// Takes the server away for half an hour, longer than the 512 KB spool holds, and checks that
+// after reconnecting the device backfills what is left in order, and that exactly the frames
+// the spool overwrote are missing.
+
+#include <unity.h>
+#include <vector>
+
+#include "NativeSimulation.h"
+
+#define OUTAGE_FROM_S 30
+#define OUTAGE_SECONDS 1800
+// Backfill runs alongside the live stream at two frames per loop
+#define RUN_SECONDS (OUTAGE_FROM_S + OUTAGE_SECONDS + 300)
+
+static std::vector<bool> s_received;       // By sequence number
+static uint32_t s_backfillOutOfOrder = 0;  // Backfill frames not following the previous one
+static uint32_t s_backfillAfterOutage = 0; // Backfill frames numbered after the first live frame that followed the outage
+static int64_t s_lastBackfill = -1;
+static int64_t s_firstBackfill = -1;
+static int64_t s_firstOutageFrame = -1; // First sequence the server missed
+static int64_t s_firstLiveAfterOutage = -1;
+static uint32_t s_lastLiveSequence = 0;
+static bool s_outage = false;
+
+static void onFrame(const ECGFrameHeader &header, const uint8_t *, size_t) {
+    if (header.sequence >= s_received.size()) {
+        s_received.resize(header.sequence + 1, false);
+    }
+    s_received[header.sequence] = true;
+    if (!(header.flags & ECG_FRAME_FLAG_BACKFILL)) {
+        s_lastLiveSequence = header.sequence;
+        if (!s_outage && s_firstOutageFrame >= 0 && s_firstLiveAfterOutage < 0) {
+            s_firstLiveAfterOutage = header.sequence;
+        }
+        return;
+    }
+    if (s_firstLiveAfterOutage >= 0 && header.sequence >= s_firstLiveAfterOutage) {
+        s_backfillAfterOutage++;
+    }
+    if (s_firstBackfill < 0) {
+        s_firstBackfill = header.sequence;
+    } else if (header.sequence != s_lastBackfill + 1) {
+        s_backfillOutOfOrder++;
+    }
+    s_lastBackfill = header.sequence;
+}
+
+static void outageScript(uint64_t nowUs) {
+    websockets::LoopbackServer &server = websockets::LoopbackServer::instance();
+    bool outage = nowUs >= OUTAGE_FROM_S * 1000000ULL && nowUs < (OUTAGE_FROM_S + OUTAGE_SECONDS) * 1000000ULL;
+    if (outage && !s_outage) {
+        s_firstOutageFrame = s_lastLiveSequence + 1;
+        server.acceptConnections = false;
+        server.closeConnection();
+    } else if (!outage && s_outage) {
+        server.acceptConnections = true;
+    }
+    s_outage = outage;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void test_spool_overflows_during_the_outage(void) {
+    ECGSpool::Stats stats = ecgSpool.getStats();
+    TEST_ASSERT_GREATER_THAN(0, stats.framesOverwritten);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.writeErrors);
+    TEST_ASSERT_EQUAL_UINT32(0, wsClient.getStats().samplesDropped);
+    TEST_ASSERT_GREATER_THAN(1, websockets::LoopbackServer::instance().getStats().connects);
+}
+
+static void test_backfill_is_complete_and_in_order(void) {
+    ECGSpool::Stats stats = ecgSpool.getStats();
+    TEST_ASSERT_TRUE(ecgSpool.isEmpty());
+    TEST_ASSERT_EQUAL_UINT32(stats.framesForwarded, NativeSim::received().backfillFrames);
+    TEST_ASSERT_EQUAL_UINT32(stats.framesSpooled, stats.framesForwarded + stats.framesOverwritten);
+    TEST_ASSERT_EQUAL_UINT32(0, NativeSim::received().badFrames);
+    TEST_ASSERT_EQUAL_UINT32(0, s_backfillOutOfOrder);
+    TEST_ASSERT_EQUAL_UINT32(0, s_backfillAfterOutage);
+}
+
+static void test_only_overwritten_frames_are_missing(void) {
+    ECGSpool::Stats stats = ecgSpool.getStats();
+    uint32_t missing = 0;
+    int64_t lastMissing = -1;
+    for (size_t i = 0; i < s_received.size(); i++) {
+        if (!s_received[i]) {
+            missing++;
+            lastMissing = static_cast<int64_t>(i);
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(stats.framesOverwritten, missing);
+    // The oldest frames of the outage are the ones overwritten.
+    TEST_ASSERT_EQUAL_INT64(s_firstOutageFrame + missing, s_firstBackfill);
+    TEST_ASSERT_EQUAL_INT64(s_firstBackfill - 1, lastMissing);
+}
+
+int main(int, char **) {
+    NativeSim::setFrameHandler(onFrame);
+
+    NativeSim::Options options = NativeSim::defaultOptions();
+    options.leadScript = false;
+    NativeSim::begin(options);
+    NativeSim::runUntil(RUN_SECONDS, outageScript);
+    NativeSim::end();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_spool_overflows_during_the_outage);
+    RUN_TEST(test_backfill_is_complete_and_in_order);
+    RUN_TEST(test_only_overwritten_frames_are_missing);
+    return UNITY_END();
+}
@@ -0,0 +1,161 @@
+// Runs a producer and a consumer thread against SPSCRingBuffer and checks that items arrive
+// whole and in order, and that every lost item is counted as an overrun.
+
+#include <stdint.h>
+#include <thread>
+#include <unity.h>
+
+#include "SPSCRingBuffer.h"
+
+#define ITEMS 2000000
+#define CAPACITY 64
+#define BULK_ITEMS 5
+
+struct Item {
+    uint32_t seq;
+    uint32_t check; // ~seq, to catch items read while being written
+    uint64_t payload;
+};
+
+static Item makeItem(uint32_t seq) {
+    Item item;
+    item.seq = seq;
+    item.check = ~seq;
+    item.payload = static_cast<uint64_t>(seq) * 0x9E3779B97F4A7C15ULL;
+    return item;
+}
+
+static bool isWhole(const Item &item) {
+    return item.check == ~item.seq && item.payload == static_cast<uint64_t>(item.seq) * 0x9E3779B97F4A7C15ULL;
+}
+
+/**
+ * @brief What the consumer saw: items in order and whole, and the sequence numbers skipped.
+ */
+struct Received {
+    uint32_t items;
+    uint32_t skipped;
+    uint32_t torn;
+    uint32_t outOfOrder;
+    uint32_t next; // Sequence number expected next
+};
+
+static void receive(Received &received, const Item &item) {
+    if (!isWhole(item)) {
+        received.torn++;
+    } else if (item.seq < received.next) {
+        received.outOfOrder++;
+    } else {
+        received.skipped += item.seq - received.next;
+        received.next = item.seq + 1;
+    }
+    received.items++;
+}
+
+/**
+ * @brief Drains the buffer with pop(), popBulk() and peekContiguous()/consume() in turn until
+ * the producer is done and the buffer is empty.
+ */
+static void consumer(SPSCRingBuffer<Item, CAPACITY> &buffer, const std::atomic<bool> &done, Received &received) {
+    Item items[BULK_ITEMS];
+    for (uint32_t round = 0;; round++) {
+        bool finished = done.load(std::memory_order_acquire);
+        size_t n = 0;
+        switch (round % 3) {
+        case 0:
+            if (buffer.pop(items[0])) {
+                receive(received, items[0]);
+                n = 1;
+            }
+            break;
+        case 1:
+            n = buffer.popBulk(items, BULK_ITEMS);
+            for (size_t i = 0; i < n; i++) {
+                receive(received, items[i]);
+            }
+            break;
+        default: {
+            const Item *run;
+            n = buffer.peekContiguous(&run);
+            for (size_t i = 0; i < n; i++) {
+                receive(received, run[i]);
+            }
+            buffer.consume(n);
+            break;
+        }
+        }
+        if (finished && n == 0 && buffer.empty()) {
+            return;
+        }
+    }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void test_lossy_producer(void) {
+    // The producer never waits, so it overruns the consumer now and then.
+    static SPSCRingBuffer<Item, CAPACITY> buffer;
+    std::atomic<bool> done(false);
+    Received received = {};
+    uint32_t rejected = 0;
+    std::thread consumerThread(consumer, std::ref(buffer), std::cref(done), std::ref(received));
+    Item bulk[BULK_ITEMS];
+    for (uint32_t seq = 0; seq < ITEMS;) {
+        if (seq % 2 == 0) {
+            rejected += buffer.push(makeItem(seq)) ? 0 : 1;
+            seq++;
+        } else {
+            size_t count = ITEMS - seq < BULK_ITEMS ? ITEMS - seq : BULK_ITEMS;
+            for (size_t i = 0; i < count; i++) {
+                bulk[i] = makeItem(seq + i);
+            }
+            size_t stored = buffer.pushBulk(bulk, count);
+            rejected += count - stored;
+            // Items after the first rejected one were not stored either; they are lost in order.
+            seq += count;
+        }
+    }
+    done.store(true, std::memory_order_release);
+    consumerThread.join();
+
+    TEST_ASSERT_EQUAL_UINT32(0, received.torn);
+    TEST_ASSERT_EQUAL_UINT32(0, received.outOfOrder);
+    TEST_ASSERT_EQUAL_UINT32(ITEMS, received.items + rejected);
+    TEST_ASSERT_EQUAL_UINT32(rejected, buffer.overrunCount());
+    // Lost items show up as gaps in the sequence, apart from any lost at the very end.
+    TEST_ASSERT_EQUAL_UINT32(rejected, received.skipped + (ITEMS - received.next));
+    TEST_ASSERT_LESS_OR_EQUAL(CAPACITY, buffer.highWaterMark());
+}
+
+static void test_retrying_producer(void) {
+    // The producer retries until each item is stored, so everything arrives.
+    static SPSCRingBuffer<Item, CAPACITY> buffer;
+    std::atomic<bool> done(false);
+    Received received = {};
+    uint32_t rejected = 0;
+    std::thread consumerThread(consumer, std::ref(buffer), std::cref(done), std::ref(received));
+    for (uint32_t seq = 0; seq < ITEMS; seq++) {
+        while (!buffer.push(makeItem(seq))) {
+            rejected++;
+            std::this_thread::yield();
+        }
+    }
+    done.store(true, std::memory_order_release);
+    consumerThread.join();
+
+    TEST_ASSERT_EQUAL_UINT32(0, received.torn);
+    TEST_ASSERT_EQUAL_UINT32(0, received.outOfOrder);
+    TEST_ASSERT_EQUAL_UINT32(ITEMS, received.items);
+    TEST_ASSERT_EQUAL_UINT32(0, received.skipped);
+    TEST_ASSERT_EQUAL_UINT32(ITEMS, received.next);
+    TEST_ASSERT_EQUAL_UINT32(rejected, buffer.overrunCount());
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_lossy_producer);
+    RUN_TEST(test_retrying_producer);
+    return UNITY_END();
+}
@@ -0,0 +1,97 @@
+// Streams a minute of synthetic ECG through the whole firmware, with the leads coming off for
+// 2 s of every 20, and checks what the server receives: samples, lead events and beats.
+
+#include <unity.h>
+
+#include <string>
+
+#include "NativeSimulation.h"
+
+#define RUN_SECONDS 60
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void test_no_sample_is_dropped(void) {
+    NativeSim::SamplingStats sampling = NativeSim::samplingStats();
+    TEST_ASSERT_GREATER_THAN(0, sampling.samplesCaptured);
+    TEST_ASSERT_EQUAL_UINT32(0, sampling.samplesDropped);
+}
+
+static void test_frames_decode(void) {
+    const NativeSim::ReceivedFrames &received = NativeSim::received();
+    TEST_ASSERT_GREATER_THAN(0, received.frames);
+    TEST_ASSERT_EQUAL_UINT32(0, received.badFrames);
+}
+
+static void test_lead_off_sends_events_instead_of_samples(void) {
+    const NativeSim::ReceivedFrames &received = NativeSim::received();
+#if !defined(ECG_CHANNEL_COUNT) || ECG_CHANNEL_COUNT == 1
+    // The script takes the leads off at 10 s, 30 s and 50 s.
+    TEST_ASSERT_EQUAL_UINT32(RUN_SECONDS / SIM_LEAD_OFF_EVERY_S, received.leadOffEvents);
+    TEST_ASSERT_EQUAL_UINT32(RUN_SECONDS / SIM_LEAD_OFF_EVERY_S, received.leadOnEvents);
+#endif
+    TEST_ASSERT_EQUAL_UINT32(0, received.leadOffFrames);
+}
+
+static void test_multi_lead_frames_flag_only_the_lead_that_is_off(void) {
+    const NativeSim::ReceivedFrames &received = NativeSim::received();
+#if defined(ECG_CHANNEL_COUNT) && ECG_CHANNEL_COUNT > 1
+    // Only lead 0's LO+ follows the script: 2 s at 10 s, 30 s and 50 s.
+    uint32_t scripted = RUN_SECONDS / SIM_LEAD_OFF_EVERY_S * SIM_LEAD_OFF_FOR_S * 1000000 / SIM_SAMPLE_PERIOD_US;
+    TEST_ASSERT_UINT32_WITHIN(RUN_SECONDS / SIM_LEAD_OFF_EVERY_S, scripted, received.leadOffSamples[0]);
+    TEST_ASSERT_EQUAL_UINT32(0, received.leadOffOutsideScript);
+    for (uint8_t c = 1; c < ECG_CHANNEL_COUNT; c++) {
+        TEST_ASSERT_EQUAL_UINT32(0, received.leadOffSamples[c]);
+    }
+#else
+    for (uint8_t c = 0; c < ECG_MAX_CHANNELS; c++) {
+        TEST_ASSERT_EQUAL_UINT32(0, received.leadOffSamples[c]);
+    }
+#endif
+}
+
+static void test_lead_events_follow_the_pins_within_a_sample(void) {
+    const NativeSim::ReceivedFrames &received = NativeSim::received();
+    TEST_ASSERT_LESS_OR_EQUAL(SIM_SAMPLE_PERIOD_US, received.maxReactionUs);
+    // The first frame after a reattach starts at the reattach event.
+    TEST_ASSERT_EQUAL(0, received.maxResumeUs);
+}
+
+static void test_beats_are_marked_on_their_r_peak(void) {
+    const NativeSim::ReceivedFrames &received = NativeSim::received();
+    // 72 bpm, less the 2 s outages and the 2 s of threshold learning after each of them
+    TEST_ASSERT_GREATER_THAN(RUN_SECONDS * 3 / 4, received.beats + received.earlierBeats);
+    TEST_ASSERT_EQUAL_UINT32(0, received.beatsOffPeak);
+    TEST_ASSERT_EQUAL_UINT32(0, received.earlierBeatsUnplaced);
+}
+
+static void test_heart_rate_is_withdrawn_while_the_detector_relearns(void) {
+    const NativeSim::ReceivedFrames &received = NativeSim::received();
+    TEST_ASSERT_GREATER_THAN(0, received.heartRateFrames);
+    TEST_ASSERT_EQUAL_UINT32(0, received.staleHeartRateFrames);
+}
+
+static void test_device_connects_with_its_id_and_answers_time_sync(void) {
+    std::string path = websockets::LoopbackServer::instance().lastPath();
+    TEST_ASSERT_TRUE(path.find("?device_id=" SIM_DEVICE_ID) != std::string::npos);
+    TEST_ASSERT_GREATER_THAN(0, NativeSim::received().timeSyncReplies);
+}
+
+int main(int, char **) {
+    NativeSim::begin(NativeSim::defaultOptions());
+    NativeSim::runUntil(RUN_SECONDS);
+    NativeSim::end();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_no_sample_is_dropped);
+    RUN_TEST(test_frames_decode);
+    RUN_TEST(test_lead_off_sends_events_instead_of_samples);
+    RUN_TEST(test_multi_lead_frames_flag_only_the_lead_that_is_off);
+    RUN_TEST(test_lead_events_follow_the_pins_within_a_sample);
+    RUN_TEST(test_beats_are_marked_on_their_r_peak);
+    RUN_TEST(test_heart_rate_is_withdrawn_while_the_detector_relearns);
+    RUN_TEST(test_device_connects_with_its_id_and_answers_time_sync);
+    return UNITY_END();
+}
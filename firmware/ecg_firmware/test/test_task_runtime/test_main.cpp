@@ -0,0 +1,120 @@
+// Runs real tasks on the POSIX backend of the task runtime (pio test -e native_threads) and
+// checks the stack high-water mark and CPU figures it measures.
+
+#include <string.h>
+#include <unity.h>
+
+#include "TaskRuntime.h"
+
+#if defined(TASK_RUNTIME_MANUAL)
+#error "test_task_runtime needs thread-backed tasks; run it in the native_threads environment"
+#endif
+
+#define STACK_BYTES (256 * 1024)
+#define DEEP_STEP_BYTES (128 * 1024)
+// Room the thread entry, the step call and nanosleep() take besides the step's own buffer
+#define STACK_OVERHEAD_BYTES (32 * 1024)
+#define PERIOD_MS 10
+#define BUSY_STEP_US 5000
+#define MEASURE_MS 500
+
+static std::atomic<uint32_t> s_stepsSeen(0);
+
+static void lightStep(void *) {
+    s_stepsSeen.fetch_add(1);
+}
+
+static void deepStep(void *) {
+    volatile uint8_t buffer[DEEP_STEP_BYTES];
+    memset(const_cast<uint8_t *>(buffer), 0, sizeof(buffer));
+    buffer[0] = buffer[DEEP_STEP_BYTES - 1];
+}
+
+static void busyStep(void *) {
+    uint32_t start = taskMicros();
+    while (taskMicros() - start < BUSY_STEP_US) {
+    }
+}
+
+/**
+ * @brief Sleeps until the task has run the given number of steps (for at most a second).
+ */
+static void waitForSteps(PeriodicTask &task, uint32_t steps) {
+    for (int i = 0; i < 1000 && task.getStats().iterations < steps; i++) {
+        taskSleepMs(1);
+    }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void test_stack_high_water_follows_the_deepest_step(void) {
+    TaskConfig config = {"light", STACK_BYTES, 1, TASK_ANY_CORE, PERIOD_MS};
+    PeriodicTask light(config, lightStep);
+    config.name = "deep";
+    PeriodicTask deep(config, deepStep);
+    TEST_ASSERT_TRUE(light.start());
+    TEST_ASSERT_TRUE(deep.start());
+    waitForSteps(light, 3);
+    waitForSteps(deep, 3);
+
+    uint32_t lightFree = light.getStats().stackHighWaterBytes;
+    uint32_t deepFree = deep.getStats().stackHighWaterBytes;
+    TEST_ASSERT_GREATER_THAN_UINT32(STACK_BYTES - STACK_OVERHEAD_BYTES, lightFree);
+    TEST_ASSERT_LESS_THAN_UINT32(STACK_BYTES - DEEP_STEP_BYTES, deepFree);
+    TEST_ASSERT_GREATER_THAN_UINT32(STACK_BYTES - DEEP_STEP_BYTES - STACK_OVERHEAD_BYTES, deepFree);
+    light.stop();
+    deep.stop();
+}
+
+static void test_cpu_load_matches_the_busy_share(void) {
+    TaskConfig config = {"busy", STACK_BYTES, 1, TASK_ANY_CORE, PERIOD_MS};
+    PeriodicTask busy(config, busyStep);
+    config.name = "idle";
+    PeriodicTask idle(config, lightStep);
+    TEST_ASSERT_TRUE(busy.start());
+    TEST_ASSERT_TRUE(idle.start());
+    busy.getStats();
+    idle.getStats();
+    taskSleepMs(MEASURE_MS);
+
+    // 5 ms busy per 15 ms cycle is ~333 permille. The bounds leave room for sleeps and
+    // steps that a busy host stretches.
+    PeriodicTask::Stats stats = busy.getStats();
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(BUSY_STEP_US, stats.maxStepUs);
+    TEST_ASSERT_GREATER_THAN_UINT32(100, stats.cpuLoadPermille);
+    TEST_ASSERT_LESS_THAN_UINT32(600, stats.cpuLoadPermille);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(static_cast<uint64_t>(stats.iterations) * BUSY_STEP_US, stats.busyUs);
+    PeriodicTask::Stats idleStats = idle.getStats();
+    TEST_ASSERT_LESS_THAN_UINT32(50, idleStats.cpuLoadPermille);
+
+    // The longest step covers the time since the previous getStats() only.
+    busy.stop();
+    idle.stop();
+    busy.getStats();
+    stats = busy.getStats();
+    TEST_ASSERT_EQUAL_UINT32(0, stats.maxStepUs);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.cpuLoadPermille);
+}
+
+static void test_stop_waits_for_the_task(void) {
+    TaskConfig config = {"stop", STACK_BYTES, 1, TASK_ANY_CORE, 1};
+    PeriodicTask task(config, lightStep);
+    TEST_ASSERT_TRUE(task.start());
+    TEST_ASSERT_TRUE(task.isRunning());
+    waitForSteps(task, 5);
+    task.stop();
+    TEST_ASSERT_FALSE(task.isRunning());
+    uint32_t steps = s_stepsSeen.load();
+    taskSleepMs(20);
+    TEST_ASSERT_EQUAL_UINT32(steps, s_stepsSeen.load());
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_stack_high_water_follows_the_deepest_step);
+    RUN_TEST(test_cpu_load_matches_the_busy_share);
+    RUN_TEST(test_stop_waits_for_the_task);
+    return UNITY_END();
+}
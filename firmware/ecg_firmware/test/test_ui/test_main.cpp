@@ -0,0 +1,127 @@
+// Checks the click classifier against scripted button timings with contact bounce, and the
+// timing and fades of the LED patterns.
+
+#include <unity.h>
+
+#include "ClickClassifier.h"
+#include "LEDPattern.h"
+
+// The network task polls the button this often, and the longest scripted case
+#define POLL_MS 10
+#define CASE_MS 4000
+
+/**
+ * @brief A scripted button: edge times alternate press, release, press... and the events
+ * the classifier must report, in order.
+ */
+struct ClickCase {
+    const char *name;
+    uint32_t edgesMs[10];
+    uint8_t edgeCount;
+    ButtonEvent expected[3];
+    uint8_t expectedCount;
+};
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+/**
+ * @brief Plays the edges of a case into a classifier, as the ISR and the network task
+ * would, and checks the events it reports.
+ */
+static void checkClicks(const ClickCase &c) {
+    ClickClassifier classifier;
+    ButtonEvent got[4];
+    uint8_t gotCount = 0;
+    uint8_t next = 0;
+    for (uint32_t t = 0; t <= CASE_MS; t++) {
+        // Edges arrive at their own time, as from the ISR; polls come every POLL_MS.
+        while (next < c.edgeCount && c.edgesMs[next] == t) {
+            classifier.edge(next % 2 == 0, t);
+            next++;
+        }
+        if (t % POLL_MS != 0) {
+            continue;
+        }
+        classifier.poll(t);
+        for (ButtonEvent e; (e = classifier.takeEvent()) != ButtonEvent::None;) {
+            TEST_ASSERT_LESS_THAN_MESSAGE(4, gotCount, c.name);
+            got[gotCount++] = e;
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT8_MESSAGE(c.expectedCount, gotCount, c.name);
+    for (uint8_t i = 0; i < gotCount; i++) {
+        TEST_ASSERT_EQUAL_UINT8_MESSAGE(static_cast<uint8_t>(c.expected[i]), static_cast<uint8_t>(got[i]), c.name);
+    }
+}
+
+static void test_clicks(void) {
+    const ButtonEvent S = ButtonEvent::SingleClick;
+    const ButtonEvent D = ButtonEvent::DoubleClick;
+    const ClickCase cases[] = {
+        {"click", {100, 180}, 2, {S}, 1},
+        {"bouncy click", {100, 103, 106, 200, 202, 205}, 6, {S}, 1},
+        {"double", {100, 180, 350, 430}, 4, {D}, 1},
+        {"bouncy double", {100, 103, 106, 180, 183, 186, 350, 353, 356, 430}, 10, {D}, 1},
+        {"two clicks", {100, 180, 900, 980}, 4, {S, S}, 2},
+        {"triple", {100, 180, 300, 380, 500, 580}, 6, {}, 0},
+        {"glitch", {100, 110}, 2, {}, 0},
+    };
+    for (const ClickCase &c : cases) {
+        checkClicks(c);
+    }
+}
+
+static void test_long_presses(void) {
+    const ButtonEvent S = ButtonEvent::SingleClick;
+    const ButtonEvent L = ButtonEvent::LongPress;
+    const ClickCase cases[] = {
+        {"long", {100, 2500}, 2, {L}, 1},
+        {"click, long", {100, 180, 300, 2200}, 4, {L}, 1},
+        {"long, click", {100, 1800, 2000, 2080}, 4, {L, S}, 2},
+    };
+    for (const ClickCase &c : cases) {
+        checkClicks(c);
+    }
+}
+
+/**
+ * @brief Checks the green channel of a pattern atMs after it started.
+ */
+static void checkPatternAt(const LEDPattern &pattern, uint32_t atMs, bool playing, uint8_t green) {
+    LEDPatternPlayer player;
+    player.play(&pattern, 1000); // Any start time; only the elapsed time counts
+    LEDColor color = {};
+    TEST_ASSERT_EQUAL(playing, player.colorAt(1000 + atMs, color));
+    if (playing) {
+        TEST_ASSERT_EQUAL_UINT8(green, color.green);
+    }
+}
+
+static void test_blink_repeats(void) {
+    checkPatternAt(LED_PATTERN_BLINK_GREEN, 0, true, 255);
+    checkPatternAt(LED_PATTERN_BLINK_GREEN, 300, true, 0);
+    checkPatternAt(LED_PATTERN_BLINK_GREEN, 60000, true, 255);
+}
+
+static void test_breathe_fades(void) {
+    checkPatternAt(LED_PATTERN_BREATHE_GREEN, 500, true, 127);
+    checkPatternAt(LED_PATTERN_BREATHE_GREEN, 1000, true, 255);
+    checkPatternAt(LED_PATTERN_BREATHE_GREEN, 1750, true, 64);
+}
+
+static void test_boot_pattern_ends(void) {
+    checkPatternAt(LED_PATTERN_BOOT, 700, true, 255);
+    checkPatternAt(LED_PATTERN_BOOT, 2000, false, 0);
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_clicks);
+    RUN_TEST(test_long_presses);
+    RUN_TEST(test_blink_repeats);
+    RUN_TEST(test_breathe_fades);
+    RUN_TEST(test_boot_pattern_ends);
+    return UNITY_END();
+}
@@ -0,0 +1,63 @@
+// FakeWiFiDriver.h
+// This header file defines FakeWiFiDriver, a scriptable WiFiDriver for the host tests.
+
+#ifndef FAKE_WIFI_DRIVER_H
+#define FAKE_WIFI_DRIVER_H
+
+#include "WiFiStateMachine.h"
+
+/**
+ * @brief A WiFiDriver with no radio behind it.
+ *
+ * It records what the state machine asked for and hands out the link events it is
+ * given, so WiFiStateMachine transitions and backoff timing can be exercised natively:
+ *
+ *     FakeWiFiDriver driver;
+ *     WiFiStateMachine wifi(driver);
+ *     wifi.connect("lab", "secret", 0);
+ *     driver.pushEvent(WiFiLinkEvent::Disconnected);
+ *     wifi.poll(10);   // -> WiFiState::Backoff, retry between 500 and 1000 ms
+ */
+class FakeWiFiDriver : public WiFiDriver {
+public:
+    uint32_t stationStarts = 0;     // startStation() calls
+    uint32_t accessPointStarts = 0; // startAccessPoint() calls
+    uint32_t stops = 0;             // stop() calls
+    bool accessPointResult = true;  // Returned by startAccessPoint()
+    uint32_t randomValue = 0;       // Returned by random(); 0 gives the shortest backoff
+
+    /**
+     * @brief Queues the event returned by the next takeEvent(), replacing any pending one.
+     */
+    void pushEvent(WiFiLinkEvent event) {
+        _event = event;
+    }
+
+    void startStation(const char *, const char *) override {
+        stationStarts++;
+    }
+
+    bool startAccessPoint(const char *, const char *) override {
+        accessPointStarts++;
+        return accessPointResult;
+    }
+
+    void stop() override {
+        stops++;
+    }
+
+    WiFiLinkEvent takeEvent() override {
+        WiFiLinkEvent event = _event;
+        _event = WiFiLinkEvent::None;
+        return event;
+    }
+
+    uint32_t random() override {
+        return randomValue;
+    }
+
+private:
+    WiFiLinkEvent _event = WiFiLinkEvent::None;
+};
+
+#endif // FAKE_WIFI_DRIVER_H
@@ -0,0 +1,137 @@
+// Drives the WiFi state machine with the fake driver: failed and timed-out attempts, the
+// bounds of the jittered backoff, and reconnecting after the link drops.
+
+#include <unity.h>
+
+#include "FakeWiFiDriver.h"
+#include "WiFiStateMachine.h"
+
+#define CONNECT_TIMEOUT_MS 5000
+#define BACKOFF_BASE_MS 1000
+#define BACKOFF_MAX_MS 16000
+
+static FakeWiFiDriver *driver;
+static WiFiStateMachine *wifi;
+
+void setUp(void) {
+    driver = new FakeWiFiDriver();
+    wifi = new WiFiStateMachine(*driver);
+    wifi->setTiming(CONNECT_TIMEOUT_MS, BACKOFF_BASE_MS, BACKOFF_MAX_MS);
+}
+
+void tearDown(void) {
+    delete wifi;
+    delete driver;
+}
+
+/**
+ * @brief Fails the current attempt and returns the backoff delay the state machine chose.
+ */
+static uint32_t failAttempt(uint32_t nowMs) {
+    driver->pushEvent(WiFiLinkEvent::Disconnected);
+    wifi->poll(nowMs);
+    TEST_ASSERT_EQUAL(WiFiState::Backoff, wifi->getState());
+    return wifi->getNextAttemptMs() - nowMs;
+}
+
+static void test_failed_and_timed_out_attempts_back_off(void) {
+    wifi->connect("lab", "secret", 0);
+    TEST_ASSERT_EQUAL(WiFiState::Connecting, wifi->getState());
+    TEST_ASSERT_EQUAL_UINT32(1, driver->stationStarts);
+
+    failAttempt(100);
+    TEST_ASSERT_EQUAL_UINT32(1, wifi->getStats().failures);
+    TEST_ASSERT_EQUAL_UINT8(1, wifi->getRetryCount());
+    TEST_ASSERT_EQUAL_UINT32(2, driver->stops); // One by connect(), one when backing off
+
+    // Nothing happens before the retry is due.
+    uint32_t nextMs = wifi->getNextAttemptMs();
+    wifi->poll(nextMs - 1);
+    TEST_ASSERT_EQUAL(WiFiState::Backoff, wifi->getState());
+    TEST_ASSERT_EQUAL_UINT32(1, driver->stationStarts);
+    wifi->poll(nextMs);
+    TEST_ASSERT_EQUAL(WiFiState::Connecting, wifi->getState());
+    TEST_ASSERT_EQUAL_UINT32(2, driver->stationStarts);
+
+    // An attempt that never reports back fails at the connect timeout.
+    wifi->poll(nextMs + CONNECT_TIMEOUT_MS - 1);
+    TEST_ASSERT_EQUAL(WiFiState::Connecting, wifi->getState());
+    wifi->poll(nextMs + CONNECT_TIMEOUT_MS);
+    TEST_ASSERT_EQUAL(WiFiState::Backoff, wifi->getState());
+    TEST_ASSERT_EQUAL_UINT32(2, wifi->getStats().failures);
+    TEST_ASSERT_EQUAL_UINT32(0, wifi->getStats().connections);
+}
+
+static void test_backoff_doubles_within_its_jitter_bounds(void) {
+    const uint32_t randomValues[] = {0, 1, 499, 0x7FFFFFFF, 0xFFFFFFFF};
+    for (uint32_t r : randomValues) {
+        driver->randomValue = r;
+        wifi->connect("lab", "secret", 0);
+        uint32_t nowMs = 0;
+        uint32_t ceilingMs = BACKOFF_BASE_MS;
+        for (int retry = 0; retry < 8; retry++) {
+            uint32_t delayMs = failAttempt(nowMs);
+            // Equal jitter: between half and all of min(base * 2^n, max).
+            TEST_ASSERT_GREATER_OR_EQUAL_UINT32(ceilingMs / 2, delayMs);
+            TEST_ASSERT_LESS_OR_EQUAL_UINT32(ceilingMs, delayMs);
+            TEST_ASSERT_EQUAL_UINT32(ceilingMs / 2 + r % (ceilingMs / 2 + 1), delayMs);
+            nowMs = wifi->getNextAttemptMs();
+            wifi->poll(nowMs);
+            TEST_ASSERT_EQUAL(WiFiState::Connecting, wifi->getState());
+            ceilingMs = ceilingMs * 2 < BACKOFF_MAX_MS ? ceilingMs * 2 : BACKOFF_MAX_MS;
+        }
+    }
+}
+
+static void test_backoff_survives_the_millis_wrap(void) {
+    const uint32_t startMs = 0xFFFFFF00;
+    wifi->connect("lab", "secret", startMs);
+    driver->randomValue = 0xFFFFFFFF;
+    uint32_t delayMs = failAttempt(startMs);
+    uint32_t nextMs = startMs + delayMs; // Past the wrap
+    TEST_ASSERT_LESS_THAN_UINT32(startMs, nextMs);
+    wifi->poll(startMs + 10);
+    TEST_ASSERT_EQUAL(WiFiState::Backoff, wifi->getState());
+    wifi->poll(nextMs);
+    TEST_ASSERT_EQUAL(WiFiState::Connecting, wifi->getState());
+}
+
+static void test_lost_link_reconnects_at_once(void) {
+    wifi->connect("lab", "secret", 0);
+    failAttempt(100);
+    wifi->poll(wifi->getNextAttemptMs());
+    failAttempt(wifi->getStateSinceMs() + 100);
+    TEST_ASSERT_EQUAL_UINT8(2, wifi->getRetryCount());
+    wifi->poll(wifi->getNextAttemptMs());
+    driver->pushEvent(WiFiLinkEvent::Connected);
+    wifi->poll(wifi->getStateSinceMs() + 200);
+    TEST_ASSERT_TRUE(wifi->isConnected());
+    TEST_ASSERT_EQUAL_UINT8(0, wifi->getRetryCount());
+
+    // A drop from Connected retries straight away, without backoff.
+    uint32_t starts = driver->stationStarts;
+    driver->pushEvent(WiFiLinkEvent::Disconnected);
+    wifi->poll(60000);
+    TEST_ASSERT_EQUAL(WiFiState::Connecting, wifi->getState());
+    TEST_ASSERT_EQUAL_UINT32(starts + 1, driver->stationStarts);
+    TEST_ASSERT_EQUAL_UINT32(1, wifi->getStats().linkLosses);
+    driver->pushEvent(WiFiLinkEvent::Connected);
+    wifi->poll(61000);
+    TEST_ASSERT_TRUE(wifi->isConnected());
+    TEST_ASSERT_EQUAL_UINT32(2, wifi->getStats().connections);
+
+    // Failing again after that starts over at the base delay.
+    driver->randomValue = 0xFFFFFFFF;
+    driver->pushEvent(WiFiLinkEvent::Disconnected);
+    wifi->poll(70000);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(BACKOFF_BASE_MS, failAttempt(70100));
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_failed_and_timed_out_attempts_back_off);
+    RUN_TEST(test_backoff_doubles_within_its_jitter_bounds);
+    RUN_TEST(test_backoff_survives_the_millis_wrap);
+    RUN_TEST(test_lost_link_reconnects_at_once);
+    return UNITY_END();
+}
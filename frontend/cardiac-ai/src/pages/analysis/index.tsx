@@ -190,14 +190,24 @@ const Analysis = () => {
 
 	socket.onmessage = (event) => {
 		const rawValue = event.data.trim();
-		const ecgPoint = parseFloat(rawValue);
+		// Batched devices send a JSON array of points, older firmware a single number.
+		let ecgPoints: number[];
+		try {
+			const parsed = JSON.parse(rawValue);
+			if (parsed && typeof parsed === "object" && parsed.type === "lead_off") {
+				setLogMessage(parsed.off ? "ECG leads disconnected" : "ECG leads connected");
+				return;
+			}
+			ecgPoints = Array.isArray(parsed) ? parsed : [parsed];
+		} catch {
+			ecgPoints = [parseFloat(rawValue)];
+		}
 
-		if (!isNaN(ecgPoint)) {
-			console.log("Received ECG point:", ecgPoint);
+		if (ecgPoints.length > 0 && ecgPoints.every((p) => typeof p === "number" && !isNaN(p))) {
 			const dataSet = (ecgChart?.data.datasets[0].data as number[]) || [];
-			dataSet.push(ecgPoint);
+			dataSet.push(...ecgPoints);
 			if (dataSet.length > MAX_POINTS) {
-				dataSet.shift();
+				dataSet.splice(0, dataSet.length - MAX_POINTS);
 			}
 			ecgChart?.update("none");
 		} else {